@@ -0,0 +1,28 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/benchmark/micro_benchmarks/micro_benchmarks.cpp" "CMakeFiles/micro_benchmarks.dir/micro_benchmarks/micro_benchmarks.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/micro_benchmarks/micro_benchmarks.cpp.o.d"
+  "/root/repo/src/cyclic_task.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/cyclic_task.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/cyclic_task.cpp.o.d"
+  "/root/repo/src/kinect_frame.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame.cpp.o.d"
+  "/root/repo/src/kinect_frame_source.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o.d"
+  "/root/repo/src/kinect_recording.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_recording.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_recording.cpp.o.d"
+  "/root/repo/src/message_broker.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/message_broker.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/message_broker.cpp.o.d"
+  "/root/repo/src/resp_writer.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/resp_writer.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/resp_writer.cpp.o.d"
+  "/root/repo/src/state_persistence.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/state_persistence.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/state_persistence.cpp.o.d"
+  "/root/repo/src/synthetic_kinect.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o.d"
+  "/root/repo/test/common/fakes/resp_server_fake.cpp" "CMakeFiles/micro_benchmarks.dir/root/repo/test/common/fakes/resp_server_fake.cpp.o" "gcc" "CMakeFiles/micro_benchmarks.dir/root/repo/test/common/fakes/resp_server_fake.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,29 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/micro_benchmarks.dir/micro_benchmarks/micro_benchmarks.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/micro_benchmarks/micro_benchmarks.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/cyclic_task.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/cyclic_task.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_recording.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/kinect_recording.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/message_broker.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/message_broker.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/resp_writer.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/resp_writer.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/state_persistence.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/state_persistence.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o.d"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/test/common/fakes/resp_server_fake.cpp.o"
+  "CMakeFiles/micro_benchmarks.dir/root/repo/test/common/fakes/resp_server_fake.cpp.o.d"
+  "micro_benchmarks"
+  "micro_benchmarks.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/micro_benchmarks.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,40 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/benchmark/fakes/alarm_module_factory_fake.cpp" "CMakeFiles/pipeline_benchmarks.dir/fakes/alarm_module_factory_fake.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/fakes/alarm_module_factory_fake.cpp.o.d"
+  "/root/repo/benchmark/fakes/kinect_factory_fake.cpp" "CMakeFiles/pipeline_benchmarks.dir/fakes/kinect_factory_fake.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/fakes/kinect_factory_fake.cpp.o.d"
+  "/root/repo/benchmark/fakes/message_broker_fake.cpp" "CMakeFiles/pipeline_benchmarks.dir/fakes/message_broker_fake.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/fakes/message_broker_fake.cpp.o.d"
+  "/root/repo/benchmark/pipeline_benchmarks/pipeline_benchmarks.cpp" "CMakeFiles/pipeline_benchmarks.dir/pipeline_benchmarks/pipeline_benchmarks.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/pipeline_benchmarks/pipeline_benchmarks.cpp.o.d"
+  "/root/repo/src/alarm.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/alarm.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/alarm.cpp.o.d"
+  "/root/repo/src/async_file_writer.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/async_file_writer.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/async_file_writer.cpp.o.d"
+  "/root/repo/src/common.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/common.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/common.cpp.o.d"
+  "/root/repo/src/cyclic_task.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/cyclic_task.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/cyclic_task.cpp.o.d"
+  "/root/repo/src/detection.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection.cpp.o.d"
+  "/root/repo/src/detection_storage.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection_storage.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection_storage.cpp.o.d"
+  "/root/repo/src/frame_container.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/frame_container.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/frame_container.cpp.o.d"
+  "/root/repo/src/jpeg_cache.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/jpeg_cache.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/jpeg_cache.cpp.o.d"
+  "/root/repo/src/kinect_frame.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame.cpp.o.d"
+  "/root/repo/src/kinect_frame_source.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o.d"
+  "/root/repo/src/kinect_recording.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_recording.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_recording.cpp.o.d"
+  "/root/repo/src/liveview.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview.cpp.o.d"
+  "/root/repo/src/liveview_shm.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview_shm.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview_shm.cpp.o.d"
+  "/root/repo/src/mjpeg_server.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/mjpeg_server.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/mjpeg_server.cpp.o.d"
+  "/root/repo/src/persistence_worker.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/persistence_worker.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/persistence_worker.cpp.o.d"
+  "/root/repo/src/state_persistance_factory.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistance_factory.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistance_factory.cpp.o.d"
+  "/root/repo/src/state_persistence.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistence.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistence.cpp.o.d"
+  "/root/repo/src/synthetic_kinect.cpp" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o" "gcc" "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,53 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/pipeline_benchmarks.dir/fakes/alarm_module_factory_fake.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/fakes/alarm_module_factory_fake.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/fakes/kinect_factory_fake.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/fakes/kinect_factory_fake.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/fakes/message_broker_fake.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/fakes/message_broker_fake.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/pipeline_benchmarks/pipeline_benchmarks.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/pipeline_benchmarks/pipeline_benchmarks.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/alarm.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/alarm.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/async_file_writer.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/async_file_writer.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/common.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/common.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/cyclic_task.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/cyclic_task.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection_storage.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/detection_storage.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/frame_container.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/frame_container.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/jpeg_cache.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/jpeg_cache.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_frame_source.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_recording.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/kinect_recording.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview_shm.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/liveview_shm.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/mjpeg_server.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/mjpeg_server.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/persistence_worker.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/persistence_worker.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistance_factory.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistance_factory.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistence.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/state_persistence.cpp.o.d"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o"
+  "CMakeFiles/pipeline_benchmarks.dir/root/repo/src/synthetic_kinect.cpp.o.d"
+  "pipeline_benchmarks"
+  "pipeline_benchmarks.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/pipeline_benchmarks.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
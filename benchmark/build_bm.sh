@@ -0,0 +1,81 @@
+#!/bin/bash
+
+set -e
+
+################################################################################
+# Parameters
+################################################################################
+BENCHMARK_FILES=("micro_benchmarks"
+                 "pipeline_benchmarks")
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+DEFAULT_BUILD_FOLDER="build"
+ABS_BUILD_FOLDER="$SCRIPT_DIR/$DEFAULT_BUILD_FOLDER"
+RUN_BENCHMARKS=false
+REDIS_UNIX_SOCKET=""
+
+################################################################################
+# Option menu
+################################################################################
+usage() { echo "Usage: $0 [-b <build folder>] [-s <sdk folder>] [-r (run benchmarks)] [-u <redis unix socket>] [-C (clean)]" 1>&2; exit 1; }
+
+while getopts ":b:s:ru:C" o; do
+    case "${o}" in
+        b)
+            FOLDER=${OPTARG}
+            case $FOLDER in
+            /*) ABS_BUILD_FOLDER="$FOLDER" ;;
+            *) ABS_BUILD_FOLDER="$SCRIPT_DIR/$FOLDER" ;;
+            esac
+            ;;
+        s)
+            FOLDER=${OPTARG}
+            source $FOLDER/environment-setup-*
+            ;;
+        r)
+            RUN_BENCHMARKS=true
+            ;;
+        u)
+            REDIS_UNIX_SOCKET=${OPTARG}
+            ;;
+        C)
+            rm -rf $ABS_BUILD_FOLDER
+            exit 0;
+            ;;
+        *)
+            usage
+            ;;
+    esac
+done
+shift $((OPTIND-1))
+
+echo $ABS_BUILD_FOLDER
+
+################################################################################
+# Create and enter the build folder
+################################################################################
+mkdir -p ${ABS_BUILD_FOLDER};cd ${ABS_BUILD_FOLDER};
+
+################################################################################
+# Cmake
+################################################################################
+if [ -n "${REDIS_UNIX_SOCKET}" ]; then
+    COMPILATION_DEFINITIONS+=-DREDIS_UNIX_SOCKET=\"${REDIS_UNIX_SOCKET}\"
+else
+    COMPILATION_DEFINITIONS+=-UREDIS_UNIX_SOCKET
+fi
+cmake ${SCRIPT_DIR} ${COMPILATION_DEFINITIONS};
+
+################################################################################
+# Make
+################################################################################
+make -j$(nproc);
+
+################################################################################
+# Execute benchmarks, one JSON result file per binary to compare between commits
+################################################################################
+if [ "$RUN_BENCHMARKS" == true ]; then
+    for BENCHMARK in ${BENCHMARK_FILES[@]}; do
+        $ABS_BUILD_FOLDER/$BENCHMARK --benchmark_out=$ABS_BUILD_FOLDER/$BENCHMARK.json --benchmark_out_format=json
+    done
+fi
@@ -0,0 +1,86 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file latency_recorder.hpp
+ *
+ */
+
+#ifndef LATENCY_RECORDER__H_
+#define LATENCY_RECORDER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+class LatencyRecorder
+{
+public:
+    LatencyRecorder(std::string stage) : m_stage(stage)
+    {
+    }
+
+    void Add(std::chrono::steady_clock::duration latency)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_samples.push_back(std::chrono::duration<double, std::micro>(latency).count());
+    }
+
+    void Add(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+    {
+        Add(end - begin);
+    }
+
+    double Percentile(double percentile)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        double retval = 0.0;
+
+        if(!m_samples.empty())
+        {
+            size_t index = static_cast<size_t>(percentile / 100.0 * (m_samples.size() - 1) + 0.5);
+            std::nth_element(m_samples.begin(), m_samples.begin() + index, m_samples.end());
+            retval = m_samples[index];
+        }
+
+        return retval;
+    }
+
+    /**
+     * @brief Add <stage>_p50_us, <stage>_p99_us and <stage>_samples to the benchmark's counters,
+     *        they end up in the JSON output next to the timings
+     */
+    void Report(benchmark::State& state)
+    {
+        size_t samples;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            samples = m_samples.size();
+        }
+
+        state.counters[m_stage + "_p50_us"]  = Percentile(50.0);
+        state.counters[m_stage + "_p99_us"]  = Percentile(99.0);
+        state.counters[m_stage + "_samples"] = samples;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_samples.clear();
+    }
+
+private:
+    std::string m_stage;
+    std::mutex m_mutex;
+    std::vector<double> m_samples;
+};
+
+#endif /* LATENCY_RECORDER__H_ */
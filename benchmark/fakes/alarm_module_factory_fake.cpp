@@ -0,0 +1,34 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file alarm_module_factory_fake.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+
+#include "../../inc/alarm_module_factory.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+extern DetectionConfig g_benchmark_detection_config;
+extern std::shared_ptr<DetectionObserver> WrapDetectionObserver(std::shared_ptr<DetectionObserver> detection_observer);
+
+/* Real modules, but Detection uses the benchmark's configuration and its observer is timed */
+std::shared_ptr<IAlarmModule> AlarmModuleFactory::CreateDetectionModule(std::shared_ptr<IKinect> kinect,
+                                                                        std::shared_ptr<DetectionObserver> detection_observer,
+                                                                        DetectionConfig detection_config)
+{
+    return std::make_shared<Detection>(kinect, WrapDetectionObserver(detection_observer), g_benchmark_detection_config);
+}
+
+std::shared_ptr<IAlarmModule> AlarmModuleFactory::CreateLiveviewModule(std::shared_ptr<IKinect> kinect,
+                                                                       std::shared_ptr<LiveviewObserver> liveview_observer,
+                                                                       LiveviewConfig liveview_config)
+{
+    return std::make_shared<Liveview>(kinect, liveview_observer, liveview_config);
+}
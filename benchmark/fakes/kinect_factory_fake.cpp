@@ -0,0 +1,23 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file kinect_factory_fake.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+
+#include "../../inc/kinect_factory.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+extern std::shared_ptr<IKinect> g_benchmark_kinect;
+
+std::shared_ptr<IKinect> KinectFactory::Create(uint32_t timeout_ms)
+{
+    return g_benchmark_kinect;
+}
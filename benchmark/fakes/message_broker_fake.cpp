@@ -0,0 +1,62 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file message_broker_fake.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include "message_broker_fake.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+MessageBrokerFake::MessageBrokerFake()
+{
+}
+
+MessageBrokerFake::~MessageBrokerFake()
+{
+}
+
+int MessageBrokerFake::Subscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer)
+{
+    return 0;
+}
+
+int MessageBrokerFake::Unsubscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer)
+{
+    return 0;
+}
+
+int MessageBrokerFake::Publish(const std::string& channel, const std::string& message)
+{
+    return 0;
+}
+
+int MessageBrokerFake::GetVariable(Variable& variable)
+{
+    return 0;
+}
+
+int MessageBrokerFake::SetVariable(const Variable& variable)
+{
+    return 0;
+}
+
+int MessageBrokerFake::SetVariableExpiration(const Variable& variable, int livetime_seconds)
+{
+    return 0;
+}
+
+int MessageBrokerFake::Clear()
+{
+    return 0;
+}
+
+int MessageBrokerFake::ExecuteBatch(const MessageBrokerBatch& batch, bool atomic)
+{
+    return 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file message_broker_fake.hpp
+ *
+ */
+
+#ifndef MESSAGE_BROKER_FAKE__H_
+#define MESSAGE_BROKER_FAKE__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+
+#include "../../inc/message_broker_interface.hpp"
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/* Accepts everything, so the pipeline benchmark doesn't depend on a Redis server */
+class MessageBrokerFake : public IMessageBroker
+{
+public:
+    MessageBrokerFake();
+    virtual ~MessageBrokerFake();
+
+    int Subscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer) override;
+    int Unsubscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer) override;
+    int Publish(const std::string& channel, const std::string& message) override;
+    int GetVariable(Variable& variable) override;
+    int SetVariable(const Variable& variable) override;
+    int SetVariableExpiration(const Variable& variable, int livetime_seconds) override;
+    int Clear() override;
+    int ExecuteBatch(const MessageBrokerBatch& batch, bool atomic = false) override;
+};
+
+#endif /* MESSAGE_BROKER_FAKE__H_ */
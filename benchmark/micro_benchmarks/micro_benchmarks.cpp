@@ -0,0 +1,297 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file micro_benchmarks.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+#include <vector>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+#include "../../inc/global_parameters.hpp"
+#include "../../inc/kinect_frame.hpp"
+#include "../../inc/synthetic_kinect.hpp"
+#include "../../inc/base64_encoder.hpp"
+#include "../../inc/state_persistence.hpp"
+#include "../../inc/message_broker.hpp"
+#include "../../inc/resp_writer.hpp"
+#include "../../test/common/fakes/resp_server_fake.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+/* Without a Redis server given the broker benchmarks run against the in-process stand-in */
+#ifdef REDIS_UNIX_SOCKET
+    #define RESP_SERVER_FAKE false
+#else
+    #define REDIS_UNIX_SOCKET "/tmp/kinectalarm_benchmark_redis.sock"
+    #define RESP_SERVER_FAKE true
+#endif
+
+#define BENCHMARK_DB_PATH "/tmp/kinectalarm_benchmark.db"
+#define BENCHMARK_JPEG_PATH "/tmp/kinectalarm_benchmark.jpeg"
+
+/*******************************************************************
+ * Static functions
+ *******************************************************************/
+
+/* Frames of the default synthetic scene, second one with the blobs in it */
+static void RenderSceneFrames(KinectDepthFrame& empty_frame, KinectDepthFrame& intrusion_frame, KinectVideoFrame& video_frame)
+{
+    SyntheticSceneConfig config;
+    SyntheticKinect synthetic_kinect(config, KINECT_GETFRAMES_TIMEOUT_MS);
+    std::vector<uint16_t> depth_data, video_data;
+
+    synthetic_kinect.Init();
+
+    for(uint64_t sequence = 1; !synthetic_kinect.IsIntrusionFrame(sequence); sequence++)
+    {
+        synthetic_kinect.RenderFrames(depth_data, video_data);
+    }
+    empty_frame.Fill(depth_data.data(), 1);
+    video_frame.Fill(video_data.data(), 1);
+
+    synthetic_kinect.RenderFrames(depth_data, video_data);
+    intrusion_frame.Fill(depth_data.data(), 2);
+}
+
+/*******************************************************************
+ * Benchmarks
+ *******************************************************************/
+static void BM_ComputeDifferences(benchmark::State& state)
+{
+    KinectDepthFrame reference(DEPTH_WIDTH, DEPTH_HEIGHT);
+    KinectDepthFrame frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+    KinectVideoFrame video_frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+
+    RenderSceneFrames(reference, frame, video_frame);
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame.ComputeDifferences(reference, DETECTION_SENSITIVITY));
+    }
+
+    state.SetItemsProcessed(state.iterations() * DEPTH_WIDTH * DEPTH_HEIGHT);
+}
+BENCHMARK(BM_ComputeDifferences);
+
+static void BM_SaveToJpegInMemory(benchmark::State& state)
+{
+    KinectDepthFrame reference(DEPTH_WIDTH, DEPTH_HEIGHT);
+    KinectDepthFrame frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+    KinectVideoFrame video_frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+    std::vector<uint8_t> jpeg;
+
+    RenderSceneFrames(reference, frame, video_frame);
+
+    for(auto _ : state)
+    {
+        video_frame.SaveToJpegInMemory(jpeg, ALARM_BRIGHTNESS, ALARM_CONTRAST);
+        benchmark::DoNotOptimize(jpeg.data());
+    }
+
+    state.counters["jpeg_bytes"] = jpeg.size();
+}
+BENCHMARK(BM_SaveToJpegInMemory)->Unit(benchmark::kMillisecond);
+
+static void BM_SaveToJpegInFile(benchmark::State& state)
+{
+    KinectDepthFrame reference(DEPTH_WIDTH, DEPTH_HEIGHT);
+    KinectDepthFrame frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+    KinectVideoFrame video_frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+
+    RenderSceneFrames(reference, frame, video_frame);
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(video_frame.SaveToJpegInFile(BENCHMARK_JPEG_PATH, ALARM_BRIGHTNESS, ALARM_CONTRAST));
+    }
+
+    remove(BENCHMARK_JPEG_PATH);
+}
+BENCHMARK(BM_SaveToJpegInFile)->Unit(benchmark::kMillisecond);
+
+static void BM_Base64Encode(benchmark::State& state)
+{
+    Base64Encoder base64_encoder;
+    std::string input(state.range(0), '\xA5');
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(base64_encoder.Encode(input).data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Base64Encode)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+static void BM_DataTableInsertItem(benchmark::State& state)
+{
+    const Entry table_definition = {
+        {"ID",           DataType::Integer,},
+        {"DATE",         DataType::Integer,},
+        {"DURATION",     DataType::Integer,},
+        {"FILENAME_IMG", DataType::String,},
+        {"FILENAME_VID", DataType::String,}
+    };
+    /* Committed one by one with a full sync, or batched in the background */
+    std::shared_ptr<Database> database = (state.range(0) == 0) ?
+                                          std::make_shared<Database>(BENCHMARK_DB_PATH) :
+                                          std::make_shared<Database>(BENCHMARK_DB_PATH, DatabaseSynchronous::Normal, state.range(0));
+    DataTable data_table(database, "DETECTIONS", table_definition);
+    Entry item = table_definition;
+    int32_t id = 0;
+
+    item[1].value = 1700000000;
+    item[2].value = 42;
+    item[3].value = std::string(DETECTION_PATH "/0_capture.zip");
+    item[4].value = std::string(DETECTION_PATH "/0_capture_vid.mp4");
+
+    for(auto _ : state)
+    {
+        item[0].value = id++;
+        if(0 != data_table.InsertItem(item))
+        {
+            state.SkipWithError("InsertItem() failed");
+            break;
+        }
+    }
+
+    data_table.DeleteTable();
+    database->RemoveDatabase();
+}
+BENCHMARK(BM_DataTableInsertItem)->Arg(0)->Arg(SQLITE_FLUSH_INTERVAL_MS)->Unit(benchmark::kMicrosecond);
+
+/* Stand-in server, if used, with the reply latency given in microseconds */
+static std::unique_ptr<RespServerFake> StartRespServer(int64_t latency_us)
+{
+    std::unique_ptr<RespServerFake> resp_server;
+
+    if(RESP_SERVER_FAKE)
+    {
+        resp_server = std::make_unique<RespServerFake>(REDIS_UNIX_SOCKET);
+        resp_server->SetReplyLatency(std::chrono::microseconds(latency_us));
+    }
+
+    return resp_server;
+}
+
+/* Asynchronous path: Publish() only queues, the event loop pipelines the commands */
+static void BM_MessageBrokerPublish(benchmark::State& state)
+{
+    std::unique_ptr<RespServerFake> resp_server;
+    std::unique_ptr<MessageBroker> message_broker;
+    std::string message(state.range(0), 'a');
+
+    try
+    {
+        resp_server = StartRespServer(state.range(1));
+        message_broker = std::make_unique<MessageBroker>(REDIS_UNIX_SOCKET);
+    }
+    catch(const std::exception& e)
+    {
+        state.SkipWithError("MessageBroker creation failed");
+        return;
+    }
+    if(!message_broker->IsConnected())
+    {
+        state.SkipWithError("Couldn't connect to " REDIS_UNIX_SOCKET);
+        return;
+    }
+
+    for(auto _ : state)
+    {
+        /* Sustained rate: wait for the loop instead of overflowing the pending limit */
+        PublishStats stats = message_broker->GetPublishStats();
+        while(stats.queued - stats.sent - stats.failed - stats.dropped >= MESSAGE_BROKER_MAX_PENDING_PUBLISH / 2)
+        {
+            std::this_thread::yield();
+            stats = message_broker->GetPublishStats();
+        }
+
+        if(0 != message_broker->Publish(REDIS_LIVEFRAMES_CHANNEL, message))
+        {
+            state.SkipWithError("Publish() failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MessageBrokerPublish)->ArgsProduct({{64, 64 << 10}, {0, 100}})->ArgNames({"size", "latency_us"})->Unit(benchmark::kMicrosecond);
+
+/* Synchronous path: each PUBLISH waits for its reply */
+static void BM_MessageBrokerPublishSync(benchmark::State& state)
+{
+    std::unique_ptr<RespServerFake> resp_server;
+    std::unique_ptr<MessageBroker> message_broker;
+    MessageBrokerBatch batch;
+
+    batch.Publish(REDIS_LIVEFRAMES_CHANNEL, std::string(state.range(0), 'a'));
+
+    try
+    {
+        resp_server = StartRespServer(state.range(1));
+        message_broker = std::make_unique<MessageBroker>(REDIS_UNIX_SOCKET);
+    }
+    catch(const std::exception& e)
+    {
+        state.SkipWithError("MessageBroker creation failed");
+        return;
+    }
+    if(!message_broker->IsConnected())
+    {
+        state.SkipWithError("Couldn't connect to " REDIS_UNIX_SOCKET);
+        return;
+    }
+
+    for(auto _ : state)
+    {
+        if(0 != message_broker->ExecuteBatch(batch))
+        {
+            state.SkipWithError("ExecuteBatch() failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MessageBrokerPublishSync)->ArgsProduct({{64, 64 << 10}, {0, 100}})->ArgNames({"size", "latency_us"})->Unit(benchmark::kMicrosecond);
+
+static void BM_RespWriterSetVariable(benchmark::State& state)
+{
+    RespWriter command_writer;
+    const Variable variable{"det_numdet", DataType::Integer, 1234};
+
+    for(auto _ : state)
+    {
+        command_writer.Clear();
+        command_writer.BeginCommand(3);
+        command_writer.AddArgument("SET");
+        command_writer.AddArgument(variable.name);
+        command_writer.AddArgument(variable);
+        benchmark::DoNotOptimize(command_writer.GetData());
+    }
+}
+BENCHMARK(BM_RespWriterSetVariable);
+
+static void BM_SyntheticRenderFrames(benchmark::State& state)
+{
+    SyntheticSceneConfig config;
+    SyntheticKinect synthetic_kinect(config, KINECT_GETFRAMES_TIMEOUT_MS);
+    std::vector<uint16_t> depth_data, video_data;
+
+    synthetic_kinect.Init();
+
+    for(auto _ : state)
+    {
+        synthetic_kinect.RenderFrames(depth_data, video_data);
+        benchmark::DoNotOptimize(depth_data.data());
+    }
+}
+BENCHMARK(BM_SyntheticRenderFrames)->Unit(benchmark::kMicrosecond);
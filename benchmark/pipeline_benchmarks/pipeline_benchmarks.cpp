@@ -0,0 +1,312 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file pipeline_benchmarks.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <benchmark/benchmark.h>
+
+#include "../../inc/global_parameters.hpp"
+#include "../../inc/common.hpp"
+#include "../../inc/alarm.hpp"
+#include "../../inc/synthetic_kinect.hpp"
+#include "../../inc/state_persistence_factory.hpp"
+#include "../common/latency_recorder.hpp"
+#include "../fakes/message_broker_fake.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define BENCHMARK_DB_PATH "/tmp/kinectalarm_pipeline_benchmark.db"
+#define BENCHMARK_INTRUSION_MS 300U
+#define BENCHMARK_IDLE_MS      600U
+#define BENCHMARK_TIMEOUT_MS   10000U
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Timestamps the frames as they leave the synthetic Kinect and the Detection events as
+ * they reach the Alarm, and turns them into per stage latencies:
+ *
+ *   detection   : first depth frame with the intruder -> IntrusionStarted()
+ *   capture     : video frame delivered by the Kinect -> IntrusionFrame() with that frame
+ *   alarm_frame : Alarm's IntrusionFrame() (frame copied and pushed to the encode stage)
+ *   release     : first depth frame without the intruder -> IntrusionStopped(), includes the cooldown
+ *   alarm_stop  : Alarm's IntrusionStopped() (SQLite insert, status write, events)
+ *   drain       : IntrusionStopped() -> every frame of the intrusion encoded and handed to the file writer
+ */
+class PipelineProbe : public KinectFrameObserver
+{
+public:
+    LatencyRecorder detection{"detection"};
+    LatencyRecorder capture{"capture"};
+    LatencyRecorder alarm_frame{"alarm_frame"};
+    LatencyRecorder release{"release"};
+    LatencyRecorder alarm_stop{"alarm_stop"};
+    LatencyRecorder drain{"drain"};
+
+    PipelineProbe(std::shared_ptr<SyntheticKinect> synthetic_kinect) :
+        m_synthetic_kinect(synthetic_kinect),
+        m_intrusions_stopped(0)
+    {
+    }
+
+    void NewDepthFrame(const KinectDepthFrame& frame, uint64_t sequence) override
+    {
+        uint32_t timestamp = frame.GetTimestamp();
+        bool intrusion = m_synthetic_kinect->IsIntrusionFrame(timestamp);
+        bool previous_intrusion = (timestamp > 1) && m_synthetic_kinect->IsIntrusionFrame(timestamp - 1);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(intrusion && !previous_intrusion)
+        {
+            m_intrusion_begin = std::chrono::steady_clock::now();
+        }
+        else if(!intrusion && previous_intrusion)
+        {
+            m_intrusion_end = std::chrono::steady_clock::now();
+        }
+    }
+
+    void NewVideoFrame(const KinectVideoFrame& frame, uint64_t sequence) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_video_delivery[frame.GetTimestamp()] = std::chrono::steady_clock::now();
+
+        /* Only the recent frames can still be picked by Detection */
+        while(m_video_delivery.size() > 1024)
+        {
+            m_video_delivery.erase(m_video_delivery.begin());
+        }
+    }
+
+    void IntrusionStarted(std::chrono::steady_clock::time_point now)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        /* Ignore the detections that don't follow an intruder entering the scene */
+        if(m_intrusion_begin > m_intrusion_end)
+        {
+            detection.Add(m_intrusion_begin, now);
+        }
+    }
+
+    void IntrusionFrame(uint32_t timestamp, std::chrono::steady_clock::time_point now)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_video_delivery.find(timestamp);
+        if(it != m_video_delivery.end())
+        {
+            capture.Add(it->second, now);
+        }
+    }
+
+    void IntrusionStopped(std::chrono::steady_clock::time_point now)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_intrusion_end > m_intrusion_begin)
+        {
+            release.Add(m_intrusion_end, now);
+        }
+        m_intrusions_stopped++;
+        m_intrusion_stopped = now;
+        m_cv.notify_all();
+    }
+
+    /**
+     * @brief Wait for the next intrusion to be stopped and for its frames to go through the Alarm's stages
+     *
+     * @return 0 on success, -1 on timeout
+     */
+    int WaitIntrusion(Alarm& alarm)
+    {
+        int retval = -1;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        uint32_t intrusions_stopped = m_intrusions_stopped;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(BENCHMARK_TIMEOUT_MS);
+
+        if(m_cv.wait_until(lock, deadline, [&] { return m_intrusions_stopped != intrusions_stopped; }))
+        {
+            std::chrono::steady_clock::time_point stopped = m_intrusion_stopped;
+            lock.unlock();
+
+            /* Drained when every item pushed to the encode and disk stages is processed */
+            while(std::chrono::steady_clock::now() < deadline)
+            {
+                FramePipelineStats stats = alarm.GetPipelineStats();
+                if(stats.encode.pushed == stats.encode.processed && stats.disk.pushed == stats.disk.processed)
+                {
+                    drain.Add(stopped, std::chrono::steady_clock::now());
+                    retval = 0;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+        return retval;
+    }
+
+    void Report(benchmark::State& state)
+    {
+        for(LatencyRecorder* recorder : {&detection, &capture, &alarm_frame, &release, &alarm_stop, &drain})
+        {
+            recorder->Report(state);
+        }
+    }
+
+private:
+    std::shared_ptr<SyntheticKinect> m_synthetic_kinect;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::chrono::steady_clock::time_point m_intrusion_begin, m_intrusion_end, m_intrusion_stopped;
+    std::map<uint32_t, std::chrono::steady_clock::time_point> m_video_delivery;
+    uint32_t m_intrusions_stopped;
+};
+
+class TimingDetectionObserver : public DetectionObserver
+{
+public:
+    TimingDetectionObserver(std::shared_ptr<DetectionObserver> detection_observer);
+    void IntrusionStarted() override;
+    void IntrusionStopped(uint32_t frame_num) override;
+    void IntrusionFrame(std::shared_ptr<KinectVideoFrame> frame, uint32_t frame_num) override;
+private:
+    std::shared_ptr<DetectionObserver> m_detection_observer;
+};
+
+/*******************************************************************
+ * Global variables
+ *******************************************************************/
+std::shared_ptr<IKinect> g_benchmark_kinect;
+std::shared_ptr<PipelineProbe> g_pipeline_probe;
+
+DetectionConfig g_benchmark_detection_config{
+    DETECTION_THRESHOLD,
+    DETECTION_SENSITIVITY,
+    100, /* cooldown_ms */
+    50,  /* refresh_reference_interval_ms */
+    1,   /* take_depth_frame_interval_ms */
+    20   /* take_video_frame_interval_ms */
+};
+
+std::shared_ptr<DetectionObserver> WrapDetectionObserver(std::shared_ptr<DetectionObserver> detection_observer)
+{
+    return std::make_shared<TimingDetectionObserver>(detection_observer);
+}
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+TimingDetectionObserver::TimingDetectionObserver(std::shared_ptr<DetectionObserver> detection_observer) :
+    m_detection_observer(detection_observer)
+{
+}
+
+void TimingDetectionObserver::IntrusionStarted()
+{
+    g_pipeline_probe->IntrusionStarted(std::chrono::steady_clock::now());
+    m_detection_observer->IntrusionStarted();
+}
+
+void TimingDetectionObserver::IntrusionStopped(uint32_t frame_num)
+{
+    auto begin = std::chrono::steady_clock::now();
+    m_detection_observer->IntrusionStopped(frame_num);
+    g_pipeline_probe->alarm_stop.Add(begin, std::chrono::steady_clock::now());
+    g_pipeline_probe->IntrusionStopped(begin);
+}
+
+void TimingDetectionObserver::IntrusionFrame(std::shared_ptr<KinectVideoFrame> frame, uint32_t frame_num)
+{
+    g_pipeline_probe->IntrusionFrame(frame->GetTimestamp(), std::chrono::steady_clock::now());
+
+    auto forward_begin = std::chrono::steady_clock::now();
+    m_detection_observer->IntrusionFrame(frame, frame_num);
+    g_pipeline_probe->alarm_frame.Add(forward_begin, std::chrono::steady_clock::now());
+}
+
+/*******************************************************************
+ * Benchmarks
+ *******************************************************************/
+
+/* One iteration is one whole intrusion: from the intruder entering the scene to its last frame handed to the disk */
+static void BM_Pipeline(benchmark::State& state)
+{
+    uint32_t frame_interval_ms = state.range(0);
+    SyntheticSceneConfig scene_config;
+
+    scene_config.frame_interval_ms  = frame_interval_ms;
+    scene_config.blob_active_frames = BENCHMARK_INTRUSION_MS / frame_interval_ms;
+    scene_config.blob_idle_frames   = BENCHMARK_IDLE_MS / frame_interval_ms;
+
+    auto synthetic_kinect = std::make_shared<SyntheticKinect>(scene_config, KINECT_GETFRAMES_TIMEOUT_MS);
+    g_benchmark_kinect = synthetic_kinect;
+    g_pipeline_probe   = std::make_shared<PipelineProbe>(synthetic_kinect);
+
+    if(0 != CreateDirectory(DETECTION_PATH))
+    {
+        state.SkipWithError("Couldn't create " DETECTION_PATH);
+        return;
+    }
+
+    {
+        auto message_broker = std::make_shared<MessageBrokerFake>();
+        auto data_base = StatePersistenceFactory::CreateDatabase(BENCHMARK_DB_PATH);
+        Alarm alarm(message_broker, data_base);
+
+        if(0 != alarm.Init())
+        {
+            state.SkipWithError("Alarm::Init() failed");
+        }
+        else if(0 != synthetic_kinect->Subscribe(KinectFrameType::Depth, g_pipeline_probe) ||
+                0 != synthetic_kinect->Subscribe(KinectFrameType::Video, g_pipeline_probe))
+        {
+            state.SkipWithError("Kinect::Subscribe() failed");
+        }
+        else if(0 != alarm.StartDetection())
+        {
+            state.SkipWithError("Alarm::StartDetection() failed");
+        }
+        else
+        {
+            for(auto _ : state)
+            {
+                if(0 != g_pipeline_probe->WaitIntrusion(alarm))
+                {
+                    state.SkipWithError("No intrusion detected");
+                    break;
+                }
+            }
+
+            alarm.StopDetection();
+            g_pipeline_probe->Report(state);
+            state.counters["frames"] = synthetic_kinect->GetNumberOfFrames();
+
+            /* Frames shed by the stages that couldn't keep up, and how close the others got */
+            FramePipelineStats stats = alarm.GetPipelineStats();
+            state.counters["encode_dropped"]  = stats.encode.dropped;
+            state.counters["encode_max_occ"]  = stats.encode.max_occupancy;
+            state.counters["disk_dropped"]    = stats.disk.dropped;
+            state.counters["disk_max_occ"]    = stats.disk.max_occupancy;
+        }
+
+        alarm.Term();
+        data_base->RemoveDatabase();
+    }
+
+    DeleteAllFilesFromDirectory(DETECTION_PATH);
+    g_pipeline_probe.reset();
+    g_benchmark_kinect.reset();
+}
+/* Sensor rate (30 fps) and 10x sensor rate */
+BENCHMARK(BM_Pipeline)->Arg(33)->Arg(3)->Iterations(10)->Unit(benchmark::kMillisecond)->UseRealTime();
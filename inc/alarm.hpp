@@ -15,10 +15,20 @@
 #include "message_broker.hpp"
 #include "state_persistence.hpp"
 #include "kinect.hpp"
+#include "kinect_recording.hpp"
 #include "log.hpp"
 #include "video_stream.hpp"
 #include "video.hpp"
 #include "liveview.hpp"
+#include "liveview_shm.hpp"
+#include "mjpeg_server.hpp"
+#include "persistence_worker.hpp"
+#include "detection_storage.hpp"
+#include "frame_container.hpp"
+#include "jpeg_cache.hpp"
+#include "object_pool.hpp"
+#include "pipeline_stage.hpp"
+#include "row_schema.hpp"
 #include "detection.hpp"
 #include "base64_encoder.hpp"
 #include "threadpool.hpp"
@@ -36,6 +46,110 @@ struct AlarmConfig
     int current_detection_number;
 };
 
+/* Row of the STATUS table */
+struct StatusRow
+{
+    int32_t id;
+    int32_t tilt;
+    int32_t brightness;
+    int32_t contrast;
+    int32_t detection_active;
+    int32_t liveview_active;
+    int32_t current_detection_number;
+    int32_t threshold;
+    int32_t sensitivity;
+    int32_t cooldown_ms;
+    int32_t refresh_reference_interval_ms;
+    int32_t take_depth_frame_interval_ms;
+    int32_t take_video_frame_interval_ms;
+    int32_t video_frame_interval_ms;
+
+    static constexpr auto columns = std::make_tuple(
+        MakeColumn("ID",                                &StatusRow::id),
+        MakeColumn("TILT",                              &StatusRow::tilt),
+        MakeColumn("BRIGHTNESS",                        &StatusRow::brightness),
+        MakeColumn("CONTRAST",                          &StatusRow::contrast),
+        MakeColumn("DET_ACTIVE",                        &StatusRow::detection_active),
+        MakeColumn("LVW_ACTIVE",                        &StatusRow::liveview_active),
+        MakeColumn("CURRENT_DET_NUM",                   &StatusRow::current_detection_number),
+        MakeColumn("DET_THRESHOLD",                     &StatusRow::threshold),
+        MakeColumn("DET_SENSITIVITY",                   &StatusRow::sensitivity),
+        MakeColumn("DET_COOLDOWN_MS",                   &StatusRow::cooldown_ms),
+        MakeColumn("DET_REFRESH_REFERENCE_INTERVAL_MS", &StatusRow::refresh_reference_interval_ms),
+        MakeColumn("DET_TAKE_DEPTH_FRAME_INTERVAL_MS",  &StatusRow::take_depth_frame_interval_ms),
+        MakeColumn("DET_TAKE_VIDEO_FRAME_INTERVAL_MS",  &StatusRow::take_video_frame_interval_ms),
+        MakeColumn("LVW_VIDEO_FRAME_INTERVAL_MS",       &StatusRow::video_frame_interval_ms));
+};
+
+/* Row of the DETECTIONS table */
+struct DetectionRow
+{
+    int32_t id;
+    int32_t date;
+    int32_t duration;
+    std::string filename_img;
+    std::string filename_vid;
+
+    static constexpr auto columns = std::make_tuple(
+        MakeColumn("ID",           &DetectionRow::id),
+        MakeColumn("DATE",         &DetectionRow::date),
+        MakeColumn("DURATION",     &DetectionRow::duration),
+        MakeColumn("FILENAME_IMG", &DetectionRow::filename_img),
+        MakeColumn("FILENAME_VID", &DetectionRow::filename_vid));
+};
+
+/* Status variables in the message broker */
+struct CacheStatusRow
+{
+    int32_t detection_active;
+    int32_t liveview_active;
+    int32_t last_detection_number;
+    int32_t tilt;
+    int32_t brightness;
+    int32_t contrast;
+    int32_t threshold;
+    int32_t sensitivity;
+
+    static constexpr auto columns = std::make_tuple(
+        MakeColumn("det_status",  &CacheStatusRow::detection_active),
+        MakeColumn("lvw_status",  &CacheStatusRow::liveview_active),
+        MakeColumn("det_numdet",  &CacheStatusRow::last_detection_number),
+        MakeColumn("tilt",        &CacheStatusRow::tilt),
+        MakeColumn("brightness",  &CacheStatusRow::brightness),
+        MakeColumn("contrast",    &CacheStatusRow::contrast),
+        MakeColumn("threshold",   &CacheStatusRow::threshold),
+        MakeColumn("sensitivity", &CacheStatusRow::sensitivity));
+};
+
+/* Item going through the frame pipeline, the fields used depend on its kind */
+struct FramePipelineItem
+{
+    enum class Kind
+    {
+        None,
+        Intrusion,       /* Frame of the detection in progress */
+        Liveview,        /* Frame for the liveview */
+        EndOfDetection   /* After the last frame of a detection */
+    };
+
+    Kind kind = Kind::None;
+    std::shared_ptr<KinectVideoFrame> frame;    /* Pooled copy, until it is encoded */
+    std::shared_ptr<const EncodedFrame> encoded;
+    std::shared_ptr<FrameContainerWriter> writer;
+    int32_t id = 0;
+    uint32_t frame_num = 0;
+    time_t date = 0;
+    int32_t brightness = 0;
+    int32_t contrast = 0;
+};
+
+struct FramePipelineStats
+{
+    PipelineStageStats encode;
+    PipelineStageStats disk;
+    PipelineStageStats publish;
+};
+
 /*******************************************************************
  * Class declaration
  *******************************************************************/
@@ -66,11 +180,14 @@ class Alarm
     friend AlarmDetectionObserver;
     friend AlarmLiveviewObserver;
 public:
+    using VideoFrameFactory = std::function<std::unique_ptr<KinectVideoFrame>()>;
+
     /**
      * @brief Contructor
      * 
+     * @param[in] frame_factory : creates the frames the captured ones are copied to, null for VIDEO_WIDTH x VIDEO_HEIGHT ones
      */
-    Alarm(std::shared_ptr<IMessageBroker> message_broker, std::shared_ptr<IDatabase> data_base);
+    Alarm(std::shared_ptr<IMessageBroker> message_broker, std::shared_ptr<IDatabase> data_base, VideoFrameFactory frame_factory = nullptr);
 
     /**
      * @brief Destructor
@@ -120,6 +237,18 @@ public:
      */
     int StopLiveview();
 
+    /**
+     * @brief Start recording the Kinect's frames to a new file in KINECT_RECORDING_PATH
+     *
+     */
+    int StartRecording();
+
+    /**
+     * @brief Stop recording
+     *
+     */
+    int StopRecording();
+
     /**
      * @brief Check if kinect is running
      * 
@@ -144,6 +273,20 @@ public:
      */
     int DeleteDetection(int id);
 
+    /**
+     * @brief Export the frames of a detection, in the background
+     *
+     * @param[in] format : "zip" or "mp4"
+     */
+    int ExportDetection(int id, const std::string& format);
+
+    /**
+     * @brief Publish a page of the detections between two dates, newest first
+     * 
+     * @param[in] before_date, before_id : date and ID of the last detection of the previous page, -1 for the first page
+     */
+    int ListDetections(int32_t from_date, int32_t to_date, uint32_t count, int32_t before_date, int32_t before_id);
+
     /**
      * @brief Change Kinect's tilt
      * 
@@ -174,9 +317,22 @@ public:
      */
     int ChangeSensitivity(int32_t value);
 
+    /**
+     * @brief Wait until the state updates posted by the observers are written
+     * 
+     */
+    void SyncPersistence();
+
+    /**
+     * @brief Counters of the stages the video frames go through
+     *
+     */
+    FramePipelineStats GetPipelineStats();
+
 private:
     /* Kinect object */
     std::shared_ptr<IKinect> m_kinect;
+    std::unique_ptr<KinectRecorder> m_recorder;
 
     /* Liveview object */
     std::shared_ptr<IAlarmModule> m_liveview;
@@ -184,6 +340,12 @@ private:
     /* Liveview observer object */
     std::shared_ptr<AlarmLiveviewObserver> m_liveview_observer;
 
+    /* Liveview shared memory, null if disabled */
+    std::unique_ptr<LiveviewShmWriter> m_liveview_shm;
+
+    /* Liveview MJPEG server, null if disabled */
+    std::unique_ptr<MjpegServer> m_mjpeg_server;
+
     /* Detection object */
     std::shared_ptr<IAlarmModule> m_detection;
 
@@ -205,9 +367,6 @@ private:
     /* Threadpool object */
     ThreadPool<4> m_threadPool;
 
-    /* Vector SavetoJpeg tasks*/
-    std::vector<std::shared_ptr<Task>> m_jpeg_tasks;
-
     AlarmConfig m_alarm_config{
         .tilt = ALARM_TILT,
         .brightness = ALARM_BRIGHTNESS,
@@ -217,22 +376,52 @@ private:
         .current_detection_number = 0
     };
 
-    DetectionConfig m_detection_config = {
-        .threshold = DETECTION_THRESHOLD,
-        .sensitivity = DETECTION_SENSITIVITY,
-        .cooldown_ms = DETECTION_COOLDOWN_MS,
-        .refresh_reference_interval_ms = DETECTION_REFRESH_REFERENCE_INTERVAL_MS,
-        .take_depth_frame_interval_ms = DETECTION_TAKE_DEPTH_FRAME_INTERVAL_MS,
-        .take_video_frame_interval_ms = DETECTION_TAKE_VIDEO_FRAME_INTERVAL_MS
+    DetectionConfig m_detection_config{
+        DETECTION_THRESHOLD,
+        DETECTION_SENSITIVITY,
+        DETECTION_COOLDOWN_MS,
+        DETECTION_REFRESH_REFERENCE_INTERVAL_MS,
+        DETECTION_TAKE_DEPTH_FRAME_INTERVAL_MS,
+        DETECTION_TAKE_VIDEO_FRAME_INTERVAL_MS
     };
 
-    LiveviewConfig m_liveview_config = {
-        .video_frame_interval_ms = LIVEVIEW_FRAME_INTERVAL_MS
+    LiveviewConfig m_liveview_config{
+        LIVEVIEW_FRAME_INTERVAL_MS
     };
 
     std::shared_ptr<IDataTable> m_detection_table;
     std::shared_ptr<IDataTable> m_status_table;
 
+    /* Writes the state off the detection thread, destroyed first so it flushes to the tables */
+    std::unique_ptr<PersistenceWorker> m_persistence_worker;
+
+    /* Files of the detections, shared with the package tasks that index what they write */
+    std::shared_ptr<DetectionStorage> m_detection_storage;
+
+    /* Writes the frames of the detections off the disk stage */
+    std::shared_ptr<AsyncFileWriter> m_file_writer;
+
+    /* JPEGs of the video frames, shared by the intrusion, the liveview and the email */
+    std::shared_ptr<JpegCache> m_jpeg_cache;
+
+    /* Container of the frames of the detection in progress */
+    std::shared_ptr<FrameContainerWriter> m_frame_writer;
+
+    /* Frames the capture copies to, so it can go on with its own */
+    std::unique_ptr<ObjectPool<KinectVideoFrame>> m_frame_pool;
+
+    /* Encode: intrusion and liveview frames in, to the disk and publish stages.
+       Destroyed before them, so what it forwards is still processed */
+    std::unique_ptr<PipelineStage<FramePipelineItem>> m_disk_stage;
+    std::unique_ptr<PipelineStage<FramePipelineItem>> m_publish_stage;
+    std::unique_ptr<PipelineStage<FramePipelineItem>> m_encode_stage;
+
+    /* Of the last liveview frame published, encode stage only */
+    uint32_t m_last_liveview_timestamp;
+
+    /* Detection whose email was already sent with its snapshot, disk stage only */
+    int32_t m_snapshot_id;
+
     uint16_t threshold;
     uint16_t sensitivity;
     uint32_t cooldown_ms;
@@ -240,39 +429,34 @@ private:
     uint32_t take_depth_frame_interval_ms;
     uint32_t take_video_frame_interval_ms;
 
-    const Entry m_status_table_definition = {
-        {"ID",              DataType::Integer,},
-        {"TILT",            DataType::Integer,},
-        {"BRIGHTNESS",      DataType::Integer,},
-        {"CONTRAST",        DataType::Integer,},
-        {"DET_ACTIVE",      DataType::Integer,},
-        {"LVW_ACTIVE",      DataType::Integer,},
-        {"CURRENT_DET_NUM", DataType::Integer,},
-        {"DET_THRESHOLD",   DataType::Integer,},
-        {"DET_SENSITIVITY", DataType::Integer,},
-        {"DET_COOLDOWN_MS", DataType::Integer,},
-        {"DET_REFRESH_REFERENCE_INTERVAL_MS", DataType::Integer,},
-        {"DET_TAKE_DEPTH_FRAME_INTERVAL_MS",  DataType::Integer,},
-        {"DET_TAKE_VIDEO_FRAME_INTERVAL_MS",  DataType::Integer,},
-        {"LVW_VIDEO_FRAME_INTERVAL_MS",       DataType::Integer,}
-    };
+    const Entry m_status_table_definition = RowDefinition<StatusRow>();
 
-    const Entry m_detection_table_definition = {
-        {"ID",           DataType::Integer,},
-        {"DATE",         DataType::Integer,},
-        {"DURATION",     DataType::Integer,},
-        {"FILENAME_IMG", DataType::String,},
-        {"FILENAME_VID", DataType::String,}
-    };
+    const Entry m_detection_table_definition = RowDefinition<DetectionRow>();
+
+    /* Rows written are filled in place into these, their layout is built once */
+    Entry m_status_entry = RowDefinition<StatusRow>();
+    std::mutex m_status_entry_mutex;
+    Entry m_detection_entry = RowDefinition<DetectionRow>(); /* Detection thread only */
 
     int UpdateLed();
 
+    StatusRow GetStatusRow();
+    void SetStatusRow(const StatusRow& status_row);
+
     int ReadStatus();
-    int WriteStatus();
+    int WriteStatus(bool wait = true);
     int CreateStatus();
 
     int InitVarsRedis();
     int InitStatePersistenceVars();
+
+    DetectionRow GetDetectionRow(int32_t id, time_t date, uint32_t frames);
+    void PackageDetection(int32_t id, time_t date, uint32_t frames, std::shared_ptr<FrameContainerWriter> writer);
+    void EncodeFrame(FramePipelineItem& item);
+    void WriteFrame(FramePipelineItem& item);
+    void PublishFrame(FramePipelineItem& item);
+    int RecoverDetections();
+    void DetectionEvicted(int32_t id);
 };
 
 #endif /* ALARM_H_ */
@@ -0,0 +1,141 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file async_file_writer.hpp
+ *
+ */
+
+#ifndef ASYNC_FILE_WRITER__H_
+#define ASYNC_FILE_WRITER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <cstdint>
+#include <sys/uio.h>
+
+#include "mpsc_queue.hpp"
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*
+ * Writes, syncs and closes files from its own thread, so the threads that produce the data,
+ * e.g. the JPEG encoders, don't block on the disk. The requests waiting when the thread wakes
+ * up are submitted as one batch to an io_uring, or done one after the other with the usual
+ * system calls where the kernel doesn't have it.
+ *
+ * Writes complete in any order. Syncs, closes and flushes start once everything submitted
+ * before them has completed. The completion callbacks are called from the writer's thread,
+ * with the bytes written or -errno, and are where the buffers of a write are released.
+ * Everything submitted completes before the destructor returns.
+ */
+class AsyncFileWriter
+{
+public:
+    using Completion = std::function<void(int result)>;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] queue_depth : requests in flight at once
+     * @param[in] use_io_uring : false to always use the thread-backed fallback
+     */
+    AsyncFileWriter(uint32_t queue_depth, bool use_io_uring = true) noexcept(false);
+    ~AsyncFileWriter();
+
+    /**
+     * @brief Write the buffers at an offset of a file, pwritev() semantics
+     *
+     * @param[in] iov : buffers, they must be valid until on_complete is called
+     */
+    void Write(int fd, std::vector<iovec> iov, uint64_t offset, Completion on_complete);
+
+    /**
+     * @brief fdatasync() a file
+     */
+    void Sync(int fd, Completion on_complete);
+
+    /**
+     * @brief Close a file
+     */
+    void Close(int fd, Completion on_complete);
+
+    /**
+     * @brief Wait until everything submitted before has completed, not from a completion
+     */
+    void Flush();
+
+    /**
+     * @brief Whether the requests go through an io_uring
+     */
+    bool IsUring();
+
+private:
+    enum class Operation
+    {
+        Write,
+        Sync,
+        Close,
+        Barrier
+    };
+
+    struct Request
+    {
+        Operation operation;
+        int fd;
+        std::vector<iovec> iov;
+        uint64_t offset;    /* Advanced with what is written */
+        size_t size;
+        size_t written;
+        Completion on_complete;
+    };
+
+    MpscQueue<std::unique_ptr<Request>> m_queue;
+    std::atomic<bool> m_stop;
+
+    /* Written to wake the thread up only when it is sleeping */
+    std::atomic<bool> m_sleeping;
+    int m_wake_fd;
+
+    /* io_uring, m_ring_fd < 0 for the fallback */
+    uint32_t m_queue_depth;
+    int m_ring_fd;
+    void *m_sq_ring;
+    size_t m_sq_ring_size;
+    void *m_cq_ring;
+    size_t m_cq_ring_size;
+    io_uring_sqe *m_sqes;
+    size_t m_sqes_size;
+    unsigned *m_sq_head, *m_sq_tail, *m_sq_mask, *m_sq_array;
+    unsigned *m_cq_head, *m_cq_tail, *m_cq_mask;
+    io_uring_cqe *m_cqes;
+    unsigned m_sq_entries;
+
+    std::unique_ptr<std::thread> m_thread;
+
+    void Submit(std::unique_ptr<Request> request);
+    void Wake();
+    void Take(std::deque<Request*>& backlog);
+
+    int SetupRing();
+    void ReleaseRing();
+    bool PrepareSqe(Request *request, uint64_t user_data);
+    void RunRing();
+
+    void RunThread();
+    static int Execute(Request& request);
+
+    static bool Advance(Request& request, size_t written);
+};
+
+#endif /* ASYNC_FILE_WRITER__H_ */
@@ -19,6 +19,34 @@
 
 #include "log.hpp"
 
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+enum class CyclicTaskBackend
+{
+    ConditionVariable, /* std::condition_variable::wait_until on steady_clock */
+    TimerFd            /* timerfd with absolute CLOCK_MONOTONIC deadlines, waited with epoll */
+};
+
+struct CyclicTaskConfig
+{
+    CyclicTaskBackend backend = CyclicTaskBackend::ConditionVariable;
+    int32_t rt_priority       = 0;  /* SCHED_FIFO priority [1,99], 0 keeps the default policy */
+    int32_t cpu_affinity      = -1; /* CPU where the task thread is pinned, -1 to not pin it */
+    int32_t nice              = 0;  /* Nice value of the task thread with the default policy, e.g. 19 for background work */
+};
+
+/*******************************************************************
+ * Function declaration
+ *******************************************************************/
+
+/**
+ * @brief Apply the scheduling options of a config (all but the backend) to the calling thread
+ *
+ * @param[in] thread_name : name used in the logs
+ */
+void ApplyThreadScheduling(const std::string& thread_name, const CyclicTaskConfig& config);
+
 /*******************************************************************
  * Class declaration
  *******************************************************************/
@@ -29,8 +57,11 @@ public:
     /**
      * @brief Constructor
      * 
+     * @param[in] task_name : name used in the logs
+     * @param[in] loop_interval_ms : period of the task
+     * @param[in] config : timing backend and scheduling options of the task thread
      */
-    CyclicTask(std::string task_name, uint32_t loop_interval_ms);
+    CyclicTask(std::string task_name, uint32_t loop_interval_ms, CyclicTaskConfig config = CyclicTaskConfig());
 
     /**
      * @brief Destructor
@@ -72,9 +103,18 @@ private:
     std::atomic<uint32_t> m_loop_interval_ms;
     std::mutex m_mutex;
     std::condition_variable m_condition_variable;
+    CyclicTaskConfig m_config;
+    int m_timer_fd;
+    int m_stop_fd;
+    int m_epoll_fd;
 
     /* Private funtions */
     void ThreadLoop();
+    void ConditionVariableLoop();
+    void TimerFdLoop();
+    void ApplySchedulingConfig();
+    int OpenTimerFd();
+    void CloseTimerFd();
     virtual void ExecutionCycle() = 0;
 };
 
@@ -11,6 +11,9 @@
 /*******************************************************************
  * Includes
  *******************************************************************/
+#include <mutex>
+#include <condition_variable>
+
 #include "common.hpp"
 #include "global_parameters.hpp"
 #include "log.hpp"
@@ -53,7 +56,7 @@ struct DetectionConfig : AlarmModuleConfig
 /*******************************************************************
  * Class declaration
  *******************************************************************/
-class RefreshReferenceFrame;
+class DetectionFrameObserver;
 class TakeVideoFrames;
 
 class DetectionObserver
@@ -66,6 +69,7 @@ public:
 
 class Detection : public IAlarmModule, public CyclicTask
 {
+    friend DetectionFrameObserver;
     friend TakeVideoFrames;
 public:
     /**
@@ -101,26 +105,35 @@ private:
     DetectionConfig m_detection_config;
     State m_current_state;
     std::chrono::time_point<std::chrono::system_clock> m_cooldown_abs_time;
+    std::chrono::time_point<std::chrono::steady_clock> m_refresh_reference_abs_time;
     std::shared_ptr<KinectDepthFrame> m_depth_frame_ref;
     std::shared_ptr<KinectDepthFrame> m_depth_frame;
-    uint32_t m_timestamp;
     std::shared_ptr<IKinect> m_kinect;
-    uint8_t* liveview_jpeg;
-    std::unique_ptr<RefreshReferenceFrame> m_refresh_reference_frame;
     std::unique_ptr<TakeVideoFrames> m_take_video_frames;
     std::shared_ptr<DetectionObserver> m_detection_observer;
+
+    /* Depth frames pushed by the Kinect, double buffered with m_depth_frame */
+    std::shared_ptr<DetectionFrameObserver> m_frame_observer;
+    std::shared_ptr<KinectDepthFrame> m_depth_frame_pending;
+    std::mutex m_frame_mutex;
+    std::condition_variable m_frame_cv;
+    bool m_waiting_frames;
+    uint64_t m_pending_sequence;
+    uint64_t m_processed_sequence;
+    uint64_t m_skipped_frames;
+
+    int WaitNextDepthFrame();
+    void ProcessDepthFrame();
+    void RefreshReferenceFrame(bool force);
 };
 
-class RefreshReferenceFrame : public CyclicTask
+class DetectionFrameObserver : public KinectFrameObserver
 {
 public:
-    RefreshReferenceFrame(std::shared_ptr<IKinect> kinect,
-                          std::shared_ptr<KinectDepthFrame> depth_frame_reff,
-                          uint32_t loop_period_ms);
-    void ExecutionCycle() override;
+    DetectionFrameObserver(Detection& detection);
+    void NewDepthFrame(const KinectDepthFrame& frame, uint64_t sequence) override;
 private:
-    std::shared_ptr<KinectDepthFrame> m_depth_frame_ref;
-    std::shared_ptr<IKinect> m_kinect;
+    Detection& m_detection;
 };
 
 class TakeVideoFrames : public CyclicTask
@@ -0,0 +1,182 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file detection_storage.hpp
+ *
+ */
+
+#ifndef DETECTION_STORAGE_H_
+#define DETECTION_STORAGE_H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <map>
+#include <mutex>
+#include <ctime>
+#include <vector>
+#include <functional>
+
+#include "cyclic_task.hpp"
+
+/*******************************************************************
+ * Structures
+ *******************************************************************/
+struct DetectionStoragePolicy
+{
+    uint64_t max_bytes           = 0; /* Total size of the detections, 0 for no limit */
+    uint32_t max_age_s           = 0; /* Age of a detection since its first file, 0 for no limit */
+    uint32_t reclaim_interval_ms = 0; /* Period of the background reclamation */
+};
+
+/* Detection whose manifest wasn't ended, e.g. the alarm stopped in the middle of the intrusion */
+struct InterruptedDetection
+{
+    int32_t id;
+    time_t date;
+    uint32_t frames;
+};
+
+struct DetectionStorageStats
+{
+    uint64_t bytes;
+    uint32_t detections;
+    uint32_t evicted;
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Each detection is stored in its own directory, "<path>/<id>/", with a manifest appended as its
+ * files are written:
+ *
+ *     detection <id> <date>
+ *     frame <frame_num> <timestamp> <filename> <offset> <size>
+ *     file <filename> <size>
+ *     end <date> <frames>
+ *
+ * The index of the files of each detection and their sizes is built from the manifests once,
+ * then updated with each file written, so deleting or packaging a detection only touches its
+ * own directory. A manifest without "end" is a detection interrupted by a crash, which can be
+ * completed from it. A low priority task evicts the oldest detections while the policy is
+ * exceeded; the newest one, which may still be being written, is never evicted.
+ * Files of the former flat layout, "<path>/<id>_*", are still indexed and deleted.
+ */
+class DetectionStorage : public CyclicTask
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] path : detection directory
+     * @param[in] policy : size and age quotas
+     * @param[in] on_evicted : called from the reclamation task with the ID of each evicted detection
+     */
+    DetectionStorage(const std::string& path, DetectionStoragePolicy policy, std::function<void(int32_t)> on_evicted);
+
+    /**
+     * @brief Destructor
+     *
+     */
+    ~DetectionStorage();
+
+    /**
+     * @brief Directory of a detection
+     *
+     */
+    std::string GetDirectory(int32_t id);
+
+    /**
+     * @brief Create the directory of a detection and start its manifest
+     *
+     */
+    int BeginDetection(int32_t id, time_t date);
+
+    /**
+     * @brief Add a frame written for a detection to the index and its manifest
+     *
+     * @param[in] filepath : path of the file with the frame, in the detection directory
+     * @param[in] offset, size : of the frame in the file
+     */
+    int AddFrame(int32_t id, uint32_t frame_num, uint32_t timestamp, const std::string& filepath, uint64_t offset, uint64_t size);
+
+    /**
+     * @brief Add a file written for a detection to the index and its manifest, or update its size
+     *
+     * @param[in] filepath : path of the file, in the detection directory
+     */
+    int AddFile(int32_t id, const std::string& filepath);
+
+    /**
+     * @brief End the manifest of a detection, all its files are written
+     *
+     */
+    int EndDetection(int32_t id, time_t date, uint32_t frames);
+
+    /**
+     * @brief Detections found with a manifest not ended
+     *
+     */
+    std::vector<InterruptedDetection> GetInterrupted();
+
+    /**
+     * @brief Delete the files of a detection
+     *
+     */
+    int DeleteDetection(int32_t id);
+
+    /**
+     * @brief Delete the files of all the detections
+     *
+     */
+    int DeleteAll();
+
+    /**
+     * @brief Evict the oldest detections until the policy is met
+     *
+     * @return number of detections evicted
+     */
+    uint32_t Reclaim();
+
+    DetectionStorageStats GetStats();
+
+private:
+    struct DetectionFiles
+    {
+        std::string directory;                 /* Empty for the flat layout */
+        std::map<std::string, uint64_t> files; /* Path and size */
+        uint64_t bytes = 0;
+        time_t date = 0;                       /* Start of the detection, or oldest modification time of its files */
+        uint32_t frames = 0;
+        bool ended = true;
+        int manifest_fd = -1;                  /* Open while the detection is written */
+    };
+
+    std::string m_path;
+    DetectionStoragePolicy m_policy;
+    std::function<void(int32_t)> m_on_evicted;
+
+    /* Detections by ID, the oldest first */
+    std::mutex m_mutex;
+    std::map<int32_t, DetectionFiles> m_detections;
+    uint64_t m_bytes;
+    uint32_t m_evicted;
+    int32_t m_evicted_id; /* Highest evicted ID, the ones up to it are evicted since they go oldest first */
+    bool m_indexed;
+
+    void ExecutionCycle() override;
+
+    /* With m_mutex taken */
+    void IndexDirectory();
+    void IndexDetectionDirectory(int32_t id, const std::string& directory);
+    void IndexFile(int32_t id, const std::string& filepath, uint64_t size, time_t date);
+    int AppendToManifest(int32_t id, const std::string& record);
+
+    /* Without m_mutex, the detection is already out of the index */
+    static int RemoveFiles(const DetectionFiles& detection);
+};
+
+#endif /* DETECTION_STORAGE_H_ */
@@ -0,0 +1,201 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file frame_container.hpp
+ *
+ */
+
+#ifndef FRAME_CONTAINER__H_
+#define FRAME_CONTAINER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+#include "async_file_writer.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define FRAME_CONTAINER_MAGIC        0x4B414643U /* "KAFC" */
+#define FRAME_CONTAINER_INDEX_MAGIC  0x4B414649U /* "KAFI" */
+#define FRAME_CONTAINER_VERSION      1U
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+
+/*
+ * Layout of a container, in host byte order:
+ *
+ *     FrameContainerHeader
+ *     FrameContainerRecord + JPEG, for each frame, in the order they were written
+ *     FrameContainerRecord[frame_count] with the offset of each record, the index
+ *     FrameContainerFooter
+ *
+ * The index and the footer are only written when the container is closed. Without
+ * them, e.g. after a crash, the frames are found walking the records from the header.
+ */
+struct FrameContainerHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t date;       /* Start of the detection */
+};
+
+struct FrameContainerRecord
+{
+    uint64_t offset;    /* Of the record, only meaningful in the index */
+    uint32_t frame_num;
+    uint32_t timestamp;
+    uint32_t size;      /* Of the JPEG that follows */
+    uint32_t reserved;
+};
+
+struct FrameContainerFooter
+{
+    uint64_t index_offset;
+    uint32_t frame_count;
+    uint32_t magic;
+};
+
+/* Frame of a container, data points into the mapping of its reader */
+struct ContainerFrame
+{
+    uint32_t frame_num;
+    uint32_t timestamp;
+    const uint8_t *data;
+    uint32_t size;
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Appends frames to a container, one positioned pwritev() per frame, record and
+ * JPEG, at the end of the last one. Append() can be called from several threads,
+ * the frames are stored in the order they are appended. The file only grows, it
+ * can be read while being written. With an AsyncFileWriter the space of each
+ * frame is reserved and its write submitted, Append() returns without waiting
+ * for the disk.
+ */
+class FrameContainerWriter
+{
+public:
+    /**
+     * @brief Create the container and write its header
+     *
+     * @param[in] sync_frames : fdatasync() every sync_frames frames, 0 only when closed
+     * @param[in] io : writes the frames in the background, null to write them from Append()
+     */
+    FrameContainerWriter(const std::string& path, time_t date, uint32_t sync_frames, std::shared_ptr<AsyncFileWriter> io = nullptr);
+    ~FrameContainerWriter();
+
+    /**
+     * @brief Append a frame
+     *
+     * @param[out] offset : of the JPEG in the container
+     */
+    int Append(uint32_t frame_num, uint32_t timestamp, const uint8_t *jpeg, size_t size, uint64_t& offset);
+
+    /**
+     * @brief Append a frame, keeping a reference to its buffer until it is written
+     *
+     * @param[out] offset : of the JPEG in the container
+     */
+    int Append(uint32_t frame_num, uint32_t timestamp, std::shared_ptr<const std::vector<uint8_t>> jpeg, uint64_t& offset);
+
+    /**
+     * @brief Write the index and the footer, sync and close, no frame can be appended after
+     *
+     */
+    int Close();
+
+    const std::string& GetPath();
+
+private:
+    std::string m_path;
+    uint32_t m_sync_frames;
+    int m_fd;
+    uint64_t m_size;
+    uint64_t m_end;     /* Past the bytes a failed append may have written */
+    uint32_t m_unsynced_frames;
+    std::vector<FrameContainerRecord> m_index;
+    std::mutex m_mutex;
+
+    /* Writes submitted and not completed yet */
+    std::shared_ptr<AsyncFileWriter> m_io;
+    uint32_t m_pending;
+    bool m_io_error;
+    std::condition_variable m_pending_condition;
+
+    void FrameWritten(uint64_t record_offset, int result);
+    int CloseAsync(std::unique_lock<std::mutex>& lock);
+};
+
+/*
+ * Maps a container for random access to its frames.
+ */
+class FrameContainerReader
+{
+public:
+    /**
+     * @brief Map the container and load its index, or rebuild it from the records
+     *
+     */
+    FrameContainerReader(const std::string& path);
+    ~FrameContainerReader();
+
+    time_t GetDate();
+    size_t GetFrameCount();
+
+    /**
+     * @brief Get a frame, by frame number order
+     *
+     */
+    int GetFrame(size_t index, ContainerFrame& frame);
+
+    /**
+     * @brief Whether it was closed, i.e. it had an index
+     *
+     */
+    bool IsComplete();
+
+private:
+    uint8_t *m_memory;
+    size_t m_memory_size;
+    time_t m_date;
+    bool m_complete;
+    std::vector<FrameContainerRecord> m_index;
+
+    int LoadIndex();
+    void ScanRecords();
+};
+
+/*******************************************************************
+ * Function declaration
+ *******************************************************************/
+
+/**
+ * @brief Write the frames of a container to a zip file, as capture_<frame_num>.jpeg
+ *
+ */
+int ExportContainerToZip(FrameContainerReader& container, const std::string& zip_path);
+
+/**
+ * @brief Encode the frames of a container to an MP4 file with ffmpeg
+ *
+ * @param[in] frame_interval_ms : between the frames, the rate of the video
+ */
+int ExportContainerToMp4(FrameContainerReader& container, const std::string& mp4_path, uint32_t frame_interval_ms);
+
+#endif /* FRAME_CONTAINER__H_ */
@@ -13,9 +13,25 @@
  *******************************************************************/
 #define KINECTALARM_VERSION "1.0"
 
+/* Paths can be overridden at build time, e.g. to run the benchmarks out of the target */
+#ifndef DETECTION_PATH
 #define DETECTION_PATH "/var/detections"
+#endif
+#ifndef REDIS_DB_PATH
 #define REDIS_DB_PATH  "/tmp/redis.sock"
+#endif
+#ifndef SQLITE_DB_PATH
 #define SQLITE_DB_PATH "/etc/kinectalarm/detections.db"
+#endif
+
+/* Writes to the state database are committed together every SQLITE_FLUSH_INTERVAL_MS */
+#define SQLITE_SYNCHRONOUS        DatabaseSynchronous::Normal
+#define SQLITE_FLUSH_INTERVAL_MS  1000U
+
+/* Log messages written to this file instead of syslog (stdout in debug builds), empty for no file */
+#ifndef LOG_FILE_PATH
+#define LOG_FILE_PATH ""
+#endif
 
 #define WATCHDOG_TIMEOUT_S  2U
 #define WATCHDOG_REFRESH_MS 1000U
@@ -25,8 +41,10 @@
 #define REDIS_EVENT_SUCCESS_CHANNEL  "event_success"
 #define REDIS_EVENT_ERROR_CHANNEL    "event_error"
 #define REDIS_LIVEFRAMES_CHANNEL     "liveview"
+#define REDIS_LIVEFRAMES_SHM_CHANNEL "liveview_shm"
 #define REDIS_DET_INTRUSION_CHANNEL  "new_det"
 #define REDIS_DET_EMAIL_SEND_CHANNEL "email_send_det"
+#define REDIS_DET_LIST_CHANNEL       "det_list"
 
 #define ALARM_TILT       0
 #define ALARM_BRIGHTNESS 1000
@@ -38,11 +56,80 @@
 #define DETECTION_REFRESH_REFERENCE_INTERVAL_MS 1000U
 #define DETECTION_TAKE_DEPTH_FRAME_INTERVAL_MS  10U
 #define DETECTION_TAKE_VIDEO_FRAME_INTERVAL_MS  200U
+#define DETECTION_LIST_MAX_ITEMS 100U
+
+/* The oldest detections are deleted while they take more than DETECTION_STORAGE_MAX_BYTES or
+   are older than DETECTION_STORAGE_MAX_AGE_S, checked every DETECTION_STORAGE_RECLAIM_INTERVAL_MS. 0 for no limit */
+#define DETECTION_STORAGE_MAX_BYTES           (2ULL * 1024U * 1024U * 1024U)
+#define DETECTION_STORAGE_MAX_AGE_S           (30U * 24U * 3600U)
+#define DETECTION_STORAGE_RECLAIM_INTERVAL_MS 10000U
+
+/* Frames of a detection are appended to DETECTION_CONTAINER_NAME in its directory, synced to disk
+   every DETECTION_CONTAINER_SYNC_FRAMES frames. 0 to sync only when the detection ends */
+#define DETECTION_CONTAINER_NAME        "capture.frames"
+#define DETECTION_CONTAINER_SYNC_FRAMES 10U
+
+/* First frame of a detection, its path published on REDIS_DET_EMAIL_SEND_CHANNEL */
+#define DETECTION_SNAPSHOT_NAME "snapshot.jpeg"
+
+/* Writes of the frames in flight at once, through io_uring when the kernel has it */
+#define ASYNC_FILE_WRITER_QUEUE_DEPTH 32U
+
+/* Encoded video frames kept to be shared by the intrusion, the liveview and the email */
+#define JPEG_CACHE_FRAMES 4U
+
+/* Video frames go through three stages, encode -> disk and encode -> publish, each with its own
+   thread and inputs of FRAME_PIPELINE_CAPACITY items. A frame that doesn't fit is dropped, the
+   capture never waits. FRAME_PIPELINE_FRAMES frames are preallocated for the capture to copy to */
+#define FRAME_PIPELINE_CAPACITY 8U
+#define FRAME_PIPELINE_FRAMES   (2U * FRAME_PIPELINE_CAPACITY + 2U)
 
 #define LIVEVIEW_FRAME_INTERVAL_MS 150U
 
+/* Liveview JPEGs also in shared memory for the local readers (liveview_shm.hpp), with the
+   frame number notified on REDIS_LIVEFRAMES_SHM_CHANNEL. Empty name to disable it */
+#ifndef LIVEVIEW_SHM_NAME
+#define LIVEVIEW_SHM_NAME ""
+#endif
+#define LIVEVIEW_SHM_SLOTS     4U
+#define LIVEVIEW_SHM_SLOT_SIZE (512U * 1024U)
+/* 0: with shared memory the frames aren't sent through Redis anymore */
+#ifndef LIVEVIEW_REDIS_FRAMES
+#define LIVEVIEW_REDIS_FRAMES 1
+#endif
+
+/* Liveview served as MJPEG on http://LIVEVIEW_HTTP_ADDRESS:LIVEVIEW_HTTP_PORT/LIVEVIEW_HTTP_PATH, port 0 to disable it */
+#ifndef LIVEVIEW_HTTP_PORT
+#define LIVEVIEW_HTTP_PORT 0
+#endif
+#define LIVEVIEW_HTTP_ADDRESS "0.0.0.0"
+#define LIVEVIEW_HTTP_PATH    "/liveview.mjpg"
+#define LIVEVIEW_HTTP_MAX_FPS 10U
+
 #define KINECT_GETFRAMES_TIMEOUT_MS 1000U
 
+/* Sessions recorded with "rec start" (kinect_recording.hpp), one file per recording */
+#ifndef KINECT_RECORDING_PATH
+#define KINECT_RECORDING_PATH "/var/recordings"
+#endif
+
+/* Instead of the sensor, replay a recording in a loop, or a synthetic scene if KINECT_SYNTHETIC is 1 */
+#ifndef KINECT_REPLAY_PATH
+#define KINECT_REPLAY_PATH ""
+#endif
+#ifndef KINECT_SYNTHETIC
+#define KINECT_SYNTHETIC 0
+#endif
+
+/* Scheduling of the time critical tasks: SCHED_FIFO priority (0 = default policy) and CPU (-1 = not pinned) */
+#define KINECT_TASK_RT_PRIORITY     0
+#define KINECT_TASK_CPU_AFFINITY    -1
+#define DETECTION_TASK_RT_PRIORITY  0
+#define DETECTION_TASK_CPU_AFFINITY -1
+#define ENCODE_STAGE_CPU_AFFINITY   -1
+#define DISK_STAGE_CPU_AFFINITY     -1
+#define PUBLISH_STAGE_CPU_AFFINITY  -1
+
 #define DEPTH_WIDTH    640U
 #define DEPTH_HEIGHT   480U
 #define VIDEO_WIDTH    640U
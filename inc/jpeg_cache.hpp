@@ -0,0 +1,96 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file jpeg_cache.hpp
+ *
+ */
+
+#ifndef JPEG_CACHE__H_
+#define JPEG_CACHE__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <cstdint>
+
+#include "kinect_frame.hpp"
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+
+/* JPEG of a video frame, never modified once encoded so it can be handed to several consumers */
+struct EncodedFrame
+{
+    uint32_t timestamp;
+    int32_t brightness;
+    int32_t contrast;
+    std::chrono::steady_clock::time_point encoded_time;
+    std::vector<uint8_t> jpeg;
+};
+
+struct JpegCacheStats
+{
+    uint64_t encoded;
+    uint64_t reused;    /* Encode() calls served with a frame someone else encoded */
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Encodes each video frame once for a given brightness and contrast, whoever asks first, and
+ * hands the same JPEG to everyone else asking for it: the frames of an intrusion and those of
+ * the liveview are often the same Kinect frame. Frames are identified by their timestamp. The
+ * last few are kept; a request for one being encoded waits for it instead of encoding it again.
+ */
+class JpegCache
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] capacity : frames kept
+     */
+    JpegCache(size_t capacity);
+
+    /**
+     * @brief Get the JPEG of a frame, encoding it if nobody did yet
+     *
+     * @return null if it couldn't be encoded
+     */
+    std::shared_ptr<const EncodedFrame> Encode(KinectVideoFrame& frame, int32_t brightness, int32_t contrast);
+
+    /**
+     * @brief Last frame encoded, if it was with these settings and not longer ago than max_age
+     *
+     * @return null if there's none
+     */
+    std::shared_ptr<const EncodedFrame> GetLatest(int32_t brightness, int32_t contrast, std::chrono::milliseconds max_age);
+
+    JpegCacheStats GetStats();
+
+private:
+    struct Entry
+    {
+        uint32_t timestamp;
+        int32_t brightness;
+        int32_t contrast;
+        std::shared_future<std::shared_ptr<const EncodedFrame>> frame;
+    };
+
+    size_t m_capacity;
+    std::mutex m_mutex;
+    std::deque<Entry> m_entries;
+    std::shared_ptr<const EncodedFrame> m_latest;
+    JpegCacheStats m_stats;
+};
+
+#endif /* JPEG_CACHE__H_ */
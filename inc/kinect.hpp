@@ -12,6 +12,7 @@
  * Includes
  *******************************************************************/
 #include <memory>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <libfreenect/libfreenect.h>
@@ -39,6 +40,8 @@ public:
     bool IsRunning() override;
     void GetDepthFrame(KinectDepthFrame& frame) override;
     void GetVideoFrame(KinectVideoFrame& frame) override;
+    int Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) override;
+    int Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) override;
     int ChangeTilt(double tilt_angle) override;
     int ChangeLedColor(freenect_led_options color) override;
 
@@ -61,6 +64,11 @@ private:
     static std::mutex m_depth_mutex, m_video_mutex;
     static std::condition_variable m_depth_cv,m_video_cv;
 
+    /* Frame observers */
+    static uint64_t m_depth_sequence, m_video_sequence;
+    static std::mutex m_observers_mutex;
+    static std::vector<std::shared_ptr<KinectFrameObserver>> m_depth_observers, m_video_observers;
+
     /* Private funtions */
     static void VideoCallback(freenect_device* dev, void* data, uint32_t timestamp);
     static void DepthCallback(freenect_device* dev, void* data, uint32_t timestamp);
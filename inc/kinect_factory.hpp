@@ -14,6 +14,8 @@
 #include <memory>
 
 #include "kinect_interface.hpp"
+#include "replay_kinect.hpp"
+#include "synthetic_kinect.hpp"
 
 /*******************************************************************
  * Class declaration
@@ -22,6 +24,8 @@ class KinectFactory
 {
 public:
     static std::shared_ptr<IKinect> Create(uint32_t timeout_ms);
+    static std::shared_ptr<IKinect> CreateReplay(std::string recording_path, ReplayKinectConfig config, uint32_t timeout_ms);
+    static std::shared_ptr<IKinect> CreateSynthetic(SyntheticSceneConfig config, uint32_t timeout_ms);
 };
 
 #endif /* KINECT_FACTORY__H_ */
\ No newline at end of file
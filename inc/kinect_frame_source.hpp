@@ -0,0 +1,77 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file kinect_frame_source.hpp
+ *
+ */
+
+#ifndef KINECT_FRAME_SOURCE_H_
+#define KINECT_FRAME_SOURCE_H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "kinect_interface.hpp"
+#include "kinect_frame.hpp"
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Last depth/video frame plus its waiters and subscribers. Shared by the IKinect
+ * implementations that produce frames in software (replay, synthetic scene).
+ */
+class KinectFrameSource
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] timeout_ms : Get*Frame() timeout
+     */
+    KinectFrameSource(uint32_t timeout_ms);
+
+    /**
+     * @brief Clear the timestamps of the last frames so the next Get*Frame() waits for a new one
+     *
+     */
+    void Reset();
+
+    void GetDepthFrame(KinectDepthFrame& frame);
+    void GetVideoFrame(KinectVideoFrame& frame);
+    int Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer);
+    int Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer);
+
+    /**
+     * @brief Store a new frame, wake up the Get*Frame() waiters and notify the subscribers
+     *
+     * @param[in] data : DEPTH_WIDTH x DEPTH_HEIGHT (VIDEO_WIDTH x VIDEO_HEIGHT) pixels
+     * @param[in] timestamp : timestamp of the frame
+     */
+    void DeliverDepthFrame(const uint16_t* data, uint32_t timestamp);
+    void DeliverVideoFrame(const uint16_t* data, uint32_t timestamp);
+
+private:
+    uint32_t m_timeout_ms;
+
+    /* Frames */
+    std::unique_ptr<KinectDepthFrame> m_depth_frame;
+    std::unique_ptr<KinectVideoFrame> m_video_frame;
+
+    /* Concurrency safe */
+    std::mutex m_depth_mutex, m_video_mutex;
+    std::condition_variable m_depth_cv, m_video_cv;
+
+    /* Frame observers */
+    uint64_t m_depth_sequence, m_video_sequence;
+    std::mutex m_observers_mutex;
+    std::vector<std::shared_ptr<KinectFrameObserver>> m_depth_observers, m_video_observers;
+};
+
+#endif /* KINECT_FRAME_SOURCE_H_ */
@@ -11,6 +11,7 @@
 /*******************************************************************
  * Includes
  *******************************************************************/
+#include <memory>
 #include <libfreenect/libfreenect.h>
 #include <libfreenect/libfreenect_sync.h>
 
@@ -19,6 +20,35 @@
 /*******************************************************************
  * Class declaration
  *******************************************************************/
+enum class KinectFrameType
+{
+    Depth,
+    Video
+};
+
+class KinectFrameObserver
+{
+public:
+    virtual ~KinectFrameObserver() {};
+
+    /**
+     * @brief Called from the capture thread once per new depth frame. Keep it short, the
+     *        frame is only valid during the call and the next frame waits for it to return.
+     * 
+     * @param[in] frame : new depth frame
+     * @param[in] sequence : frame sequence number, increased by one per captured frame
+     */
+    virtual void NewDepthFrame(const KinectDepthFrame& frame, uint64_t sequence) {};
+
+    /**
+     * @brief Called from the capture thread once per new video frame. Same rules as NewDepthFrame().
+     * 
+     * @param[in] frame : new video frame
+     * @param[in] sequence : frame sequence number, increased by one per captured frame
+     */
+    virtual void NewVideoFrame(const KinectVideoFrame& frame, uint64_t sequence) {};
+};
+
 class IKinect
 {
 public:
@@ -73,6 +103,26 @@ public:
      */
     virtual void GetVideoFrame(KinectVideoFrame& frame) = 0;
 
+    /**
+     * @brief Register an observer to be called once per new frame of the given type
+     * 
+     * @param[in] frame_type : depth or video frames
+     * @param[in] observer : observer to register
+     * 
+     * @return 0 on success
+     */
+    virtual int Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) = 0;
+
+    /**
+     * @brief Unregister an observer. Must not be called from inside the observer's callback.
+     * 
+     * @param[in] frame_type : depth or video frames
+     * @param[in] observer : observer to unregister
+     * 
+     * @return 0 on success
+     */
+    virtual int Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) = 0;
+
     /**
      * @brief To get change kinect's tilt
      * 
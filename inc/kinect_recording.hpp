@@ -0,0 +1,175 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file kinect_recording.hpp
+ *
+ */
+
+#ifndef KINECT_RECORDING_H_
+#define KINECT_RECORDING_H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#include "kinect_interface.hpp"
+#include "kinect_frame.hpp"
+#include "object_pool.hpp"
+#include "pipeline_stage.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define KINECT_RECORDING_MAGIC   "KARECORD"
+#define KINECT_RECORDING_VERSION 1U
+
+/* Frames of each type waiting to be written, a frame that doesn't fit is dropped */
+#define KINECT_RECORDING_QUEUE_FRAMES 8U
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+
+/*
+ * Recording file layout, native endianness:
+ *
+ *   KinectRecordingHeader
+ *   KinectRecordingFrameHeader + depth_width * depth_height * uint16_t  (depth frame)
+ *   KinectRecordingFrameHeader + video_width * video_height * uint16_t  (video frame)
+ *   ...
+ *
+ * Both headers are multiple of 8 bytes so the frame data can be used directly from a
+ * memory map without copying it first. The frames are raw, not compressed: 600 KB each,
+ * about 36 MB/s with both streams at 30 fps, meant for short sessions.
+ */
+struct KinectRecordingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t depth_width;
+    uint32_t depth_height;
+    uint32_t video_width;
+    uint32_t video_height;
+    uint32_t reserved;
+};
+
+struct KinectRecordingFrameHeader
+{
+    uint8_t frame_type;       /* KinectFrameType */
+    uint8_t reserved[3];
+    uint32_t timestamp;       /* Kinect timestamp of the frame */
+    uint64_t capture_time_us; /* Capture time relative to the start of the recording */
+};
+
+static_assert(sizeof(KinectRecordingHeader) == 32, "Unexpected recording header size");
+static_assert(sizeof(KinectRecordingFrameHeader) == 16, "Unexpected recording frame header size");
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+class KinectRecorderObserver;
+
+/* Frame copied from the capture thread, written by the recorder's thread */
+struct RecordedFrame
+{
+    KinectFrameType frame_type;
+    std::shared_ptr<KinectFrame> frame;
+    uint64_t capture_time_us;
+};
+
+/*
+ * The capture thread only copies each frame to a preallocated one and queues it, the
+ * recorder's thread writes them. When the disk can't keep up the frames are dropped.
+ */
+class KinectRecorder
+{
+    friend KinectRecorderObserver;
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] kinect : kinect whose frames are recorded
+     */
+    KinectRecorder(std::shared_ptr<IKinect> kinect);
+
+    /**
+     * @brief Destructor
+     *
+     */
+    ~KinectRecorder();
+
+    /**
+     * @brief Create the recording file and start recording every depth and video frame
+     *
+     * @param[in] recording_path : path of the recording file, overwritten if it exists
+     *
+     * @return 0 on success
+     */
+    int Start(const std::string& recording_path);
+
+    /**
+     * @brief Stop recording, write the frames still queued and close the recording file
+     *
+     * @return 0 on success
+     */
+    int Stop();
+
+    /**
+     * @brief Check if it's recording, a frame that can't be written stops it
+     *
+     * @return true if it is recording
+     */
+    bool IsRecording();
+
+    /**
+     * @brief Get the number of frames written to the current/last recording
+     *
+     * @return number of frames
+     */
+    uint64_t GetNumberOfFrames();
+
+    /**
+     * @brief Get the number of frames of the current/last recording dropped, the queue was full
+     *
+     * @return number of frames
+     */
+    uint64_t GetDroppedFrames();
+
+private:
+    std::shared_ptr<IKinect> m_kinect;
+    std::shared_ptr<KinectRecorderObserver> m_observer;
+    std::mutex m_file_mutex;
+    FILE* m_file;
+    std::string m_path;
+    uint64_t m_file_end; /* End of the last complete frame */
+    uint64_t m_num_frames;
+    std::atomic<uint64_t> m_dropped_frames;
+    std::chrono::time_point<std::chrono::steady_clock> m_start_time;
+
+    /* While recording. One input per frame type, each has its own producer */
+    std::unique_ptr<ObjectPool<KinectDepthFrame>> m_depth_pool;
+    std::unique_ptr<ObjectPool<KinectVideoFrame>> m_video_pool;
+    std::unique_ptr<PipelineStage<RecordedFrame>> m_write_stage;
+
+    void QueueFrame(KinectFrameType frame_type, const KinectFrame& frame, std::shared_ptr<KinectFrame> pooled_frame);
+    void WriteFrame(RecordedFrame& recorded_frame);
+};
+
+class KinectRecorderObserver : public KinectFrameObserver
+{
+public:
+    KinectRecorderObserver(KinectRecorder& recorder);
+    void NewDepthFrame(const KinectDepthFrame& frame, uint64_t sequence) override;
+    void NewVideoFrame(const KinectVideoFrame& frame, uint64_t sequence) override;
+private:
+    KinectRecorder& m_recorder;
+};
+
+#endif /* KINECT_RECORDING_H_ */
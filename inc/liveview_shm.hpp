@@ -0,0 +1,128 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file liveview_shm.hpp
+ *
+ */
+
+#ifndef LIVEVIEW_SHM__H_
+#define LIVEVIEW_SHM__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define LIVEVIEW_SHM_MAGIC   0x4B414C56U /* "KALV" */
+#define LIVEVIEW_SHM_VERSION 1U
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+
+/*
+ * Layout of the shared memory object: the header followed by slot_count slots of
+ * sizeof(LiveviewShmSlot) + slot_size bytes. Frame n goes to slot n % slot_count.
+ */
+struct LiveviewShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    std::atomic<uint32_t> last_frame; /* Number of the last complete frame (0 = none yet), also the futex word */
+};
+
+struct LiveviewShmSlot
+{
+    std::atomic<uint32_t> frame; /* Frame number stored, 0 while being written */
+    uint32_t size;
+    uint64_t timestamp_us;       /* CLOCK_MONOTONIC when written */
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Publishes the encoded liveview frames in a POSIX shared memory ring. Only one writer
+ * per object. The readers are woken through a futex on the frame counter.
+ */
+class LiveviewShmWriter
+{
+public:
+    /**
+     * @brief Create (or take over) the shared memory object
+     *
+     * @param[in] name : POSIX shared memory name, e.g. "/kinectalarm_liveview"
+     * @param[in] slot_count : frames kept, a reader has slot_count - 1 frame periods to use one
+     * @param[in] slot_size : maximum size of a frame
+     */
+    LiveviewShmWriter(const std::string& name, uint32_t slot_count, uint32_t slot_size);
+    ~LiveviewShmWriter();
+
+    /**
+     * @brief Copy a frame to the next slot and wake the readers
+     *
+     * @return number of the frame, 0 if it doesn't fit in a slot
+     */
+    uint32_t Write(const uint8_t* data, size_t size);
+
+private:
+    std::string m_name;
+    uint8_t *m_memory;
+    size_t m_memory_size;
+    LiveviewShmHeader *m_header;
+};
+
+/*
+ * Reads the frames from another process without copying them. A slot can be overwritten
+ * while it's being used: after using the data IsValid() tells if it was still that frame.
+ */
+class LiveviewShmReader
+{
+public:
+    /**
+     * @brief Map the shared memory object read only
+     */
+    LiveviewShmReader(const std::string& name);
+    ~LiveviewShmReader();
+
+    /**
+     * @brief Wait for a frame newer than last_frame
+     *
+     * @return number of the newest frame, 0 on timeout
+     */
+    uint32_t WaitFrame(uint32_t last_frame, uint32_t timeout_ms);
+
+    /**
+     * @brief Get the newest frame
+     *
+     * @param[out] frame : its number, to check it with IsValid()
+     * @param[out] data : the frame, in the shared memory
+     * @param[out] size : its size
+     *
+     * @return 0 if ok, -1 if there isn't any frame yet
+     */
+    int GetFrame(uint32_t& frame, const uint8_t*& data, size_t& size);
+
+    /**
+     * @brief Check that the slot of this frame hasn't been reused
+     */
+    bool IsValid(uint32_t frame);
+
+private:
+    const uint8_t *m_memory;
+    size_t m_memory_size;
+    const LiveviewShmHeader *m_header;
+
+    const LiveviewShmSlot* GetSlot(uint32_t frame);
+};
+
+#endif /* LIVEVIEW_SHM__H_ */
@@ -12,15 +12,474 @@
  * Includes
  *******************************************************************/
 #include <stdio.h>
+#include <stdarg.h>
 #include <syslog.h>
+#include <time.h>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "spsc_queue.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+
+/* Levels above it are compiled out, their arguments aren't even evaluated */
+#ifndef LOG_COMPILE_LEVEL
+    #ifndef DEBUG
+        #define LOG_COMPILE_LEVEL LOG_INFO
+    #else
+        #define LOG_COMPILE_LEVEL LOG_DEBUG
+    #endif
+#endif
+
+#define LOG_MESSAGE_SIZE       256U /* Longer messages are truncated */
+#define LOG_THREAD_RECORDS     128U /* Messages each thread can have waiting, the ones that don't fit are counted as lost */
+#define LOG_DRAIN_INTERVAL_MS  20U
+
+/* Messages of a call site beyond LOG_RATE_LIMIT_BURST per LOG_RATE_LIMIT_INTERVAL_MS are counted, not written.
+   The count is written with the next message of the call site after the interval */
+#define LOG_RATE_LIMIT_BURST       20U
+#define LOG_RATE_LIMIT_INTERVAL_MS 1000U
 
 /*******************************************************************
  * Macros
  *******************************************************************/
+#define LOG(log_level,format, ...)                                        \
+    do                                                                    \
+    {                                                                     \
+        if((log_level) <= LOG_COMPILE_LEVEL)                              \
+        {                                                                 \
+            Logger::Log(log_level, format, ## __VA_ARGS__);               \
+        }                                                                 \
+    } while(0)
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+enum class LogSink
+{
+    Syslog,
+    Stdout,     /* Messages as they are, like printf() */
+    File        /* Messages with date and level */
+};
+
+struct LogRecord
+{
+    int level;
+    const char *format;     /* Identifies the call site for the rate limiter */
+    struct timespec time;
+    char message[LOG_MESSAGE_SIZE];
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Each thread formats its messages into its own ring, LOG() doesn't wait for the output. It only
+ * takes a lock for the first message of a thread, to register its ring, and to wake up the drain
+ * when it sleeps. A background thread takes them from the rings every LOG_DRAIN_INTERVAL_MS, or
+ * right away for errors, and writes them to the sink: syslog in release builds, stdout in debug
+ * ones. The messages of each thread keep their order, the ones of different threads may not.
+ * Pending messages are written at exit.
+ */
+class Logger
+{
+public:
+    /**
+     * @brief The logger, created with the first message
+     *
+     */
+    static Logger& Instance()
+    {
+        /* Never destroyed: threads may log while the statics are destroyed */
+        static Logger *logger = new Logger();
+
+        return *logger;
+    }
+
+    /**
+     * @brief Format a message to the ring of the calling thread, use LOG() instead
+     *
+     */
+    static void Log(int level, const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        Logger& logger = Instance();
+        ThreadBuffer& buffer = logger.LocalBuffer();
+        LogRecord record;
+        va_list args;
+
+        record.level  = level;
+        record.format = format;
+        clock_gettime(CLOCK_REALTIME, &record.time);
+        va_start(args, format);
+        vsnprintf(record.message, sizeof(record.message), format, args);
+        va_end(args);
+
+        if(!buffer.queue.TryPush(std::move(record)))
+        {
+            buffer.lost.fetch_add(1, std::memory_order_relaxed);
+            logger.Wake();
+        }
+        else if(level <= LOG_ERR || buffer.queue.Size() > buffer.queue.Capacity() / 2)
+        {
+            logger.Wake();
+        }
+    }
+
+    /**
+     * @brief Change where the messages are written
+     *
+     * @param[in] path : file for LogSink::File, appended to
+     */
+    int SetSink(LogSink sink, const std::string& path = "")
+    {
+        int ret_val = 0;
+        FILE *file = nullptr;
+
+        if(sink == LogSink::File && nullptr == (file = fopen(path.c_str(), "ae")))
+        {
+            ret_val = -1;
+        }
+        else
+        {
+            Flush();
+
+            std::lock_guard<std::mutex> lock(m_sink_mutex);
+            if(m_file != nullptr)
+            {
+                fclose(m_file);
+            }
+            m_file = file;
+            m_sink = sink;
+        }
+
+        return ret_val;
+    }
+
+    /**
+     * @brief Change the rate limit of the call sites, and forget what they logged
+     *
+     * @param[in] burst : messages of a call site written per interval, 0 for no limit
+     */
+    void SetRateLimit(uint32_t burst, uint32_t interval_ms)
+    {
+        Flush();
+
+        std::lock_guard<std::mutex> lock(m_sink_mutex);
+        m_rate_limit_burst = burst;
+        m_rate_limit_interval = std::chrono::milliseconds(interval_ms);
+        m_call_sites.clear();
+    }
+
+    /**
+     * @brief Wait until the messages logged before, by any thread, are written
+     *
+     */
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        uint64_t ticket = ++m_flush_requested;
+
+        lock.unlock();
+        Wake();
+        lock.lock();
+        m_flushed_condition.wait(lock, [this, ticket] { return m_flushed >= ticket; });
+    }
+
+    /**
+     * @brief Messages lost because the ring of their thread was full
+     *
+     */
+    uint64_t GetLost()
+    {
+        return m_lost.load();
+    }
+
+    /**
+     * @brief Messages not written by the rate limiter
+     *
+     */
+    uint64_t GetSuppressed()
+    {
+        return m_suppressed.load();
+    }
+
+private:
+    struct ThreadBuffer
+    {
+        SpscQueue<LogRecord> queue{LOG_THREAD_RECORDS};
+        std::atomic<uint64_t> lost{0};
+        std::atomic<bool> exited{false};
+    };
+
+    /* Owned by each thread, its ring is dropped by the drain once the thread exited and it is empty */
+    struct ThreadHandle
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        ~ThreadHandle()
+        {
+            if(buffer)
+            {
+                buffer->exited.store(true);
+            }
+        }
+    };
+
+    struct CallSite
+    {
+        std::chrono::steady_clock::time_point window_start;
+        uint32_t count;
+        uint32_t suppressed;
+        int level;
+    };
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    uint64_t m_flush_requested;
+    uint64_t m_flushed;
+    std::condition_variable m_flushed_condition;
+
+    /* Only taken to wake the drain up when it is sleeping */
+    std::atomic<bool> m_sleeping;
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake_condition;
+
+    /* Taken by the drain while it writes */
+    std::mutex m_sink_mutex;
+    LogSink m_sink;
+    FILE *m_file;
+    uint32_t m_rate_limit_burst;
+    std::chrono::milliseconds m_rate_limit_interval;
+    std::unordered_map<const char*, CallSite> m_call_sites;
+
+    std::atomic<uint64_t> m_lost;
+    std::atomic<uint64_t> m_suppressed;
+
+    std::thread m_thread;
+
+    Logger() :
+        m_flush_requested(0),
+        m_flushed(0),
+        m_sleeping(false),
 #ifndef DEBUG
-    #define LOG(log_level,format, ...) syslog(log_level,format, ## __VA_ARGS__)
+        m_sink(LogSink::Syslog),
 #else
-    #define LOG(log_level,format, ...) printf(format, ## __VA_ARGS__)
+        m_sink(LogSink::Stdout),
 #endif
+        m_file(nullptr),
+        m_rate_limit_burst(LOG_RATE_LIMIT_BURST),
+        m_rate_limit_interval(LOG_RATE_LIMIT_INTERVAL_MS),
+        m_lost(0),
+        m_suppressed(0)
+    {
+        m_thread = std::thread(&Logger::Run, this);
+        std::atexit([] { Logger::Instance().Flush(); });
+    }
+
+    ThreadBuffer& LocalBuffer()
+    {
+        static thread_local ThreadHandle handle;
+
+        if(handle.buffer == nullptr)
+        {
+            handle.buffer = std::make_shared<ThreadBuffer>();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_buffers.push_back(handle.buffer);
+        }
+
+        return *handle.buffer;
+    }
+
+    void Wake()
+    {
+        /* Pairs with the one in Sleep(): either the drain sees the message or this sees it sleeping */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(m_sleeping.exchange(false))
+        {
+            std::lock_guard<std::mutex> lock(m_wake_mutex);
+            m_wake_condition.notify_one();
+        }
+    }
+
+    bool Pending(const std::vector<std::shared_ptr<ThreadBuffer>>& buffers)
+    {
+        for(const std::shared_ptr<ThreadBuffer>& buffer : buffers)
+        {
+            if(buffer->queue.Size() != 0 || buffer->lost.load() != 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Sleep(const std::vector<std::shared_ptr<ThreadBuffer>>& buffers, uint64_t flush_requested)
+    {
+        std::unique_lock<std::mutex> lock(m_wake_mutex);
+        bool flush;
+
+        m_sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        {
+            std::lock_guard<std::mutex> flush_lock(m_mutex);
+            flush = (m_flush_requested != flush_requested);
+        }
+
+        if(flush || Pending(buffers))
+        {
+            m_sleeping.store(false);
+        }
+        else
+        {
+            m_wake_condition.wait_for(lock, std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS), [this] { return !m_sleeping.load(); });
+            m_sleeping.store(false);
+        }
+    }
+
+    void Run()
+    {
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        uint64_t flush_requested;
+        LogRecord record;
+
+        while(true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                /* Read before draining: what was logged before the flush was requested is written */
+                flush_requested = m_flush_requested;
+                buffers = m_buffers;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_sink_mutex);
+
+                for(const std::shared_ptr<ThreadBuffer>& buffer : buffers)
+                {
+                    /* Read before draining, nothing is pushed after it */
+                    bool exited = buffer->exited.load();
+
+                    while(buffer->queue.TryPop(record))
+                    {
+                        Write(record);
+                    }
+
+                    uint64_t lost = buffer->lost.exchange(0);
+                    if(lost != 0)
+                    {
+                        m_lost.fetch_add(lost);
+                        WriteNotice(LOG_WARNING, std::to_string(lost) + " log messages lost, written faster than they were drained\n");
+                    }
+
+                    if(exited)
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_buffers.erase(std::remove(m_buffers.begin(), m_buffers.end(), buffer), m_buffers.end());
+                    }
+                }
+
+                if(m_sink != LogSink::Syslog)
+                {
+                    fflush((m_sink == LogSink::File) ? m_file : stdout);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_flushed != flush_requested)
+                {
+                    m_flushed = flush_requested;
+                    m_flushed_condition.notify_all();
+                }
+            }
+
+            Sleep(buffers, flush_requested);
+        }
+    }
+
+    /* With m_sink_mutex taken */
+    void Write(const LogRecord& record)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        auto it = m_call_sites.find(record.format);
+
+        if(it == m_call_sites.end())
+        {
+            it = m_call_sites.emplace(record.format, CallSite{now, 0, 0, record.level}).first;
+        }
+        else if(now - it->second.window_start >= m_rate_limit_interval)
+        {
+            if(it->second.suppressed != 0)
+            {
+                WriteNotice(it->second.level, std::to_string(it->second.suppressed) + " messages suppressed like: " + record.message);
+            }
+            it->second = CallSite{now, 0, 0, record.level};
+        }
+
+        if(m_rate_limit_burst == 0 || it->second.count < m_rate_limit_burst)
+        {
+            it->second.count++;
+            WriteSink(record);
+        }
+        else
+        {
+            it->second.suppressed++;
+            m_suppressed.fetch_add(1);
+        }
+    }
+
+    /* With m_sink_mutex taken */
+    void WriteNotice(int level, const std::string& message)
+    {
+        LogRecord record;
+
+        record.level  = level;
+        record.format = nullptr;
+        clock_gettime(CLOCK_REALTIME, &record.time);
+        snprintf(record.message, sizeof(record.message), "%s", message.c_str());
+        WriteSink(record);
+    }
+
+    /* With m_sink_mutex taken */
+    void WriteSink(const LogRecord& record)
+    {
+        static const char *level_names[] = {"EMERG", "ALERT", "CRIT", "ERR", "WARNING", "NOTICE", "INFO", "DEBUG"};
+        struct tm date;
+        char date_string[32];
+
+        if(m_sink == LogSink::Syslog)
+        {
+            syslog(record.level, "%s", record.message);
+        }
+        else if(m_sink == LogSink::Stdout)
+        {
+            fputs(record.message, stdout);
+        }
+        else
+        {
+            localtime_r(&record.time.tv_sec, &date);
+            strftime(date_string, sizeof(date_string), "%Y-%m-%d %H:%M:%S", &date);
+            fprintf(m_file, "%s.%03ld %s %s", date_string, record.time.tv_nsec / 1000000L,
+                    level_names[LOG_PRI(record.level)], record.message);
+        }
+    }
+};
 
 #endif /* SRC_LOG_H_ */
@@ -13,18 +13,32 @@
  *******************************************************************/
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <future>
 
 #include <hiredis/hiredis.h>
 #include <hiredis/async.h>
 #include <hiredis/adapters/libevent.h>
 
 #include "message_broker_interface.hpp"
+#include "mpsc_queue.hpp"
+#include "resp_writer.hpp"
+#include "ring_buffer.hpp"
 #include "log.hpp"
 
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define MESSAGE_BROKER_MAX_PENDING_PUBLISH 1024U
+#define MESSAGE_BROKER_OFFLINE_EVENTS      256U   /* Publishes kept while Redis is down */
+#define MESSAGE_BROKER_RECONNECT_MIN_MS    100U
+#define MESSAGE_BROKER_RECONNECT_MAX_MS    10000U
+
 /*******************************************************************
  * Class declaration
  *******************************************************************/
@@ -34,7 +48,21 @@
 class ChannelMessageObserver : public IChannelMessageObserver
 {
 public:
-    void ChannelMessageListener(const std::string& message) override {};
+    void ChannelMessageListener(std::string_view message) override {};
+};
+
+class IPublishObserver
+{
+public:
+    virtual void PublishFailed(const std::string& channel, const std::string& error) = 0;
+};
+
+struct PublishStats
+{
+    uint64_t queued;  /* Accepted by Publish(), or in a batch by ExecuteBatch() */
+    uint64_t sent;    /* Acknowledged by Redis */
+    uint64_t failed;  /* Rejected by Redis */
+    uint64_t dropped; /* Queue full, volatile channel while offline or offline buffer overflow */
 };
 
 class MessageBroker : public IMessageBroker
@@ -42,6 +70,11 @@ class MessageBroker : public IMessageBroker
 public:
     MessageBroker() = delete;
 
+    /**
+     * @brief Constructor, if Redis isn't available it keeps retrying in the background
+     *
+     * @param[in] path : Redis unix socket
+     */
     MessageBroker(const std::string path) noexcept(false);
 
     ~MessageBroker();
@@ -50,6 +83,13 @@ public:
 
     int Unsubscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer) override;
 
+    /**
+     * @brief Queue the message to be published from the event loop thread, it doesn't
+     *        wait for Redis. Failures are reported to the publish observer and counted
+     *        in the publish stats
+     *
+     * @return 0 if queued, -1 if dropped
+     */
     int Publish(const std::string& channel, const std::string& message) override;
 
     int GetVariable(Variable& variable) override;
@@ -60,16 +100,152 @@ public:
 
     int Clear() override;
 
-    int CallObservers(const std::string& channel, const std::string& message);
+    /**
+     * @brief Queue the commands of the batch behind the publishes already queued, wrapped in
+     *        MULTI/EXEC if atomic, and wait for their replies. Its publishes are counted in the
+     *        publish stats and kept while Redis is down like the others. From the event loop
+     *        thread it doesn't wait
+     *
+     * @return 0 if all the commands succeeded (queued from the event loop thread), -1 if a value
+     *         doesn't match its data type, nothing is sent then
+     */
+    int ExecuteBatch(const MessageBrokerBatch& batch, bool atomic = false) override;
+
+    /**
+     * @brief Queue the batch like ExecuteBatch(), done is called from the event loop thread
+     *        once its replies are in
+     *
+     * @return 0 if queued, -1 if a value doesn't match its data type, nothing is sent then
+     */
+    int PostBatch(const MessageBrokerBatch& batch, bool atomic, std::function<void(int)> done) override;
+
+    int CallObservers(std::string_view channel, std::string_view message);
+
+    /**
+     * @brief Set the observer notified, from the event loop thread, of the failed publishes
+     */
+    void SetPublishObserver(const std::shared_ptr<IPublishObserver> observer);
+
+    PublishStats GetPublishStats();
+
+    /**
+     * @brief Publishes to this channel are dropped instead of kept while Redis is down
+     */
+    void SetVolatileChannel(const std::string& channel);
+
+    /**
+     * @return true if all the connections to Redis are up
+     */
+    bool IsConnected();
+
 private:
+    struct PendingBatch;
+
+    struct PendingPublish
+    {
+        std::string channel;
+        std::string command;                 /* PUBLISH already encoded in RESP */
+        std::shared_ptr<PendingBatch> batch; /* Instead of the command, from ExecuteBatch() */
+    };
+
+    /* Owned by the event loop thread once queued */
+    struct PendingBatch
+    {
+        std::vector<PendingPublish> commands; /* MULTI/EXEC included if atomic, only the PUBLISHes have a channel */
+        bool atomic;
+        std::promise<int> result;
+        std::function<void(int)> done;       /* From PostBatch() */
+        size_t outstanding = 0;               /* Replies still to come */
+        bool failed = false;
+        bool lost = false;                    /* Not sent or no reply, the connection dropped */
+    };
+
+    struct BatchReply
+    {
+        std::shared_ptr<PendingBatch> batch;
+        size_t index;
+    };
+
+    std::string m_path;
     redisContext *m_context = nullptr;
     redisAsyncContext *m_async_context = nullptr;
     event_base *m_event_base = nullptr;
     std::mutex m_context_mutex;
+    RespWriter m_command_writer; /* Protected by m_context_mutex */
     std::unique_ptr<std::thread> m_proccess_async_events_thread;
-    std::map<std::string, std::vector<std::shared_ptr<IChannelMessageObserver>>> m_observer_map;
+    std::thread::id m_proccess_async_events_thread_id;
+
+    struct ChannelObservers
+    {
+        std::string channel;
+        std::vector<std::shared_ptr<IChannelMessageObserver>> observers;
+    };
+
+    /*
+     * Copy on write: a published table is never modified, Subscribe() and Unsubscribe() build a
+     * new one and replace it under the mutex, then bump the version. The event loop keeps its own
+     * reference and only takes the mutex to reload it when the version changed, so delivering a
+     * message is a single atomic load. Not std::atomic_load() of the shared_ptr, it isn't lock-free
+     * in libstdc++ and is deprecated in C++20. The keys point to the channel of their own entry,
+     * so lookups with a string_view don't allocate.
+     */
+    using ObserverTable = std::unordered_map<std::string_view, std::shared_ptr<const ChannelObservers>>;
+    std::shared_ptr<const ObserverTable> m_observer_table; /* Protected by m_observer_table_mutex */
+    std::mutex m_observer_table_mutex;
+    std::atomic<uint64_t> m_observer_table_version;
+    std::shared_ptr<const ObserverTable> m_loop_observer_table; /* Owned by the event loop thread */
+    uint64_t m_loop_observer_table_version;
+
+    /* A subscribed connection can't PUBLISH, the publishes have their own one in the same loop */
+    redisAsyncContext *m_publish_context = nullptr;
+    event *m_publish_event = nullptr;
+    MpscQueue<PendingPublish> m_publish_queue;
+    std::atomic<bool> m_publish_connected;
+    std::atomic<bool> m_publish_scheduled;
+    std::atomic<uint32_t> m_publish_pending;
+    std::atomic<uint64_t> m_publish_queued, m_publish_sent, m_publish_failed, m_publish_dropped;
+    std::shared_ptr<IPublishObserver> m_publish_observer;
+    std::mutex m_publish_observer_mutex;
+
+    /* Connection supervision, all owned by the event loop thread except the atomics */
+    event *m_reconnect_event = nullptr;
+    uint32_t m_reconnect_interval_ms;
+    std::atomic<bool> m_reconnect_scheduled;
+    std::atomic<bool> m_sync_connected;
+    std::atomic<bool> m_subscribe_connected;
+    RingBuffer<PendingPublish> m_offline_events;
+    std::vector<std::string> m_volatile_channels;
+    std::unordered_map<std::string, Variable> m_variable_cache; /* Last SET of each variable, protected by m_context_mutex */
 
     void ProccessAsyncEvents();
+    int RunInEventLoop(std::function<int(void)> function);
+    void SendPendingPublishes();
+    std::shared_ptr<PendingBatch> EncodeBatch(const MessageBrokerBatch& batch, bool atomic);
+    void QueueBatch(std::shared_ptr<PendingBatch> batch, const MessageBrokerBatch& commands);
+    void SendBatch(std::shared_ptr<PendingBatch> batch);
+    void BatchCommandDone(PendingBatch& batch, size_t index, const redisReply* reply);
+    void FinishBatch(PendingBatch& batch);
+    void PublishDone(const std::string& channel, const char* error);
+    void PublishDropped(const std::string& channel, const char* reason);
+    void NotifyPublishFailed(const std::string& channel, const char* error);
+    void KeepOffline(PendingPublish&& pending);
+    redisReply* SendCommand();
+    int ConnectSync();
+    int ConnectSubscribe();
+    int ConnectPublish();
+    void RequestReconnect();
+    void Reconnect();
+    void ReplayOfflineState();
+
+    static void OnRunInEventLoop(evutil_socket_t fd, short events, void *data);
+    static void OnPublishEvent(evutil_socket_t fd, short events, void *data);
+    static void OnPublishReply(redisAsyncContext *redis_context, void *reply, void *data);
+    static void OnBatchReply(redisAsyncContext *redis_context, void *reply, void *data);
+    static void OnPublishDisconnect(const redisAsyncContext *redis_context, int status);
+    static void OnSubscribeDisconnect(const redisAsyncContext *redis_context, int status);
+    static void OnReconnect(evutil_socket_t fd, short events, void *data);
+    std::shared_ptr<const ObserverTable> LoadObserverTable();
+    void StoreObserverTable(std::shared_ptr<const ObserverTable> table);
     int RegisterObserver(const std::string& channel, std::shared_ptr<IChannelMessageObserver> observer);
     int UnRegisterObserver(const std::string& channel, std::shared_ptr<IChannelMessageObserver> observer);
 };
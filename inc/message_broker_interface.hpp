@@ -12,7 +12,10 @@
  * Includes
  *******************************************************************/
 #include <string>
+#include <string_view>
+#include <vector>
 #include <memory>
+#include <functional>
 #include "data_definition.hpp"
 
 /*******************************************************************
@@ -21,7 +24,47 @@
 class IChannelMessageObserver
 {
 public:
-    virtual void ChannelMessageListener(const std::string& message) = 0;
+    /**
+     * @brief Called from the broker's event loop thread, message is only valid during the call
+     */
+    virtual void ChannelMessageListener(std::string_view message) = 0;
+};
+
+enum class BatchCommandType
+{
+    SetVariable,
+    Publish
+};
+
+struct BatchCommand
+{
+    BatchCommandType type;
+    Variable variable;   /* SetVariable */
+    std::string channel; /* Publish */
+    std::string message; /* Publish */
+};
+
+/* Commands collected to be sent together with IMessageBroker::ExecuteBatch() */
+class MessageBrokerBatch
+{
+public:
+    void SetVariable(const Variable& variable)
+    {
+        m_commands.push_back({BatchCommandType::SetVariable, variable, std::string(), std::string()});
+    }
+
+    void Publish(const std::string& channel, const std::string& message)
+    {
+        m_commands.push_back({BatchCommandType::Publish, Variable(), channel, message});
+    }
+
+    const std::vector<BatchCommand>& GetCommands() const
+    {
+        return m_commands;
+    }
+
+private:
+    std::vector<BatchCommand> m_commands;
 };
 
 class IMessageBroker
@@ -77,6 +120,59 @@ public:
      * @return 0 if ok
      */
     virtual int Clear() = 0;
+
+    /**
+     * @brief Execute the commands of the batch in order. This one sends them one by one, so it
+     *        fails without sending anything if atomic, the brokers that can do it override it
+     *
+     * @param[in] batch : commands to execute
+     * @param[in] atomic : the commands are applied all together or none of them
+     *
+     * @return 0 if all the commands succeeded
+     */
+    virtual int ExecuteBatch(const MessageBrokerBatch& batch, bool atomic = false)
+    {
+        return atomic ? -1 : ExecuteBatchInOrder(batch);
+    }
+
+    /**
+     * @brief Like ExecuteBatch() without waiting for the replies, for the threads the broker may be
+     *        waiting for. This one executes the batch before returning
+     *
+     * @param[in] done : gets what ExecuteBatch() would return, maybe from the broker's thread
+     *
+     * @return 0 if the batch was taken, done is called then
+     */
+    virtual int PostBatch(const MessageBrokerBatch& batch, bool atomic, std::function<void(int)> done)
+    {
+        done(ExecuteBatch(batch, atomic));
+        return 0;
+    }
+
+protected:
+    /**
+     * @brief Execute the commands one by one, the ones after a failed command are still executed
+     *
+     * @return 0 if all the commands succeeded
+     */
+    int ExecuteBatchInOrder(const MessageBrokerBatch& batch)
+    {
+        int retval = 0;
+
+        for(const auto& command : batch.GetCommands())
+        {
+            if(command.type == BatchCommandType::SetVariable && 0 != SetVariable(command.variable))
+            {
+                retval = -1;
+            }
+            else if(command.type == BatchCommandType::Publish && 0 != Publish(command.channel, command.message))
+            {
+                retval = -1;
+            }
+        }
+
+        return retval;
+    }
 };
 
 #endif /* IMESSAGE_BROKER__H_ */
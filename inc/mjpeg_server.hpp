@@ -0,0 +1,115 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file mjpeg_server.hpp
+ *
+ */
+
+#ifndef MJPEG_SERVER__H_
+#define MJPEG_SERVER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include <event2/event.h>
+#include <event2/http.h>
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define MJPEG_SERVER_BOUNDARY "kinectalarmframe"
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+struct MjpegServerStats
+{
+    uint32_t clients;
+    uint64_t frames_sent;    /* Frame deliveries, one per client */
+    uint64_t frames_dropped; /* Skipped because the client hadn't taken the previous one yet */
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Serves the liveview as multipart/x-mixed-replace MJPEG over HTTP from its own libevent
+ * loop. Every client shares the same encoded frame (referenced, not copied, by the output
+ * buffers) and gets the newest one when it is ready for it: a slow client only loses frames.
+ * A client can ask for a lower rate with ?fps=N.
+ */
+class MjpegServer
+{
+public:
+    /**
+     * @brief Start serving on address:port
+     *
+     * @param[in] port : 0 for any free port, see GetPort()
+     * @param[in] max_fps : rate limit of every client
+     */
+    MjpegServer(const std::string& address, uint16_t port, const std::string& path, uint32_t max_fps);
+    ~MjpegServer();
+
+    /**
+     * @brief Send a new JPEG to the clients, can be called from any thread
+     */
+    void PushFrame(const std::vector<uint8_t>& jpeg);
+
+    uint16_t GetPort();
+
+    MjpegServerStats GetStats();
+
+private:
+    struct Client
+    {
+        MjpegServer *server;
+        evhttp_request *request;
+        std::chrono::steady_clock::duration interval;
+        std::chrono::steady_clock::time_point last_sent;
+        uint64_t last_frame;
+    };
+
+    using Frame = std::shared_ptr<const std::vector<uint8_t>>;
+
+    std::string m_path;
+    uint32_t m_max_fps;
+    uint16_t m_port;
+    event_base *m_event_base = nullptr;
+    evhttp *m_http = nullptr;
+    event *m_frame_event = nullptr;
+    event *m_pacing_event = nullptr;
+    event *m_stop_event = nullptr;
+    std::unique_ptr<std::thread> m_thread;
+
+    std::mutex m_frame_mutex;
+    Frame m_frame;               /* Protected by m_frame_mutex */
+    std::atomic<uint64_t> m_frame_number;
+
+    /* Owned by the event loop thread */
+    std::vector<std::unique_ptr<Client>> m_clients;
+    std::atomic<uint32_t> m_client_count;
+    std::atomic<uint64_t> m_frames_sent, m_frames_dropped;
+
+    void SendFrames();
+    void SendFrame(Client& client, const Frame& frame, uint64_t frame_number);
+    void RemoveClient(Client *client);
+    void Release();
+
+    static void OnRequest(evhttp_request *request, void *data);
+    static void OnClientClose(evhttp_connection *connection, void *data);
+    static void OnFrame(evutil_socket_t fd, short events, void *data);
+    static void OnStop(evutil_socket_t fd, short events, void *data);
+    static void OnFrameSent(const void *data, size_t length, void *frame);
+};
+
+#endif /* MJPEG_SERVER__H_ */
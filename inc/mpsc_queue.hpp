@@ -0,0 +1,106 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file mpsc_queue.hpp
+ *
+ */
+
+#ifndef MPSC_QUEUE__H_
+#define MPSC_QUEUE__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <atomic>
+#include <utility>
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Unbounded multi producer single consumer queue (Vyukov's intrusive list).
+ * Push() is wait-free and can be called from any thread, Pop() must always be
+ * called from the same consumer thread. T has to be default constructible, the
+ * list always keeps one stub node.
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() :
+        m_head(new Node()),
+        m_tail(m_head.load(std::memory_order_relaxed))
+    {
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while(Pop(value))
+        {
+        }
+        delete m_tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Add an element at the end of the queue
+     *
+     * @param[in] value : element to add
+     */
+    void Push(T value)
+    {
+        Node* node = new Node(std::move(value));
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+
+        /* Until this store the consumer sees the queue as finishing at previous */
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief Take the first element of the queue, consumer thread only
+     *
+     * @param[out] value : element taken
+     *
+     * @return true if an element was taken, false if the queue was empty
+     */
+    bool Pop(T& value)
+    {
+        bool retval = false;
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+
+        if(next != nullptr)
+        {
+            value = std::move(next->value);
+            m_tail = next;
+            delete tail;
+            retval = true;
+        }
+
+        return retval;
+    }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr)
+        {
+        }
+
+        Node(T&& node_value) : next(nullptr), value(std::move(node_value))
+        {
+        }
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+};
+
+#endif /* MPSC_QUEUE__H_ */
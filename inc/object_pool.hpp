@@ -0,0 +1,93 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file object_pool.hpp
+ *
+ */
+
+#ifndef OBJECT_POOL__H_
+#define OBJECT_POOL__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Fixed set of objects allocated up front. Acquire() lends one as a shared_ptr that gives
+ * it back to the pool when the last reference is dropped, from whichever thread that is.
+ * Objects lent keep the pool's free list alive, they can outlive the pool itself.
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] count : objects in the pool
+     * @param[in] create : allocates each of them
+     */
+    ObjectPool(size_t count, std::function<std::unique_ptr<T>()> create) :
+        m_free(std::make_shared<FreeList>())
+    {
+        m_free->objects.reserve(count);
+        for(size_t i = 0; i < count; i++)
+        {
+            m_free->objects.push_back(create());
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * @brief Lend an object, as it was left by its last user
+     *
+     * @return null if all of them are lent
+     */
+    std::shared_ptr<T> Acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_free->mutex);
+        std::shared_ptr<FreeList> free_list = m_free;
+
+        if(m_free->objects.empty())
+        {
+            return nullptr;
+        }
+
+        T *object = m_free->objects.back().release();
+        m_free->objects.pop_back();
+
+        return std::shared_ptr<T>(object, [free_list](T *returned)
+        {
+            std::lock_guard<std::mutex> lock(free_list->mutex);
+            free_list->objects.emplace_back(returned);
+        });
+    }
+
+    size_t Available()
+    {
+        std::lock_guard<std::mutex> lock(m_free->mutex);
+
+        return m_free->objects.size();
+    }
+
+private:
+    struct FreeList
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<T>> objects;
+    };
+
+    std::shared_ptr<FreeList> m_free;
+};
+
+#endif /* OBJECT_POOL__H_ */
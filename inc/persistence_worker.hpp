@@ -0,0 +1,80 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file persistence_worker.hpp
+ *
+ */
+
+#ifndef PERSISTENCE_WORKER__H_
+#define PERSISTENCE_WORKER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "mpsc_queue.hpp"
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Applies the state updates (database rows, Redis variables and events) from its own thread,
+ * so the thread that produces them, e.g. the detection loop, never waits for the disk or the
+ * network. The updates are applied in the order they were posted, the ones waiting when the
+ * thread wakes up as one batch. Everything posted is applied before the destructor returns.
+ */
+class PersistenceWorker
+{
+public:
+    using Command = std::function<void()>;
+
+    PersistenceWorker() noexcept(false);
+    ~PersistenceWorker();
+
+    /**
+     * @brief Queue an update, wait-free, can be called from any thread
+     *
+     * @param[in] command : applies the update, it should capture copies of what it writes
+     * @param[in] key : if not empty, a command with the same key posted later in the same batch replaces this one
+     */
+    void Post(Command command, const std::string& key = "");
+
+    /**
+     * @brief Wait until everything posted before is applied. Not from a command, nor from a thread
+     *        a command may wait for, like the message broker's event loop
+     */
+    void Flush();
+
+private:
+    struct PendingCommand
+    {
+        std::string key;
+        Command command;
+    };
+
+    MpscQueue<PendingCommand> m_queue;
+    std::atomic<bool> m_stop;
+
+    /* Only taken to wake the thread up when it is sleeping */
+    std::atomic<bool> m_sleeping;
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake_condition;
+
+    std::unique_ptr<std::thread> m_thread;
+
+    void Run();
+    void Wake();
+    void Sleep(std::vector<PendingCommand>& batch);
+    static void Apply(std::vector<PendingCommand>& batch);
+};
+
+#endif /* PERSISTENCE_WORKER__H_ */
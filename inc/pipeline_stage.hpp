@@ -0,0 +1,327 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file pipeline_stage.hpp
+ *
+ */
+
+#ifndef PIPELINE_STAGE__H_
+#define PIPELINE_STAGE__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <deque>
+
+#include "spsc_queue.hpp"
+#include "cyclic_task.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+struct PipelineStageStats
+{
+    uint64_t pushed;        /* Items accepted by the inputs, processed or still waiting */
+    uint64_t processed;
+    uint64_t dropped;       /* Items that found their input full, or lost before reaching it */
+    size_t occupancy;       /* Items waiting in the inputs */
+    size_t max_occupancy;   /* Most items ever waiting in one input */
+    size_t capacity;        /* Of each input */
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Stage of a pipeline: a thread that processes the items pushed to its inputs, each of them a
+ * bounded SPSC queue with one producer, e.g. the previous stage. The inputs are served round
+ * robin, the items of each one in order. Push() never blocks: an item that doesn't fit is
+ * dropped and counted, so a slow stage sheds load instead of stalling the ones before it.
+ * Neither does PushOrDefer(), an item that can't be dropped waits aside, behind the others.
+ * Everything pushed is processed before the destructor returns.
+ */
+template<typename T>
+class PipelineStage
+{
+public:
+    using Process = std::function<void(T& item)>;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] stage_name : name used in the logs and of the thread scheduling
+     * @param[in] inputs : number of inputs, one per producer
+     * @param[in] capacity : items each input can hold
+     * @param[in] config : scheduling options of the stage thread, the backend is not used
+     * @param[in] process : called from the stage thread for each item
+     */
+    PipelineStage(const std::string& stage_name, size_t inputs, size_t capacity, CyclicTaskConfig config, Process process) noexcept(false) :
+        m_stage_name(stage_name),
+        m_config(config),
+        m_process(std::move(process)),
+        m_processed(0),
+        m_stop(false),
+        m_sleeping(false)
+    {
+        for(size_t i = 0; i < inputs; i++)
+        {
+            m_inputs.push_back(std::make_unique<Input>(capacity));
+        }
+
+        try
+        {
+            m_thread = std::make_unique<std::thread>(&PipelineStage::Run, this);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LOG_ERR,"%s stage thread creation failed\n", m_stage_name.c_str());
+            throw std::exception();
+        }
+    }
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    ~PipelineStage()
+    {
+        m_stop.store(true);
+        Wake();
+        m_thread->join();
+    }
+
+    /**
+     * @brief Queue an item, wait-free, only from the producer of the input
+     *
+     * @return false if the input was full, the item is dropped
+     */
+    bool Push(size_t input, T&& item)
+    {
+        Input& in = *m_inputs[input];
+
+        /* Counted before it can be processed, pushed == processed means nothing is left */
+        in.pushed.fetch_add(1, std::memory_order_relaxed);
+
+        /* Never ahead of a deferred item */
+        bool ret_val = (in.deferred_count.load(std::memory_order_acquire) == 0) && in.queue.TryPush(std::move(item));
+
+        if(ret_val)
+        {
+            in.dropping = false;
+            UpdateMaxOccupancy(in);
+            Wake();
+        }
+        else
+        {
+            in.pushed.fetch_sub(1, std::memory_order_relaxed);
+            in.dropped.fetch_add(1, std::memory_order_relaxed);
+            /* Logged once per burst, not for each item */
+            if(!in.dropping)
+            {
+                in.dropping = true;
+                LOG(LOG_WARNING,"%s stage input %zu full, dropping items\n", m_stage_name.c_str(), input);
+            }
+        }
+
+        return ret_val;
+    }
+
+    /**
+     * @brief Queue an item that can't be dropped, e.g. one that ends a sequence, without waiting,
+     *        only from the producer of the input. If the input is full it is kept aside and
+     *        processed after the items before it, the ones pushed until then are dropped
+     */
+    void PushOrDefer(size_t input, T&& item)
+    {
+        Input& in = *m_inputs[input];
+
+        in.pushed.fetch_add(1, std::memory_order_relaxed);
+        if(in.deferred_count.load(std::memory_order_acquire) == 0 && in.queue.TryPush(std::move(item)))
+        {
+            UpdateMaxOccupancy(in);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(in.deferred_mutex);
+            in.deferred.push_back(std::move(item));
+            in.deferred_count.fetch_add(1, std::memory_order_release);
+        }
+
+        Wake();
+    }
+
+    /**
+     * @brief Count an item dropped before reaching the input, e.g. no buffer was free for it
+     */
+    void Dropped(size_t input)
+    {
+        m_inputs[input]->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    PipelineStageStats GetStats()
+    {
+        /* Processed read first, so it is never ahead of pushed */
+        PipelineStageStats stats = {0, m_processed.load(std::memory_order_acquire), 0, 0, 0, 0};
+
+        for(const std::unique_ptr<Input>& in : m_inputs)
+        {
+            stats.pushed += in->pushed.load(std::memory_order_relaxed);
+            stats.dropped += in->dropped.load(std::memory_order_relaxed);
+            stats.occupancy += in->queue.Size() + in->deferred_count.load(std::memory_order_relaxed);
+            stats.max_occupancy = std::max(stats.max_occupancy, in->max_occupancy.load(std::memory_order_relaxed));
+            stats.capacity = in->queue.Capacity();
+        }
+
+        return stats;
+    }
+
+private:
+    struct Input
+    {
+        Input(size_t capacity) : queue(capacity), dropping(false), pushed(0), dropped(0), max_occupancy(0), deferred_count(0) {}
+
+        SpscQueue<T> queue;
+        bool dropping;      /* Producer side only */
+        std::atomic<uint64_t> pushed;
+        std::atomic<uint64_t> dropped;
+        std::atomic<size_t> max_occupancy;
+
+        /* Items that didn't fit in the queue, taken by the stage once it is empty */
+        std::mutex deferred_mutex;
+        std::deque<T> deferred;
+        std::atomic<size_t> deferred_count;
+    };
+
+    std::string m_stage_name;
+    CyclicTaskConfig m_config;
+    Process m_process;
+    std::vector<std::unique_ptr<Input>> m_inputs;
+    std::atomic<uint64_t> m_processed;
+    std::atomic<bool> m_stop;
+
+    /* Only taken to wake the thread up when it is sleeping */
+    std::atomic<bool> m_sleeping;
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake_condition;
+
+    std::unique_ptr<std::thread> m_thread;
+
+    void UpdateMaxOccupancy(Input& in)
+    {
+        size_t occupancy = in.queue.Size();
+        size_t max_occupancy = in.max_occupancy.load(std::memory_order_relaxed);
+
+        while(occupancy > max_occupancy &&
+              !in.max_occupancy.compare_exchange_weak(max_occupancy, occupancy, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void Wake()
+    {
+        /* Pairs with the one in Sleep(): either the stage sees the item or this sees it sleeping */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(m_sleeping.exchange(false))
+        {
+            std::lock_guard<std::mutex> lock(m_wake_mutex);
+            m_wake_condition.notify_one();
+        }
+    }
+
+    bool Pending()
+    {
+        for(const std::unique_ptr<Input>& in : m_inputs)
+        {
+            if(in->queue.Size() != 0 || in->deferred_count.load() != 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Sleep()
+    {
+        std::unique_lock<std::mutex> lock(m_wake_mutex);
+
+        m_sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(Pending() || m_stop.load())
+        {
+            /* Pushed while going to sleep, the producer may or may not have seen it sleeping */
+            m_sleeping.store(false);
+        }
+        else
+        {
+            m_wake_condition.wait(lock, [this] { return !m_sleeping.load(); });
+        }
+    }
+
+    bool PopDeferred(Input& in, T& item)
+    {
+        bool ret_val = false;
+
+        /* The producer pushes nothing to the queue meanwhile, so once it is empty they are next */
+        if(in.deferred_count.load(std::memory_order_acquire) != 0)
+        {
+            std::lock_guard<std::mutex> lock(in.deferred_mutex);
+            item = std::move(in.deferred.front());
+            in.deferred.pop_front();
+            in.deferred_count.fetch_sub(1, std::memory_order_release);
+            ret_val = true;
+        }
+
+        return ret_val;
+    }
+
+    void Run()
+    {
+        T item;
+        bool stop = false;
+
+        ApplyThreadScheduling(m_stage_name, m_config);
+
+        while(!stop)
+        {
+            /* Read before draining: everything pushed before the stop is processed */
+            stop = m_stop.load();
+            bool processed = false;
+
+            for(const std::unique_ptr<Input>& in : m_inputs)
+            {
+                if(in->queue.TryPop(item) || PopDeferred(*in, item))
+                {
+                    m_process(item);
+                    item = T();
+                    m_processed.fetch_add(1, std::memory_order_release);
+                    processed = true;
+                }
+            }
+
+            if(processed)
+            {
+                stop = false;
+            }
+            else if(!stop)
+            {
+                Sleep();
+            }
+        }
+    }
+};
+
+#endif /* PIPELINE_STAGE__H_ */
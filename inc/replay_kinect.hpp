@@ -0,0 +1,109 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file replay_kinect.hpp
+ *
+ */
+
+#ifndef REPLAY_KINECT_H_
+#define REPLAY_KINECT_H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "kinect_interface.hpp"
+#include "kinect_recording.hpp"
+#include "kinect_frame_source.hpp"
+#include "cyclic_task.hpp"
+#include "kinect_frame.hpp"
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+enum class ReplayMode
+{
+    RealTime,        /* Frames are delivered honoring the recorded capture times */
+    AsFastAsPossible /* Frames are delivered back to back */
+};
+
+struct ReplayKinectConfig
+{
+    ReplayMode mode = ReplayMode::RealTime;
+    bool loop       = false; /* Start over when the end of the recording is reached */
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+class ReplayKinect : public IKinect, public CyclicTask
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] recording_path : recording written by KinectRecorder
+     * @param[in] config : replay mode
+     * @param[in] timeout_ms : Get*Frame() timeout
+     */
+    ReplayKinect(std::string recording_path, ReplayKinectConfig config, uint32_t timeout_ms);
+    virtual ~ReplayKinect();
+
+    int Init() override;
+    int Term() override;
+    int Start() override;
+    int Stop() override;
+    bool IsRunning() override;
+    void GetDepthFrame(KinectDepthFrame& frame) override;
+    void GetVideoFrame(KinectVideoFrame& frame) override;
+    int Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) override;
+    int Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) override;
+    int ChangeTilt(double tilt_angle) override;
+    int ChangeLedColor(freenect_led_options color) override;
+
+    /**
+     * @brief Check if every frame of the recording has been delivered. Never true when looping.
+     *
+     * @return true if the replay reached the end of the recording
+     */
+    bool IsFinished();
+
+    /**
+     * @brief Get the number of frames (depth and video) in the recording
+     *
+     * @return number of frames, 0 if it's not initialized
+     */
+    uint64_t GetNumberOfFrames();
+
+private:
+    std::string m_recording_path;
+    ReplayKinectConfig m_config;
+
+    /* Memory mapped recording */
+    const uint8_t* m_recording;
+    size_t m_recording_size;
+    std::vector<size_t> m_frame_offsets;
+    size_t m_next_frame;
+
+    /* Frames, waiters and observers */
+    KinectFrameSource m_frame_source;
+
+    /* Pacing */
+    std::mutex m_pacing_mutex;
+    std::condition_variable m_pacing_cv;
+    bool m_stopping;
+    std::atomic<bool> m_finished;
+    std::chrono::time_point<std::chrono::steady_clock> m_replay_start;
+
+    /* Private funtions */
+    int IndexRecording();
+    void ExecutionCycle() override;
+};
+
+#endif /* REPLAY_KINECT_H_ */
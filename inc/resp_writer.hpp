@@ -0,0 +1,79 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file resp_writer.hpp
+ *
+ */
+
+#ifndef RESP_WRITER__H_
+#define RESP_WRITER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "data_definition.hpp"
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Encodes Redis commands in RESP (arrays of bulk strings) with explicit lengths, so the
+ * arguments can hold spaces or NULs. The buffer keeps its capacity between commands:
+ * once it has grown, encoding a command doesn't allocate. Several commands can be
+ * encoded one after the other to be sent pipelined.
+ */
+class RespWriter
+{
+public:
+    RespWriter();
+
+    /**
+     * @brief Empty the buffer, keeping its capacity
+     */
+    void Clear();
+
+    /**
+     * @brief Make room for at least size bytes
+     */
+    void Reserve(size_t size);
+
+    /**
+     * @brief Start a command, it must be followed by argc arguments
+     *
+     * @param[in] argc : number of arguments, the command name included
+     */
+    void BeginCommand(uint32_t argc);
+
+    void AddArgument(std::string_view argument);
+    void AddArgument(const char* argument);
+    void AddArgument(int32_t argument);
+    void AddArgument(float argument);
+    void AddArgument(bool argument);
+
+    /**
+     * @brief Add the value of the variable, formatted as its data type
+     *
+     * @return 0 if ok, -1 if the value doesn't hold the variable's data type (nothing is added)
+     */
+    int AddArgument(const Variable& variable);
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+    /**
+     * @brief Move the encoded commands out, the writer is left empty
+     */
+    std::string TakeBuffer();
+
+private:
+    std::string m_buffer;
+
+    void AppendHeader(char type, int64_t value);
+};
+
+#endif /* RESP_WRITER__H_ */
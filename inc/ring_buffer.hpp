@@ -0,0 +1,100 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file ring_buffer.hpp
+ *
+ */
+
+#ifndef RING_BUFFER__H_
+#define RING_BUFFER__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <vector>
+#include <utility>
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Fixed capacity FIFO, when full the oldest element is overwritten.
+ * Not thread safe.
+ */
+template<typename T>
+class RingBuffer
+{
+public:
+    RingBuffer(size_t capacity) :
+        m_elements(capacity),
+        m_first(0),
+        m_size(0)
+    {
+    }
+
+    /**
+     * @brief Add an element at the end
+     *
+     * @return true if the oldest element had to be overwritten to make room
+     */
+    bool Push(T value)
+    {
+        bool overwritten = false;
+
+        if(m_elements.empty())
+        {
+            overwritten = true;
+        }
+        else
+        {
+            if(m_size == m_elements.size())
+            {
+                m_first = (m_first + 1) % m_elements.size();
+                m_size--;
+                overwritten = true;
+            }
+            m_elements[(m_first + m_size) % m_elements.size()] = std::move(value);
+            m_size++;
+        }
+
+        return overwritten;
+    }
+
+    /**
+     * @brief Take the oldest element
+     *
+     * @return false if empty
+     */
+    bool Pop(T& value)
+    {
+        bool retval = false;
+
+        if(m_size > 0)
+        {
+            value = std::move(m_elements[m_first]);
+            m_first = (m_first + 1) % m_elements.size();
+            m_size--;
+            retval = true;
+        }
+
+        return retval;
+    }
+
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+    bool Empty() const
+    {
+        return m_size == 0;
+    }
+
+private:
+    std::vector<T> m_elements;
+    size_t m_first;
+    size_t m_size;
+};
+
+#endif /* RING_BUFFER__H_ */
@@ -0,0 +1,209 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file row_schema.hpp
+ *
+ */
+
+#ifndef ROW_SCHEMA__H_
+#define ROW_SCHEMA__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include "data_definition.hpp"
+
+/*******************************************************************
+ * Type definitions
+ *******************************************************************/
+
+/*
+ * A row is a plain struct whose schema is a constexpr tuple of its columns:
+ *
+ *     struct DetectionRow
+ *     {
+ *         int32_t id;
+ *         std::string filename;
+ *
+ *         static constexpr auto columns = std::make_tuple(MakeColumn("ID",       &DetectionRow::id),
+ *                                                         MakeColumn("FILENAME", &DetectionRow::filename));
+ *     };
+ *
+ * The conversions to and from Entry / Variable are generated from it, so the column order, names
+ * and types are written once and checked by the compiler. This is about typing only: the data
+ * tables and the broker still take Entry / Variable, each conversion builds their names and
+ * values as before.
+ */
+template<typename T>
+struct DataTypeOf;
+
+template<>
+struct DataTypeOf<int32_t>
+{
+    static constexpr DataType value = DataType::Integer;
+};
+
+template<>
+struct DataTypeOf<float>
+{
+    static constexpr DataType value = DataType::Float;
+};
+
+template<>
+struct DataTypeOf<std::string>
+{
+    static constexpr DataType value = DataType::String;
+};
+
+template<>
+struct DataTypeOf<bool>
+{
+    static constexpr DataType value = DataType::Boolean;
+};
+
+template<typename Row, typename T>
+struct Column
+{
+    using ValueType = T;
+    static constexpr DataType data_type = DataTypeOf<T>::value;
+
+    const char *name;
+    T Row::*member;
+};
+
+template<typename Row, typename T>
+constexpr Column<Row, T> MakeColumn(const char *name, T Row::*member)
+{
+    return Column<Row, T>{name, member};
+}
+
+template<typename Row>
+constexpr size_t ColumnCount = std::tuple_size_v<std::decay_t<decltype(Row::columns)>>;
+
+/*******************************************************************
+ * Function definitions
+ *******************************************************************/
+namespace row_schema_detail
+{
+    template<typename Row, typename F, size_t... I>
+    void ForEachColumn(F&& function, std::index_sequence<I...>)
+    {
+        (function(std::get<I>(Row::columns), I), ...);
+    }
+}
+
+/**
+ * @brief Call function(column, index) for each column of the schema, in order
+ */
+template<typename Row, typename F>
+void ForEachColumn(F&& function)
+{
+    row_schema_detail::ForEachColumn<Row>(std::forward<F>(function), std::make_index_sequence<ColumnCount<Row>>());
+}
+
+/**
+ * @brief Entry with the columns of the row, each one holding the default value of its type
+ */
+template<typename Row>
+Entry RowDefinition()
+{
+    Entry entry;
+
+    entry.reserve(ColumnCount<Row>);
+    ForEachColumn<Row>([&entry](const auto& column, size_t index)
+    {
+        using ValueType = typename std::decay_t<decltype(column)>::ValueType;
+        entry.push_back(Variable{column.name, column.data_type, ValueType()});
+    });
+
+    return entry;
+}
+
+/**
+ * @brief Write the row values into an entry with its layout, e.g. from RowDefinition()
+ *
+ * @return 0 if ok, -1 if the entry doesn't have the row layout
+ */
+template<typename Row>
+int ToEntry(const Row& row, Entry& entry)
+{
+    int ret_val = 0;
+
+    if(entry.size() != ColumnCount<Row>)
+    {
+        ret_val = -1;
+    }
+    else
+    {
+        ForEachColumn<Row>([&row, &entry](const auto& column, size_t index)
+        {
+            entry[index].value = row.*(column.member);
+        });
+    }
+
+    return ret_val;
+}
+
+template<typename Row>
+Entry ToEntry(const Row& row)
+{
+    Entry entry = RowDefinition<Row>();
+
+    ToEntry(row, entry);
+
+    return entry;
+}
+
+/**
+ * @brief Read the row values from an entry with its layout
+ *
+ * @return 0 if ok, -1 if the entry doesn't have the row layout or a value has another type
+ */
+template<typename Row>
+int FromEntry(const Entry& entry, Row& row)
+{
+    int ret_val = 0;
+
+    if(entry.size() != ColumnCount<Row>)
+    {
+        ret_val = -1;
+    }
+    else
+    {
+        ForEachColumn<Row>([&row, &entry, &ret_val](const auto& column, size_t index)
+        {
+            using ValueType = typename std::decay_t<decltype(column)>::ValueType;
+
+            if(const ValueType *value = std::get_if<ValueType>(&entry[index].value))
+            {
+                row.*(column.member) = *value;
+            }
+            else
+            {
+                ret_val = -1;
+            }
+        });
+    }
+
+    return ret_val;
+}
+
+/**
+ * @brief Call function(variable) with each column of the row as a variable, e.g. to set them in the message broker
+ */
+template<typename Row, typename F>
+void ForEachVariable(const Row& row, F&& function)
+{
+    ForEachColumn<Row>([&row, &function](const auto& column, size_t index)
+    {
+        function(Variable{column.name, column.data_type, row.*(column.member)});
+    });
+}
+
+#endif /* ROW_SCHEMA__H_ */
@@ -0,0 +1,141 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file spsc_queue.hpp
+ *
+ */
+
+#ifndef SPSC_QUEUE__H_
+#define SPSC_QUEUE__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Bounded single producer single consumer queue, a ring of preallocated slots.
+ * TryPush() and TryPop() are wait-free, each must always be called from the same
+ * thread, or from threads taking turns with a happens-before between them, e.g.
+ * a thread stopped and joined before the next one starts. The capacity is rounded
+ * up to a power of two.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(size_t capacity) :
+        m_slots(RoundUp(capacity)),
+        m_mask(m_slots.size() - 1),
+        m_head(0),
+        m_cached_tail(0),
+        m_tail(0),
+        m_cached_head(0)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Add an element at the end of the queue, producer thread only
+     *
+     * @param[in] value : element to add, only moved from if there was room
+     *
+     * @return false if the queue was full
+     */
+    bool TryPush(T&& value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        /* The head is only read again when the queue looked full */
+        if(tail - m_cached_head == m_slots.size())
+        {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if(tail - m_cached_head == m_slots.size())
+            {
+                return false;
+            }
+        }
+
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Take the first element of the queue, consumer thread only
+     *
+     * @param[out] value : element taken
+     *
+     * @return false if the queue was empty
+     */
+    bool TryPop(T& value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if(head == m_cached_tail)
+        {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if(head == m_cached_tail)
+            {
+                return false;
+            }
+        }
+
+        /* Moved out so the slot doesn't keep what it held, e.g. a pooled frame */
+        value = std::move(m_slots[head & m_mask]);
+        m_slots[head & m_mask] = T();
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Elements in the queue, exact from the producer or the consumer, a snapshot from others
+     */
+    size_t Size() const
+    {
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+
+        return (tail >= head) ? (tail - head) : 0;
+    }
+
+    size_t Capacity() const
+    {
+        return m_slots.size();
+    }
+
+private:
+    static size_t RoundUp(size_t capacity)
+    {
+        size_t rounded = 1;
+
+        while(rounded < capacity)
+        {
+            rounded <<= 1;
+        }
+
+        return rounded;
+    }
+
+    std::vector<T> m_slots;
+    const size_t m_mask;
+
+    /* Consumer side and producer side on their own cache lines */
+    alignas(64) std::atomic<size_t> m_head;
+    size_t m_cached_tail;
+    alignas(64) std::atomic<size_t> m_tail;
+    size_t m_cached_head;
+};
+
+#endif /* SPSC_QUEUE__H_ */
@@ -12,12 +12,32 @@
  * Includes
  *******************************************************************/
 #include <memory>
+#include <atomic>
 #include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <optional>
 #include <sqlite3.h>
 
 #include "state_persistence_interface.hpp"
 #include "log.hpp"
 
+/*******************************************************************
+ * Enum definition
+ *******************************************************************/
+
+/* PRAGMA synchronous, with WAL NORMAL never corrupts but can lose the last commits on power loss */
+enum class DatabaseSynchronous
+{
+    Off,
+    Normal,
+    Full
+};
+
 /*******************************************************************
  * Class declaration
  *******************************************************************/
@@ -31,18 +51,49 @@ public:
     int InsertItem(const Entry& item);
     int GetItem(Entry& item);
     int SetItem(const Entry& item);
+    int InsertItem(const Entry& item, bool wait);
+    int SetItem(const Entry& item, bool wait);
     int DeleteItem(const Entry& item);
     int DeleteAllItems();
     int DeleteTable();
+    int QueryItems(Entry& item, const ItemRange& range, const std::function<bool(const Entry&)>& on_item);
 private:
+    enum class Statement
+    {
+        NumberItems,
+        InsertItem,
+        GetItem,
+        SetItem,
+        DeleteItem,
+        DeleteAllItems,
+        QueryItems,
+        QueryItemsBefore
+    };
+
+    struct PreparedStatement
+    {
+        sqlite3_stmt *statement = nullptr;
+        std::vector<std::string> columns; /* Names of the item it was prepared for */
+        std::string range_column;
+    };
+
     const std::string m_name;
     std::weak_ptr<Database> m_data_base;
     Entry m_list_variables;
 
+    /* Prepared on first use, the values are bound on each call */
+    std::map<Statement, PreparedStatement> m_statements;
+    std::mutex m_statements_mutex;
+
+    /* Indexed on their first range query, protected by m_statements_mutex */
+    std::set<std::string> m_indexed_columns;
+
     const static std::map<DataType, std::string> m_data_type_map;
 
     int ExecuteSqlCommand(const std::string& command);
     int ExecuteSqlRequest(const std::string& command, sqlite3_stmt **response);
+    sqlite3_stmt* GetStatement(Statement type, const Entry& item, const std::string& range_column = std::string());
+    void FinalizeStatements();
 
     int FormCreateTableMessage(std::string& command);
     int FormDeleteTableMessage(std::string& command);
@@ -52,12 +103,22 @@ private:
     int FormSetItemMessage(std::string& command, const Entry& item);
     int FormDeleteItemMessage(std::string& command, const Entry& item);
     int FormDeleteAllItemsMessage(std::string& command);
+    int FormQueryItemsMessage(std::string& command, const Entry& item, const std::string& range_column, bool before);
+    int FormCreateIndexMessage(std::string& command, const std::string& column);
+
+    int HandleNumberItemsResponse(sqlite3_stmt *response, int& number_items);
+    int HandleGetItemResponse(sqlite3_stmt *response, Entry& item);
+    int HandleQueryItemsResponse(sqlite3_stmt *response, Entry& item, const std::function<bool(const Entry&)>& on_item);
 
-    int HandleNumberItemsResponse(sqlite3_stmt **response, int& number_items);
-    int HandleGetItemResponse(sqlite3_stmt **response, Entry& item);
+    int ApplyInsertItem(const Entry& item);
+    int ApplySetItem(const Entry& item);
+    int ApplyDeleteItem(const Entry& item);
+    int ApplyDeleteAllItems();
+    int QueueWrite(std::optional<Value> row, bool overwrite, bool wait, std::function<int()> write);
+    int FlushDatabase();
 
-    std::string VariableToString(const Variable& variable);
-    int StringToVariable(const std::string& string_value, Variable& variable);
+    int BindVariable(sqlite3_stmt *statement, int index, const Variable& variable);
+    int ColumnToVariable(sqlite3_stmt *statement, int column, Variable& variable);
 };
 
 class Database : public IDatabase
@@ -66,14 +127,59 @@ class Database : public IDatabase
 public:
     Database() = delete;
 
-    Database(const std::string path) noexcept(false);
+    /**
+     * @brief Open the database in WAL mode
+     *
+     * @param[in] flush_interval_ms : the writes are queued and committed together by a background
+     *                                thread every flush_interval_ms, 0 to write them straight away.
+     *                                Queued, the table writes return 0 as soon as they are queued: a
+     *                                write that fails when committed is logged and counted by
+     *                                GetFailedWrites(), and makes that Flush() return -1. The ones
+     *                                called with wait are written straight away and return their result
+     */
+    Database(const std::string path,
+             DatabaseSynchronous synchronous = DatabaseSynchronous::Full,
+             uint32_t flush_interval_ms = 0) noexcept(false);
 
     int RemoveDatabase();
 
+    /**
+     * @brief Commit the queued writes now, in one transaction
+     */
+    int Flush();
+
+    /**
+     * @brief Number of queued writes that failed when committed, e.g. a duplicated insert
+     */
+    uint64_t GetFailedWrites();
+
     ~Database();
 private:
+    struct PendingWrite
+    {
+        const DataTable *table;
+        std::optional<Value> row;  /* Primary key, none for writes to the whole table */
+        bool overwrite;            /* A later write to the same row replaces it */
+        std::function<int()> write;
+    };
+
     const std::string m_path;
     sqlite3 *m_sqlite_database;
+    const uint32_t m_flush_interval_ms;
+
+    std::mutex m_write_mutex;
+    std::condition_variable m_write_condition;
+    std::vector<PendingWrite> m_pending_writes;  /* Protected by m_write_mutex */
+    bool m_stop;                                 /* Protected by m_write_mutex */
+    std::atomic<uint64_t> m_failed_writes;
+    std::mutex m_flush_mutex;                    /* One batch at a time, they are committed in order */
+    std::unique_ptr<std::thread> m_writer_thread;
+
+    const static std::map<DatabaseSynchronous, std::string> m_synchronous_map;
+
+    int QueueWrite(PendingWrite pending_write, bool wait);
+    int CommitPendingWrites();
+    int ExecuteSqlCommand(const std::string& command);
 };
 
 #endif /* STATE_PERSISTANCE__H_ */
@@ -13,8 +13,25 @@
  *******************************************************************/
 #include <string>
 #include <memory>
+#include <optional>
+#include <functional>
 #include "data_definition.hpp"
 
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+
+/* Items with from <= column <= to, sorted by column and primary key, highest first */
+struct ItemRange
+{
+    std::string column;
+    Value from;
+    Value to;
+    std::optional<Value> before_column; /* Next page: the column and primary key values of the last item received */
+    std::optional<Value> before_key;
+    uint32_t limit;
+};
+
 /*******************************************************************
  * Class declaration
  *******************************************************************/
@@ -28,12 +45,26 @@ public:
     virtual ~IDataTable() {};
 
     virtual int NumberItems(int& number_items) = 0;
+
+    /* The writes may be queued by the database, then 0 only means queued, see Database */
     virtual int InsertItem(const Entry& item) = 0;
     virtual int GetItem(Entry& item) = 0;
     virtual int SetItem(const Entry& item) = 0;
+
+    /* With wait, written before returning, after the ones queued before it, and the result is its own */
+    virtual int InsertItem(const Entry& item, bool wait) = 0;
+    virtual int SetItem(const Entry& item, bool wait) = 0;
     virtual int DeleteItem(const Entry& item) = 0;
     virtual int DeleteAllItems() = 0;
     virtual int DeleteTable() = 0;
+
+    /**
+     * @brief Read the items in a range, one at a time
+     *
+     * @param[in,out] item : columns to read, filled with each item before calling on_item
+     * @param[in] on_item : return false to stop
+     */
+    virtual int QueryItems(Entry& item, const ItemRange& range, const std::function<bool(const Entry&)>& on_item) = 0;
 };
 
 class IDatabase
@@ -0,0 +1,132 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file synthetic_kinect.hpp
+ *
+ */
+
+#ifndef SYNTHETIC_KINECT_H_
+#define SYNTHETIC_KINECT_H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <memory>
+#include <vector>
+#include <atomic>
+
+#include "kinect_interface.hpp"
+#include "kinect_frame_source.hpp"
+#include "cyclic_task.hpp"
+#include "kinect_frame.hpp"
+
+/*******************************************************************
+ * Struct declaration
+ *******************************************************************/
+struct SyntheticSceneConfig
+{
+    uint32_t frame_interval_ms   = 33;   /* Period between frames, 0 to render as fast as possible */
+    uint32_t seed                = 1;    /* Same seed, same sequence of frames */
+
+    /* Static room: back wall plus a floor getting closer towards the bottom of the image */
+    uint16_t room_depth          = 900;  /* Raw 11-bit depth of the back wall */
+    uint16_t floor_slope         = 1;    /* Depth decrease per row in the lower half */
+    uint16_t noise_amplitude     = 2;    /* Uniform noise in [-noise_amplitude, noise_amplitude] */
+    uint16_t dropout_per_mille   = 5;    /* Pixels reported as BLANK_DEPTH_PIXEL, per thousand */
+
+    /* Moving blobs, bouncing against the edges of the image */
+    uint32_t blob_count          = 1;
+    uint32_t blob_radius         = 40;   /* Pixels */
+    uint32_t blob_speed          = 4;    /* Pixels per frame */
+    uint16_t blob_depth          = 600;  /* Raw 11-bit depth of the blobs */
+    uint32_t blob_active_frames  = 30;   /* Blobs are in the scene this number of frames... */
+    uint32_t blob_idle_frames    = 60;   /* ...then out of it this number of frames, 0 to never leave */
+
+    /* IR video */
+    uint16_t flicker_amplitude   = 20;   /* Global IR intensity variation between frames */
+    uint32_t video_frame_divider = 1;    /* One video frame every this number of depth frames */
+};
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+class SyntheticKinect : public IKinect, public CyclicTask
+{
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] config : scene description
+     * @param[in] timeout_ms : Get*Frame() timeout
+     */
+    SyntheticKinect(SyntheticSceneConfig config, uint32_t timeout_ms);
+    virtual ~SyntheticKinect();
+
+    int Init() override;
+    int Term() override;
+    int Start() override;
+    int Stop() override;
+    bool IsRunning() override;
+    void GetDepthFrame(KinectDepthFrame& frame) override;
+    void GetVideoFrame(KinectVideoFrame& frame) override;
+    int Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) override;
+    int Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer) override;
+    int ChangeTilt(double tilt_angle) override;
+    int ChangeLedColor(freenect_led_options color) override;
+
+    /**
+     * @brief Ground truth to measure the detection accuracy against
+     *
+     * @param[in] frame_number : number of the depth frame since the last Start(), from 1, it is also
+     *                           its timestamp. Not the sequence given to the frame observers, that
+     *                           one keeps counting across restarts
+     *
+     * @return true if the blobs are in the scene in that frame
+     */
+    bool IsIntrusionFrame(uint64_t frame_number) const;
+
+    /**
+     * @brief Get the number of depth frames rendered since the last Start()
+     *
+     * @return number of depth frames
+     */
+    uint64_t GetNumberOfFrames();
+
+    /**
+     * @brief Render the next depth and video frames, without delivering them. Used by
+     *        Start()'s task and exposed to measure the rendering cost alone.
+     *
+     * @param[out] depth_data : DEPTH_WIDTH x DEPTH_HEIGHT pixels
+     * @param[out] video_data : VIDEO_WIDTH x VIDEO_HEIGHT pixels, only written when a video frame is due
+     *
+     * @return true if a video frame was rendered too
+     */
+    bool RenderFrames(std::vector<uint16_t>& depth_data, std::vector<uint16_t>& video_data);
+
+private:
+    struct Blob
+    {
+        int32_t x, y;
+        int32_t speed_x, speed_y;
+    };
+
+    SyntheticSceneConfig m_config;
+    KinectFrameSource m_frame_source;
+    bool m_is_initialized;
+
+    /* Scene state */
+    std::vector<uint16_t> m_room;
+    std::vector<uint16_t> m_depth_data;
+    std::vector<uint16_t> m_video_data;
+    std::vector<Blob> m_blobs;
+    uint32_t m_random_state;
+    std::atomic<uint64_t> m_num_frames;
+
+    /* Private funtions */
+    uint32_t NextRandom();
+    void ResetScene();
+    void MoveBlobs();
+    void ExecutionCycle() override;
+};
+
+#endif /* SYNTHETIC_KINECT_H_ */
@@ -90,7 +90,8 @@ class ThreadPool
             for(auto& thread : m_threads)
             {
                 thread = std::make_unique<std::thread>(&ThreadPool::ThreadLoop, this, thread_id);
-                LOG(LOG_DEBUG, "Thread: %d created\n", thread_id++);
+                LOG(LOG_DEBUG, "Thread: %d created\n", thread_id);
+                thread_id++;
             }
         }
 
@@ -109,7 +110,8 @@ class ThreadPool
             for(auto& thread : m_threads)
             {
                 thread->join();
-                LOG(LOG_DEBUG, "Thread: %d destroyed\n", thread_id++);
+                LOG(LOG_DEBUG, "Thread: %d destroyed\n", thread_id);
+                thread_id++;
             }
             LOG(LOG_INFO, "Threadpool destroyed\n");
         }
@@ -121,7 +123,7 @@ class ThreadPool
             if(!task->m_ended)
             {
                 m_task_queue.push(task);
-                LOG(LOG_DEBUG, "Added task: %s, Threadpool size: %u\n", task->m_name.c_str(), m_task_queue.size());
+                LOG(LOG_DEBUG, "Added task: %s, Threadpool size: %zu\n", task->m_name.c_str(), m_task_queue.size());
                 m_condition_variable.notify_one();
             }
             else
@@ -148,7 +150,7 @@ class ThreadPool
                 {
                     std::shared_ptr<Task> task = m_task_queue.front();
                     m_task_queue.pop();
-                    LOG(LOG_DEBUG, "Threadpool size: %u\n", m_task_queue.size());
+                    LOG(LOG_DEBUG, "Threadpool size: %zu\n", m_task_queue.size());
                     LOG(LOG_DEBUG, "Thread n: %d started task %s execution\n", thread_id, task->m_name.c_str());
                     lock.unlock();
                     task->ExecuteTask();
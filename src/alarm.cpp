@@ -10,6 +10,7 @@
  *******************************************************************/
 #include <filesystem>
 #include <time.h>
+#include <fcntl.h>
 
 #include "alarm.hpp"
 #include "kinect_factory.hpp"
@@ -17,71 +18,248 @@
 #include "message_broker_factory.hpp"
 #include "state_persistence_factory.hpp"
 
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+/* Inputs of the encode stage, one per producer */
+#define ENCODE_INPUT_INTRUSION 0U /* Take video frames task, then the detection thread ending the detection */
+#define ENCODE_INPUT_LIVEVIEW  1U /* Liveview task */
+
 /*******************************************************************
  * Class definition
  *******************************************************************/
-class SaveToJpegTask : public Task
+/*******************************************************************
+ * Static functions
+ *******************************************************************/
+
+/* Email of the intrusion, with the path of its snapshot or empty without it */
+static void PublishEmail(std::shared_ptr<IMessageBroker> message_broker, const std::string& snapshot)
+{
+    if(0 != message_broker->Publish(REDIS_DET_EMAIL_SEND_CHANNEL, snapshot))
+    {
+        LOG(LOG_WARNING, "Couldn't publish event\n");
+    }
+}
+
+/* Snapshot of the intrusion for the email, published once it is on disk */
+static void SaveSnapshot(std::shared_ptr<AsyncFileWriter> file_writer, std::shared_ptr<DetectionStorage> storage,
+                         std::shared_ptr<IMessageBroker> message_broker, int32_t id, std::shared_ptr<const EncodedFrame> encoded)
+{
+    std::string filepath = storage->GetDirectory(id) + "/" DETECTION_SNAPSHOT_NAME;
+    auto written = std::make_shared<bool>(false);
+    int fd;
+
+    /* The email goes without snapshot if it couldn't be written */
+    auto publish = [message_broker](const std::string& snapshot)
+    {
+        PublishEmail(message_broker, snapshot);
+    };
+
+    if(0 > (fd = open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660)))
+    {
+        LOG(LOG_ERR,"open(%s) failed: %s\n", filepath.c_str(), strerror(errno));
+        publish("");
+    }
+    else
+    {
+        file_writer->Write(fd, {{const_cast<uint8_t*>(encoded->jpeg.data()), encoded->jpeg.size()}}, 0,
+                           [encoded, written](int result) { *written = (result >= 0); });
+        file_writer->Close(fd, [storage, id, filepath, written, publish](int result)
+        {
+            if(*written && result == 0)
+            {
+                storage->AddFile(id, filepath);
+                publish(filepath);
+            }
+            else
+            {
+                LOG(LOG_ERR,"Couldn't write the snapshot %s\n", filepath.c_str());
+                publish("");
+            }
+        });
+    }
+}
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+class CreateDetectionTarbalTask : public Task
 {
     private:
-        std::shared_ptr<KinectVideoFrame> m_frame;
-        std::string m_filepath;
-        int m_brightness;
-        int m_constrast;
+        std::shared_ptr<FrameContainerWriter> m_writer;
+        std::shared_ptr<DetectionStorage> m_storage;
+        int m_detection_num;
+        time_t m_date;
+        uint32_t m_frames;
 
     public:
-        SaveToJpegTask(std::shared_ptr<KinectVideoFrame> frame, std::string filepath, int brightness, int constrast)
-         : Task("SaveToJpeg"), m_frame(frame), m_filepath(filepath), m_brightness(brightness), m_constrast(constrast)
+        CreateDetectionTarbalTask(std::shared_ptr<FrameContainerWriter> writer, std::shared_ptr<DetectionStorage> storage,
+                                  int detection_num, time_t date, uint32_t frames)
+            : Task("CreateDetectionTarbal"), m_writer(writer), m_storage(storage), m_detection_num(detection_num),
+              m_date(date), m_frames(frames)
         {
         }
 
         void operator() () override
         {
-            if(m_frame->SaveToJpegInFile(m_filepath, m_brightness, m_constrast))
+            std::string directory = m_storage->GetDirectory(m_detection_num);
+            std::string container_path = directory + "/" DETECTION_CONTAINER_NAME;
+
+            /* Without writer when recovered, its container has no index but its records are walked */
+            if(m_writer)
             {
-                LOG(LOG_ERR,"Error saving intrusion Jpeg frame to file\n");
+                m_writer->Close();
+                m_storage->AddFile(m_detection_num, container_path);
             }
+
+            try
+            {
+                FrameContainerReader container(container_path);
+                if(0 != ExportContainerToZip(container, directory + "/capture.zip"))
+                {
+                    LOG(LOG_WARNING,"Couldn't package detection n°%d\n", m_detection_num);
+                }
+                else
+                {
+                    m_storage->AddFile(m_detection_num, directory + "/capture.zip");
+                }
+            }
+            catch(const std::exception& e)
+            {
+                LOG(LOG_WARNING,"Couldn't read the frames of detection n°%d\n", m_detection_num);
+            }
+
+            m_storage->EndDetection(m_detection_num, m_date, m_frames);
         }
 };
 
-class CreateDetectionTarbalTask : public Task
+class ExportDetectionTask : public Task
 {
     private:
-        std::vector<std::shared_ptr<Task>> m_tasks;
-        std::string m_path;
-        int m_current_detection_num;
+        std::shared_ptr<DetectionStorage> m_storage;
+        std::shared_ptr<IMessageBroker> m_message_broker;
+        int m_detection_num;
+        std::string m_format;
+        uint32_t m_frame_interval_ms;
 
     public:
-        CreateDetectionTarbalTask(std::vector<std::shared_ptr<Task>> tasks, std::string path, int current_detection_num)
-            : Task("CreateDetectionTarbal"), m_tasks(tasks), m_path(path), m_current_detection_num(current_detection_num)
+        ExportDetectionTask(std::shared_ptr<DetectionStorage> storage, std::shared_ptr<IMessageBroker> message_broker, int detection_num,
+                            std::string format, uint32_t frame_interval_ms)
+            : Task("ExportDetection"), m_storage(storage), m_message_broker(message_broker), m_detection_num(detection_num),
+              m_format(format), m_frame_interval_ms(frame_interval_ms)
         {
         }
 
         void operator() () override
         {
-            for(auto& task : m_tasks)
+            std::string directory = m_storage->GetDirectory(m_detection_num);
+            std::string filepath = directory + ((m_format == "mp4") ? "/capture_vid.mp4" : "/capture.zip");
+            int ret_val = -1;
+
+            try
+            {
+                FrameContainerReader container(directory + "/" DETECTION_CONTAINER_NAME);
+                ret_val = (m_format == "mp4") ? ExportContainerToMp4(container, filepath, m_frame_interval_ms) : ExportContainerToZip(container, filepath);
+            }
+            catch(const std::exception& e)
+            {
+                LOG(LOG_ERR,"Couldn't read the frames of detection n°%d\n", m_detection_num);
+            }
+
+            if(ret_val == 0)
             {
-                task->Join();
+                m_storage->AddFile(m_detection_num, filepath);
+            }
+
+            /* Publish event */
+            if(0 != m_message_broker->Publish((ret_val == 0) ? REDIS_EVENT_SUCCESS_CHANNEL : REDIS_EVENT_ERROR_CHANNEL,
+                                              (ret_val == 0) ? "Exported intrusion" : "Couldn't export intrusion"))
+            {
+                LOG(LOG_WARNING, "Couldn't publish event\n");
             }
-            char command[PATH_MAX];
-            sprintf(command,"cd %s;zip -q %u_capture.zip %u*", m_path.c_str(), m_current_detection_num, m_current_detection_num);
-            system(command);
         }
 };
 
-Alarm::Alarm(std::shared_ptr<IMessageBroker> message_broker, std::shared_ptr<IDatabase> data_base) :
+Alarm::Alarm(std::shared_ptr<IMessageBroker> message_broker, std::shared_ptr<IDatabase> data_base, VideoFrameFactory frame_factory) :
     m_message_broker(message_broker),
-    m_data_base(data_base)
+    m_data_base(data_base),
+    m_last_liveview_timestamp(0),
+    m_snapshot_id(-1)
 {
+    if(frame_factory == nullptr)
+    {
+        frame_factory = []
+        {
+            return std::make_unique<KinectVideoFrame>(VIDEO_WIDTH, VIDEO_HEIGHT);
+        };
+    }
+
     m_detection_observer = std::make_shared<AlarmDetectionObserver>(*this);
     m_liveview_observer  = std::make_shared<AlarmLiveviewObserver>(*this);
 
     m_kinect    = KinectFactory::Create(KINECT_GETFRAMES_TIMEOUT_MS);
+    m_recorder  = std::make_unique<KinectRecorder>(m_kinect);
     m_detection = AlarmModuleFactory::CreateDetectionModule(m_kinect, m_detection_observer, m_detection_config);
     m_liveview  = AlarmModuleFactory::CreateLiveviewModule(m_kinect, m_liveview_observer, m_liveview_config);
+
+    m_persistence_worker = std::make_unique<PersistenceWorker>();
+
+    m_file_writer = std::make_shared<AsyncFileWriter>(ASYNC_FILE_WRITER_QUEUE_DEPTH);
+    m_jpeg_cache  = std::make_shared<JpegCache>(JPEG_CACHE_FRAMES);
+
+    m_frame_pool = std::make_unique<ObjectPool<KinectVideoFrame>>(FRAME_PIPELINE_FRAMES, frame_factory);
+
+    CyclicTaskConfig stage_config;
+    stage_config.cpu_affinity = DISK_STAGE_CPU_AFFINITY;
+    m_disk_stage = std::make_unique<PipelineStage<FramePipelineItem>>("Disk stage", 1, FRAME_PIPELINE_CAPACITY, stage_config,
+                                                                      [this](FramePipelineItem& item) { WriteFrame(item); });
+    stage_config.cpu_affinity = PUBLISH_STAGE_CPU_AFFINITY;
+    m_publish_stage = std::make_unique<PipelineStage<FramePipelineItem>>("Publish stage", 1, FRAME_PIPELINE_CAPACITY, stage_config,
+                                                                         [this](FramePipelineItem& item) { PublishFrame(item); });
+    stage_config.cpu_affinity = ENCODE_STAGE_CPU_AFFINITY;
+    m_encode_stage = std::make_unique<PipelineStage<FramePipelineItem>>("Encode stage", 2, FRAME_PIPELINE_CAPACITY, stage_config,
+                                                                        [this](FramePipelineItem& item) { EncodeFrame(item); });
+
+    DetectionStoragePolicy storage_policy;
+    storage_policy.max_bytes           = DETECTION_STORAGE_MAX_BYTES;
+    storage_policy.max_age_s           = DETECTION_STORAGE_MAX_AGE_S;
+    storage_policy.reclaim_interval_ms = DETECTION_STORAGE_RECLAIM_INTERVAL_MS;
+    m_detection_storage = std::make_shared<DetectionStorage>(DETECTION_PATH, storage_policy, [this](int32_t id) { DetectionEvicted(id); });
+
+    if(std::string(LIVEVIEW_SHM_NAME).size() > 0)
+    {
+        try
+        {
+            m_liveview_shm = std::make_unique<LiveviewShmWriter>(LIVEVIEW_SHM_NAME, LIVEVIEW_SHM_SLOTS, LIVEVIEW_SHM_SLOT_SIZE);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LOG_WARNING, "Liveview shared memory not available, frames only sent through Redis\n");
+        }
+    }
+
+    if(LIVEVIEW_HTTP_PORT != 0)
+    {
+        try
+        {
+            m_mjpeg_server = std::make_unique<MjpegServer>(LIVEVIEW_HTTP_ADDRESS, LIVEVIEW_HTTP_PORT, LIVEVIEW_HTTP_PATH, LIVEVIEW_HTTP_MAX_FPS);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LOG_WARNING, "Liveview HTTP server not available\n");
+        }
+    }
 }
 
 Alarm::~Alarm()
 {
+    /* Drained in order, what a stage forwards is processed by the next one */
+    m_encode_stage.reset();
+    m_disk_stage.reset();
+    m_publish_stage.reset();
+
+    /* Its evictions are posted to the worker, it may outlive the alarm in a pending package task */
+    m_detection_storage->Stop();
 }
 
 int Alarm::Init()
@@ -102,6 +280,13 @@ int Alarm::Init()
     }
     else
     {
+        /* Tables ready: the interrupted detections can be added and the evicted ones deleted */
+        if(0 != RecoverDetections())
+        {
+            LOG(LOG_WARNING, "Couldn't recover all the interrupted detections\n");
+        }
+        m_detection_storage->Start();
+
         /* Update kinect led */
         UpdateLed();
 
@@ -144,6 +329,12 @@ int Alarm::Term()
         ret_val = -1;
     }
 
+    if(m_recorder->IsRecording() && (0 != m_recorder->Stop()))
+    {
+        LOG(LOG_ERR, "Error stoping the recording\n");
+        ret_val = -1;
+    }
+
     if(m_kinect->IsRunning() && (0 != m_kinect->Stop()))
     {
         LOG(LOG_ERR, "Error stoping Kinect\n");
@@ -156,9 +347,30 @@ int Alarm::Term()
         ret_val = -1;
     }
 
+    m_detection_storage->Stop();
+
+    SyncPersistence();
+
     return ret_val;
 }
 
+void Alarm::SyncPersistence()
+{
+    m_persistence_worker->Flush();
+}
+
+FramePipelineStats Alarm::GetPipelineStats()
+{
+    /* Upstream first: a drained encode stage read before the others leaves nothing on its way to them */
+    FramePipelineStats stats;
+
+    stats.encode  = m_encode_stage->GetStats();
+    stats.disk    = m_disk_stage->GetStats();
+    stats.publish = m_publish_stage->GetStats();
+
+    return stats;
+}
+
 int Alarm::StartDetection()
 {
     int ret_val = -1;
@@ -186,22 +398,19 @@ int Alarm::StartDetection()
                 LOG(LOG_WARNING, "Couldn't write Status in the Persisten DB\n");
             }
 
-            /* Update Cache DB */
-            if(0 != m_message_broker->SetVariable({"det_status",  DataType::Integer, 1}))
-            {
-                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-            }
-
             /* Update led */
             if(0 != UpdateLed())
             {
                 LOG(LOG_WARNING, "Couldn't update Kinect's led\n");
             }
 
-            /* Publish event */
-            if(0 != m_message_broker->Publish(REDIS_EVENT_INFO_CHANNEL, "Detection started"))
+            /* Update Cache DB and publish event, in one round trip */
+            MessageBrokerBatch batch;
+            batch.SetVariable({"det_status",  DataType::Integer, 1});
+            batch.Publish(REDIS_EVENT_INFO_CHANNEL, "Detection started");
+            if(0 != m_message_broker->ExecuteBatch(batch))
             {
-                LOG(LOG_WARNING, "Couldn't publish event\n");
+                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
             }
 
             LOG(LOG_NOTICE, "Detection module started\n");
@@ -232,28 +441,25 @@ int Alarm::StopDetection()
                 LOG(LOG_WARNING, "Couldn't write Status in the Persisten DB\n");
             }
 
-            /* Update Cache DB */
-            if(0 != m_message_broker->SetVariable({"det_status",  DataType::Integer, 0}))
-            {
-                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-            }
-
             /* Update led */
             if(0 != UpdateLed())
             {
                 LOG(LOG_WARNING, "Couldn't update Kinect's led\n");
             }
 
-            /* Publish event */
-            if(0 != m_message_broker->Publish(REDIS_EVENT_INFO_CHANNEL, "Detection stopped"))
+            /* Update Cache DB and publish event, in one round trip */
+            MessageBrokerBatch batch;
+            batch.SetVariable({"det_status",  DataType::Integer, 0});
+            batch.Publish(REDIS_EVENT_INFO_CHANNEL, "Detection stopped");
+            if(0 != m_message_broker->ExecuteBatch(batch))
             {
-                LOG(LOG_WARNING, "Couldn't publish event\n");
+                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
             }
 
             LOG(LOG_NOTICE, "Detection module stopped\n");
 
             /* Stop Kinect if possible */
-            if(!m_detection->IsRunning() && !m_liveview->IsRunning())
+            if(!m_detection->IsRunning() && !m_liveview->IsRunning() && !m_recorder->IsRecording())
             {
                 if(0 != m_kinect->Stop())
                 {
@@ -295,22 +501,19 @@ int Alarm::StartLiveview()
                 LOG(LOG_WARNING, "Couldn't write Status in the Persisten DB\n");
             }
 
-            /* Update Cache DB */
-            if(0 != m_message_broker->SetVariable({"lvw_status",  DataType::Integer, 1}))
-            {
-                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-            }
-
             /* Update led */
             if(0 != UpdateLed())
             {
                 LOG(LOG_WARNING, "Couldn't update Kinect's led\n");
             }
 
-            /* Publish event */
-            if(0 != m_message_broker->Publish(REDIS_EVENT_INFO_CHANNEL,"Liveview started"))
+            /* Update Cache DB and publish event, in one round trip */
+            MessageBrokerBatch batch;
+            batch.SetVariable({"lvw_status",  DataType::Integer, 1});
+            batch.Publish(REDIS_EVENT_INFO_CHANNEL, "Liveview started");
+            if(0 != m_message_broker->ExecuteBatch(batch))
             {
-                LOG(LOG_WARNING, "Couldn't publish event\n");
+                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
             }
 
             LOG(LOG_NOTICE, "Liveview module started\n");
@@ -322,6 +525,81 @@ int Alarm::StartLiveview()
     return ret_val;
 }
 
+int Alarm::StartRecording()
+{
+    int ret_val = -1;
+    time_t now = time(nullptr);
+    struct tm local;
+    char name[32];
+
+    if(!m_kinect->IsRunning() && (0 != m_kinect->Start()))
+    {
+        LOG(LOG_ERR, "Error starting Kinect\n");
+    }
+
+    if(m_recorder->IsRecording())
+    {
+        LOG(LOG_INFO, "Already recording\n");
+    }
+    else if(0 != CreateDirectory(KINECT_RECORDING_PATH))
+    {
+        LOG(LOG_ERR, "Error creating the recording directory: %s\n", KINECT_RECORDING_PATH);
+    }
+    else if(0 == strftime(name, sizeof(name), "%Y%m%d_%H%M%S.rec", localtime_r(&now, &local)))
+    {
+        LOG(LOG_ERR, "Error naming the recording\n");
+    }
+    else if(0 != m_recorder->Start(std::string(KINECT_RECORDING_PATH "/") + name))
+    {
+        LOG(LOG_ERR, "Error starting the recording\n");
+    }
+    else
+    {
+        if(0 != m_message_broker->Publish(REDIS_EVENT_INFO_CHANNEL, std::string("Recording started ") + name))
+        {
+            LOG(LOG_WARNING, "Couldn't publish event\n");
+        }
+
+        LOG(LOG_NOTICE, "Recording started\n");
+        ret_val = 0;
+    }
+
+    return ret_val;
+}
+
+int Alarm::StopRecording()
+{
+    int ret_val = -1;
+
+    /* Also after a frame that couldn't be written stopped it, to unsubscribe */
+    if(0 != m_recorder->Stop())
+    {
+        LOG(LOG_ERR, "Error stopping the recording\n");
+    }
+    else
+    {
+        std::string message = std::string("Recording stopped, ") + std::to_string(m_recorder->GetNumberOfFrames()) + " frames, " +
+                              std::to_string(m_recorder->GetDroppedFrames()) + " dropped";
+        if(0 != m_message_broker->Publish(REDIS_EVENT_INFO_CHANNEL, message))
+        {
+            LOG(LOG_WARNING, "Couldn't publish event\n");
+        }
+
+        /* Stop Kinect if possible */
+        if(!m_detection->IsRunning() && !m_liveview->IsRunning())
+        {
+            if(0 != m_kinect->Stop())
+            {
+                LOG(LOG_WARNING, "Error stopping Kinect\n");
+            }
+        }
+
+        ret_val = 0;
+    }
+
+    return ret_val;
+}
+
 int Alarm::StopLiveview()
 {
     int ret_val = -1;
@@ -341,28 +619,25 @@ int Alarm::StopLiveview()
                 LOG(LOG_WARNING, "Couldn't write Status in the Persisten DB\n");
             }
 
-            /* Update Cache DB */
-            if(0 != m_message_broker->SetVariable({"lvw_status",  DataType::Integer, 0}))
-            {
-                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-            }
-
             /* Update led */
             if(0 != UpdateLed())
             {
                 LOG(LOG_WARNING, "Couldn't update Kinect's led\n");
             }
 
-            /* Publish event */
-            if(0 != m_message_broker->Publish(REDIS_EVENT_INFO_CHANNEL, "Liveview stopped"))
+            /* Update Cache DB and publish event, in one round trip */
+            MessageBrokerBatch batch;
+            batch.SetVariable({"lvw_status",  DataType::Integer, 0});
+            batch.Publish(REDIS_EVENT_INFO_CHANNEL, "Liveview stopped");
+            if(0 != m_message_broker->ExecuteBatch(batch))
             {
-                LOG(LOG_WARNING, "Couldn't publish event\n");
+                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
             }
 
             LOG(LOG_NOTICE, "Liveview module stopped\n");
 
             /* Stop Kinect if possible */
-            if(!m_detection->IsRunning() && !m_liveview->IsRunning())
+            if(!m_detection->IsRunning() && !m_liveview->IsRunning() && !m_recorder->IsRecording())
             {
                 if(0 != m_kinect->Stop())
                 {
@@ -421,15 +696,13 @@ int Alarm::ResetDetection()
 {
     /* Update Persistence DB */
     m_detection_table->DeleteAllItems();
-#if 0 /* TODO */
-    /* Delete all files from Detection path */
-    for(const auto& entry : std::filesystem::directory_iterator(DETECTION_PATH))
+
+    /* Delete all files of the detections */
+    if(0 != m_detection_storage->DeleteAll())
     {
-        std::filesystem::remove_all(entry.path());
+        LOG(LOG_WARNING, "Couldn't delete all the detection files\n");
     }
-#else
-    DeleteAllFilesFromDirectory(DETECTION_PATH);
-#endif
+
     /* Publish event */
     if(0 != m_message_broker->Publish(REDIS_EVENT_SUCCESS_CHANNEL, "Deleted all instrusions"))
     {
@@ -443,21 +716,11 @@ int Alarm::ResetDetection()
 
 int Alarm::DeleteDetection(int id)
 {
-#if 0 /* TODO */
-    /* Delete all files from Detection id, "{id}*" */
-    for(auto& entry: std::filesystem::directory_iterator(DETECTION_PATH))
+    /* Delete the files of the detection, only those */
+    if(0 != m_detection_storage->DeleteDetection(id))
     {
-        std::string filename = entry.path().filename().string();
-
-        if(0 == filename.find(std::to_string(id)))
-        {
-            std::filesystem::remove(entry);
-        }
+        LOG(LOG_WARNING, "Couldn't delete the files of detection n°%d\n", id);
     }
-#else
-    std::string command = "rm -rf " + std::string(DETECTION_PATH) + "/" + std::to_string(id) + "_*";
-    system(command.c_str());
-#endif
 
     /* Update Persistence DB */
     Entry delete_entry = m_detection_table_definition;
@@ -475,28 +738,300 @@ int Alarm::DeleteDetection(int id)
     return 0;
 }
 
-int Alarm::InitVarsRedis()
+int Alarm::ExportDetection(int id, const std::string& format)
 {
-    int rel_val = 0;
-    std::array<Variable, 8> variables{{
-        {"det_status",  DataType::Integer, m_alarm_config.detection_active},
-        {"lvw_status",  DataType::Integer, m_alarm_config.liveview_active},
-        {"det_numdet",  DataType::Integer, m_alarm_config.current_detection_number-1},
-        {"tilt",        DataType::Integer, m_alarm_config.tilt},
-        {"brightness",  DataType::Integer, m_alarm_config.brightness},
-        {"contrast",    DataType::Integer, m_alarm_config.contrast},
-        {"threshold",   DataType::Integer, m_detection_config.threshold},
-        {"sensitivity", DataType::Integer, m_detection_config.sensitivity}
-    }};
+    int ret_val = 0;
+
+    if(format != "zip" && format != "mp4")
+    {
+        LOG(LOG_ERR, "Unknown export format: %s\n", format.c_str());
+        ret_val = -1;
+    }
+    else
+    {
+        /* Encoding takes a while, done by the thread pool */
+        std::shared_ptr<Task> export_task = std::make_shared<ExportDetectionTask>(m_detection_storage, m_message_broker, id, format,
+                                                                                  m_detection_config.take_video_frame_interval_ms);
+        m_threadPool.QueueTask(export_task);
+        LOG(LOG_INFO,"Exporting detection n°%d to %s\n", id, format.c_str());
+    }
+
+    return ret_val;
+}
+
+void Alarm::DetectionEvicted(int32_t id)
+{
+    Entry delete_entry = m_detection_table_definition;
+    delete_entry[0].value = id; /* ID */
+
+    /* Called from the storage task, the table is written by the persistence worker as usual.
+       The clients are told like for a detection deleted by them */
+    std::shared_ptr<IDataTable> detection_table = m_detection_table;
+    std::shared_ptr<IMessageBroker> message_broker = m_message_broker;
+    m_persistence_worker->Post([detection_table, message_broker, delete_entry]
+    {
+        if(0 != detection_table->DeleteItem(delete_entry))
+        {
+            LOG(LOG_WARNING,"Error deleting evicted detection\n");
+        }
+
+        if(0 != message_broker->Publish(REDIS_EVENT_SUCCESS_CHANNEL, "Deleted intrusion"))
+        {
+            LOG(LOG_WARNING, "Couldn't publish event\n");
+        }
+    });
+}
+
+DetectionRow Alarm::GetDetectionRow(int32_t id, time_t date, uint32_t frames)
+{
+    std::string directory = m_detection_storage->GetDirectory(id);
+
+    return DetectionRow{
+        id,
+        static_cast<int32_t>(date),
+        static_cast<int32_t>(frames),
+        directory + "/capture.zip",
+        directory + "/capture_vid.mp4"
+    };
+}
+
+void Alarm::PackageDetection(int32_t id, time_t date, uint32_t frames, std::shared_ptr<FrameContainerWriter> writer)
+{
+    /* After its last frame was appended, ends its manifest */
+    std::shared_ptr<Task> package_task = std::make_shared<CreateDetectionTarbalTask>(writer, m_detection_storage, id, date, frames);
+    m_threadPool.QueueTask(package_task);
+}
+
+void Alarm::EncodeFrame(FramePipelineItem& item)
+{
+    if(item.kind == FramePipelineItem::Kind::Intrusion)
+    {
+        /* Encoded once, shared with the liveview if it shows the same frame */
+        item.encoded = m_jpeg_cache->Encode(*item.frame, item.brightness, item.contrast);
+        item.frame.reset();
+
+        if(item.encoded == nullptr)
+        {
+            LOG(LOG_ERR,"Error saving intrusion Jpeg frame to memory\n");
+        }
+        else
+        {
+            m_disk_stage->Push(0, std::move(item));
+        }
+    }
+    else if(item.kind == FramePipelineItem::Kind::Liveview)
+    {
+        /* During an intrusion its newest frame is shown if it wasn't yet, instead of encoding another one */
+        item.encoded = m_jpeg_cache->GetLatest(item.brightness, item.contrast, std::chrono::milliseconds(m_liveview_config.video_frame_interval_ms));
+        if(item.encoded == nullptr || item.encoded->timestamp == m_last_liveview_timestamp)
+        {
+            item.encoded = m_jpeg_cache->Encode(*item.frame, item.brightness, item.contrast);
+        }
+        item.frame.reset();
+
+        if(item.encoded == nullptr)
+        {
+            LOG(LOG_ERR, "Couldn't convert frame to Jpeg\n");
+        }
+        else
+        {
+            m_last_liveview_timestamp = item.encoded->timestamp;
+            m_publish_stage->Push(0, std::move(item));
+        }
+    }
+    else if(item.kind == FramePipelineItem::Kind::EndOfDetection)
+    {
+        /* Must reach the disk stage, its frames are there before it */
+        m_disk_stage->PushOrDefer(0, std::move(item));
+    }
+}
+
+void Alarm::WriteFrame(FramePipelineItem& item)
+{
+    uint64_t offset;
+
+    if(item.kind == FramePipelineItem::Kind::EndOfDetection)
+    {
+        /* No snapshot could be taken, e.g. its frame wasn't encoded, the email goes anyway */
+        if(m_snapshot_id != item.id)
+        {
+            LOG(LOG_WARNING,"Detection n°%d without snapshot\n", item.id);
+            PublishEmail(m_message_broker, "");
+        }
+        m_snapshot_id = -1;
+
+        PackageDetection(item.id, item.date, item.frame_num, item.writer);
+        return;
+    }
+
+    /* Handed over to the file writer, this thread doesn't wait for the disk */
+    if(item.writer == nullptr)
+    {
+        LOG(LOG_ERR,"Intrusion Jpeg frame without container\n");
+    }
+    else if(0 != item.writer->Append(item.frame_num, item.encoded->timestamp,
+                                     std::shared_ptr<const std::vector<uint8_t>>(item.encoded, &item.encoded->jpeg), offset))
+    {
+        LOG(LOG_ERR,"Error appending intrusion Jpeg frame to its container\n");
+    }
+    else
+    {
+        m_detection_storage->AddFrame(item.id, item.frame_num, item.encoded->timestamp, item.writer->GetPath(), offset, item.encoded->jpeg.size());
+    }
+
+    /* The first frame of the detection reaching this stage is the snapshot of the email, earlier ones may have been dropped */
+    if(m_snapshot_id != item.id)
+    {
+        m_snapshot_id = item.id;
+        SaveSnapshot(m_file_writer, m_detection_storage, m_message_broker, item.id, item.encoded);
+    }
+}
+
+void Alarm::PublishFrame(FramePipelineItem& item)
+{
+    const std::vector<uint8_t>& liveview_jpeg = item.encoded->jpeg;
+
+    /* Same JPEG for every viewer, the server doesn't encode */
+    if(m_mjpeg_server != nullptr)
+    {
+        m_mjpeg_server->PushFrame(liveview_jpeg);
+    }
+
+    /* Local readers take it from shared memory, Redis only carries "<frame number> <size>" */
+    if(m_liveview_shm != nullptr)
+    {
+        uint32_t shm_frame = m_liveview_shm->Write(liveview_jpeg.data(), liveview_jpeg.size());
 
-    for(const auto& variable : variables)
+        if(shm_frame != 0 &&
+           0 != m_message_broker->Publish(REDIS_LIVEFRAMES_SHM_CHANNEL, std::to_string(shm_frame) + " " + std::to_string(liveview_jpeg.size())))
+        {
+            LOG(LOG_WARNING, "Couldn't publish event\n");
+        }
+    }
+
+    if(m_liveview_shm == nullptr || LIVEVIEW_REDIS_FRAMES)
+    {
+        /* Convert to base64 */
+        std::string base64_jpeg_frame = m_base64_encoder.Encode(std::string(liveview_jpeg.begin(), liveview_jpeg.end()));
+
+        /* Publish event */
+        if(0 != m_message_broker->Publish(REDIS_LIVEFRAMES_CHANNEL, base64_jpeg_frame))
+        {
+            LOG(LOG_WARNING, "Couldn't publish event\n");
+        }
+    }
+}
+
+int Alarm::RecoverDetections()
+{
+    int ret_val = 0;
+
+    /* Interrupted in the middle of the intrusion: completed from what its manifest recorded */
+    for(const auto& detection : m_detection_storage->GetInterrupted())
     {
-        if(0 != m_message_broker->SetVariable(variable))
+        LOG(LOG_NOTICE,"Recovering detection n°%d, %u frames\n", detection.id, detection.frames);
+
+        /* Already there if it was interrupted while packaging, waited for to know it */
+        Entry detection_entry = ToEntry(GetDetectionRow(detection.id, detection.date, detection.frames));
+        if(0 != m_detection_table->InsertItem(detection_entry, true))
         {
-            rel_val = -1;
-            break;
+            LOG(LOG_INFO,"Detection n°%d already in the detection table\n", detection.id);
+        }
+
+        PackageDetection(detection.id, detection.date, detection.frames, nullptr);
+
+        if(detection.id >= m_alarm_config.current_detection_number)
+        {
+            m_alarm_config.current_detection_number = detection.id + 1;
+            if(0 != WriteStatus())
+            {
+                LOG(LOG_WARNING,"Couldn't write Status in the Persisten DB\n");
+                ret_val = -1;
+            }
         }
     }
+
+    return ret_val;
+}
+
+int Alarm::ListDetections(int32_t from_date, int32_t to_date, uint32_t count, int32_t before_date, int32_t before_id)
+{
+    int ret_val = 0;
+    Entry detection_entry = m_detection_table_definition;
+    DetectionRow detection_row;
+    ItemRange range{"DATE", from_date, to_date, std::nullopt, std::nullopt, std::min(count, DETECTION_LIST_MAX_ITEMS)};
+    std::string rows;
+    uint32_t listed = 0;
+    int32_t last_date = -1;
+    int32_t last_id = -1;
+
+    if(before_date >= 0 && before_id >= 0)
+    {
+        range.before_column = before_date;
+        range.before_key = before_id;
+    }
+
+    /* Each row straight into the message */
+    if(0 != m_detection_table->QueryItems(detection_entry, range, [&](const Entry& entry)
+    {
+        if(0 == FromEntry(entry, detection_row))
+        {
+            last_id = detection_row.id;
+            last_date = detection_row.date;
+            rows += "\n" + std::to_string(last_id) + " " + std::to_string(last_date) + " " + std::to_string(detection_row.duration);
+            listed++;
+        }
+        return true;
+    }))
+    {
+        LOG(LOG_WARNING, "Couldn't list the detections\n");
+        ret_val = -1;
+    }
+    else
+    {
+        /* "detlist {count} {next_date} {next_id}" and a line per detection "{id} {date} {duration}", next -1 -1 if it was the last page */
+        if(listed < range.limit)
+        {
+            last_date = -1;
+            last_id = -1;
+        }
+        std::string message = "detlist " + std::to_string(listed) + " " + std::to_string(last_date) + " " + std::to_string(last_id) + rows;
+
+        if(0 != m_message_broker->Publish(REDIS_DET_LIST_CHANNEL, message))
+        {
+            LOG(LOG_WARNING, "Couldn't publish event\n");
+            ret_val = -1;
+        }
+    }
+
+    return ret_val;
+}
+
+int Alarm::InitVarsRedis()
+{
+    int rel_val = 0;
+    CacheStatusRow cache_status{
+        m_alarm_config.detection_active,
+        m_alarm_config.liveview_active,
+        m_alarm_config.current_detection_number - 1,
+        m_alarm_config.tilt,
+        m_alarm_config.brightness,
+        m_alarm_config.contrast,
+        m_detection_config.threshold,
+        m_detection_config.sensitivity
+    };
+
+    MessageBrokerBatch batch;
+
+    ForEachVariable(cache_status, [&batch](const Variable& variable)
+    {
+        batch.SetVariable(variable);
+    });
+
+    if(0 != m_message_broker->ExecuteBatch(batch))
+    {
+        rel_val = -1;
+    }
     return rel_val;
 }
 
@@ -538,31 +1073,61 @@ int Alarm::InitStatePersistenceVars()
     return ret_val;
 }
 
+StatusRow Alarm::GetStatusRow()
+{
+    return StatusRow{
+        0,
+        m_alarm_config.tilt,
+        m_alarm_config.brightness,
+        m_alarm_config.contrast,
+        m_alarm_config.detection_active,
+        m_alarm_config.liveview_active,
+        m_alarm_config.current_detection_number,
+        m_detection_config.threshold,
+        m_detection_config.sensitivity,
+        static_cast<int32_t>(m_detection_config.cooldown_ms),
+        static_cast<int32_t>(m_detection_config.refresh_reference_interval_ms),
+        static_cast<int32_t>(m_detection_config.take_depth_frame_interval_ms),
+        static_cast<int32_t>(m_detection_config.take_video_frame_interval_ms),
+        static_cast<int32_t>(m_liveview_config.video_frame_interval_ms)
+    };
+}
+
+void Alarm::SetStatusRow(const StatusRow& status_row)
+{
+    m_alarm_config.tilt                              = status_row.tilt;
+    m_alarm_config.brightness                        = status_row.brightness;
+    m_alarm_config.contrast                          = status_row.contrast;
+    m_alarm_config.detection_active                  = status_row.detection_active;
+    m_alarm_config.liveview_active                   = status_row.liveview_active;
+    m_alarm_config.current_detection_number          = status_row.current_detection_number;
+    m_detection_config.threshold                     = status_row.threshold;
+    m_detection_config.sensitivity                   = status_row.sensitivity;
+    m_detection_config.cooldown_ms                   = status_row.cooldown_ms;
+    m_detection_config.refresh_reference_interval_ms = status_row.refresh_reference_interval_ms;
+    m_detection_config.take_depth_frame_interval_ms  = status_row.take_depth_frame_interval_ms;
+    m_detection_config.take_video_frame_interval_ms  = status_row.take_video_frame_interval_ms;
+    m_liveview_config.video_frame_interval_ms        = status_row.video_frame_interval_ms;
+}
+
 int Alarm::ReadStatus()
 {
     int ret_val = -1;
     Entry status = m_status_table_definition;
-    status[0].value = 0; /*index*/
+    StatusRow status_row;
 
+    /* Single row, ID 0 */
     if(0 != m_status_table->GetItem(status))
     {
         LOG(LOG_WARNING,"Error reading status table\n");
     }
+    else if(0 != FromEntry(status, status_row))
+    {
+        LOG(LOG_WARNING,"Status table with unexpected types\n");
+    }
     else
     {
-        m_alarm_config.tilt                              = std::get<int>(status[1].value);
-        m_alarm_config.brightness                        = std::get<int>(status[2].value);
-        m_alarm_config.contrast                          = std::get<int>(status[3].value);
-        m_alarm_config.detection_active                  = std::get<int>(status[4].value);
-        m_alarm_config.liveview_active                   = std::get<int>(status[5].value);
-        m_alarm_config.current_detection_number          = std::get<int>(status[6].value);
-        m_detection_config.threshold                     = std::get<int>(status[7].value);
-        m_detection_config.sensitivity                   = std::get<int>(status[8].value);
-        m_detection_config.cooldown_ms                   = std::get<int>(status[9].value);
-        m_detection_config.refresh_reference_interval_ms = std::get<int>(status[10].value);
-        m_detection_config.take_depth_frame_interval_ms  = std::get<int>(status[11].value);
-        m_detection_config.take_video_frame_interval_ms  = std::get<int>(status[12].value);
-        m_liveview_config.video_frame_interval_ms        = std::get<int>(status[13].value);
+        SetStatusRow(status_row);
 
         LOG(LOG_INFO,"Status table read\n");
         ret_val = 0;
@@ -571,34 +1136,46 @@ int Alarm::ReadStatus()
     return ret_val;
 }
 
-int Alarm::WriteStatus()
+int Alarm::WriteStatus(bool wait)
 {
-    int ret_val = -1;
-    Entry status = m_status_table_definition;
-    status[0].value = 0; /*index*/
-
-    status[1].value = static_cast<int32_t>(m_alarm_config.tilt); /*TILT*/
-    status[2].value = static_cast<int32_t>(m_alarm_config.brightness); /*BRIGHTNESS*/
-    status[3].value = static_cast<int32_t>(m_alarm_config.contrast); /*CONTRAST*/
-    status[4].value = static_cast<int32_t>(m_alarm_config.detection_active); /*DET_ACTIVE*/
-    status[5].value = static_cast<int32_t>(m_alarm_config.liveview_active); /*LVW_ACTIVE*/
-    status[6].value = static_cast<int32_t>(m_alarm_config.current_detection_number); /*CURRENT_DET_NUM*/
-    status[7].value = static_cast<int32_t>(m_detection_config.threshold); /*DET_THRESHOLD*/
-    status[8].value = static_cast<int32_t>(m_detection_config.sensitivity); /*DET_SENSITIVITY*/
-    status[9].value = static_cast<int32_t>(m_detection_config.cooldown_ms); /*DET_COOLDOWN_MS*/
-    status[10].value = static_cast<int32_t>(m_detection_config.refresh_reference_interval_ms); /*DET_REFRESH_REFERENCE_INTERVAL_MS*/
-    status[11].value = static_cast<int32_t>(m_detection_config.take_depth_frame_interval_ms); /*DET_TAKE_DEPTH_FRAME_INTERVAL_MS*/
-    status[12].value = static_cast<int32_t>(m_detection_config.take_video_frame_interval_ms); /*DET_TAKE_VIDEO_FRAME_INTERVAL_MS*/
-    status[13].value = static_cast<int32_t>(m_liveview_config.video_frame_interval_ms); /*LVW_VIDEO_FRAME_INTERVAL_MS*/
-
-    if(0 != m_status_table->SetItem(status))
-    {
-        LOG(LOG_WARNING,"Error writing status table\n");
+    int ret_val = 0;
+    Entry status;
+
+    /* Also from the detection thread */
+    {
+        std::lock_guard<std::mutex> lock(m_status_entry_mutex);
+        ToEntry(GetStatusRow(), m_status_entry);
+        status = m_status_entry;
+    }
+
+    if(wait)
+    {
+        /* After the snapshots the observers posted, then written by the database straight away */
+        SyncPersistence();
+        if(0 != (ret_val = m_status_table->SetItem(status, true)))
+        {
+            LOG(LOG_WARNING,"Error writing status table\n");
+        }
+        else
+        {
+            LOG(LOG_INFO,"Status written\n");
+        }
     }
     else
     {
-        LOG(LOG_INFO,"Status written\n");
-        ret_val = 0;
+        /* Same queue as the observers' updates, a snapshot taken later is always written later */
+        std::shared_ptr<IDataTable> status_table = m_status_table;
+        m_persistence_worker->Post([status_table, status = std::move(status)]
+        {
+            if(0 != status_table->SetItem(status))
+            {
+                LOG(LOG_WARNING,"Error writing status table\n");
+            }
+            else
+            {
+                LOG(LOG_INFO,"Status written\n");
+            }
+        }, "status");
     }
 
     return ret_val;
@@ -607,24 +1184,9 @@ int Alarm::WriteStatus()
 int Alarm::CreateStatus()
 {
     int ret_val = -1;
-    Entry status = m_status_table_definition;
-    status[0].value = 0; /*index*/
-
-    status[1].value = static_cast<int32_t>(m_alarm_config.tilt); /*TILT*/
-    status[2].value = static_cast<int32_t>(m_alarm_config.brightness); /*BRIGHTNESS*/
-    status[3].value = static_cast<int32_t>(m_alarm_config.contrast); /*CONTRAST*/
-    status[4].value = static_cast<int32_t>(m_alarm_config.detection_active); /*DET_ACTIVE*/
-    status[5].value = static_cast<int32_t>(m_alarm_config.liveview_active); /*LVW_ACTIVE*/
-    status[6].value = static_cast<int32_t>(m_alarm_config.current_detection_number); /*CURRENT_DET_NUM*/
-    status[7].value = static_cast<int32_t>(m_detection_config.threshold); /*DET_THRESHOLD*/
-    status[8].value = static_cast<int32_t>(m_detection_config.sensitivity); /*DET_SENSITIVITY*/
-    status[9].value = static_cast<int32_t>(m_detection_config.cooldown_ms); /*DET_COOLDOWN_MS*/
-    status[10].value = static_cast<int32_t>(m_detection_config.refresh_reference_interval_ms); /*DET_REFRESH_REFERENCE_INTERVAL_MS*/
-    status[11].value = static_cast<int32_t>(m_detection_config.take_depth_frame_interval_ms); /*DET_TAKE_DEPTH_FRAME_INTERVAL_MS*/
-    status[12].value = static_cast<int32_t>(m_detection_config.take_video_frame_interval_ms); /*DET_TAKE_VIDEO_FRAME_INTERVAL_MS*/
-    status[13].value = static_cast<int32_t>(m_liveview_config.video_frame_interval_ms); /*LVW_VIDEO_FRAME_INTERVAL_MS*/
-
-    if(0 != m_status_table->InsertItem(status))
+    Entry status = ToEntry(GetStatusRow());
+
+    if(0 != m_status_table->InsertItem(status, true))
     {
         LOG(LOG_WARNING,"InsertItem returned error\n");
     }
@@ -715,22 +1277,19 @@ int Alarm::ChangeThreshold(int32_t value)
     m_detection_config.threshold = static_cast<uint16_t>(value);
     m_detection->UpdateConfig(m_detection_config);
 
-    /* Update Cache DB */
-    if(0 != m_message_broker->SetVariable({"threshold",  DataType::Integer, static_cast<int32_t>(value)}))
-    {
-        LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-    }
-
     /* Update Persistence DB */
     if(0 != WriteStatus())
     {
         LOG(LOG_WARNING, "Couldn't write Status in the Persisten DB\n");
     }
 
-    /* Publish event */
-    if(0 != m_message_broker->Publish(REDIS_EVENT_SUCCESS_CHANNEL, std::string("Threshold changed to ") + std::to_string(value)))
+    /* Update Cache DB and publish event, in one round trip */
+    MessageBrokerBatch batch;
+    batch.SetVariable({"threshold",  DataType::Integer, static_cast<int32_t>(value)});
+    batch.Publish(REDIS_EVENT_SUCCESS_CHANNEL, std::string("Threshold changed to ") + std::to_string(value));
+    if(0 != m_message_broker->ExecuteBatch(batch))
     {
-        LOG(LOG_WARNING, "Couldn't publish event\n");
+        LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
     }
 
     LOG(LOG_INFO,"Changed Kinect's threshold to: %d\n",value);
@@ -743,22 +1302,19 @@ int Alarm::ChangeSensitivity(int32_t value)
     m_detection_config.sensitivity = static_cast<uint16_t>(value);
     m_detection->UpdateConfig(m_detection_config);
 
-    /* Update Cache DB */
-    if(0 != m_message_broker->SetVariable({"sensitivity",  DataType::Integer, static_cast<int32_t>(value)}))
-    {
-        LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-    }
-
     /* Update Persistence DB */
     if(0 != WriteStatus())
     {
         LOG(LOG_WARNING, "Couldn't write Status in the Persisten DB\n");
     }
 
-    /* Publish event */
-    if(0 != m_message_broker->Publish(REDIS_EVENT_SUCCESS_CHANNEL, std::string("Sensitivity changed to ") + std::to_string(value)))
+    /* Update Cache DB and publish event, in one round trip */
+    MessageBrokerBatch batch;
+    batch.SetVariable({"sensitivity",  DataType::Integer, static_cast<int32_t>(value)});
+    batch.Publish(REDIS_EVENT_SUCCESS_CHANNEL, std::string("Sensitivity changed to ") + std::to_string(value));
+    if(0 != m_message_broker->ExecuteBatch(batch))
     {
-        LOG(LOG_WARNING, "Couldn't publish event\n");
+        LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
     }
 
     LOG(LOG_INFO,"Changed Kinect's sensitivity to: %d\n",value);
@@ -778,34 +1334,29 @@ AlarmLiveviewObserver::AlarmLiveviewObserver(Alarm& alarm) :
 
 void AlarmLiveviewObserver::NewFrame(KinectVideoFrame& frame)
 {
-    static std::vector<uint8_t> liveview_jpeg;
+    std::shared_ptr<KinectVideoFrame> pooled_frame = m_alarm.m_frame_pool->Acquire();
 
-    /* Convert to jpeg */
-    if(0 != frame.SaveToJpegInMemory(liveview_jpeg, m_alarm.m_alarm_config.brightness, m_alarm.m_alarm_config.contrast))
+    /* Copied so the liveview can take the next one, encoded and published by the stages */
+    if(pooled_frame == nullptr)
     {
-        LOG(LOG_ERR, "Couldn't convert frame to Jpeg\n");
+        m_alarm.m_encode_stage->Dropped(ENCODE_INPUT_LIVEVIEW);
     }
     else
     {
-        /* Convert to base64 */
-        std::string base64_jpeg_frame = m_alarm.m_base64_encoder.Encode(std::string(liveview_jpeg.begin(), liveview_jpeg.end()));
-
-        /* Publish event */
-        if(0 != m_alarm.m_message_broker->Publish(REDIS_LIVEFRAMES_CHANNEL, base64_jpeg_frame))
-        {
-            LOG(LOG_WARNING, "Couldn't publish event\n");
-        }
+        FramePipelineItem item;
+
+        *pooled_frame   = frame;
+        item.kind       = FramePipelineItem::Kind::Liveview;
+        item.frame      = std::move(pooled_frame);
+        item.brightness = m_alarm.m_alarm_config.brightness;
+        item.contrast   = m_alarm.m_alarm_config.contrast;
+        m_alarm.m_encode_stage->Push(ENCODE_INPUT_LIVEVIEW, std::move(item));
     }
 }
 
 void AlarmDetectionObserver::IntrusionStarted()
 {
-    /* Publish events */
-    if(0 != m_alarm.m_message_broker->Publish(REDIS_DET_EMAIL_SEND_CHANNEL, ""))
-    {
-        LOG(LOG_WARNING, "Couldn't publish event\n");
-    }
-
+    /* Publish events, the email one with the first frame */
     if(0 != m_alarm.m_message_broker->Publish(REDIS_EVENT_ERROR_CHANNEL, "New Intrusion"))
     {
         LOG(LOG_WARNING, "Couldn't publish event\n");
@@ -817,7 +1368,26 @@ void AlarmDetectionObserver::IntrusionStarted()
         LOG(LOG_ERR, "Error couldn't change Kinect's Led color\n");
     }
 
-    m_alarm.m_jpeg_tasks.clear();
+    /* Directory and manifest of the detection, its frames are appended to a single container */
+    time_t intrusion_date = time(NULL);
+    int32_t id = m_alarm.m_alarm_config.current_detection_number;
+    m_alarm.m_frame_writer.reset();
+    if(0 != m_alarm.m_detection_storage->BeginDetection(id, intrusion_date))
+    {
+        LOG(LOG_ERR, "Error couldn't create the detection directory\n");
+    }
+    else
+    {
+        try
+        {
+            m_alarm.m_frame_writer = std::make_shared<FrameContainerWriter>(m_alarm.m_detection_storage->GetDirectory(id) + "/" DETECTION_CONTAINER_NAME,
+                                                                            intrusion_date, DETECTION_CONTAINER_SYNC_FRAMES, m_alarm.m_file_writer);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LOG_ERR, "Error couldn't create the frame container of the detection\n");
+        }
+    }
 }
 
 void AlarmDetectionObserver::IntrusionStopped(uint32_t frame_num)
@@ -827,51 +1397,77 @@ void AlarmDetectionObserver::IntrusionStopped(uint32_t frame_num)
     /* Update kinect led */
     m_alarm.UpdateLed();
 
-    /* Publish event */
-    std::string message = std::string("newdet ") + std::to_string(m_alarm.m_alarm_config.current_detection_number) + " " +
-                          std::to_string(intrusion_date) + " " + std::to_string(frame_num);
-
-    if(0 != m_alarm.m_message_broker->Publish(REDIS_DET_INTRUSION_CHANNEL, message))
-    {
-        LOG(LOG_WARNING, "Couldn't publish event\n");
-    }
 
     /* Update SQLite db */
-    Entry detection_entry = m_alarm.m_detection_table_definition;
-    detection_entry[0].value = static_cast<int>(m_alarm.m_alarm_config.current_detection_number); /*ID*/
-    detection_entry[1].value = static_cast<int>(intrusion_date); /*DATE*/
-    detection_entry[2].value = static_cast<int>(frame_num); /*DURATION*/
-    detection_entry[3].value = std::string(DETECTION_PATH) + "/" + std::to_string(m_alarm.m_alarm_config.current_detection_number) + "_capture.zip"; /*FILENAME_IMG*/
-    detection_entry[4].value = std::string(DETECTION_PATH) + "/" + std::to_string(m_alarm.m_alarm_config.current_detection_number) + "_capture_vid.mp4"; /*FILENAME_VID*/
+    ToEntry(m_alarm.GetDetectionRow(m_alarm.m_alarm_config.current_detection_number, intrusion_date, frame_num), m_alarm.m_detection_entry);
 
-    if(0 != m_alarm.m_detection_table->InsertItem(detection_entry))
-    {
-        LOG(LOG_WARNING,"Error creating status table\n");
-    }
+    /* Update Redis db and publish event, atomically so who gets the event already reads the new count */
+    std::string message = std::string("newdet ") + std::to_string(m_alarm.m_alarm_config.current_detection_number) + " " +
+                          std::to_string(intrusion_date) + " " + std::to_string(frame_num);
+
+    MessageBrokerBatch batch;
+    batch.SetVariable({"det_numdet",  DataType::Integer, static_cast<int32_t>(m_alarm.m_alarm_config.current_detection_number)});
+    batch.Publish(REDIS_DET_INTRUSION_CHANNEL, message);
 
-    /* Update Redis db */
-    if(0 != m_alarm.m_message_broker->SetVariable({"det_numdet",  DataType::Integer, static_cast<int32_t>(m_alarm.m_alarm_config.current_detection_number)}))
+    /* Written by the persistence worker, the detection goes on straight away */
+    std::shared_ptr<IDataTable> detection_table = m_alarm.m_detection_table;
+    std::shared_ptr<IMessageBroker> message_broker = m_alarm.m_message_broker;
+    m_alarm.m_persistence_worker->Post([detection_table, detection_entry = m_alarm.m_detection_entry, message_broker, batch]
     {
-        LOG(LOG_WARNING, "Couldn't write Status in the Cache DB\n");
-    }
+        if(0 != detection_table->InsertItem(detection_entry))
+        {
+            LOG(LOG_WARNING,"Error creating status table\n");
+        }
 
-    /* Package detections */
-    std::shared_ptr<Task> package_task = std::make_shared<CreateDetectionTarbalTask>(m_alarm.m_jpeg_tasks, DETECTION_PATH, m_alarm.m_alarm_config.current_detection_number);
-    m_alarm.m_threadPool.QueueTask(package_task);
+        /* Not waited for, the worker never depends on the event loop and the writes behind it go on */
+        if(0 != message_broker->PostBatch(batch, true, [](int result)
+        {
+            if(result != 0)
+            {
+                LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
+            }
+        }))
+        {
+            LOG(LOG_WARNING, "Couldn't write Status in the Cache DB or publish event\n");
+        }
+    });
+
+    /* Package detections, behind its last frame without waiting for room, the take video frames task is already stopped */
+    FramePipelineItem end_item;
+    end_item.kind      = FramePipelineItem::Kind::EndOfDetection;
+    end_item.writer    = std::move(m_alarm.m_frame_writer);
+    end_item.id        = m_alarm.m_alarm_config.current_detection_number;
+    end_item.frame_num = frame_num;
+    end_item.date      = intrusion_date;
+    m_alarm.m_encode_stage->PushOrDefer(ENCODE_INPUT_INTRUSION, std::move(end_item));
+    m_alarm.m_frame_writer.reset();
 
     /* Change Status */
     m_alarm.m_alarm_config.current_detection_number += 1;
-    m_alarm.WriteStatus();
+    m_alarm.WriteStatus(false);
 }
 
 void AlarmDetectionObserver::IntrusionFrame(std::shared_ptr<KinectVideoFrame> frame, uint32_t frame_num)
 {
-    /* Save the frame to JPEG */
-    std::string filepath = std::string(DETECTION_PATH) + "/" + std::to_string(m_alarm.m_alarm_config.current_detection_number) + 
-                           "_capture_" + std::to_string(frame_num) + ".jpeg";
+    std::shared_ptr<KinectVideoFrame> pooled_frame = m_alarm.m_frame_pool->Acquire();
 
-    std::shared_ptr<Task> jpeg_task = std::make_shared<SaveToJpegTask>(frame, filepath, m_alarm.m_alarm_config.brightness, m_alarm.m_alarm_config.contrast);
-    m_alarm.m_threadPool.QueueTask(jpeg_task);
-    m_alarm.m_jpeg_tasks.push_back(jpeg_task);
+    /* Copied so the capture can take the next one, encoded and appended to the container by the stages */
+    if(pooled_frame == nullptr)
+    {
+        m_alarm.m_encode_stage->Dropped(ENCODE_INPUT_INTRUSION);
+    }
+    else
+    {
+        FramePipelineItem item;
+
+        *pooled_frame   = *frame;
+        item.kind       = FramePipelineItem::Kind::Intrusion;
+        item.frame      = std::move(pooled_frame);
+        item.writer     = m_alarm.m_frame_writer;
+        item.id         = m_alarm.m_alarm_config.current_detection_number;
+        item.frame_num  = frame_num;
+        item.brightness = m_alarm.m_alarm_config.brightness;
+        item.contrast   = m_alarm.m_alarm_config.contrast;
+        m_alarm.m_encode_stage->Push(ENCODE_INPUT_INTRUSION, std::move(item));
+    }
 }
-
@@ -0,0 +1,474 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file async_file_writer.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cstring>
+#include <cerrno>
+#include <exception>
+#include <future>
+#include <algorithm>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "async_file_writer.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define WAKE_USER_DATA 0U /* Requests are identified by their address */
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+AsyncFileWriter::AsyncFileWriter(uint32_t queue_depth, bool use_io_uring) :
+    m_stop(false),
+    m_sleeping(false),
+    m_wake_fd(-1),
+    m_queue_depth(std::max(queue_depth, 1U)),
+    m_ring_fd(-1),
+    m_sq_ring(MAP_FAILED),
+    m_sq_ring_size(0),
+    m_cq_ring(MAP_FAILED),
+    m_cq_ring_size(0),
+    m_sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+    m_sqes_size(0),
+    m_sq_head(nullptr), m_sq_tail(nullptr), m_sq_mask(nullptr), m_sq_array(nullptr),
+    m_cq_head(nullptr), m_cq_tail(nullptr), m_cq_mask(nullptr),
+    m_cqes(nullptr),
+    m_sq_entries(0)
+{
+    if(0 > (m_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)))
+    {
+        LOG(LOG_ERR,"eventfd() failed: %s\n", strerror(errno));
+        throw std::exception();
+    }
+
+    if(use_io_uring && 0 != SetupRing())
+    {
+        LOG(LOG_NOTICE,"io_uring not available, files written from a thread\n");
+    }
+
+    try
+    {
+        m_thread = std::make_unique<std::thread>(IsUring() ? &AsyncFileWriter::RunRing : &AsyncFileWriter::RunThread, this);
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LOG_ERR,"AsyncFileWriter thread creation failed\n");
+        ReleaseRing();
+        close(m_wake_fd);
+        throw std::exception();
+    }
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    m_stop.store(true);
+    Wake();
+    m_thread->join();
+
+    ReleaseRing();
+    close(m_wake_fd);
+}
+
+void AsyncFileWriter::Write(int fd, std::vector<iovec> iov, uint64_t offset, Completion on_complete)
+{
+    size_t size = 0;
+
+    for(const auto& buffer : iov)
+    {
+        size += buffer.iov_len;
+    }
+
+    Submit(std::unique_ptr<Request>(new Request{Operation::Write, fd, std::move(iov), offset, size, 0, std::move(on_complete)}));
+}
+
+void AsyncFileWriter::Sync(int fd, Completion on_complete)
+{
+    Submit(std::unique_ptr<Request>(new Request{Operation::Sync, fd, {}, 0, 0, 0, std::move(on_complete)}));
+}
+
+void AsyncFileWriter::Close(int fd, Completion on_complete)
+{
+    Submit(std::unique_ptr<Request>(new Request{Operation::Close, fd, {}, 0, 0, 0, std::move(on_complete)}));
+}
+
+void AsyncFileWriter::Flush()
+{
+    std::promise<void> completed;
+    std::future<void> future = completed.get_future();
+
+    Submit(std::unique_ptr<Request>(new Request{Operation::Barrier, -1, {}, 0, 0, 0, [&completed](int) { completed.set_value(); }}));
+    future.wait();
+}
+
+bool AsyncFileWriter::IsUring()
+{
+    return m_ring_fd >= 0;
+}
+
+void AsyncFileWriter::Submit(std::unique_ptr<Request> request)
+{
+    m_queue.Push(std::move(request));
+    Wake();
+}
+
+void AsyncFileWriter::Wake()
+{
+    uint64_t value = 1;
+
+    /* Pairs with the one before sleeping: either the thread sees the request or this sees it sleeping */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(m_sleeping.exchange(false) && sizeof(value) != write(m_wake_fd, &value, sizeof(value)))
+    {
+        LOG(LOG_ERR,"Couldn't wake the AsyncFileWriter thread up: %s\n", strerror(errno));
+    }
+}
+
+void AsyncFileWriter::Take(std::deque<Request*>& backlog)
+{
+    std::unique_ptr<Request> request;
+
+    while(m_queue.Pop(request))
+    {
+        backlog.push_back(request.release());
+    }
+}
+
+int AsyncFileWriter::SetupRing()
+{
+    io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+
+    /* One more entry for the wake up poll */
+    if(0 > (m_ring_fd = syscall(__NR_io_uring_setup, m_queue_depth + 1, &params)))
+    {
+        return -1;
+    }
+
+    m_sq_entries = params.sq_entries;
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+    }
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    if(m_sq_ring != MAP_FAILED)
+    {
+        m_cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? m_sq_ring :
+                    mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+    }
+    m_sqes = static_cast<io_uring_sqe*>(mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES));
+
+    if(m_sq_ring == MAP_FAILED || m_cq_ring == MAP_FAILED || m_sqes == MAP_FAILED)
+    {
+        LOG(LOG_ERR,"io_uring mmap() failed: %s\n", strerror(errno));
+        ReleaseRing();
+        return -1;
+    }
+
+    uint8_t *sq_ring = static_cast<uint8_t*>(m_sq_ring);
+    uint8_t *cq_ring = static_cast<uint8_t*>(m_cq_ring);
+    m_sq_head  = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.head);
+    m_sq_tail  = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+    m_sq_mask  = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+    m_cq_head  = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+    m_cq_tail  = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+    m_cq_mask  = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+    m_cqes     = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+
+    return 0;
+}
+
+void AsyncFileWriter::ReleaseRing()
+{
+    if(m_sqes != MAP_FAILED)
+    {
+        munmap(m_sqes, m_sqes_size);
+        m_sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if(m_cq_ring != MAP_FAILED && m_cq_ring != m_sq_ring)
+    {
+        munmap(m_cq_ring, m_cq_ring_size);
+    }
+    m_cq_ring = MAP_FAILED;
+    if(m_sq_ring != MAP_FAILED)
+    {
+        munmap(m_sq_ring, m_sq_ring_size);
+        m_sq_ring = MAP_FAILED;
+    }
+    if(m_ring_fd >= 0)
+    {
+        close(m_ring_fd);
+        m_ring_fd = -1;
+    }
+}
+
+bool AsyncFileWriter::PrepareSqe(Request *request, uint64_t user_data)
+{
+    unsigned tail = *m_sq_tail;
+    unsigned index;
+    io_uring_sqe *sqe;
+
+    if(tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+    {
+        return false;
+    }
+
+    index = tail & *m_sq_mask;
+    sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+
+    if(request == nullptr)
+    {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = m_wake_fd;
+        sqe->poll_events = POLLIN;
+    }
+    else if(request->operation == Operation::Write)
+    {
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = request->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(request->iov.data());
+        sqe->len = request->iov.size();
+        sqe->off = request->offset;
+    }
+    else if(request->operation == Operation::Sync)
+    {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = request->fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    }
+    else if(request->operation == Operation::Close)
+    {
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = request->fd;
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_NOP;
+    }
+
+    m_sq_array[index] = index;
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void AsyncFileWriter::RunRing()
+{
+    std::deque<Request*> backlog;
+    uint32_t in_flight = 0;
+    bool wake_armed = false;
+    bool stop = false;
+
+    while(true)
+    {
+        /* Read before draining: everything submitted before the stop completes */
+        stop = m_stop.load();
+        Take(backlog);
+
+        /* Writes go in parallel, the rest once those before them have completed */
+        while(!backlog.empty() && in_flight < m_queue_depth &&
+              (backlog.front()->operation == Operation::Write || in_flight == 0) &&
+              PrepareSqe(backlog.front(), reinterpret_cast<uint64_t>(backlog.front())))
+        {
+            in_flight++;
+            bool ordered = (backlog.front()->operation != Operation::Write);
+            backlog.pop_front();
+            if(ordered)
+            {
+                break;
+            }
+        }
+
+        if(!wake_armed)
+        {
+            wake_armed = PrepareSqe(nullptr, WAKE_USER_DATA);
+        }
+
+        if(stop && backlog.empty() && in_flight == 0)
+        {
+            break;
+        }
+
+        /* Sleeps until a completion, submitting wakes it up only when there's nothing in flight to wait for */
+        bool wait = true;
+        if(backlog.empty())
+        {
+            m_sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            Take(backlog);
+            if(!backlog.empty() || (m_stop.load() && in_flight == 0))
+            {
+                m_sleeping.store(false);
+                wait = false;
+            }
+        }
+
+        unsigned to_submit = *m_sq_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+        if(0 > syscall(__NR_io_uring_enter, m_ring_fd, to_submit, wait ? 1U : 0U, wait ? IORING_ENTER_GETEVENTS : 0U, nullptr, 0) &&
+           errno != EINTR)
+        {
+            LOG(LOG_ERR,"io_uring_enter() failed: %s\n", strerror(errno));
+        }
+        m_sleeping.store(false);
+
+        unsigned head = *m_cq_head;
+        unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++)
+        {
+            const io_uring_cqe& cqe = m_cqes[head & *m_cq_mask];
+            int result = cqe.res;
+
+            if(cqe.user_data == WAKE_USER_DATA)
+            {
+                uint64_t value;
+                wake_armed = false;
+                if(0 > read(m_wake_fd, &value, sizeof(value)) && errno != EAGAIN)
+                {
+                    LOG(LOG_ERR,"Couldn't read the AsyncFileWriter wake up: %s\n", strerror(errno));
+                }
+                continue;
+            }
+
+            Request *request = reinterpret_cast<Request*>(cqe.user_data);
+            in_flight--;
+
+            if(request->operation == Operation::Write && result > 0 && Advance(*request, result))
+            {
+                /* Short write, the rest goes next */
+                backlog.push_front(request);
+                continue;
+            }
+            else if(request->operation == Operation::Write && result >= 0)
+            {
+                result = (request->written == request->size) ? static_cast<int>(request->written) : -EIO;
+            }
+            else if(request->operation == Operation::Close && result == -EINVAL)
+            {
+                /* Kernel without IORING_OP_CLOSE */
+                result = (0 == close(request->fd)) ? 0 : -errno;
+            }
+
+            request->on_complete(result);
+            delete request;
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+void AsyncFileWriter::RunThread()
+{
+    std::deque<Request*> backlog;
+    bool stop = false;
+
+    while(!stop)
+    {
+        /* Read before draining: everything submitted before the stop completes */
+        stop = m_stop.load();
+        Take(backlog);
+
+        if(!backlog.empty())
+        {
+            for(Request *request : backlog)
+            {
+                request->on_complete(Execute(*request));
+                delete request;
+            }
+            backlog.clear();
+        }
+        else if(!stop)
+        {
+            m_sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            Take(backlog);
+            if(backlog.empty() && !m_stop.load())
+            {
+                pollfd wake = {m_wake_fd, POLLIN, 0};
+                uint64_t value;
+
+                if(0 > poll(&wake, 1, -1) && errno != EINTR)
+                {
+                    LOG(LOG_ERR,"poll() failed: %s\n", strerror(errno));
+                }
+                if(0 > read(m_wake_fd, &value, sizeof(value)) && errno != EAGAIN)
+                {
+                    LOG(LOG_ERR,"Couldn't read the AsyncFileWriter wake up: %s\n", strerror(errno));
+                }
+            }
+            m_sleeping.store(false);
+        }
+    }
+}
+
+int AsyncFileWriter::Execute(Request& request)
+{
+    int ret_val = 0;
+
+    if(request.operation == Operation::Write)
+    {
+        ssize_t written;
+
+        do
+        {
+            written = pwritev(request.fd, request.iov.data(), request.iov.size(), request.offset);
+        }
+        while((written > 0 && Advance(request, written)) || (written < 0 && errno == EINTR));
+
+        ret_val = (written < 0) ? -errno : (request.written == request.size) ? static_cast<int>(request.written) : -EIO;
+    }
+    else if(request.operation == Operation::Sync)
+    {
+        ret_val = (0 == fdatasync(request.fd)) ? 0 : -errno;
+    }
+    else if(request.operation == Operation::Close)
+    {
+        ret_val = (0 == close(request.fd)) ? 0 : -errno;
+    }
+
+    return ret_val;
+}
+
+bool AsyncFileWriter::Advance(Request& request, size_t written)
+{
+    request.written += written;
+    request.offset += written;
+
+    while(written > 0 && !request.iov.empty())
+    {
+        if(written >= request.iov.front().iov_len)
+        {
+            written -= request.iov.front().iov_len;
+            request.iov.erase(request.iov.begin());
+        }
+        else
+        {
+            request.iov.front().iov_base = static_cast<uint8_t*>(request.iov.front().iov_base) + written;
+            request.iov.front().iov_len -= written;
+            written = 0;
+        }
+    }
+
+    return request.written < request.size;
+}
@@ -9,17 +9,85 @@
  * Includes
  *******************************************************************/
 #include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
 
 #include "cyclic_task.hpp"
 
+/*******************************************************************
+ * Static functions
+ *******************************************************************/
+static void AddMilliseconds(struct timespec& time, uint32_t milliseconds)
+{
+    time.tv_sec  += milliseconds / 1000U;
+    time.tv_nsec += static_cast<long>(milliseconds % 1000U) * 1000000L;
+
+    if(time.tv_nsec >= 1000000000L)
+    {
+        time.tv_sec  += 1;
+        time.tv_nsec -= 1000000000L;
+    }
+}
+
+/*******************************************************************
+ * Function definition
+ *******************************************************************/
+void ApplyThreadScheduling(const std::string& thread_name, const CyclicTaskConfig& config)
+{
+    if(config.cpu_affinity >= 0)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(config.cpu_affinity, &cpu_set);
+
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if(0 != ret)
+        {
+            LOG(LOG_WARNING,"%s couldn't be pinned to CPU %d: %s\n", thread_name.c_str(), config.cpu_affinity, strerror(ret));
+        }
+    }
+
+    if(config.rt_priority > 0)
+    {
+        struct sched_param sched_param = {};
+        sched_param.sched_priority = config.rt_priority;
+
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sched_param);
+        if(0 != ret)
+        {
+            LOG(LOG_WARNING,"%s couldn't set SCHED_FIFO priority %d: %s\n", thread_name.c_str(), config.rt_priority, strerror(ret));
+        }
+    }
+    else if(config.nice != 0)
+    {
+        /* On Linux the nice value is per thread */
+        if(0 != setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), config.nice))
+        {
+            LOG(LOG_WARNING,"%s couldn't set nice value %d: %s\n", thread_name.c_str(), config.nice, strerror(errno));
+        }
+    }
+}
+
 /*******************************************************************
  * Class definition
  *******************************************************************/
 
-CyclicTask::CyclicTask(std::string task_name, uint32_t loop_period_ms) :
+CyclicTask::CyclicTask(std::string task_name, uint32_t loop_period_ms, CyclicTaskConfig config) :
     m_running(false),
     m_task_name(task_name),
-    m_loop_interval_ms(loop_period_ms)
+    m_loop_interval_ms(loop_period_ms),
+    m_config(config),
+    m_timer_fd(-1),
+    m_stop_fd(-1),
+    m_epoll_fd(-1)
 {
 }
 
@@ -32,7 +100,16 @@ int CyclicTask::Start()
 {
     int retval = 0;
 
-    if(!m_running)
+    if(m_running)
+    {
+        LOG(LOG_INFO,"%s task is already started\n", m_task_name.c_str());
+    }
+    else if(m_config.backend == CyclicTaskBackend::TimerFd && 0 != OpenTimerFd())
+    {
+        LOG(LOG_ERR,"%s timerfd creation failed\n", m_task_name.c_str());
+        retval = -1;
+    }
+    else
     {
         m_running = true;
 
@@ -48,10 +125,6 @@ int CyclicTask::Start()
 
         LOG(LOG_INFO,"Starting %s task\n", m_task_name.c_str());
     }
-    else
-    {
-        LOG(LOG_INFO,"%s task is already started\n", m_task_name.c_str());
-    }
 
     return retval;
 }
@@ -64,10 +137,23 @@ int CyclicTask::Stop()
     {
         m_running = false;
 
-        m_condition_variable.notify_one();
+        if(m_config.backend == CyclicTaskBackend::TimerFd)
+        {
+            uint64_t value = 1;
+            if(sizeof(value) != write(m_stop_fd, &value, sizeof(value)))
+            {
+                LOG(LOG_ERR,"%s failed to signal the stop event: %s\n", m_task_name.c_str(), strerror(errno));
+            }
+        }
+        else
+        {
+            m_condition_variable.notify_one();
+        }
 
         m_thread->join();
 
+        CloseTimerFd();
+
         LOG(LOG_INFO,"Stoping %s task\n",m_task_name.c_str());
     }
     else
@@ -89,6 +175,22 @@ void CyclicTask::ChangeLoopInterval(uint32_t loop_interval_ms)
 }
 
 void CyclicTask::ThreadLoop()
+{
+    ApplySchedulingConfig();
+
+    switch(m_config.backend)
+    {
+        case CyclicTaskBackend::TimerFd:
+            TimerFdLoop();
+            break;
+        case CyclicTaskBackend::ConditionVariable:
+        default:
+            ConditionVariableLoop();
+            break;
+    }
+}
+
+void CyclicTask::ConditionVariableLoop()
 {
     std::unique_lock<std::mutex> unique_lock(m_mutex);
 
@@ -100,4 +202,112 @@ void CyclicTask::ThreadLoop()
         sleep_abs_time += std::chrono::milliseconds(m_loop_interval_ms);
         m_condition_variable.wait_until(unique_lock, sleep_abs_time);
     }
-}
\ No newline at end of file
+}
+
+void CyclicTask::TimerFdLoop()
+{
+    struct timespec deadline;
+    struct epoll_event events[2];
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while(m_running)
+    {
+        ExecutionCycle();
+
+        /* Absolute deadlines: the wake-up error of one cycle doesn't accumulate into the next one */
+        AddMilliseconds(deadline, m_loop_interval_ms);
+
+        struct itimerspec timer_spec = {};
+        timer_spec.it_value = deadline;
+
+        if(0 != timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &timer_spec, nullptr))
+        {
+            LOG(LOG_ERR,"%s timerfd_settime() failed: %s\n", m_task_name.c_str(), strerror(errno));
+            break;
+        }
+
+        int num_events = epoll_wait(m_epoll_fd, events, 2, -1);
+        if(num_events < 0 && errno != EINTR)
+        {
+            LOG(LOG_ERR,"%s epoll_wait() failed: %s\n", m_task_name.c_str(), strerror(errno));
+            break;
+        }
+
+        for(int i = 0; i < num_events; i++)
+        {
+            if(events[i].data.fd == m_timer_fd)
+            {
+                uint64_t expirations;
+                if(sizeof(expirations) != read(m_timer_fd, &expirations, sizeof(expirations)))
+                {
+                    LOG(LOG_WARNING,"%s failed to read the timerfd\n", m_task_name.c_str());
+                }
+            }
+        }
+    }
+}
+
+void CyclicTask::ApplySchedulingConfig()
+{
+    ApplyThreadScheduling(m_task_name, m_config);
+}
+
+int CyclicTask::OpenTimerFd()
+{
+    int retval = -1;
+    struct epoll_event event = {};
+
+    if(0 > (m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)))
+    {
+        LOG(LOG_ERR,"timerfd_create() failed: %s\n", strerror(errno));
+    }
+    else if(0 > (m_stop_fd = eventfd(0, EFD_CLOEXEC)))
+    {
+        LOG(LOG_ERR,"eventfd() failed: %s\n", strerror(errno));
+    }
+    else if(0 > (m_epoll_fd = epoll_create1(EPOLL_CLOEXEC)))
+    {
+        LOG(LOG_ERR,"epoll_create1() failed: %s\n", strerror(errno));
+    }
+    else
+    {
+        event.events = EPOLLIN;
+        event.data.fd = m_timer_fd;
+        if(0 != epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &event))
+        {
+            LOG(LOG_ERR,"epoll_ctl() failed: %s\n", strerror(errno));
+        }
+        else
+        {
+            event.data.fd = m_stop_fd;
+            if(0 != epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_stop_fd, &event))
+            {
+                LOG(LOG_ERR,"epoll_ctl() failed: %s\n", strerror(errno));
+            }
+            else
+            {
+                retval = 0;
+            }
+        }
+    }
+
+    if(retval != 0)
+    {
+        CloseTimerFd();
+    }
+
+    return retval;
+}
+
+void CyclicTask::CloseTimerFd()
+{
+    for(int* fd : {&m_epoll_fd, &m_stop_fd, &m_timer_fd})
+    {
+        if(*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
@@ -14,15 +14,21 @@
  * Class definition
  *******************************************************************/
 Detection::Detection(std::shared_ptr<IKinect> kinect, std::shared_ptr<DetectionObserver> detection_observer, DetectionConfig detection_config) :
-    CyclicTask("Detection", detection_config.take_depth_frame_interval_ms),
+    CyclicTask("Detection", detection_config.take_depth_frame_interval_ms,
+               {CyclicTaskBackend::TimerFd, DETECTION_TASK_RT_PRIORITY, DETECTION_TASK_CPU_AFFINITY}),
     m_detection_config(detection_config),
     m_current_state(State::Idle),
     m_kinect(kinect),
-    m_detection_observer(detection_observer)
+    m_detection_observer(detection_observer),
+    m_waiting_frames(false),
+    m_pending_sequence(0),
+    m_processed_sequence(0),
+    m_skipped_frames(0)
 {
     m_depth_frame_ref         = std::make_unique<KinectDepthFrame>(DEPTH_WIDTH,DEPTH_HEIGHT);
     m_depth_frame             = std::make_unique<KinectDepthFrame>(DEPTH_WIDTH,DEPTH_HEIGHT);
-    m_refresh_reference_frame = std::make_unique<RefreshReferenceFrame>(kinect, m_depth_frame_ref, detection_config.refresh_reference_interval_ms);
+    m_depth_frame_pending     = std::make_unique<KinectDepthFrame>(DEPTH_WIDTH,DEPTH_HEIGHT);
+    m_frame_observer          = std::make_shared<DetectionFrameObserver>(*this);
     m_take_video_frames       = std::make_unique<TakeVideoFrames>(*this, kinect, detection_config.take_video_frame_interval_ms);
 }
 
@@ -41,9 +47,21 @@ int Detection::Start()
     m_kinect->GetDepthFrame(*m_depth_frame_ref);
     LOG(LOG_INFO,"Detection: Depth reference frame\n");
 
-    if(0 != CyclicTask::Start())
+    {
+        std::lock_guard<std::mutex> lock(m_frame_mutex);
+        m_waiting_frames = true;
+        m_processed_sequence = m_pending_sequence;
+        m_skipped_frames = 0;
+    }
+
+    if(0 != m_kinect->Subscribe(KinectFrameType::Depth, m_frame_observer))
+    {
+        LOG(LOG_ERR,"Kinect::Subscribe() failed\n");
+    }
+    else if(0 != CyclicTask::Start())
     {
         LOG(LOG_ERR,"CyclicTask::Start() failed\n");
+        m_kinect->Unsubscribe(KinectFrameType::Depth, m_frame_observer);
     }
     else
     {
@@ -59,7 +77,18 @@ int Detection::Stop()
     int retval = 0;
 
     m_take_video_frames->Stop();
-    m_refresh_reference_frame->Stop();
+
+    if(0 != m_kinect->Unsubscribe(KinectFrameType::Depth, m_frame_observer))
+    {
+        LOG(LOG_WARNING,"Kinect::Unsubscribe() failed\n");
+    }
+
+    /* Wake up the execution thread if it's waiting for a frame */
+    {
+        std::lock_guard<std::mutex> lock(m_frame_mutex);
+        m_waiting_frames = false;
+    }
+    m_frame_cv.notify_one();
 
     /* Call parent Stop to stop the execution thread*/
     if(0 != CyclicTask::Stop())
@@ -69,7 +98,7 @@ int Detection::Stop()
     }
     else
     {
-        LOG(LOG_INFO,"Detection stopped successfully\n");
+        LOG(LOG_INFO,"Detection stopped successfully (%llu frames skipped)\n", static_cast<unsigned long long>(m_skipped_frames));
     }
 
     return retval;
@@ -85,15 +114,65 @@ void Detection::UpdateConfig(AlarmModuleConfig& config)
     m_detection_config = dynamic_cast<DetectionConfig&>(config);
 
     CyclicTask::ChangeLoopInterval(m_detection_config.take_depth_frame_interval_ms);
-    m_refresh_reference_frame->ChangeLoopInterval(m_detection_config.refresh_reference_interval_ms);
     m_take_video_frames->ChangeLoopInterval(m_detection_config.take_video_frame_interval_ms);
 }
 
+int Detection::WaitNextDepthFrame()
+{
+    int retval = -1;
+    std::unique_lock<std::mutex> lock(m_frame_mutex);
+
+    /* Sleep until the Kinect pushes a frame newer than the last one compared */
+    bool new_frame = m_frame_cv.wait_for(lock, std::chrono::milliseconds(KINECT_GETFRAMES_TIMEOUT_MS), [this]
+    {
+        return !m_waiting_frames || m_pending_sequence != m_processed_sequence;
+    });
+
+    if(!m_waiting_frames)
+    {
+        /* Stopping */
+    }
+    else if(!new_frame)
+    {
+        LOG(LOG_WARNING,"Detection: no depth frame received in %u ms\n", KINECT_GETFRAMES_TIMEOUT_MS);
+    }
+    else
+    {
+        /* The first frame after a Start has nothing to be compared against */
+        if(m_processed_sequence != 0 && m_pending_sequence > m_processed_sequence)
+        {
+            m_skipped_frames += m_pending_sequence - m_processed_sequence - 1;
+        }
+        m_processed_sequence = m_pending_sequence;
+        std::swap(m_depth_frame, m_depth_frame_pending);
+        retval = 0;
+    }
+
+    return retval;
+}
+
+void Detection::RefreshReferenceFrame(bool force)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    if(force || now >= m_refresh_reference_abs_time)
+    {
+        *m_depth_frame_ref = *m_depth_frame;
+        m_refresh_reference_abs_time = now + std::chrono::milliseconds(m_detection_config.refresh_reference_interval_ms);
+    }
+}
+
 void Detection::ExecutionCycle()
 {
-    /* Get depth frame */
-    m_kinect->GetDepthFrame(*m_depth_frame);
+    /* Wait for the next depth frame */
+    if(0 == WaitNextDepthFrame())
+    {
+        ProcessDepthFrame();
+    }
+}
 
+void Detection::ProcessDepthFrame()
+{
     uint32_t diff = m_depth_frame->ComputeDifferences((*m_depth_frame_ref.get()), m_detection_config.sensitivity);
 
     LOG(LOG_DEBUG,"Detection: Diff %d\n", diff);
@@ -107,12 +186,14 @@ void Detection::ExecutionCycle()
         {
             m_detection_observer->IntrusionStarted();
             m_take_video_frames->Start();
-            m_refresh_reference_frame->Start();
+            /* While the intrusion lasts the reference follows the scene, so a static intruder ends it */
+            RefreshReferenceFrame(true);
             m_current_state = State::Intrusion;
             LOG(LOG_WARNING,"Detection: Intrusion started\n");
         }
         break;
     case State::Intrusion:
+        RefreshReferenceFrame(false);
         if(!detected_movement)
         {
             m_current_state = State::Cooldown;
@@ -120,6 +201,7 @@ void Detection::ExecutionCycle()
         }
         break;
     case State::Cooldown:
+        RefreshReferenceFrame(false);
         if(detected_movement)
         {
             m_current_state = State::Intrusion;
@@ -129,7 +211,6 @@ void Detection::ExecutionCycle()
             if(std::chrono::system_clock::now() > m_cooldown_abs_time)
             {
                 uint32_t num_frames = m_take_video_frames->Stop();
-                m_refresh_reference_frame->Stop();
                 LOG(LOG_WARNING,"Detection: Intrusion Stopped\n");
                 m_detection_observer->IntrusionStopped(num_frames);
                 m_current_state = State::Idle;
@@ -141,18 +222,19 @@ void Detection::ExecutionCycle()
     }
 }
 
-RefreshReferenceFrame::RefreshReferenceFrame(std::shared_ptr<IKinect> kinect,
-                                             std::shared_ptr<KinectDepthFrame> depth_frame_reff,
-                                             uint32_t loop_period_ms) :
-    CyclicTask("RefreshReferenceFrame", loop_period_ms),
-    m_depth_frame_ref(depth_frame_reff),
-    m_kinect(kinect)
+DetectionFrameObserver::DetectionFrameObserver(Detection& detection) :
+    m_detection(detection)
 {
 }
 
-void RefreshReferenceFrame::ExecutionCycle()
+void DetectionFrameObserver::NewDepthFrame(const KinectDepthFrame& frame, uint64_t sequence)
 {
-    m_kinect->GetDepthFrame(*m_depth_frame_ref);
+    {
+        std::lock_guard<std::mutex> lock(m_detection.m_frame_mutex);
+        *m_detection.m_depth_frame_pending = frame;
+        m_detection.m_pending_sequence = sequence;
+    }
+    m_detection.m_frame_cv.notify_one();
 }
 
 TakeVideoFrames::TakeVideoFrames(Detection& detection,
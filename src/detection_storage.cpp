@@ -0,0 +1,578 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file detection_storage.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "detection_storage.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define DETECTION_STORAGE_NICE 19 /* Reclamation only uses the CPU the detection doesn't */
+#define DETECTION_MANIFEST_NAME "manifest"
+
+/*******************************************************************
+ * Static functions
+ *******************************************************************/
+static std::string Filename(const std::string& filepath)
+{
+    return std::filesystem::path(filepath).filename().string();
+}
+
+static CyclicTaskConfig ReclaimTaskConfig()
+{
+    CyclicTaskConfig config;
+
+    config.nice = DETECTION_STORAGE_NICE;
+
+    return config;
+}
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+DetectionStorage::DetectionStorage(const std::string& path, DetectionStoragePolicy policy, std::function<void(int32_t)> on_evicted) :
+    CyclicTask("DetectionStorage", policy.reclaim_interval_ms, ReclaimTaskConfig()),
+    m_path(path),
+    m_policy(policy),
+    m_on_evicted(on_evicted),
+    m_bytes(0),
+    m_evicted(0),
+    m_evicted_id(-1),
+    m_indexed(false)
+{
+}
+
+DetectionStorage::~DetectionStorage()
+{
+    /* Before the members ExecutionCycle() uses are gone */
+    Stop();
+
+    for(auto& entry : m_detections)
+    {
+        if(entry.second.manifest_fd >= 0)
+        {
+            close(entry.second.manifest_fd);
+        }
+    }
+}
+
+std::string DetectionStorage::GetDirectory(int32_t id)
+{
+    return m_path + "/" + std::to_string(id);
+}
+
+int DetectionStorage::BeginDetection(int32_t id, time_t date)
+{
+    int ret_val = -1;
+    int fd = -1;
+    std::string directory = GetDirectory(id);
+
+    if(0 != mkdir(directory.c_str(), 0770) && errno != EEXIST)
+    {
+        LOG(LOG_ERR,"DetectionStorage couldn't create %s: %s\n", directory.c_str(), strerror(errno));
+    }
+    else if(0 > (fd = open((directory + "/" DETECTION_MANIFEST_NAME).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0660)))
+    {
+        LOG(LOG_ERR,"DetectionStorage couldn't create the manifest of detection n°%d: %s\n", id, strerror(errno));
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(!m_indexed)
+        {
+            IndexDirectory();
+        }
+
+        DetectionFiles& detection = m_detections[id];
+        if(detection.manifest_fd >= 0)
+        {
+            close(detection.manifest_fd);
+        }
+        detection.directory = directory;
+        detection.date = date;
+        detection.ended = false;
+        detection.manifest_fd = fd;
+
+        ret_val = AppendToManifest(id, "detection " + std::to_string(id) + " " + std::to_string(date));
+    }
+
+    return ret_val;
+}
+
+int DetectionStorage::AddFrame(int32_t id, uint32_t frame_num, uint32_t timestamp, const std::string& filepath, uint64_t offset, uint64_t size)
+{
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_indexed)
+    {
+        IndexDirectory();
+    }
+
+    if(id <= m_evicted_id)
+    {
+        LOG(LOG_WARNING,"DetectionStorage ignores a frame of evicted detection n°%d\n", id);
+    }
+    else
+    {
+        /* Frames are appended, the file is as big as the end of its last one */
+        IndexFile(id, filepath, offset + size, time(nullptr));
+        m_detections[id].frames++;
+
+        ret_val = AppendToManifest(id, "frame " + std::to_string(frame_num) + " " + std::to_string(timestamp) + " " +
+                                       Filename(filepath) + " " + std::to_string(offset) + " " + std::to_string(size));
+    }
+
+    return ret_val;
+}
+
+int DetectionStorage::AddFile(int32_t id, const std::string& filepath)
+{
+    int ret_val = -1;
+    struct stat file_stat;
+
+    if(0 != stat(filepath.c_str(), &file_stat))
+    {
+        LOG(LOG_WARNING,"DetectionStorage couldn't stat %s: %s\n", filepath.c_str(), strerror(errno));
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        /* The scan finds this file too, indexing it twice is harmless */
+        if(!m_indexed)
+        {
+            IndexDirectory();
+        }
+
+        /* E.g. an export that ended after the eviction, its entry isn't created again */
+        if(id <= m_evicted_id)
+        {
+            LOG(LOG_WARNING,"DetectionStorage ignores %s of evicted detection n°%d\n", filepath.c_str(), id);
+        }
+        else
+        {
+            IndexFile(id, filepath, static_cast<uint64_t>(file_stat.st_size), file_stat.st_mtime);
+            ret_val = AppendToManifest(id, "file " + Filename(filepath) + " " + std::to_string(file_stat.st_size));
+        }
+    }
+
+    return ret_val;
+}
+
+int DetectionStorage::EndDetection(int32_t id, time_t date, uint32_t frames)
+{
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_indexed)
+    {
+        IndexDirectory();
+    }
+
+    auto entry = m_detections.find(id);
+    if(entry == m_detections.end() || entry->second.directory.empty())
+    {
+        LOG(LOG_WARNING,"DetectionStorage has no directory for detection n°%d\n", id);
+    }
+    else if(0 != AppendToManifest(id, "end " + std::to_string(date) + " " + std::to_string(frames)))
+    {
+        LOG(LOG_WARNING,"DetectionStorage couldn't end the manifest of detection n°%d\n", id);
+    }
+    else
+    {
+        DetectionFiles& detection = entry->second;
+
+        /* The manifest is what a recovery relies on */
+        if(0 != fdatasync(detection.manifest_fd))
+        {
+            LOG(LOG_WARNING,"DetectionStorage couldn't sync the manifest of detection n°%d: %s\n", id, strerror(errno));
+        }
+        close(detection.manifest_fd);
+        detection.manifest_fd = -1;
+        detection.ended = true;
+        detection.frames = frames;
+        ret_val = 0;
+    }
+
+    return ret_val;
+}
+
+std::vector<InterruptedDetection> DetectionStorage::GetInterrupted()
+{
+    std::vector<InterruptedDetection> interrupted;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_indexed)
+    {
+        IndexDirectory();
+    }
+
+    for(const auto& entry : m_detections)
+    {
+        /* With the manifest open it's still being written */
+        if(!entry.second.ended && entry.second.manifest_fd < 0)
+        {
+            interrupted.push_back(InterruptedDetection{entry.first, entry.second.date, entry.second.frames});
+        }
+    }
+
+    return interrupted;
+}
+
+int DetectionStorage::DeleteDetection(int32_t id)
+{
+    int ret_val = 0;
+    DetectionFiles detection;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(!m_indexed)
+        {
+            IndexDirectory();
+        }
+
+        auto entry = m_detections.find(id);
+        if(entry != m_detections.end())
+        {
+            detection = std::move(entry->second);
+            m_bytes -= detection.bytes;
+            m_detections.erase(entry);
+        }
+    }
+
+    if(0 != RemoveFiles(detection))
+    {
+        ret_val = -1;
+    }
+
+    return ret_val;
+}
+
+int DetectionStorage::DeleteAll()
+{
+    int ret_val = 0;
+    std::map<int32_t, DetectionFiles> detections;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(!m_indexed)
+        {
+            IndexDirectory();
+        }
+
+        /* The numbering starts over */
+        detections.swap(m_detections);
+        m_bytes = 0;
+        m_evicted_id = -1;
+    }
+
+    for(const auto& entry : detections)
+    {
+        if(0 != RemoveFiles(entry.second))
+        {
+            ret_val = -1;
+        }
+    }
+
+    return ret_val;
+}
+
+uint32_t DetectionStorage::Reclaim()
+{
+    std::vector<std::pair<int32_t, DetectionFiles>> evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        time_t now = time(nullptr);
+
+        if(!m_indexed)
+        {
+            IndexDirectory();
+        }
+
+        /* The newest detection always stays, it may still be being written */
+        while(m_detections.size() > 1)
+        {
+            auto oldest = m_detections.begin();
+            bool over_size = (m_policy.max_bytes != 0) && (m_bytes > m_policy.max_bytes);
+            bool too_old = (m_policy.max_age_s != 0) && (oldest->second.date + static_cast<time_t>(m_policy.max_age_s) < now);
+
+            if(!over_size && !too_old)
+            {
+                break;
+            }
+
+            m_bytes -= oldest->second.bytes;
+            m_evicted_id = std::max(m_evicted_id, oldest->first);
+            evicted.emplace_back(oldest->first, std::move(oldest->second));
+            m_detections.erase(oldest);
+        }
+
+        m_evicted += evicted.size();
+    }
+
+    for(const auto& entry : evicted)
+    {
+        RemoveFiles(entry.second);
+        LOG(LOG_NOTICE,"Detection n°%d evicted, %llu bytes\n", entry.first, static_cast<unsigned long long>(entry.second.bytes));
+
+        if(m_on_evicted)
+        {
+            m_on_evicted(entry.first);
+        }
+    }
+
+    return evicted.size();
+}
+
+DetectionStorageStats DetectionStorage::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_indexed)
+    {
+        IndexDirectory();
+    }
+
+    return DetectionStorageStats{m_bytes, static_cast<uint32_t>(m_detections.size()), m_evicted};
+}
+
+void DetectionStorage::ExecutionCycle()
+{
+    Reclaim();
+}
+
+void DetectionStorage::IndexDirectory()
+{
+    std::error_code error;
+
+    for(auto entry = std::filesystem::directory_iterator(m_path, error);
+        !error && entry != std::filesystem::directory_iterator(); entry.increment(error))
+    {
+        std::string filename = entry->path().filename().string();
+        char *end = nullptr;
+        long id = strtol(filename.c_str(), &end, 10);
+        std::error_code type_error;
+
+        /* Only "<id>/" and the flat "<id>_*", anything else in the directory isn't a detection */
+        if(end == filename.c_str())
+        {
+            continue;
+        }
+        else if(*end == '\0' && entry->is_directory(type_error))
+        {
+            IndexDetectionDirectory(static_cast<int32_t>(id), entry->path().string());
+        }
+        else if(*end == '_' && entry->is_regular_file(type_error))
+        {
+            struct stat file_stat;
+
+            if(0 == stat(entry->path().c_str(), &file_stat))
+            {
+                IndexFile(static_cast<int32_t>(id), entry->path().string(), static_cast<uint64_t>(file_stat.st_size), file_stat.st_mtime);
+            }
+        }
+    }
+
+    if(error)
+    {
+        LOG(LOG_WARNING,"DetectionStorage couldn't scan %s: %s\n", m_path.c_str(), error.message().c_str());
+    }
+
+    LOG(LOG_INFO,"DetectionStorage indexed %zu detections, %llu bytes\n", m_detections.size(), static_cast<unsigned long long>(m_bytes));
+    m_indexed = true;
+}
+
+void DetectionStorage::IndexDetectionDirectory(int32_t id, const std::string& directory)
+{
+    DetectionFiles& detection = m_detections[id];
+    std::ifstream manifest(directory + "/" DETECTION_MANIFEST_NAME);
+    std::string line;
+
+    detection.directory = directory;
+
+    if(!manifest.is_open())
+    {
+        /* No manifest, its files as they are */
+        std::error_code error;
+        struct stat file_stat;
+
+        for(auto entry = std::filesystem::directory_iterator(directory, error);
+            !error && entry != std::filesystem::directory_iterator(); entry.increment(error))
+        {
+            if(0 == stat(entry->path().c_str(), &file_stat) && S_ISREG(file_stat.st_mode))
+            {
+                IndexFile(id, entry->path().string(), static_cast<uint64_t>(file_stat.st_size), file_stat.st_mtime);
+            }
+        }
+        return;
+    }
+
+    /* A record cut by a crash has no newline, the numbers in it may still parse so it's dropped */
+    detection.ended = false;
+    while(std::getline(manifest, line))
+    {
+        if(manifest.eof())
+        {
+            LOG(LOG_WARNING,"DetectionStorage drops the cut manifest record of detection %d\n", id);
+            break;
+        }
+
+        std::istringstream record(line);
+        std::string type, filename;
+        long long date;
+        int32_t record_id;
+        uint32_t frame_num, timestamp, frames;
+        uint64_t offset, size;
+
+        record >> type;
+        if(type == "detection" && (record >> record_id >> date))
+        {
+            detection.date = static_cast<time_t>(date);
+        }
+        else if(type == "frame" && (record >> frame_num >> timestamp >> filename >> offset >> size))
+        {
+            IndexFile(id, directory + "/" + filename, offset + size, detection.date);
+            detection.frames++;
+        }
+        else if(type == "file" && (record >> filename >> size))
+        {
+            IndexFile(id, directory + "/" + filename, size, detection.date);
+        }
+        else if(type == "end" && (record >> date >> frames))
+        {
+            detection.ended = true;
+            detection.frames = frames;
+        }
+    }
+
+    /* Without its date the detection is dated by the last write of its manifest, not evicted as the oldest */
+    if(detection.date == 0)
+    {
+        struct stat file_stat;
+
+        if(0 == stat((directory + "/" DETECTION_MANIFEST_NAME).c_str(), &file_stat))
+        {
+            detection.date = file_stat.st_mtime;
+        }
+        else
+        {
+            detection.date = time(nullptr);
+        }
+    }
+}
+
+void DetectionStorage::IndexFile(int32_t id, const std::string& filepath, uint64_t size, time_t date)
+{
+    DetectionFiles& detection = m_detections[id];
+    auto file = detection.files.find(filepath);
+
+    if(file != detection.files.end())
+    {
+        detection.bytes -= file->second;
+        m_bytes -= file->second;
+        file->second = size;
+    }
+    else
+    {
+        detection.files.emplace(filepath, size);
+    }
+
+    detection.bytes += size;
+    m_bytes += size;
+
+    if(detection.date == 0 || date < detection.date)
+    {
+        detection.date = date;
+    }
+}
+
+int DetectionStorage::AppendToManifest(int32_t id, const std::string& record)
+{
+    int ret_val = 0;
+    DetectionFiles& detection = m_detections[id];
+    std::string line = record + "\n";
+
+    if(detection.directory.empty())
+    {
+        /* Flat layout, no manifest */
+    }
+    else if(detection.manifest_fd < 0 &&
+            0 > (detection.manifest_fd = open((detection.directory + "/" DETECTION_MANIFEST_NAME).c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)))
+    {
+        LOG(LOG_WARNING,"DetectionStorage couldn't open the manifest of detection n°%d: %s\n", id, strerror(errno));
+        ret_val = -1;
+    }
+    else if(static_cast<ssize_t>(line.size()) != write(detection.manifest_fd, line.data(), line.size()))
+    {
+        LOG(LOG_WARNING,"DetectionStorage couldn't write the manifest of detection n°%d: %s\n", id, strerror(errno));
+        ret_val = -1;
+    }
+
+    /* Appended after its end, e.g. an exported file: not left open until the detection is removed */
+    if(detection.ended && detection.manifest_fd >= 0)
+    {
+        close(detection.manifest_fd);
+        detection.manifest_fd = -1;
+    }
+
+    return ret_val;
+}
+
+int DetectionStorage::RemoveFiles(const DetectionFiles& detection)
+{
+    int ret_val = 0;
+
+    if(detection.manifest_fd >= 0)
+    {
+        close(detection.manifest_fd);
+    }
+
+    if(!detection.directory.empty())
+    {
+        std::error_code error;
+
+        /* Only its own directory */
+        std::filesystem::remove_all(detection.directory, error);
+        if(error)
+        {
+            LOG(LOG_WARNING,"DetectionStorage couldn't delete %s: %s\n", detection.directory.c_str(), error.message().c_str());
+            ret_val = -1;
+        }
+    }
+    else
+    {
+        for(const auto& file : detection.files)
+        {
+            if(0 != unlink(file.first.c_str()) && errno != ENOENT)
+            {
+                LOG(LOG_WARNING,"DetectionStorage couldn't delete %s: %s\n", file.first.c_str(), strerror(errno));
+                ret_val = -1;
+            }
+        }
+    }
+
+    return ret_val;
+}
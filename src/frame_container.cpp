@@ -0,0 +1,597 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file frame_container.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <array>
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "frame_container.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define ZIP_LOCAL_HEADER_SIGNATURE   0x04034B50U
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014B50U
+#define ZIP_END_SIGNATURE            0x06054B50U
+#define ZIP_VERSION                  20U /* 2.0, stored entries */
+
+/*******************************************************************
+ * Static functions
+ *******************************************************************/
+static int WriteAll(int fd, iovec *iov, int iov_count, size_t size, uint64_t offset)
+{
+    /* A regular file takes it in one go unless the disk is full */
+    return (static_cast<ssize_t>(size) == pwritev(fd, iov, iov_count, static_cast<off_t>(offset))) ? 0 : -1;
+}
+
+static uint32_t Crc32(const uint8_t *data, size_t size)
+{
+    static const std::array<uint32_t, 256> table = []
+    {
+        std::array<uint32_t, 256> values;
+
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for(int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1U) ? (0xEDB88320U ^ (crc >> 1)) : (crc >> 1);
+            }
+            values[i] = crc;
+        }
+
+        return values;
+    }();
+    uint32_t crc = 0xFFFFFFFFU;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFFU] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFU;
+}
+
+/* Zip fields are little endian */
+static void PutLe(std::vector<uint8_t>& buffer, uint32_t value, size_t bytes)
+{
+    for(size_t i = 0; i < bytes; i++)
+    {
+        buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static void DosDateTime(time_t date, uint16_t& dos_date, uint16_t& dos_time)
+{
+    struct tm local;
+
+    if(localtime_r(&date, &local) == nullptr || local.tm_year < 80)
+    {
+        dos_date = (1U << 5) | 1U; /* 1980-01-01 */
+        dos_time = 0;
+    }
+    else
+    {
+        dos_date = static_cast<uint16_t>(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+        dos_time = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+    }
+}
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+FrameContainerWriter::FrameContainerWriter(const std::string& path, time_t date, uint32_t sync_frames, std::shared_ptr<AsyncFileWriter> io) :
+    m_path(path),
+    m_sync_frames(sync_frames),
+    m_fd(-1),
+    m_size(0),
+    m_end(0),
+    m_unsynced_frames(0),
+    m_io(io),
+    m_pending(0),
+    m_io_error(false)
+{
+    FrameContainerHeader header = {FRAME_CONTAINER_MAGIC, FRAME_CONTAINER_VERSION, static_cast<int64_t>(date)};
+    iovec iov = {&header, sizeof(header)};
+
+    /* Written at the offset of each frame, not appended, so a failed one can be written over */
+    if(0 > (m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660)))
+    {
+        LOG(LOG_ERR,"open(%s) failed: %s\n", path.c_str(), strerror(errno));
+        throw std::exception();
+    }
+    else if(0 != WriteAll(m_fd, &iov, 1, sizeof(header), 0))
+    {
+        LOG(LOG_ERR,"FrameContainerWriter couldn't write the header of %s: %s\n", path.c_str(), strerror(errno));
+        close(m_fd);
+        throw std::exception();
+    }
+
+    m_size = sizeof(header);
+    m_end = m_size;
+}
+
+FrameContainerWriter::~FrameContainerWriter()
+{
+    if(m_fd >= 0)
+    {
+        Close();
+    }
+}
+
+int FrameContainerWriter::Append(uint32_t frame_num, uint32_t timestamp, const uint8_t *jpeg, size_t size, uint64_t& offset)
+{
+    if(m_io)
+    {
+        return Append(frame_num, timestamp, std::make_shared<const std::vector<uint8_t>>(jpeg, jpeg + size), offset);
+    }
+
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FrameContainerRecord record = {m_size, frame_num, timestamp, static_cast<uint32_t>(size), 0};
+    iovec iov[2] = {{&record, sizeof(record)}, {const_cast<uint8_t*>(jpeg), size}};
+
+    if(m_fd < 0)
+    {
+        LOG(LOG_ERR,"FrameContainerWriter %s is closed\n", m_path.c_str());
+    }
+    else if(0 != WriteAll(m_fd, iov, 2, sizeof(record) + size, m_size))
+    {
+        LOG(LOG_ERR,"FrameContainerWriter couldn't append to %s: %s\n", m_path.c_str(), strerror(errno));
+
+        /* The partial record is written over by the next frame, the file is never shrunk as an export may have it mapped */
+        m_end = std::max(m_end, m_size + sizeof(record) + size);
+    }
+    else
+    {
+        offset = m_size + sizeof(record);
+        m_size += sizeof(record) + size;
+        m_end = std::max(m_end, m_size);
+        m_index.push_back(record);
+
+        if(m_sync_frames != 0 && ++m_unsynced_frames >= m_sync_frames)
+        {
+            if(0 != fdatasync(m_fd))
+            {
+                LOG(LOG_WARNING,"fdatasync(%s) failed: %s\n", m_path.c_str(), strerror(errno));
+            }
+            m_unsynced_frames = 0;
+        }
+
+        ret_val = 0;
+    }
+
+    return ret_val;
+}
+
+int FrameContainerWriter::Append(uint32_t frame_num, uint32_t timestamp, std::shared_ptr<const std::vector<uint8_t>> jpeg, uint64_t& offset)
+{
+    if(!m_io)
+    {
+        return Append(frame_num, timestamp, jpeg->data(), jpeg->size(), offset);
+    }
+
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_fd < 0)
+    {
+        LOG(LOG_ERR,"FrameContainerWriter %s is closed\n", m_path.c_str());
+    }
+    else
+    {
+        /* Record and JPEG stay with the write until it completes */
+        auto record = std::make_shared<FrameContainerRecord>(FrameContainerRecord{m_size, frame_num, timestamp, static_cast<uint32_t>(jpeg->size()), 0});
+        uint64_t record_offset = m_size;
+
+        offset = m_size + sizeof(*record);
+        m_size += sizeof(*record) + jpeg->size();
+        m_index.push_back(*record);
+        m_pending++;
+
+        m_io->Write(m_fd, {{record.get(), sizeof(*record)}, {const_cast<uint8_t*>(jpeg->data()), jpeg->size()}}, record_offset,
+                    [this, record, jpeg, record_offset](int result) { FrameWritten(record_offset, result); });
+
+        if(m_sync_frames != 0 && ++m_unsynced_frames >= m_sync_frames)
+        {
+            std::string path = m_path;
+            m_io->Sync(m_fd, [path](int result)
+            {
+                if(result < 0)
+                {
+                    LOG(LOG_WARNING,"fdatasync(%s) failed: %s\n", path.c_str(), strerror(-result));
+                }
+            });
+            m_unsynced_frames = 0;
+        }
+
+        ret_val = 0;
+    }
+
+    return ret_val;
+}
+
+void FrameContainerWriter::FrameWritten(uint64_t record_offset, int result)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(result < 0)
+    {
+        LOG(LOG_ERR,"FrameContainerWriter couldn't write a frame to %s: %s\n", m_path.c_str(), strerror(-result));
+
+        /* Left as a hole, where walking the records stops */
+        m_index.erase(std::remove_if(m_index.begin(), m_index.end(), [record_offset](const FrameContainerRecord& record)
+        {
+            return record.offset == record_offset;
+        }), m_index.end());
+        m_io_error = true;
+    }
+
+    m_pending--;
+    m_pending_condition.notify_all();
+}
+
+int FrameContainerWriter::CloseAsync(std::unique_lock<std::mutex>& lock)
+{
+    FrameContainerFooter footer;
+    std::promise<int> closed;
+    std::future<int> future = closed.get_future();
+    auto result = std::make_shared<int>(0);
+
+    /* The index only has the frames that made it to the file */
+    m_pending_condition.wait(lock, [this] { return m_pending == 0; });
+
+    footer = {m_size, static_cast<uint32_t>(m_index.size()), FRAME_CONTAINER_INDEX_MAGIC};
+    m_io->Write(m_fd, {{m_index.data(), m_index.size() * sizeof(FrameContainerRecord)}, {&footer, sizeof(footer)}}, m_size,
+                [result](int written) { if(written < 0) { *result = written; } });
+    m_io->Sync(m_fd, [result](int synced) { if(synced < 0 && *result == 0) { *result = synced; } });
+    m_io->Close(m_fd, [result, &closed](int) { closed.set_value(*result); });
+    m_fd = -1;
+
+    int ret_val = future.get();
+    if(ret_val < 0)
+    {
+        LOG(LOG_ERR,"FrameContainerWriter couldn't write the index of %s: %s\n", m_path.c_str(), strerror(-ret_val));
+    }
+
+    return (ret_val < 0 || m_io_error) ? -1 : 0;
+}
+
+int FrameContainerWriter::Close()
+{
+    int ret_val = -1;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if(m_io && m_fd >= 0)
+    {
+        return CloseAsync(lock);
+    }
+
+
+    /* Ending the file, past what is left of a failed frame */
+    size_t index_size = m_index.size() * sizeof(FrameContainerRecord);
+    uint64_t index_offset = std::max(m_size, m_end - std::min<uint64_t>(m_end, index_size + sizeof(FrameContainerFooter)));
+    FrameContainerFooter footer = {index_offset, static_cast<uint32_t>(m_index.size()), FRAME_CONTAINER_INDEX_MAGIC};
+    iovec iov[2] = {{m_index.data(), index_size}, {&footer, sizeof(footer)}};
+
+    if(m_fd < 0)
+    {
+        LOG(LOG_WARNING,"FrameContainerWriter %s already closed\n", m_path.c_str());
+    }
+    else
+    {
+        if(0 != WriteAll(m_fd, iov, 2, index_size + sizeof(footer), index_offset))
+        {
+            LOG(LOG_ERR,"FrameContainerWriter couldn't write the index of %s: %s\n", m_path.c_str(), strerror(errno));
+        }
+        else if(0 != fdatasync(m_fd))
+        {
+            LOG(LOG_ERR,"fdatasync(%s) failed: %s\n", m_path.c_str(), strerror(errno));
+        }
+        else
+        {
+            ret_val = 0;
+        }
+
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    return ret_val;
+}
+
+const std::string& FrameContainerWriter::GetPath()
+{
+    return m_path;
+}
+
+FrameContainerReader::FrameContainerReader(const std::string& path) :
+    m_memory(nullptr),
+    m_memory_size(0),
+    m_date(0),
+    m_complete(false)
+{
+    int fd;
+    struct stat file_stat;
+    FrameContainerHeader header;
+
+    if(0 > (fd = open(path.c_str(), O_RDONLY | O_CLOEXEC)))
+    {
+        LOG(LOG_ERR,"open(%s) failed: %s\n", path.c_str(), strerror(errno));
+        throw std::exception();
+    }
+    else if(0 != fstat(fd, &file_stat) || static_cast<size_t>(file_stat.st_size) < sizeof(header))
+    {
+        LOG(LOG_ERR,"FrameContainerReader: %s is not a container\n", path.c_str());
+        close(fd);
+        throw std::exception();
+    }
+
+    m_memory_size = file_stat.st_size;
+    m_memory = static_cast<uint8_t*>(mmap(nullptr, m_memory_size, PROT_READ, MAP_SHARED, fd, 0));
+    close(fd);
+    if(m_memory == MAP_FAILED)
+    {
+        LOG(LOG_ERR,"mmap(%s) failed: %s\n", path.c_str(), strerror(errno));
+        throw std::exception();
+    }
+
+    memcpy(&header, m_memory, sizeof(header));
+    if(header.magic != FRAME_CONTAINER_MAGIC || header.version != FRAME_CONTAINER_VERSION)
+    {
+        LOG(LOG_ERR,"FrameContainerReader: %s is not a container\n", path.c_str());
+        munmap(m_memory, m_memory_size);
+        throw std::exception();
+    }
+    m_date = static_cast<time_t>(header.date);
+
+    if(0 == LoadIndex())
+    {
+        m_complete = true;
+    }
+    else
+    {
+        LOG(LOG_NOTICE,"Container %s without index, walking its records\n", path.c_str());
+        ScanRecords();
+    }
+
+    /* Appended as their JPEGs got ready, not always in order */
+    std::stable_sort(m_index.begin(), m_index.end(), [](const FrameContainerRecord& lhs, const FrameContainerRecord& rhs)
+    {
+        return lhs.frame_num < rhs.frame_num;
+    });
+}
+
+FrameContainerReader::~FrameContainerReader()
+{
+    munmap(m_memory, m_memory_size);
+}
+
+time_t FrameContainerReader::GetDate()
+{
+    return m_date;
+}
+
+size_t FrameContainerReader::GetFrameCount()
+{
+    return m_index.size();
+}
+
+int FrameContainerReader::GetFrame(size_t index, ContainerFrame& frame)
+{
+    int ret_val = -1;
+
+    if(index < m_index.size())
+    {
+        const FrameContainerRecord& record = m_index[index];
+
+        frame.frame_num = record.frame_num;
+        frame.timestamp = record.timestamp;
+        frame.data = m_memory + record.offset + sizeof(FrameContainerRecord);
+        frame.size = record.size;
+        ret_val = 0;
+    }
+
+    return ret_val;
+}
+
+bool FrameContainerReader::IsComplete()
+{
+    return m_complete;
+}
+
+int FrameContainerReader::LoadIndex()
+{
+    FrameContainerFooter footer;
+
+    if(m_memory_size < sizeof(FrameContainerHeader) + sizeof(footer))
+    {
+        return -1;
+    }
+
+    memcpy(&footer, m_memory + m_memory_size - sizeof(footer), sizeof(footer));
+    if(footer.magic != FRAME_CONTAINER_INDEX_MAGIC ||
+       footer.index_offset + footer.frame_count * sizeof(FrameContainerRecord) + sizeof(footer) != m_memory_size)
+    {
+        return -1;
+    }
+
+    m_index.resize(footer.frame_count);
+    memcpy(m_index.data(), m_memory + footer.index_offset, footer.frame_count * sizeof(FrameContainerRecord));
+
+    for(const auto& record : m_index)
+    {
+        if(record.offset + sizeof(FrameContainerRecord) + record.size > footer.index_offset)
+        {
+            m_index.clear();
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void FrameContainerReader::ScanRecords()
+{
+    size_t offset = sizeof(FrameContainerHeader);
+    FrameContainerRecord record;
+
+    /* Up to the first record cut by the crash */
+    while(offset + sizeof(record) <= m_memory_size)
+    {
+        memcpy(&record, m_memory + offset, sizeof(record));
+        if(record.offset != offset || offset + sizeof(record) + record.size > m_memory_size)
+        {
+            break;
+        }
+
+        m_index.push_back(record);
+        offset += sizeof(record) + record.size;
+    }
+}
+
+/*******************************************************************
+ * Function definition
+ *******************************************************************/
+int ExportContainerToZip(FrameContainerReader& container, const std::string& zip_path)
+{
+    int ret_val = 0;
+    std::string temporary_path = zip_path + ".tmp";
+    std::vector<uint8_t> central_directory;
+    std::vector<uint8_t> header;
+    ContainerFrame frame;
+    uint32_t offset = 0;
+    uint16_t dos_date, dos_time;
+    FILE *file;
+
+    DosDateTime(container.GetDate(), dos_date, dos_time);
+
+    /* Written aside, the zip only appears complete */
+    if((file = fopen(temporary_path.c_str(), "wb")) == nullptr)
+    {
+        LOG(LOG_ERR,"fopen(%s) failed: %s\n", temporary_path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    /* JPEGs don't deflate, the entries are stored */
+    for(size_t i = 0; ret_val == 0 && 0 == container.GetFrame(i, frame); i++)
+    {
+        std::string name = "capture_" + std::to_string(frame.frame_num) + ".jpeg";
+        uint32_t crc = Crc32(frame.data, frame.size);
+
+        header.clear();
+        PutLe(header, ZIP_LOCAL_HEADER_SIGNATURE, 4);
+        PutLe(header, ZIP_VERSION, 2);
+        PutLe(header, 0, 2);                     /* Flags */
+        PutLe(header, 0, 2);                     /* Stored */
+        PutLe(header, dos_time, 2);
+        PutLe(header, dos_date, 2);
+        PutLe(header, crc, 4);
+        PutLe(header, frame.size, 4);
+        PutLe(header, frame.size, 4);
+        PutLe(header, name.size(), 2);
+        PutLe(header, 0, 2);                     /* Extra field */
+        header.insert(header.end(), name.begin(), name.end());
+
+        PutLe(central_directory, ZIP_CENTRAL_HEADER_SIGNATURE, 4);
+        PutLe(central_directory, ZIP_VERSION, 2); /* Made by */
+        PutLe(central_directory, ZIP_VERSION, 2); /* Needed */
+        PutLe(central_directory, 0, 2);
+        PutLe(central_directory, 0, 2);
+        PutLe(central_directory, dos_time, 2);
+        PutLe(central_directory, dos_date, 2);
+        PutLe(central_directory, crc, 4);
+        PutLe(central_directory, frame.size, 4);
+        PutLe(central_directory, frame.size, 4);
+        PutLe(central_directory, name.size(), 2);
+        PutLe(central_directory, 0, 2);           /* Extra field */
+        PutLe(central_directory, 0, 2);           /* Comment */
+        PutLe(central_directory, 0, 2);           /* Disk */
+        PutLe(central_directory, 0, 2);           /* Internal attributes */
+        PutLe(central_directory, 0, 4);           /* External attributes */
+        PutLe(central_directory, offset, 4);
+        central_directory.insert(central_directory.end(), name.begin(), name.end());
+
+        if(1 != fwrite(header.data(), header.size(), 1, file) || 1 != fwrite(frame.data, frame.size, 1, file))
+        {
+            ret_val = -1;
+        }
+        offset += header.size() + frame.size;
+    }
+
+    header.clear();
+    PutLe(header, ZIP_END_SIGNATURE, 4);
+    PutLe(header, 0, 2);
+    PutLe(header, 0, 2);
+    PutLe(header, container.GetFrameCount(), 2);
+    PutLe(header, container.GetFrameCount(), 2);
+    PutLe(header, central_directory.size(), 4);
+    PutLe(header, offset, 4);
+    PutLe(header, 0, 2);
+
+    if(ret_val != 0 ||
+       (!central_directory.empty() && 1 != fwrite(central_directory.data(), central_directory.size(), 1, file)) ||
+       1 != fwrite(header.data(), header.size(), 1, file))
+    {
+        ret_val = -1;
+    }
+
+    if(0 != fclose(file) || ret_val != 0 || 0 != rename(temporary_path.c_str(), zip_path.c_str()))
+    {
+        LOG(LOG_ERR,"Couldn't write %s: %s\n", zip_path.c_str(), strerror(errno));
+        unlink(temporary_path.c_str());
+        ret_val = -1;
+    }
+
+    return ret_val;
+}
+
+int ExportContainerToMp4(FrameContainerReader& container, const std::string& mp4_path, uint32_t frame_interval_ms)
+{
+    int ret_val = 0;
+    ContainerFrame frame;
+    /* As a fraction, a frame every 1.5 s is 2/3 fps */
+    std::string command = "ffmpeg -loglevel error -y -f image2pipe -c:v mjpeg -framerate 1000/" + std::to_string(std::max(frame_interval_ms, 1U)) +
+                          " -i - -pix_fmt yuv420p '" + mp4_path + "'";
+    FILE *pipe;
+
+    /* The JPEGs are piped from the mapping, no file per frame */
+    if((pipe = popen(command.c_str(), "w")) == nullptr)
+    {
+        LOG(LOG_ERR,"popen(ffmpeg) failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for(size_t i = 0; ret_val == 0 && 0 == container.GetFrame(i, frame); i++)
+    {
+        if(1 != fwrite(frame.data, frame.size, 1, pipe))
+        {
+            ret_val = -1;
+        }
+    }
+
+    if(0 != pclose(pipe) || ret_val != 0)
+    {
+        LOG(LOG_ERR,"ffmpeg couldn't encode %s\n", mp4_path.c_str());
+        ret_val = -1;
+    }
+
+    return ret_val;
+}
@@ -0,0 +1,93 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file jpeg_cache.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <algorithm>
+
+#include "jpeg_cache.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+JpegCache::JpegCache(size_t capacity) :
+    m_capacity(std::max<size_t>(capacity, 1)),
+    m_stats{0, 0}
+{
+}
+
+std::shared_ptr<const EncodedFrame> JpegCache::Encode(KinectVideoFrame& frame, int32_t brightness, int32_t contrast)
+{
+    uint32_t timestamp = frame.GetTimestamp();
+    std::promise<std::shared_ptr<const EncodedFrame>> encoded;
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto entry = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& entry)
+    {
+        return entry.timestamp == timestamp && entry.brightness == brightness && entry.contrast == contrast;
+    });
+
+    if(entry != m_entries.end())
+    {
+        std::shared_future<std::shared_ptr<const EncodedFrame>> frame_future = entry->frame;
+        m_stats.reused++;
+
+        /* Encoded or being encoded by someone else */
+        lock.unlock();
+        return frame_future.get();
+    }
+
+    m_entries.push_back(Entry{timestamp, brightness, contrast, encoded.get_future().share()});
+    if(m_entries.size() > m_capacity)
+    {
+        m_entries.pop_front();
+    }
+    m_stats.encoded++;
+    lock.unlock();
+
+    auto result = std::make_shared<EncodedFrame>();
+    result->timestamp = timestamp;
+    result->brightness = brightness;
+    result->contrast = contrast;
+
+    if(0 != frame.SaveToJpegInMemory(result->jpeg, brightness, contrast))
+    {
+        LOG(LOG_ERR,"JpegCache couldn't encode frame %u\n", timestamp);
+        encoded.set_value(nullptr);
+        return nullptr;
+    }
+
+    result->encoded_time = std::chrono::steady_clock::now();
+    encoded.set_value(result);
+
+    lock.lock();
+    m_latest = result;
+
+    return result;
+}
+
+std::shared_ptr<const EncodedFrame> JpegCache::GetLatest(int32_t brightness, int32_t contrast, std::chrono::milliseconds max_age)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_latest != nullptr && m_latest->brightness == brightness && m_latest->contrast == contrast &&
+       std::chrono::steady_clock::now() - m_latest->encoded_time <= max_age)
+    {
+        return m_latest;
+    }
+
+    return nullptr;
+}
+
+JpegCacheStats JpegCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_stats;
+}
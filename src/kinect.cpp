@@ -9,6 +9,7 @@
  * Includes
  *******************************************************************/
 #include <chrono>
+#include <algorithm>
 
 #include "log.hpp"
 #include "kinect.hpp"
@@ -24,10 +25,15 @@ std::condition_variable Kinect::m_depth_cv, Kinect::m_video_cv;
 
 uint32_t Kinect::m_timeout_ms;
 
+uint64_t Kinect::m_depth_sequence, Kinect::m_video_sequence;
+std::mutex Kinect::m_observers_mutex;
+std::vector<std::shared_ptr<KinectFrameObserver>> Kinect::m_depth_observers, Kinect::m_video_observers;
+
 /*******************************************************************
  * Class definition
  *******************************************************************/
-Kinect::Kinect(uint32_t timeout_ms) : CyclicTask("Kinect", 0)
+Kinect::Kinect(uint32_t timeout_ms) :
+    CyclicTask("Kinect", 0, {CyclicTaskBackend::ConditionVariable, KINECT_TASK_RT_PRIORITY, KINECT_TASK_CPU_AFFINITY})
 {
     /* Members initialization */
     m_timeout_ms            = timeout_ms;
@@ -262,18 +268,74 @@ void Kinect::GetVideoFrame(KinectVideoFrame& frame)
     frame = *m_video_frame;
 }
 
+int Kinect::Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    int retval = -1;
+
+    if(observer == nullptr)
+    {
+        LOG(LOG_ERR,"Kinect::Subscribe() failed: observer null\n");
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_observers_mutex);
+        auto& observers = (frame_type == KinectFrameType::Depth) ? m_depth_observers : m_video_observers;
+        observers.push_back(observer);
+        retval = 0;
+    }
+
+    return retval;
+}
+
+int Kinect::Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    int retval = -1;
+    std::lock_guard<std::mutex> lock(m_observers_mutex);
+    auto& observers = (frame_type == KinectFrameType::Depth) ? m_depth_observers : m_video_observers;
+
+    auto it = std::find(observers.begin(), observers.end(), observer);
+    if(it != observers.end())
+    {
+        observers.erase(it);
+        retval = 0;
+    }
+
+    return retval;
+}
+
 void Kinect::DepthCallback(freenect_device* dev, void* data, uint32_t timestamp)
 {
-    std::unique_lock<std::mutex> ulock(m_depth_mutex);
-    m_depth_frame->Fill(static_cast<uint16_t*>(data), timestamp);
-    m_depth_cv.notify_all();
+    uint64_t sequence;
+    {
+        std::unique_lock<std::mutex> ulock(m_depth_mutex);
+        m_depth_frame->Fill(static_cast<uint16_t*>(data), timestamp);
+        sequence = ++m_depth_sequence;
+        m_depth_cv.notify_all();
+    }
+
+    /* The frame is only written from this thread, observers can read it without the frame lock */
+    std::lock_guard<std::mutex> lock(m_observers_mutex);
+    for(auto& observer : m_depth_observers)
+    {
+        observer->NewDepthFrame(*m_depth_frame, sequence);
+    }
 }
 
 void Kinect::VideoCallback(freenect_device* dev, void* data, uint32_t timestamp)
 {
-    std::unique_lock<std::mutex> ulock(m_video_mutex);
-    m_video_frame->Fill(static_cast<uint16_t*>(data), timestamp);
-    m_video_cv.notify_all();
+    uint64_t sequence;
+    {
+        std::unique_lock<std::mutex> ulock(m_video_mutex);
+        m_video_frame->Fill(static_cast<uint16_t*>(data), timestamp);
+        sequence = ++m_video_sequence;
+        m_video_cv.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(m_observers_mutex);
+    for(auto& observer : m_video_observers)
+    {
+        observer->NewVideoFrame(*m_video_frame, sequence);
+    }
 }
 
 int Kinect::ChangeTilt(double tilt_angle)
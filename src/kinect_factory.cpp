@@ -12,6 +12,7 @@
 
 #include "kinect_factory.hpp"
 #include "kinect.hpp"
+#include "global_parameters.hpp"
 
 /*******************************************************************
  * Class definition
@@ -19,5 +20,30 @@
 
 std::shared_ptr<IKinect> KinectFactory::Create(uint32_t timeout_ms)
 {
-    return std::make_shared<Kinect>(timeout_ms);
+    std::shared_ptr<IKinect> kinect;
+
+    if(!std::string(KINECT_REPLAY_PATH).empty())
+    {
+        kinect = CreateReplay(KINECT_REPLAY_PATH, {ReplayMode::RealTime, true}, timeout_ms);
+    }
+    else if(KINECT_SYNTHETIC)
+    {
+        kinect = CreateSynthetic(SyntheticSceneConfig(), timeout_ms);
+    }
+    else
+    {
+        kinect = std::make_shared<Kinect>(timeout_ms);
+    }
+
+    return kinect;
+}
+
+std::shared_ptr<IKinect> KinectFactory::CreateReplay(std::string recording_path, ReplayKinectConfig config, uint32_t timeout_ms)
+{
+    return std::make_shared<ReplayKinect>(recording_path, config, timeout_ms);
+}
+
+std::shared_ptr<IKinect> KinectFactory::CreateSynthetic(SyntheticSceneConfig config, uint32_t timeout_ms)
+{
+    return std::make_shared<SyntheticKinect>(config, timeout_ms);
 }
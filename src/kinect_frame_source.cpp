@@ -0,0 +1,142 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file kinect_frame_source.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <chrono>
+#include <algorithm>
+
+#include "kinect_frame_source.hpp"
+#include "global_parameters.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+KinectFrameSource::KinectFrameSource(uint32_t timeout_ms) :
+    m_timeout_ms(timeout_ms),
+    m_depth_sequence(0),
+    m_video_sequence(0)
+{
+    m_depth_frame = std::make_unique<KinectDepthFrame>(DEPTH_WIDTH, DEPTH_HEIGHT);
+    m_video_frame = std::make_unique<KinectVideoFrame>(VIDEO_WIDTH, VIDEO_HEIGHT);
+}
+
+void KinectFrameSource::Reset()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_depth_mutex);
+        m_depth_frame->SetTimestamp(0);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_video_mutex);
+        m_video_frame->SetTimestamp(0);
+    }
+}
+
+void KinectFrameSource::GetDepthFrame(KinectDepthFrame& frame)
+{
+    std::unique_lock<std::mutex> ulock(m_depth_mutex);
+
+    /* Compare the given timestamp with the current, if it's the same must wait to the next frame */
+    if(frame.GetTimestamp() == m_depth_frame->GetTimestamp())
+    {
+        if(m_depth_cv.wait_for(ulock, std::chrono::milliseconds(m_timeout_ms)) == std::cv_status::timeout)
+        {
+            LOG(LOG_WARNING,"GetDepthFrame() failed to acquire a frame in %u ms\n", m_timeout_ms);
+        }
+    }
+
+    frame = *m_depth_frame;
+}
+
+void KinectFrameSource::GetVideoFrame(KinectVideoFrame& frame)
+{
+    std::unique_lock<std::mutex> ulock(m_video_mutex);
+
+    /*  Compare the given timestamp with the current, if it's the same must wait to the next frame */
+    if(frame.GetTimestamp() == m_video_frame->GetTimestamp())
+    {
+        if(m_video_cv.wait_for(ulock, std::chrono::milliseconds(m_timeout_ms)) == std::cv_status::timeout)
+        {
+            LOG(LOG_WARNING,"GetVideoFrame() failed to acquire a frame in %u ms\n", m_timeout_ms);
+        }
+    }
+
+    frame = *m_video_frame;
+}
+
+int KinectFrameSource::Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    int retval = -1;
+
+    if(observer == nullptr)
+    {
+        LOG(LOG_ERR,"KinectFrameSource::Subscribe() failed: observer null\n");
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_observers_mutex);
+        auto& observers = (frame_type == KinectFrameType::Depth) ? m_depth_observers : m_video_observers;
+        observers.push_back(observer);
+        retval = 0;
+    }
+
+    return retval;
+}
+
+int KinectFrameSource::Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    int retval = -1;
+    std::lock_guard<std::mutex> lock(m_observers_mutex);
+    auto& observers = (frame_type == KinectFrameType::Depth) ? m_depth_observers : m_video_observers;
+
+    auto it = std::find(observers.begin(), observers.end(), observer);
+    if(it != observers.end())
+    {
+        observers.erase(it);
+        retval = 0;
+    }
+
+    return retval;
+}
+
+void KinectFrameSource::DeliverDepthFrame(const uint16_t* data, uint32_t timestamp)
+{
+    uint64_t sequence;
+    {
+        std::unique_lock<std::mutex> ulock(m_depth_mutex);
+        m_depth_frame->Fill(data, timestamp);
+        sequence = ++m_depth_sequence;
+        m_depth_cv.notify_all();
+    }
+
+    /* The frame is only written from the delivering thread, observers can read it without the frame lock */
+    std::lock_guard<std::mutex> lock(m_observers_mutex);
+    for(auto& observer : m_depth_observers)
+    {
+        observer->NewDepthFrame(*m_depth_frame, sequence);
+    }
+}
+
+void KinectFrameSource::DeliverVideoFrame(const uint16_t* data, uint32_t timestamp)
+{
+    uint64_t sequence;
+    {
+        std::unique_lock<std::mutex> ulock(m_video_mutex);
+        m_video_frame->Fill(data, timestamp);
+        sequence = ++m_video_sequence;
+        m_video_cv.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(m_observers_mutex);
+    for(auto& observer : m_video_observers)
+    {
+        observer->NewVideoFrame(*m_video_frame, sequence);
+    }
+}
@@ -0,0 +1,243 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file kinect_recording.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include "kinect_recording.hpp"
+#include "global_parameters.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+KinectRecorder::KinectRecorder(std::shared_ptr<IKinect> kinect) :
+    m_kinect(kinect),
+    m_file(nullptr),
+    m_file_end(0),
+    m_num_frames(0),
+    m_dropped_frames(0)
+{
+    m_observer = std::make_shared<KinectRecorderObserver>(*this);
+}
+
+KinectRecorder::~KinectRecorder()
+{
+    if(IsRecording())
+    {
+        Stop();
+    }
+}
+
+int KinectRecorder::Start(const std::string& recording_path)
+{
+    int retval = -1;
+    FILE* file = nullptr;
+    KinectRecordingHeader header = {};
+
+    memcpy(header.magic, KINECT_RECORDING_MAGIC, sizeof(header.magic));
+    header.version      = KINECT_RECORDING_VERSION;
+    header.depth_width  = DEPTH_WIDTH;
+    header.depth_height = DEPTH_HEIGHT;
+    header.video_width  = VIDEO_WIDTH;
+    header.video_height = VIDEO_HEIGHT;
+
+    if(IsRecording())
+    {
+        LOG(LOG_ERR,"KinectRecorder is already recording\n");
+    }
+    else if(nullptr == (file = fopen(recording_path.c_str(), "wb")))
+    {
+        LOG(LOG_ERR,"KinectRecorder couldn't open %s: %s\n", recording_path.c_str(), strerror(errno));
+    }
+    else if(1 != fwrite(&header, sizeof(header), 1, file))
+    {
+        LOG(LOG_ERR,"KinectRecorder couldn't write the header: %s\n", strerror(errno));
+        fclose(file);
+    }
+    else
+    {
+        /* Published with the header written, before any frame is queued */
+        {
+            std::lock_guard<std::mutex> lock(m_file_mutex);
+            m_file       = file;
+            m_path       = recording_path;
+            m_file_end   = sizeof(header);
+            m_num_frames = 0;
+            m_start_time = std::chrono::steady_clock::now();
+        }
+        m_dropped_frames = 0;
+
+        /* One more frame than the queue holds, the one being written */
+        m_depth_pool  = std::make_unique<ObjectPool<KinectDepthFrame>>(KINECT_RECORDING_QUEUE_FRAMES + 1, []
+        {
+            return std::make_unique<KinectDepthFrame>(DEPTH_WIDTH, DEPTH_HEIGHT);
+        });
+        m_video_pool  = std::make_unique<ObjectPool<KinectVideoFrame>>(KINECT_RECORDING_QUEUE_FRAMES + 1, []
+        {
+            return std::make_unique<KinectVideoFrame>(VIDEO_WIDTH, VIDEO_HEIGHT);
+        });
+        m_write_stage = std::make_unique<PipelineStage<RecordedFrame>>("Recorder", 2, KINECT_RECORDING_QUEUE_FRAMES, CyclicTaskConfig(),
+                                                                       [this](RecordedFrame& recorded_frame) { WriteFrame(recorded_frame); });
+
+        if(0 != m_kinect->Subscribe(KinectFrameType::Depth, m_observer))
+        {
+            LOG(LOG_ERR,"KinectRecorder couldn't subscribe to depth frames\n");
+        }
+        else if(0 != m_kinect->Subscribe(KinectFrameType::Video, m_observer))
+        {
+            LOG(LOG_ERR,"KinectRecorder couldn't subscribe to video frames\n");
+            m_kinect->Unsubscribe(KinectFrameType::Depth, m_observer);
+        }
+        else
+        {
+            LOG(LOG_INFO,"KinectRecorder recording to %s\n", recording_path.c_str());
+            retval = 0;
+        }
+
+        if(retval != 0)
+        {
+            m_write_stage.reset();
+            std::lock_guard<std::mutex> lock(m_file_mutex);
+            fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+    return retval;
+}
+
+int KinectRecorder::Stop()
+{
+    int retval = 0;
+
+    /* Unsubscribe first so no frame is queued, then the ones queued are written */
+    m_kinect->Unsubscribe(KinectFrameType::Depth, m_observer);
+    m_kinect->Unsubscribe(KinectFrameType::Video, m_observer);
+    if(m_write_stage != nullptr)
+    {
+        m_dropped_frames += m_write_stage->GetStats().dropped;
+        m_write_stage.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+
+    if(m_file == nullptr)
+    {
+        LOG(LOG_INFO,"KinectRecorder is already stopped\n");
+    }
+    else
+    {
+        if(0 != fclose(m_file))
+        {
+            LOG(LOG_ERR,"KinectRecorder couldn't close the recording: %s\n", strerror(errno));
+            retval = -1;
+        }
+        else
+        {
+            LOG(LOG_INFO,"KinectRecorder stopped, %llu frames recorded, %llu dropped\n", static_cast<unsigned long long>(m_num_frames),
+                static_cast<unsigned long long>(m_dropped_frames.load()));
+        }
+        m_file = nullptr;
+    }
+
+    return retval;
+}
+
+bool KinectRecorder::IsRecording()
+{
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+    return m_file != nullptr;
+}
+
+uint64_t KinectRecorder::GetNumberOfFrames()
+{
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+    return m_num_frames;
+}
+
+uint64_t KinectRecorder::GetDroppedFrames()
+{
+    uint64_t dropped_frames = m_dropped_frames;
+
+    if(m_write_stage != nullptr)
+    {
+        dropped_frames += m_write_stage->GetStats().dropped;
+    }
+
+    return dropped_frames;
+}
+
+void KinectRecorder::QueueFrame(KinectFrameType frame_type, const KinectFrame& frame, std::shared_ptr<KinectFrame> pooled_frame)
+{
+    size_t input = static_cast<size_t>(frame_type);
+
+    if(pooled_frame == nullptr)
+    {
+        m_write_stage->Dropped(input);
+    }
+    else
+    {
+        /* Timed on capture, not when written */
+        *pooled_frame = frame;
+        m_write_stage->Push(input, RecordedFrame{frame_type, std::move(pooled_frame),
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start_time).count())});
+    }
+}
+
+void KinectRecorder::WriteFrame(RecordedFrame& recorded_frame)
+{
+    KinectRecordingFrameHeader frame_header = {};
+    size_t pixels = (recorded_frame.frame_type == KinectFrameType::Depth) ? (DEPTH_WIDTH * DEPTH_HEIGHT) : (VIDEO_WIDTH * VIDEO_HEIGHT);
+
+    frame_header.frame_type      = static_cast<uint8_t>(recorded_frame.frame_type);
+    frame_header.timestamp       = recorded_frame.frame->GetTimestamp();
+    frame_header.capture_time_us = recorded_frame.capture_time_us;
+
+    std::lock_guard<std::mutex> lock(m_file_mutex);
+
+    if(m_file == nullptr)
+    {
+        /* Stopped by a frame that couldn't be written */
+    }
+    else if((1 != fwrite(&frame_header, sizeof(frame_header), 1, m_file)) ||
+            (pixels != fwrite(recorded_frame.frame->GetDataPointer(), sizeof(uint16_t), pixels, m_file)))
+    {
+        /* The recording ends with the last complete frame, a replay would reject a partial one */
+        LOG(LOG_ERR,"KinectRecorder couldn't write a frame, recording stopped: %s\n", strerror(errno));
+        fclose(m_file);
+        m_file = nullptr;
+        if(0 != truncate(m_path.c_str(), m_file_end))
+        {
+            LOG(LOG_ERR,"KinectRecorder couldn't remove the partial frame: %s\n", strerror(errno));
+        }
+    }
+    else
+    {
+        m_file_end += sizeof(frame_header) + pixels * sizeof(uint16_t);
+        m_num_frames++;
+    }
+}
+
+KinectRecorderObserver::KinectRecorderObserver(KinectRecorder& recorder) :
+    m_recorder(recorder)
+{
+}
+
+void KinectRecorderObserver::NewDepthFrame(const KinectDepthFrame& frame, uint64_t sequence)
+{
+    m_recorder.QueueFrame(KinectFrameType::Depth, frame, m_recorder.m_depth_pool->Acquire());
+}
+
+void KinectRecorderObserver::NewVideoFrame(const KinectVideoFrame& frame, uint64_t sequence)
+{
+    m_recorder.QueueFrame(KinectFrameType::Video, frame, m_recorder.m_video_pool->Acquire());
+}
@@ -0,0 +1,259 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file liveview_shm.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <exception>
+#include <chrono>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "liveview_shm.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Static functions
+ *******************************************************************/
+
+/* Header and slots start on their own cache line */
+static size_t CacheLineAlign(size_t size)
+{
+    return (size + 63) & ~static_cast<size_t>(63);
+}
+
+static size_t SlotStride(uint32_t slot_size)
+{
+    return CacheLineAlign(sizeof(LiveviewShmSlot) + slot_size);
+}
+
+static size_t MemorySize(uint32_t slot_count, uint32_t slot_size)
+{
+    return CacheLineAlign(sizeof(LiveviewShmHeader)) + slot_count * SlotStride(slot_size);
+}
+
+static size_t SlotOffset(uint32_t frame, uint32_t slot_count, uint32_t slot_size)
+{
+    return CacheLineAlign(sizeof(LiveviewShmHeader)) + (frame % slot_count) * SlotStride(slot_size);
+}
+
+/* Not private: the readers are other processes */
+static long Futex(const std::atomic<uint32_t> *word, int operation, uint32_t value, const timespec *timeout)
+{
+    return syscall(SYS_futex, word, operation, value, timeout, nullptr, 0);
+}
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+LiveviewShmWriter::LiveviewShmWriter(const std::string& name, uint32_t slot_count, uint32_t slot_size) :
+    m_name(name),
+    m_memory(nullptr),
+    m_memory_size(MemorySize(slot_count, slot_size)),
+    m_header(nullptr)
+{
+    int fd = -1;
+
+    if(slot_count == 0)
+    {
+        LOG(LOG_ERR,"LiveviewShmWriter() failed: no slots\n");
+        throw std::exception();
+    }
+    else if((fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644)) < 0)
+    {
+        LOG(LOG_ERR,"shm_open(%s) failed: %s\n", name.c_str(), strerror(errno));
+        throw std::exception();
+    }
+    else if(0 != ftruncate(fd, m_memory_size))
+    {
+        LOG(LOG_ERR,"ftruncate(%s) failed: %s\n", name.c_str(), strerror(errno));
+        close(fd);
+        throw std::exception();
+    }
+
+    void *memory = mmap(nullptr, m_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED)
+    {
+        LOG(LOG_ERR,"mmap(%s) failed: %s\n", name.c_str(), strerror(errno));
+        throw std::exception();
+    }
+
+    m_memory = reinterpret_cast<uint8_t*>(memory);
+    m_header = reinterpret_cast<LiveviewShmHeader*>(m_memory);
+
+    /* Left by a previous run with the same geometry: keep numbering, the readers don't notice the restart */
+    if(m_header->magic != LIVEVIEW_SHM_MAGIC || m_header->version != LIVEVIEW_SHM_VERSION ||
+       m_header->slot_count != slot_count || m_header->slot_size != slot_size)
+    {
+        m_header->magic = 0;
+        m_header->version = LIVEVIEW_SHM_VERSION;
+        m_header->slot_count = slot_count;
+        m_header->slot_size = slot_size;
+        m_header->last_frame.store(0, std::memory_order_relaxed);
+        for(uint32_t i = 0; i < slot_count; i++)
+        {
+            reinterpret_cast<LiveviewShmSlot*>(m_memory + SlotOffset(i, slot_count, slot_size))->frame.store(0, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic = LIVEVIEW_SHM_MAGIC;
+    }
+}
+
+LiveviewShmWriter::~LiveviewShmWriter()
+{
+    /* The object is kept, the readers can stay mapped while the alarm restarts */
+    munmap(m_memory, m_memory_size);
+}
+
+uint32_t LiveviewShmWriter::Write(const uint8_t* data, size_t size)
+{
+    uint32_t frame = 0;
+    timespec now;
+
+    if(size > m_header->slot_size)
+    {
+        LOG(LOG_ERR,"Liveview frame of %zu bytes doesn't fit in a %u bytes slot\n", size, m_header->slot_size);
+    }
+    else
+    {
+        frame = m_header->last_frame.load(std::memory_order_relaxed) + 1;
+        if(frame == 0)
+        {
+            frame = 1;
+        }
+
+        auto slot = reinterpret_cast<LiveviewShmSlot*>(m_memory + SlotOffset(frame, m_header->slot_count, m_header->slot_size));
+
+        /* Seqlock: a reader that sees the same frame number before and after using the data didn't race */
+        slot->frame.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        slot->size = size;
+        slot->timestamp_us = static_cast<uint64_t>(now.tv_sec) * 1000000U + now.tv_nsec / 1000U;
+        memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(LiveviewShmSlot), data, size);
+
+        slot->frame.store(frame, std::memory_order_release);
+        m_header->last_frame.store(frame, std::memory_order_release);
+
+        Futex(&m_header->last_frame, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+    return frame;
+}
+
+LiveviewShmReader::LiveviewShmReader(const std::string& name) :
+    m_memory(nullptr),
+    m_memory_size(0),
+    m_header(nullptr)
+{
+    struct stat shm_stat;
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+    if(fd < 0)
+    {
+        throw std::exception();
+    }
+    else if(0 != fstat(fd, &shm_stat) || static_cast<size_t>(shm_stat.st_size) < sizeof(LiveviewShmHeader))
+    {
+        close(fd);
+        throw std::exception();
+    }
+
+    m_memory_size = shm_stat.st_size;
+    void *memory = mmap(nullptr, m_memory_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED)
+    {
+        throw std::exception();
+    }
+
+    m_memory = reinterpret_cast<const uint8_t*>(memory);
+    m_header = reinterpret_cast<const LiveviewShmHeader*>(m_memory);
+
+    if(m_header->magic != LIVEVIEW_SHM_MAGIC || m_header->version != LIVEVIEW_SHM_VERSION ||
+       m_header->slot_count == 0 || MemorySize(m_header->slot_count, m_header->slot_size) != m_memory_size)
+    {
+        munmap(const_cast<uint8_t*>(m_memory), m_memory_size);
+        throw std::exception();
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+LiveviewShmReader::~LiveviewShmReader()
+{
+    munmap(const_cast<uint8_t*>(m_memory), m_memory_size);
+}
+
+uint32_t LiveviewShmReader::WaitFrame(uint32_t last_frame, uint32_t timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    uint32_t frame;
+
+    while(((frame = m_header->last_frame.load(std::memory_order_acquire)) == last_frame || frame == 0))
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+        if(remaining.count() <= 0)
+        {
+            frame = 0;
+            break;
+        }
+
+        timespec timeout = {static_cast<time_t>(remaining.count() / 1000000000),
+                            static_cast<long>(remaining.count() % 1000000000)};
+
+        /* Returns straight away if a frame was written since the load */
+        Futex(&m_header->last_frame, FUTEX_WAIT, frame, &timeout);
+    }
+
+    return frame;
+}
+
+int LiveviewShmReader::GetFrame(uint32_t& frame, const uint8_t*& data, size_t& size)
+{
+    int retval = -1;
+
+    /* If its slot is already being rewritten the newer frame is taken */
+    for(uint32_t attempt = 0; attempt < m_header->slot_count && retval != 0; attempt++)
+    {
+        frame = m_header->last_frame.load(std::memory_order_acquire);
+        if(frame == 0)
+        {
+            break;
+        }
+
+        const LiveviewShmSlot *slot = GetSlot(frame);
+        if(slot->frame.load(std::memory_order_acquire) == frame)
+        {
+            data = reinterpret_cast<const uint8_t*>(slot) + sizeof(LiveviewShmSlot);
+            size = slot->size;
+            retval = (size <= m_header->slot_size) ? 0 : -1;
+        }
+    }
+
+    return retval;
+}
+
+bool LiveviewShmReader::IsValid(uint32_t frame)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return GetSlot(frame)->frame.load(std::memory_order_relaxed) == frame;
+}
+
+const LiveviewShmSlot* LiveviewShmReader::GetSlot(uint32_t frame)
+{
+    return reinterpret_cast<const LiveviewShmSlot*>(m_memory + SlotOffset(frame, m_header->slot_count, m_header->slot_size));
+}
@@ -23,6 +23,7 @@
 #include "common.hpp"
 #include "message_broker_factory.hpp"
 #include "state_persistence_factory.hpp"
+#include "threadpool.hpp"
 
 /*******************************************************************
  * Global variables
@@ -37,7 +38,8 @@ enum class Target
     Brightness,
     Contrast,
     Threshold,
-    Sensitivity
+    Sensitivity,
+    Recording
 };
 
 enum class Action
@@ -45,7 +47,9 @@ enum class Action
     Start,
     Stop,
     Reset,
-    Delete
+    Delete,
+    List,
+    Export
 };
 
 const std::map<std::string, Target> parameter_map
@@ -57,6 +61,7 @@ const std::map<std::string, Target> parameter_map
     {"contrast",    Target::Contrast},
     {"threshold",   Target::Threshold},
     {"sensitivity", Target::Sensitivity},
+    {"rec",         Target::Recording},
 };
 
 const std::map<std::string, Action> action_map
@@ -65,6 +70,8 @@ const std::map<std::string, Action> action_map
     {"stop",  Action::Stop},
     {"rst",   Action::Reset},
     {"del",   Action::Delete},
+    {"list",  Action::List},
+    {"export", Action::Export},
 };
 
 /*******************************************************************
@@ -83,19 +90,33 @@ private:
     void ExecutionCycle() override;
 
     std::shared_ptr<IMessageBroker> m_message_broker;
-    std::shared_ptr<IChannelMessageObserver> m_message_observer;
+    std::shared_ptr<MessageListener> m_message_observer;
     std::shared_ptr<IDatabase> m_data_base;
     std::shared_ptr<Alarm> m_alarm;
+    /* The commands wait for the persistence and Redis, never on the broker's event loop thread. Destroyed before the alarm */
+    ThreadPool<1> m_command_thread;
+    const Variable m_watchdog_variable{"kinectalarm_watchdog", DataType::Integer, 1};
+};
+
+class CommandTask : public Task
+{
+public:
+    CommandTask(MessageListener& listener, std::string_view message);
+    void operator() () override;
+private:
+    MessageListener& m_listener;
+    std::string m_message;
 };
 
 class MessageListener : public IChannelMessageObserver
 {
 public:
     MessageListener(Main& main);
-    void ChannelMessageListener(const std::string& message) override;
+    void ChannelMessageListener(std::string_view message) override;
+    void ExecuteCommand(const std::string& message);
 private:
     Main& m_main;
-    void ParseCommandWords(const std::string& message, std::vector<std::string>& command_words);
+    void ParseCommandWords(std::string_view message, std::vector<std::string>& command_words);
 };
 
 /*******************************************************************
@@ -177,6 +198,13 @@ int Main::Term()
         }
     }
 
+    /* The commands already received are executed before the alarm goes, the task goes behind them */
+    std::shared_ptr<Task> commands_done = std::make_shared<CommandTask>(*m_message_observer, "");
+    if(0 == m_command_thread.QueueTask(commands_done))
+    {
+        commands_done->Join();
+    }
+
     /* Alarm class term */
     if(m_alarm != nullptr)
     {
@@ -200,7 +228,7 @@ int Main::Term()
 
 void Main::ExecutionCycle()
 {
-    m_message_broker->SetVariableExpiration({"kinectalarm_watchdog",  DataType::Integer, 1}, WATCHDOG_TIMEOUT_S);
+    m_message_broker->SetVariableExpiration(m_watchdog_variable, WATCHDOG_TIMEOUT_S);
 }
 
 void signalHandler(int signal)
@@ -231,6 +259,11 @@ int main(int argc, char** argv)
     /* Set up syslog */
     openlog("kinectalarm", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
 
+    if(std::string(LOG_FILE_PATH).size() > 0 && 0 != Logger::Instance().SetSink(LogSink::File, LOG_FILE_PATH))
+    {
+        LOG(LOG_WARNING, "Couldn't open the log file %s\n", LOG_FILE_PATH);
+    }
+
     try
     {
         Main _main;
@@ -258,7 +291,7 @@ MessageListener::MessageListener(Main& _main) :
 {
 }
 
-void MessageListener::ParseCommandWords(const std::string& message, std::vector<std::string>& command_words)
+void MessageListener::ParseCommandWords(std::string_view message, std::vector<std::string>& command_words)
 {
     std::string command(message);
 
@@ -287,9 +320,29 @@ void MessageListener::ParseCommandWords(const std::string& message, std::vector<
     command_words = words;
 }
 
-void MessageListener::ChannelMessageListener(const std::string& message)
+CommandTask::CommandTask(MessageListener& listener, std::string_view message) :
+    Task("Command"),
+    m_listener(listener),
+    m_message(message)
+{
+}
+
+void CommandTask::operator() ()
+{
+    if(!m_message.empty())
+    {
+        m_listener.ExecuteCommand(m_message);
+    }
+}
+
+void MessageListener::ChannelMessageListener(std::string_view message)
 {
+    /* Copied, the message only lives during the call */
+    m_main.m_command_thread.QueueTask(std::make_shared<CommandTask>(*this, message));
+}
 
+void MessageListener::ExecuteCommand(const std::string& message)
+{
     std::vector<std::string> command_words;
     Target parameter = Target::Detection;
     Action action = Action::Start;
@@ -319,6 +372,18 @@ void MessageListener::ChannelMessageListener(const std::string& message)
                         value = std::stoi(command_words.at(2));;
                         m_main.m_alarm->DeleteDetection(value);
                         break;
+                    case Action::List:
+                        /* det list {from_date} {to_date} {count} [{before_date} {before_id}] */
+                        m_main.m_alarm->ListDetections(std::stoi(command_words.at(2)),
+                                                       std::stoi(command_words.at(3)),
+                                                       std::stoi(command_words.at(4)),
+                                                       (command_words.size() > 6) ? std::stoi(command_words.at(5)) : -1,
+                                                       (command_words.size() > 6) ? std::stoi(command_words.at(6)) : -1);
+                        break;
+                    case Action::Export:
+                        /* det export {id} {zip|mp4} */
+                        m_main.m_alarm->ExportDetection(std::stoi(command_words.at(2)), command_words.at(3));
+                        break;
                     default:
                         break;
                 }
@@ -337,6 +402,20 @@ void MessageListener::ChannelMessageListener(const std::string& message)
                         break;
                 }
                 break;
+            case Target::Recording:
+                action = action_map.at(command_words.at(1));
+                switch(action)
+                {
+                    case Action::Start:
+                        m_main.m_alarm->StartRecording();
+                        break;
+                    case Action::Stop:
+                        m_main.m_alarm->StopRecording();
+                        break;
+                    default:
+                        break;
+                }
+                break;
             case Target::Tilt:
                 value = std::stoi(command_words.at(1));
                 m_main.m_alarm->ChangeTilt(value);
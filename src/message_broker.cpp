@@ -10,6 +10,7 @@
  *******************************************************************/
 #include <memory>
 #include <algorithm>
+#include <future>
 #include <event2/thread.h>
 #include <signal.h>
 
@@ -57,8 +58,8 @@ static void OnMessage(redisAsyncContext *redis_context, void *replay, void *data
             if(reply->element[1]->type == REDIS_REPLY_STRING &&
                reply->element[2]->type == REDIS_REPLY_STRING)
             {
-                std::string channel(reply->element[1]->str);
-                std::string messsage(reply->element[2]->str);
+                std::string_view channel(reply->element[1]->str, reply->element[1]->len);
+                std::string_view messsage(reply->element[2]->str, reply->element[2]->len);
                 if(0 != message_broker->CallObservers(channel, messsage))
                 {
                     LOG(LOG_ERR, "Failed to call observers\n");
@@ -72,30 +73,51 @@ static void OnMessage(redisAsyncContext *redis_context, void *replay, void *data
     }
 }
 
-/*******************************************************************
- * Class definition
- *******************************************************************/
-MessageBroker::MessageBroker(const std::string path)
+static bool IsErrorReply(const redisReply* reply)
 {
-    /* Init sync context*/
-    m_context = redisConnectUnix(path.c_str());
-    if(m_context == NULL || m_context->err)
+    bool retval = false;
+
+    if(reply->type == REDIS_REPLY_ERROR)
     {
-        if (m_context)
-        {
-            LOG(LOG_ERR,"redisConnectUnix() failed: %s\n", m_context->errstr);
-        }
-        else
+        retval = true;
+    }
+    else if(reply->type == REDIS_REPLY_ARRAY)
+    {
+        /* EXEC reply, one element per queued command */
+        for(size_t i = 0; i < reply->elements; i++)
         {
-            LOG(LOG_ERR,"redisConnectUnix() failed: Can't allocate redis context\n");
+            retval = retval || IsErrorReply(reply->element[i]);
         }
-        throw std::exception();
     }
 
-    /* Init Async context*/
+    return retval;
+}
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+MessageBroker::MessageBroker(const std::string path) :
+    m_path(path),
+    m_observer_table(std::make_shared<const ObserverTable>()),
+    m_observer_table_version(0),
+    m_loop_observer_table(m_observer_table),
+    m_loop_observer_table_version(0),
+    m_offline_events(MESSAGE_BROKER_OFFLINE_EVENTS)
+{
+    m_publish_connected     = false;
+    m_publish_scheduled     = false;
+    m_publish_pending       = 0;
+    m_publish_queued        = 0;
+    m_publish_sent          = 0;
+    m_publish_failed        = 0;
+    m_publish_dropped       = 0;
+    m_reconnect_interval_ms = MESSAGE_BROKER_RECONNECT_MIN_MS;
+    m_reconnect_scheduled   = false;
+    m_sync_connected        = false;
+    m_subscribe_connected   = false;
 
-    /* TODO: Received SIGPIPE */
-    signal(SIGPIPE, SIG_IGN); 
+    /* Writing to a closed socket fails with EPIPE instead, and triggers the reconnection */
+    signal(SIGPIPE, SIG_IGN);
 
     if(evthread_use_pthreads() != 0) /* This is needed to allow event_base_loopbreak() exit the loop from another thread */
     {
@@ -110,16 +132,30 @@ MessageBroker::MessageBroker(const std::string path)
         throw std::exception();
     }
 
-    m_async_context = redisAsyncConnectUnix(path.c_str());
-    if(m_async_context->err)
+    m_publish_event = event_new(m_event_base, -1, 0, OnPublishEvent, this);
+    m_reconnect_event = evtimer_new(m_event_base, OnReconnect, this);
+    if(m_publish_event == nullptr || m_reconnect_event == nullptr)
     {
-        LOG(LOG_ERR,"redisAsyncConnectUnix() failed: %s\n", m_async_context->errstr);
+        LOG(LOG_ERR,"event_new() failed\n");
         throw std::exception();
     }
 
-    if(REDIS_OK != redisLibeventAttach(m_async_context, m_event_base))
+    /* Without Redis the broker still works, it keeps retrying from the event loop */
+    if(0 != ConnectSync() || 0 != ConnectSubscribe() || 0 != ConnectPublish())
     {
-        LOG(LOG_ERR,"redisLibeventAttach() failed: %s\n", m_async_context->errstr);
+        LOG(LOG_WARNING,"Redis not available on %s, retrying in the background\n", path.c_str());
+        RequestReconnect();
+    }
+
+    /* The loop runs from the start, the publishes are sent from it */
+    try
+    {
+        m_proccess_async_events_thread = std::make_unique<std::thread>(&MessageBroker::ProccessAsyncEvents,this);
+        m_proccess_async_events_thread_id = m_proccess_async_events_thread->get_id();
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LOG_ERR,"m_proccess_async_events_thread thread creation failed\n");
         throw std::exception();
     }
 }
@@ -130,20 +166,266 @@ MessageBroker::~MessageBroker()
 
     if(m_proccess_async_events_thread != nullptr)
     {
-        //event_base_loopexit(m_event_base, nullptr);
-
-        event_base_loopbreak(m_event_base);
+        /* From inside the loop, event_base_loop() clears a break requested before it started */
+        RunInEventLoop([&]
+        {
+            return event_base_loopbreak(m_event_base);
+        });
 
         m_proccess_async_events_thread->join();
     }
 
-    redisFree(m_context);
+    /* The publishes still queued or kept offline are lost */
+    if(m_publish_context != nullptr)
+    {
+        redisAsyncFree(m_publish_context);
+    }
+    event_free(m_publish_event);
+    event_free(m_reconnect_event);
+
+    if(m_context != nullptr)
+    {
+        redisFree(m_context);
+    }
+}
+
+int MessageBroker::ConnectSync()
+{
+    int retval = -1;
+
+    std::lock_guard<std::mutex> lock(m_context_mutex);
+
+    m_sync_connected = false;
+    if(m_context != nullptr)
+    {
+        redisFree(m_context);
+    }
+
+    m_context = redisConnectUnix(m_path.c_str());
+    if(m_context == nullptr)
+    {
+        LOG(LOG_ERR,"redisConnectUnix() failed: Can't allocate redis context\n");
+    }
+    else if(m_context->err)
+    {
+        LOG(LOG_ERR,"redisConnectUnix() failed: %s\n", m_context->errstr);
+        redisFree(m_context);
+        m_context = nullptr;
+    }
+    else
+    {
+        m_sync_connected = true;
+        retval = 0;
+    }
+
+    return retval;
+}
+
+int MessageBroker::ConnectSubscribe()
+{
+    int retval = -1;
+
+    m_async_context = redisAsyncConnectUnix(m_path.c_str());
+    if(m_async_context == nullptr)
+    {
+        LOG(LOG_ERR,"redisAsyncConnectUnix() failed: Can't allocate redis context\n");
+    }
+    else if(m_async_context->err)
+    {
+        LOG(LOG_ERR,"redisAsyncConnectUnix() failed: %s\n", m_async_context->errstr);
+        redisAsyncFree(m_async_context);
+        m_async_context = nullptr;
+    }
+    else if(REDIS_OK != redisLibeventAttach(m_async_context, m_event_base))
+    {
+        LOG(LOG_ERR,"redisLibeventAttach() failed: %s\n", m_async_context->errstr);
+        redisAsyncFree(m_async_context);
+        m_async_context = nullptr;
+    }
+    else
+    {
+        m_async_context->data = this;
+        redisAsyncSetDisconnectCallback(m_async_context, OnSubscribeDisconnect);
+
+        /* Subscribe again to every channel that has observers */
+        std::shared_ptr<const ObserverTable> table = LoadObserverTable();
+        for(const auto& entry : *table)
+        {
+            redisAsyncCommand(m_async_context, OnMessage, reinterpret_cast<void*>(this), "SUBSCRIBE %b", entry.first.data(), entry.first.size());
+        }
+
+        m_subscribe_connected = true;
+        retval = 0;
+    }
+
+    return retval;
+}
+
+int MessageBroker::ConnectPublish()
+{
+    int retval = -1;
+
+    m_publish_context = redisAsyncConnectUnix(m_path.c_str());
+    if(m_publish_context == nullptr)
+    {
+        LOG(LOG_ERR,"redisAsyncConnectUnix() failed: Can't allocate redis context\n");
+    }
+    else if(m_publish_context->err)
+    {
+        LOG(LOG_ERR,"redisAsyncConnectUnix() failed: %s\n", m_publish_context->errstr);
+        redisAsyncFree(m_publish_context);
+        m_publish_context = nullptr;
+    }
+    else if(REDIS_OK != redisLibeventAttach(m_publish_context, m_event_base))
+    {
+        LOG(LOG_ERR,"redisLibeventAttach() failed: %s\n", m_publish_context->errstr);
+        redisAsyncFree(m_publish_context);
+        m_publish_context = nullptr;
+    }
+    else
+    {
+        m_publish_context->data = this;
+        redisAsyncSetDisconnectCallback(m_publish_context, OnPublishDisconnect);
+
+        m_publish_connected = true;
+        retval = 0;
+    }
+
+    return retval;
+}
+
+void MessageBroker::RequestReconnect()
+{
+    /* Only one reconnection in progress, the next attempts are timed by Reconnect() */
+    if(!m_reconnect_scheduled.exchange(true))
+    {
+        event_active(m_reconnect_event, EV_TIMEOUT, 0);
+    }
+}
+
+void MessageBroker::OnReconnect(evutil_socket_t fd, short events, void *data)
+{
+    reinterpret_cast<MessageBroker*>(data)->Reconnect();
+}
+
+void MessageBroker::Reconnect()
+{
+    /* Whatever dropped, Redis may have restarted: the sync context is always renewed */
+    bool sync_connected      = (0 == ConnectSync());
+    bool subscribe_connected = (m_async_context != nullptr) || (0 == ConnectSubscribe());
+    bool publish_connected   = (m_publish_context != nullptr) || (0 == ConnectPublish());
+
+    if(sync_connected && subscribe_connected && publish_connected)
+    {
+        LOG(LOG_NOTICE,"Connected to Redis on %s\n", m_path.c_str());
+        m_reconnect_interval_ms = MESSAGE_BROKER_RECONNECT_MIN_MS;
+        m_reconnect_scheduled = false;
+        ReplayOfflineState();
+    }
+    else
+    {
+        const timeval interval = {static_cast<time_t>(m_reconnect_interval_ms / 1000),
+                                  static_cast<suseconds_t>((m_reconnect_interval_ms % 1000) * 1000)};
+
+        LOG(LOG_WARNING,"Redis reconnection failed, next attempt in %u ms\n", m_reconnect_interval_ms);
+        evtimer_add(m_reconnect_event, &interval);
+        m_reconnect_interval_ms = std::min(m_reconnect_interval_ms * 2, MESSAGE_BROKER_RECONNECT_MAX_MS);
+    }
+}
+
+void MessageBroker::ReplayOfflineState()
+{
+    MessageBrokerBatch batch;
+    PendingPublish pending;
+
+    /* Last value of every variable, a restarted Redis has lost them. Sent from this thread on the
+       publish connection without waiting, ahead of the events, FinishBatch() logs if it fails */
+    {
+        std::lock_guard<std::mutex> lock(m_context_mutex);
+        for(const auto& variable : m_variable_cache)
+        {
+            batch.SetVariable(variable.second);
+        }
+    }
+    std::shared_ptr<PendingBatch> pending_batch = EncodeBatch(batch, false);
+    if(pending_batch != nullptr && !pending_batch->commands.empty())
+    {
+        SendBatch(std::move(pending_batch));
+    }
+
+    /* Then the events in the order they were published */
+    if(!m_offline_events.Empty())
+    {
+        LOG(LOG_NOTICE,"Replaying %zu events published while Redis was down\n", m_offline_events.Size());
+    }
+    while(m_publish_connected && m_offline_events.Pop(pending))
+    {
+        auto in_flight = new PendingPublish(std::move(pending));
+
+        if(REDIS_OK != redisAsyncFormattedCommand(m_publish_context, OnPublishReply, in_flight,
+                                                  in_flight->command.data(), in_flight->command.size()))
+        {
+            PublishDone(in_flight->channel, "redisAsyncFormattedCommand() failed");
+            delete in_flight;
+        }
+    }
+
+    SendPendingPublishes();
+}
+
+bool MessageBroker::IsConnected()
+{
+    return m_sync_connected && m_subscribe_connected && m_publish_connected;
+}
+
+void MessageBroker::SetVolatileChannel(const std::string& channel)
+{
+    /* Only read from the event loop thread */
+    RunInEventLoop([&]
+    {
+        m_volatile_channels.push_back(channel);
+        return 0;
+    });
 }
 
 void MessageBroker::ProccessAsyncEvents()
 {
-    event_base_dispatch(m_event_base);
-    //event_base_loop(m_event_base, EVLOOP_NO_EXIT_ON_EMPTY);
+    /* Keep looping while there are no events, the publish event is only activated on demand */
+    event_base_loop(m_event_base, EVLOOP_NO_EXIT_ON_EMPTY);
+}
+
+int MessageBroker::RunInEventLoop(std::function<int(void)> function)
+{
+    int retval = -1;
+
+    if(std::this_thread::get_id() == m_proccess_async_events_thread_id)
+    {
+        retval = function();
+    }
+    else
+    {
+        std::pair<std::function<int(void)>, std::promise<int>> call(function, std::promise<int>());
+        std::future<int> result = call.second.get_future();
+        const timeval now = {0, 0};
+
+        if(0 != event_base_once(m_event_base, -1, EV_TIMEOUT, OnRunInEventLoop, &call, &now))
+        {
+            LOG(LOG_ERR,"event_base_once() failed\n");
+        }
+        else
+        {
+            retval = result.get();
+        }
+    }
+
+    return retval;
+}
+
+void MessageBroker::OnRunInEventLoop(evutil_socket_t fd, short events, void *data)
+{
+    auto call = reinterpret_cast<std::pair<std::function<int(void)>, std::promise<int>>*>(data);
+
+    call->second.set_value(call->first());
 }
 
 int MessageBroker::Subscribe(const std::string& channel, std::shared_ptr<IChannelMessageObserver> observer)
@@ -157,26 +439,17 @@ int MessageBroker::Subscribe(const std::string& channel, std::shared_ptr<IChanne
     {
         LOG(LOG_ERR,"RegisterObserver() failed\n");
     }
-    else if(REDIS_OK != redisAsyncCommand(m_async_context, OnMessage, reinterpret_cast<void*>(this), "SUBSCRIBE %s",channel.c_str()))
+    /* The async context is only touched from the event loop thread, without it the channel is subscribed on reconnection */
+    else if(REDIS_OK != RunInEventLoop([&]
+            {
+                return (m_async_context == nullptr) ? REDIS_OK :
+                    redisAsyncCommand(m_async_context, OnMessage, reinterpret_cast<void*>(this), "SUBSCRIBE %b", channel.data(), channel.size());
+            }))
     {
         LOG(LOG_ERR,"redisAsyncCommand() failed\n");
     }
     else
     {
-        if(m_proccess_async_events_thread == nullptr)
-        {
-            try
-            {
-                m_proccess_async_events_thread = std::make_unique<std::thread>(&MessageBroker::ProccessAsyncEvents,this);
-                
-            }
-            catch(const std::exception& e)
-            {
-                LOG(LOG_ERR,"m_proccess_async_events_thread thread creation failed\n");
-                throw std::exception();
-            }
-            
-        }
         LOG(LOG_INFO,"Reddis subscription success: channel %s observer %p\n", channel.c_str(), observer.get());
 
         retval = 0;
@@ -185,23 +458,44 @@ int MessageBroker::Subscribe(const std::string& channel, std::shared_ptr<IChanne
     return retval;
 }
 
+std::shared_ptr<const MessageBroker::ObserverTable> MessageBroker::LoadObserverTable()
+{
+    std::lock_guard<std::mutex> lock(m_observer_table_mutex);
+    return m_observer_table;
+}
+
+/* Called with m_observer_table_mutex held */
+void MessageBroker::StoreObserverTable(std::shared_ptr<const ObserverTable> table)
+{
+    m_observer_table = std::move(table);
+    m_observer_table_version.fetch_add(1, std::memory_order_release);
+}
+
 int MessageBroker::RegisterObserver(const std::string& channel, std::shared_ptr<IChannelMessageObserver> observer)
 {
     int ret = 1;
     if(observer != nullptr)
     {
-        auto it = m_observer_map.find(channel);
-        if(it != m_observer_map.end())
+        std::lock_guard<std::mutex> lock(m_observer_table_mutex);
+        auto table = std::make_shared<ObserverTable>(*m_observer_table);
+        auto entry = std::make_shared<ChannelObservers>();
+
+        auto it = table->find(channel);
+        if(it != table->end())
         {
             /* Existing entry */
-            it->second.push_back(observer);
+            *entry = *it->second;
+            table->erase(it);
         }
         else
         {
             /* New entry */
-            auto pair = std::pair<std::string, std::vector<std::shared_ptr<IChannelMessageObserver>>>(channel,{observer});
-            m_observer_map.insert(pair);
+            entry->channel = channel;
         }
+        entry->observers.push_back(observer);
+        table->emplace(entry->channel, entry);
+
+        StoreObserverTable(table);
         ret = 0;
 
         LOG(LOG_INFO,"Reddis observer registered successfully, channel %s observer %p\n", channel.c_str(), observer.get());
@@ -214,19 +508,26 @@ int MessageBroker::UnRegisterObserver(const std::string& channel, std::shared_pt
     int ret = 1;
     if(observer != nullptr)
     {
-        auto map_it = m_observer_map.find(channel);
-        if(map_it != m_observer_map.end())
+        std::lock_guard<std::mutex> lock(m_observer_table_mutex);
+        auto table = std::make_shared<ObserverTable>(*m_observer_table);
+
+        auto map_it = table->find(channel);
+        if(map_it != table->end())
         {
-            std::vector<std::shared_ptr<IChannelMessageObserver>>& observers = map_it->second;
+            auto entry = std::make_shared<ChannelObservers>(*map_it->second);
+            std::vector<std::shared_ptr<IChannelMessageObserver>>& observers = entry->observers;
 
             auto vec_it = std::find(observers.begin(), observers.end(), observer);
             if(vec_it != observers.end())
             {
                 observers.erase(vec_it);
-                if(observers.empty())
+                table->erase(map_it);
+                if(!observers.empty())
                 {
-                    m_observer_map.erase(map_it);
+                    table->emplace(entry->channel, entry);
                 }
+
+                StoreObserverTable(table);
                 ret = 0;
 
                 LOG(LOG_INFO,"Reddis observer unregistered successfully, channel %s observer %p\n", channel.c_str(), observer.get());
@@ -236,13 +537,23 @@ int MessageBroker::UnRegisterObserver(const std::string& channel, std::shared_pt
     return ret;
 }
 
-int MessageBroker::CallObservers(const std::string& channel, const std::string& message)
+int MessageBroker::CallObservers(std::string_view channel, std::string_view message)
 {
     int ret = 1;
-    auto map_it = m_observer_map.find(channel);
-    if(map_it != m_observer_map.end())
+
+    /* Only reloaded here, so the table stays alive while the observers run even if they replace it */
+    uint64_t version = m_observer_table_version.load(std::memory_order_acquire);
+    if(version != m_loop_observer_table_version)
     {
-        for(const auto& it : map_it->second)
+        m_loop_observer_table = LoadObserverTable();
+        m_loop_observer_table_version = version;
+    }
+    const ObserverTable& table = *m_loop_observer_table;
+
+    auto map_it = table.find(channel);
+    if(map_it != table.end())
+    {
+        for(const auto& it : map_it->second->observers)
         {
             it->ChannelMessageListener(message);
         }
@@ -260,11 +571,17 @@ int MessageBroker::Unsubscribe(const std::string& channel, const std::shared_ptr
         retval = -1;
     }
 
-    if (m_observer_map.end() == m_observer_map.find(channel))
+    std::shared_ptr<const ObserverTable> table = LoadObserverTable();
+    if (table->end() == table->find(channel))
     {
         std::lock_guard<std::mutex> lock(m_context_mutex);
 
-        redisReply *reply = (redisReply *) redisCommand(m_context, "UNSUBSCRIBE %s", channel.c_str());
+        m_command_writer.Clear();
+        m_command_writer.BeginCommand(2);
+        m_command_writer.AddArgument("UNSUBSCRIBE");
+        m_command_writer.AddArgument(channel);
+
+        redisReply *reply = SendCommand();
         if(reply != nullptr && reply->type == REDIS_REPLY_ERROR)
         {
             retval = -1;
@@ -282,29 +599,205 @@ int MessageBroker::Unsubscribe(const std::string& channel, const std::shared_ptr
 
 int MessageBroker::Publish(const std::string& channel, const std::string& message)
 {
-    int retval = 0;
-
-    std::lock_guard<std::mutex> lock(m_context_mutex);
+    int retval = -1;
 
-    redisReply* reply = (redisReply *) redisCommand(m_context, "PUBLISH %s %s", channel.c_str(), message.c_str());
-    if(reply != nullptr && reply->type == REDIS_REPLY_ERROR)
+    /* Accepted even without connection, the loop keeps it until Redis is back */
+    if(m_publish_pending.fetch_add(1) >= MESSAGE_BROKER_MAX_PENDING_PUBLISH)
     {
-        retval = -1;
+        PublishDropped(channel, "too many pending publishes");
     }
+    else
+    {
+        /* Encoded here, the loop thread only copies it to the output buffer */
+        RespWriter command_writer;
+        command_writer.Reserve(channel.size() + message.size() + 48);
+        command_writer.BeginCommand(3);
+        command_writer.AddArgument("PUBLISH");
+        command_writer.AddArgument(channel);
+        command_writer.AddArgument(message);
 
-    freeReplyObject(reply);
+        m_publish_queue.Push(PendingPublish{channel, command_writer.TakeBuffer()});
+        m_publish_queued++;
+
+        /* Only the first publish after a drain has to wake up the loop */
+        if(!m_publish_scheduled.exchange(true))
+        {
+            event_active(m_publish_event, EV_TIMEOUT, 0);
+        }
+        retval = 0;
+    }
 
     return retval;
 }
 
+void MessageBroker::SetPublishObserver(const std::shared_ptr<IPublishObserver> observer)
+{
+    std::lock_guard<std::mutex> lock(m_publish_observer_mutex);
+    m_publish_observer = observer;
+}
+
+PublishStats MessageBroker::GetPublishStats()
+{
+    return PublishStats{m_publish_queued, m_publish_sent, m_publish_failed, m_publish_dropped};
+}
+
+void MessageBroker::OnPublishEvent(evutil_socket_t fd, short events, void *data)
+{
+    reinterpret_cast<MessageBroker*>(data)->SendPendingPublishes();
+}
+
+void MessageBroker::SendPendingPublishes()
+{
+    PendingPublish pending;
+
+    /* Cleared before draining, a publish queued from now on activates the event again */
+    m_publish_scheduled = false;
+
+    /* All the commands go to the output buffer, hiredis writes them together when the socket is writable */
+    while(m_publish_queue.Pop(pending))
+    {
+        if(pending.batch != nullptr)
+        {
+            SendBatch(std::move(pending.batch));
+        }
+        else if(!m_publish_connected)
+        {
+            KeepOffline(std::move(pending));
+        }
+        else
+        {
+            /* The command is kept until the reply, to replay it if the connection is lost */
+            auto in_flight = new PendingPublish(std::move(pending));
+
+            if(REDIS_OK != redisAsyncFormattedCommand(m_publish_context, OnPublishReply, in_flight,
+                                                      in_flight->command.data(), in_flight->command.size()))
+            {
+                PublishDone(in_flight->channel, "redisAsyncFormattedCommand() failed");
+                delete in_flight;
+            }
+        }
+    }
+}
+
+void MessageBroker::OnPublishReply(redisAsyncContext *redis_context, void *reply, void *data)
+{
+    auto message_broker = reinterpret_cast<MessageBroker*>(redis_context->data);
+    auto in_flight = reinterpret_cast<PendingPublish*>(data);
+    auto redis_reply = reinterpret_cast<redisReply*>(reply);
+
+    if(redis_reply == nullptr)
+    {
+        /* Connection lost or context freed */
+        message_broker->KeepOffline(std::move(*in_flight));
+    }
+    else if(redis_reply->type == REDIS_REPLY_ERROR)
+    {
+        message_broker->PublishDone(in_flight->channel, redis_reply->str);
+    }
+    else
+    {
+        message_broker->PublishDone(in_flight->channel, nullptr);
+    }
+
+    delete in_flight;
+}
+
+void MessageBroker::OnPublishDisconnect(const redisAsyncContext *redis_context, int status)
+{
+    auto message_broker = reinterpret_cast<MessageBroker*>(redis_context->data);
+
+    /* hiredis frees the context after this callback, REDIS_OK when it was freed by us */
+    message_broker->m_publish_connected = false;
+    message_broker->m_publish_context = nullptr;
+    if(status != REDIS_OK)
+    {
+        LOG(LOG_ERR,"Redis publish connection lost: %s\n", redis_context->errstr);
+        message_broker->RequestReconnect();
+    }
+}
+
+void MessageBroker::OnSubscribeDisconnect(const redisAsyncContext *redis_context, int status)
+{
+    auto message_broker = reinterpret_cast<MessageBroker*>(redis_context->data);
+
+    message_broker->m_subscribe_connected = false;
+    message_broker->m_async_context = nullptr;
+    if(status != REDIS_OK)
+    {
+        LOG(LOG_ERR,"Redis subscribe connection lost: %s\n", redis_context->errstr);
+        message_broker->RequestReconnect();
+    }
+}
+
+void MessageBroker::KeepOffline(PendingPublish&& pending)
+{
+    PendingPublish oldest;
+
+    if(std::find(m_volatile_channels.begin(), m_volatile_channels.end(), pending.channel) != m_volatile_channels.end())
+    {
+        PublishDropped(pending.channel, "volatile channel while offline");
+    }
+    else
+    {
+        if(m_offline_events.Size() == MESSAGE_BROKER_OFFLINE_EVENTS && m_offline_events.Pop(oldest))
+        {
+            PublishDropped(oldest.channel, "offline buffer full");
+        }
+        m_offline_events.Push(std::move(pending));
+    }
+}
+
+void MessageBroker::PublishDone(const std::string& channel, const char* error)
+{
+    m_publish_pending--;
+
+    if(error == nullptr)
+    {
+        m_publish_sent++;
+    }
+    else
+    {
+        m_publish_failed++;
+        LOG(LOG_ERR,"Publish on channel %s failed: %s\n", channel.c_str(), error);
+        NotifyPublishFailed(channel, error);
+    }
+}
+
+void MessageBroker::PublishDropped(const std::string& channel, const char* reason)
+{
+    m_publish_pending--;
+    m_publish_dropped++;
+    LOG(LOG_WARNING,"Publish on channel %s dropped: %s\n", channel.c_str(), reason);
+    NotifyPublishFailed(channel, reason);
+}
+
+void MessageBroker::NotifyPublishFailed(const std::string& channel, const char* error)
+{
+    std::shared_ptr<IPublishObserver> observer;
+
+    {
+        std::lock_guard<std::mutex> lock(m_publish_observer_mutex);
+        observer = m_publish_observer;
+    }
+    if(observer != nullptr)
+    {
+        observer->PublishFailed(channel, error);
+    }
+}
+
 int MessageBroker::GetVariable(Variable& variable)
 {
     int retval = 0;
 
     std::lock_guard<std::mutex> lock(m_context_mutex);
 
-    redisReply *reply = (redisReply *) redisCommand(m_context,"GET %s",variable.name.c_str());
-    if(reply->type != REDIS_REPLY_STRING)
+    m_command_writer.Clear();
+    m_command_writer.BeginCommand(2);
+    m_command_writer.AddArgument("GET");
+    m_command_writer.AddArgument(variable.name);
+
+    redisReply *reply = SendCommand();
+    if(reply == nullptr || reply->type != REDIS_REPLY_STRING)
     {
         retval = -1;
     }
@@ -315,16 +808,16 @@ int MessageBroker::GetVariable(Variable& variable)
             switch(variable.data_type)
             {
                 case DataType::Integer:
-                    variable.value = std::stoi(std::string(reply->str), nullptr);
+                    variable.value = std::stoi(std::string(reply->str, reply->len), nullptr);
                     break;
                 case DataType::Float:
-                    variable.value = std::stof(std::string(reply->str), nullptr);
+                    variable.value = std::stof(std::string(reply->str, reply->len), nullptr);
                     break;
                 case DataType::String:
-                    variable.value = std::string(reply->str);
+                    variable.value = std::string(reply->str, reply->len);
                     break;
                 case DataType::Boolean:
-                    variable.value = std::string(reply->str) == "true" ? true : false;
+                    variable.value = std::string_view(reply->str, reply->len) == "true" ? true : false;
                     break;
             }
         }
@@ -340,100 +833,354 @@ int MessageBroker::GetVariable(Variable& variable)
 
 int MessageBroker::SetVariable(const Variable& variable)
 {
-    int retval = 0;
+    int retval = -1;
 
-    std::string value;
-    try
+    std::lock_guard<std::mutex> lock(m_context_mutex);
+
+    m_command_writer.Clear();
+    m_command_writer.BeginCommand(3);
+    m_command_writer.AddArgument("SET");
+    m_command_writer.AddArgument(variable.name);
+
+    if(0 != m_command_writer.AddArgument(variable))
+    {
+        LOG(LOG_ERR,"SetVariable() failed: %s value doesn't match its data type\n", variable.name.c_str());
+    }
+    else
     {
-        switch(variable.data_type)
-        {
-            /*TODO unify conversion to from string to value and viceversa*/
-            case DataType::Integer:
-            value = std::to_string(std::get<int>(variable.value));
-            break;
-            case DataType::Float:
-            value = std::to_string(std::get<float>(variable.value));
-            break;
-            case DataType::String:
-            value = std::get<std::string>(variable.value);
-            break;
-            case DataType::Boolean:
-            value = std::get<bool>(variable.value) == true ? "true" : "false";
-            break;
+        /* Restored on reconnection, even if this SET doesn't make it */
+        m_variable_cache[variable.name] = variable;
+
+        redisReply *reply = SendCommand();
+        if(reply != nullptr && reply->type != REDIS_REPLY_ERROR)
+        {
+            retval = 0;
         }
-        std::lock_guard<std::mutex> lock(m_context_mutex);
 
-        redisReply *reply = (redisReply *) redisCommand(m_context,"SET %s %s", variable.name.c_str(), value.c_str());
-        if(reply->type == REDIS_REPLY_ERROR)
+        freeReplyObject(reply);
+    }
+
+    return retval;
+}
+
+int MessageBroker::SetVariableExpiration(const Variable& variable, int livetime_seconds)
+{
+    int retval = -1;
+
+    std::lock_guard<std::mutex> lock(m_context_mutex);
+
+    m_command_writer.Clear();
+    m_command_writer.BeginCommand(4);
+    m_command_writer.AddArgument("SETEX");
+    m_command_writer.AddArgument(variable.name);
+    m_command_writer.AddArgument(static_cast<int32_t>(livetime_seconds));
+
+    if(0 != m_command_writer.AddArgument(variable))
+    {
+        LOG(LOG_ERR,"SetVariableExpiration() failed: %s value doesn't match its data type\n", variable.name.c_str());
+    }
+    else
+    {
+        redisReply *reply = SendCommand();
+        if(reply != nullptr && reply->type != REDIS_REPLY_ERROR)
         {
-            retval = -1;
+            retval = 0;
         }
 
         freeReplyObject(reply);
     }
-    catch(...)
+
+    return retval;
+}
+
+int MessageBroker::Clear()
+{
+    int retval = 0;
+
+    std::lock_guard<std::mutex> lock(m_context_mutex);
+
+    m_variable_cache.clear();
+
+    m_command_writer.Clear();
+    m_command_writer.BeginCommand(1);
+    m_command_writer.AddArgument("FLUSHALL");
+
+    redisReply *reply = SendCommand();
+    if(reply == nullptr || reply->type != REDIS_REPLY_STATUS)
     {
-        LOG(LOG_INFO,"Exception raised\n");
         retval = -1;
     }
 
+    freeReplyObject(reply);
+
     return retval;
 }
 
-int MessageBroker::SetVariableExpiration(const Variable& variable, int livetime_seconds)
+std::shared_ptr<MessageBroker::PendingBatch> MessageBroker::EncodeBatch(const MessageBrokerBatch& batch, bool atomic)
 {
-    int retval = 0;
+    const std::vector<BatchCommand>& commands = batch.GetCommands();
+    auto pending_batch = std::make_shared<PendingBatch>();
 
-    std::string value;
-    try
+    pending_batch->atomic = atomic;
+    for(size_t i = 0; i < commands.size(); i++)
     {
-        switch(variable.data_type)
-        {
-            case DataType::Integer:
-            value = std::to_string(std::get<int>(variable.value));
-            break;
-            case DataType::Float:
-            value = std::to_string(std::get<float>(variable.value));
-            break;
-            case DataType::String:
-            value = std::get<std::string>(variable.value);
-            break;
-            case DataType::Boolean:
-            value = std::get<bool>(variable.value) == true ? "true" : "false";
-            break;
-        }
-        std::lock_guard<std::mutex> lock(m_context_mutex);
+        RespWriter command_writer;
+        std::string channel;
 
-        redisReply *reply = (redisReply *) redisCommand(m_context,"SETEX %s %d %s", variable.name.c_str(), livetime_seconds, value.c_str());
-        if(reply->type == REDIS_REPLY_ERROR)
+        command_writer.BeginCommand(3);
+        if(commands[i].type == BatchCommandType::SetVariable)
         {
-            retval = -1;
+            command_writer.AddArgument("SET");
+            command_writer.AddArgument(commands[i].variable.name);
+            if(0 != command_writer.AddArgument(commands[i].variable))
+            {
+                LOG(LOG_ERR,"ExecuteBatch() failed: %s value doesn't match its data type\n", commands[i].variable.name.c_str());
+                pending_batch = nullptr;
+                break;
+            }
+        }
+        else
+        {
+            command_writer.AddArgument("PUBLISH");
+            command_writer.AddArgument(commands[i].channel);
+            command_writer.AddArgument(commands[i].message);
+            channel = commands[i].channel;
         }
+        pending_batch->commands.push_back(PendingPublish{std::move(channel), command_writer.TakeBuffer(), nullptr});
+    }
 
-        freeReplyObject(reply);
+    if(pending_batch != nullptr && atomic)
+    {
+        RespWriter command_writer;
+        command_writer.BeginCommand(1);
+        command_writer.AddArgument("MULTI");
+        pending_batch->commands.insert(pending_batch->commands.begin(), PendingPublish{std::string(), command_writer.TakeBuffer(), nullptr});
+        command_writer.BeginCommand(1);
+        command_writer.AddArgument("EXEC");
+        pending_batch->commands.push_back(PendingPublish{std::string(), command_writer.TakeBuffer(), nullptr});
     }
-    catch(...)
+
+    return pending_batch;
+}
+
+int MessageBroker::ExecuteBatch(const MessageBrokerBatch& batch, bool atomic)
+{
+    int retval = 0;
+
+    /* The whole batch is encoded first, nothing is sent if a value is wrong */
+    std::shared_ptr<PendingBatch> pending_batch = EncodeBatch(batch, atomic);
+
+    if(pending_batch == nullptr)
     {
-        LOG(LOG_INFO,"Exception raised\n");
         retval = -1;
     }
+    else if(!batch.GetCommands().empty())
+    {
+        std::future<int> result = pending_batch->result.get_future();
+        QueueBatch(std::move(pending_batch), batch);
+
+        /* The event loop thread would wait for itself */
+        if(std::this_thread::get_id() != m_proccess_async_events_thread_id)
+        {
+            retval = result.get();
+        }
+    }
 
     return retval;
 }
 
-int MessageBroker::Clear()
+int MessageBroker::PostBatch(const MessageBrokerBatch& batch, bool atomic, std::function<void(int)> done)
 {
     int retval = 0;
+    std::shared_ptr<PendingBatch> pending_batch = EncodeBatch(batch, atomic);
 
-    std::lock_guard<std::mutex> lock(m_context_mutex);
-
-    redisReply *reply = (redisReply *) redisCommand(m_context,"flushall");
-    if(reply->type != REDIS_REPLY_STRING)
+    if(pending_batch == nullptr)
     {
         retval = -1;
     }
-
-    freeReplyObject(reply);
+    else if(batch.GetCommands().empty())
+    {
+        done(0);
+    }
+    else
+    {
+        pending_batch->done = std::move(done);
+        QueueBatch(std::move(pending_batch), batch);
+    }
 
     return retval;
 }
+
+void MessageBroker::QueueBatch(std::shared_ptr<PendingBatch> pending_batch, const MessageBrokerBatch& batch)
+{
+    const std::vector<BatchCommand>& commands = batch.GetCommands();
+    uint32_t publishes = std::count_if(commands.begin(), commands.end(), [](const BatchCommand& command)
+    {
+        return command.type == BatchCommandType::Publish;
+    });
+
+    /* Restored on reconnection, even if the batch doesn't make it */
+    {
+        std::lock_guard<std::mutex> lock(m_context_mutex);
+        for(const auto& command : commands)
+        {
+            if(command.type == BatchCommandType::SetVariable)
+            {
+                m_variable_cache[command.variable.name] = command.variable;
+            }
+        }
+    }
+
+    /* Behind the publishes already queued. Not dropped when too many are pending, the variables go with them */
+    m_publish_pending += publishes;
+    m_publish_queued += publishes;
+    m_publish_queue.Push(PendingPublish{std::string(), std::string(), std::move(pending_batch)});
+    if(!m_publish_scheduled.exchange(true))
+    {
+        event_active(m_publish_event, EV_TIMEOUT, 0);
+    }
+}
+
+void MessageBroker::SendBatch(std::shared_ptr<PendingBatch> batch)
+{
+    bool connected = m_publish_connected;
+
+    /* One more until all the commands are handed over, no reply can finish the batch before */
+    batch->outstanding = batch->commands.size() + 1;
+
+    /* One after the other from this thread, nothing else goes between the MULTI and the EXEC */
+    for(size_t i = 0; i < batch->commands.size(); i++)
+    {
+        const std::string& command = batch->commands[i].command;
+
+        if(!connected)
+        {
+            BatchCommandDone(*batch, i, nullptr);
+        }
+        else
+        {
+            auto in_flight = new BatchReply{batch, i};
+
+            if(REDIS_OK != redisAsyncFormattedCommand(m_publish_context, OnBatchReply, in_flight, command.data(), command.size()))
+            {
+                LOG(LOG_ERR,"redisAsyncFormattedCommand() failed\n");
+                delete in_flight;
+                connected = false;
+                BatchCommandDone(*batch, i, nullptr);
+            }
+        }
+    }
+
+    if(--batch->outstanding == 0)
+    {
+        FinishBatch(*batch);
+    }
+}
+
+void MessageBroker::OnBatchReply(redisAsyncContext *redis_context, void *reply, void *data)
+{
+    auto message_broker = reinterpret_cast<MessageBroker*>(redis_context->data);
+    auto in_flight = reinterpret_cast<BatchReply*>(data);
+
+    message_broker->BatchCommandDone(*in_flight->batch, in_flight->index, reinterpret_cast<redisReply*>(reply));
+    delete in_flight;
+}
+
+void MessageBroker::BatchCommandDone(PendingBatch& batch, size_t index, const redisReply* reply)
+{
+    PendingPublish& command = batch.commands[index];
+    const char* error = nullptr;
+
+    if(reply == nullptr)
+    {
+        /* Not sent or connection lost */
+        batch.lost = true;
+        batch.failed = true;
+    }
+    else if(IsErrorReply(reply))
+    {
+        error = (reply->type == REDIS_REPLY_ERROR) ? reply->str : "command of the transaction failed";
+        batch.failed = true;
+    }
+    else if(batch.atomic && index + 1 == batch.commands.size() && reply->type != REDIS_REPLY_ARRAY)
+    {
+        /* A non array EXEC reply means the transaction was aborted */
+        error = "transaction aborted";
+        batch.failed = true;
+    }
+
+    /* Out of a transaction each publish has its own outcome */
+    if(!batch.atomic && !command.channel.empty())
+    {
+        if(reply == nullptr)
+        {
+            KeepOffline(std::move(command));
+        }
+        else
+        {
+            PublishDone(command.channel, error);
+        }
+    }
+
+    if(--batch.outstanding == 0)
+    {
+        FinishBatch(batch);
+    }
+}
+
+void MessageBroker::FinishBatch(PendingBatch& batch)
+{
+    /* The publishes of a transaction go or fail together. If the connection dropped after the EXEC was
+       written they may be received twice, the variables are restored from the cache */
+    if(batch.atomic)
+    {
+        for(auto& command : batch.commands)
+        {
+            if(command.channel.empty())
+            {
+                /* MULTI, SET or EXEC */
+            }
+            else if(batch.lost)
+            {
+                KeepOffline(std::move(command));
+            }
+            else
+            {
+                PublishDone(command.channel, batch.failed ? "transaction failed" : nullptr);
+            }
+        }
+    }
+
+    if(batch.failed)
+    {
+        LOG(LOG_WARNING,"Batch of %zu commands failed\n", batch.commands.size());
+    }
+    batch.result.set_value(batch.failed ? -1 : 0);
+    if(batch.done)
+    {
+        batch.done(batch.failed ? -1 : 0);
+    }
+}
+
+redisReply* MessageBroker::SendCommand()
+{
+    void *reply = nullptr;
+
+    if(!m_sync_connected)
+    {
+        /* Reconnection already requested */
+    }
+    else if(REDIS_OK != redisAppendFormattedCommand(m_context, m_command_writer.GetData(), m_command_writer.GetSize()))
+    {
+        LOG(LOG_ERR,"redisAppendFormattedCommand() failed: %s\n", m_context->errstr);
+    }
+    else if(REDIS_OK != redisGetReply(m_context, &reply))
+    {
+        LOG(LOG_ERR,"redisGetReply() failed: %s\n", m_context->errstr);
+        reply = nullptr;
+        m_sync_connected = false;
+        RequestReconnect();
+    }
+
+    return reinterpret_cast<redisReply*>(reply);
+}
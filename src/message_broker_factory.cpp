@@ -12,6 +12,7 @@
 
 #include "message_broker_factory.hpp"
 #include "message_broker.hpp"
+#include "global_parameters.hpp"
 
 /*******************************************************************
  * Class definition
@@ -19,5 +20,11 @@
 
 std::shared_ptr<IMessageBroker> MessageBrokerFactory::Create(std::string path)
 {
-    return std::make_shared<MessageBroker>(path);
+    auto message_broker = std::make_shared<MessageBroker>(path);
+
+    /* A liveview frame is worthless once Redis is back, only the events are kept */
+    message_broker->SetVolatileChannel(REDIS_LIVEFRAMES_CHANNEL);
+    message_broker->SetVolatileChannel(REDIS_LIVEFRAMES_SHM_CHANNEL);
+
+    return message_broker;
 }
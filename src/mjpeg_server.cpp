@@ -0,0 +1,304 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file mjpeg_server.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <event2/thread.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/keyvalq_struct.h>
+
+#include "mjpeg_server.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define MJPEG_SERVER_TICK_MS 10U /* Clients held back by their rate or a full socket are retried this often */
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+MjpegServer::MjpegServer(const std::string& address, uint16_t port, const std::string& path, uint32_t max_fps) :
+    m_path(path),
+    m_max_fps(std::max(max_fps, 1U)),
+    m_port(port)
+{
+    evhttp_bound_socket *socket = nullptr;
+    const timeval tick = {0, MJPEG_SERVER_TICK_MS * 1000};
+
+    m_frame_number = 0;
+    m_client_count = 0;
+    m_frames_sent = 0;
+    m_frames_dropped = 0;
+
+    if(evthread_use_pthreads() != 0) /* PushFrame() activates an event from another thread */
+    {
+        LOG(LOG_ERR,"evthread_use_pthreads() failed\n");
+        throw std::exception();
+    }
+    else if((m_event_base = event_base_new()) == nullptr)
+    {
+        LOG(LOG_ERR,"event_base_new() failed\n");
+        throw std::exception();
+    }
+    else if((m_http = evhttp_new(m_event_base)) == nullptr)
+    {
+        LOG(LOG_ERR,"evhttp_new() failed\n");
+        Release();
+        throw std::exception();
+    }
+    else if((socket = evhttp_bind_socket_with_handle(m_http, address.c_str(), port)) == nullptr)
+    {
+        LOG(LOG_ERR,"MjpegServer couldn't listen on %s:%u\n", address.c_str(), port);
+        Release();
+        throw std::exception();
+    }
+
+    sockaddr_storage bound_address;
+    socklen_t bound_address_length = sizeof(bound_address);
+    if(0 == getsockname(evhttp_bound_socket_get_fd(socket), reinterpret_cast<sockaddr*>(&bound_address), &bound_address_length))
+    {
+        m_port = ntohs((bound_address.ss_family == AF_INET6) ? reinterpret_cast<sockaddr_in6*>(&bound_address)->sin6_port :
+                                                               reinterpret_cast<sockaddr_in*>(&bound_address)->sin_port);
+    }
+
+    evhttp_set_allowed_methods(m_http, EVHTTP_REQ_GET);
+    evhttp_set_gencb(m_http, OnRequest, this);
+
+    m_frame_event = event_new(m_event_base, -1, 0, OnFrame, this);
+    m_pacing_event = event_new(m_event_base, -1, EV_PERSIST, OnFrame, this);
+    m_stop_event = event_new(m_event_base, -1, 0, OnStop, this);
+    if(m_frame_event == nullptr || m_pacing_event == nullptr || m_stop_event == nullptr || 0 != event_add(m_pacing_event, &tick))
+    {
+        LOG(LOG_ERR,"event_new() failed\n");
+        Release();
+        throw std::exception();
+    }
+
+    try
+    {
+        m_thread = std::make_unique<std::thread>([this]
+        {
+            event_base_dispatch(m_event_base);
+        });
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LOG_ERR,"MjpegServer thread creation failed\n");
+        Release();
+        throw std::exception();
+    }
+
+    LOG(LOG_NOTICE,"Liveview served on http://%s:%u%s\n", address.c_str(), m_port, m_path.c_str());
+}
+
+MjpegServer::~MjpegServer()
+{
+    /* A break requested before the loop started would be lost, an active event isn't */
+    event_active(m_stop_event, EV_TIMEOUT, 0);
+    m_thread->join();
+
+    Release();
+}
+
+void MjpegServer::Release()
+{
+    if(m_http != nullptr)
+    {
+        /* Closes the connections, their close callbacks remove the clients */
+        evhttp_free(m_http);
+    }
+    m_clients.clear();
+
+    if(m_frame_event != nullptr)
+    {
+        event_free(m_frame_event);
+    }
+    if(m_pacing_event != nullptr)
+    {
+        event_free(m_pacing_event);
+    }
+    if(m_stop_event != nullptr)
+    {
+        event_free(m_stop_event);
+    }
+    if(m_event_base != nullptr)
+    {
+        event_base_free(m_event_base);
+    }
+}
+
+void MjpegServer::PushFrame(const std::vector<uint8_t>& jpeg)
+{
+    /* The only copy: from here the frame is shared by all the clients */
+    auto frame = std::make_shared<const std::vector<uint8_t>>(jpeg);
+
+    {
+        std::lock_guard<std::mutex> lock(m_frame_mutex);
+        m_frame = std::move(frame);
+        m_frame_number++;
+    }
+
+    event_active(m_frame_event, EV_TIMEOUT, 0);
+}
+
+uint16_t MjpegServer::GetPort()
+{
+    return m_port;
+}
+
+MjpegServerStats MjpegServer::GetStats()
+{
+    return MjpegServerStats{m_client_count, m_frames_sent, m_frames_dropped};
+}
+
+void MjpegServer::OnRequest(evhttp_request *request, void *data)
+{
+    auto server = reinterpret_cast<MjpegServer*>(data);
+    const evhttp_uri *uri = evhttp_request_get_evhttp_uri(request);
+    const char *path = evhttp_uri_get_path(uri);
+    const char *query = evhttp_uri_get_query(uri);
+    uint32_t fps = server->m_max_fps;
+
+    if(path == nullptr || server->m_path != path)
+    {
+        evhttp_send_error(request, HTTP_NOTFOUND, nullptr);
+    }
+    else
+    {
+        if(query != nullptr)
+        {
+            evkeyvalq parameters;
+
+            if(0 == evhttp_parse_query_str(query, &parameters))
+            {
+                const char *requested_fps = evhttp_find_header(&parameters, "fps");
+                if(requested_fps != nullptr && atoi(requested_fps) > 0)
+                {
+                    fps = std::min(fps, static_cast<uint32_t>(atoi(requested_fps)));
+                }
+            }
+            evhttp_clear_headers(&parameters);
+        }
+
+        evkeyvalq *headers = evhttp_request_get_output_headers(request);
+        evhttp_add_header(headers, "Content-Type", "multipart/x-mixed-replace; boundary=" MJPEG_SERVER_BOUNDARY);
+        evhttp_add_header(headers, "Cache-Control", "no-cache, no-store");
+        evhttp_add_header(headers, "Pragma", "no-cache");
+        evhttp_send_reply_start(request, HTTP_OK, "OK");
+
+        uint64_t frame_number = server->m_frame_number;
+        auto client = std::make_unique<Client>(Client{server, request,
+                                                      std::chrono::steady_clock::duration(std::chrono::seconds(1)) / fps,
+                                                      std::chrono::steady_clock::time_point(),
+                                                      (frame_number > 0) ? frame_number - 1 : 0});
+
+        evhttp_connection_set_closecb(evhttp_request_get_connection(request), OnClientClose, client.get());
+        server->m_clients.push_back(std::move(client));
+        server->m_client_count = server->m_clients.size();
+
+        /* The current frame straight away, not at the next one */
+        server->SendFrames();
+    }
+}
+
+void MjpegServer::OnClientClose(evhttp_connection *connection, void *data)
+{
+    auto client = reinterpret_cast<Client*>(data);
+
+    client->server->RemoveClient(client);
+}
+
+void MjpegServer::RemoveClient(Client *client)
+{
+    m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                   [client](const std::unique_ptr<Client>& entry) { return entry.get() == client; }),
+                    m_clients.end());
+    m_client_count = m_clients.size();
+}
+
+void MjpegServer::OnFrame(evutil_socket_t fd, short events, void *data)
+{
+    reinterpret_cast<MjpegServer*>(data)->SendFrames();
+}
+
+void MjpegServer::OnStop(evutil_socket_t fd, short events, void *data)
+{
+    event_base_loopbreak(reinterpret_cast<MjpegServer*>(data)->m_event_base);
+}
+
+void MjpegServer::SendFrames()
+{
+    Frame frame;
+    uint64_t frame_number;
+    auto now = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(m_frame_mutex);
+        frame = m_frame;
+        frame_number = m_frame_number;
+    }
+
+    for(auto& client : m_clients)
+    {
+        evbuffer *output = bufferevent_get_output(evhttp_connection_get_bufferevent(evhttp_request_get_connection(client->request)));
+
+        /* Up to date, paced or the previous frame not written yet: it gets the newest one later */
+        if(frame == nullptr || client->last_frame == frame_number ||
+           now - client->last_sent < client->interval || evbuffer_get_length(output) > 0)
+        {
+            continue;
+        }
+
+        m_frames_dropped += frame_number - client->last_frame - 1;
+        SendFrame(*client, frame, frame_number);
+        client->last_sent = now;
+    }
+}
+
+void MjpegServer::SendFrame(Client& client, const Frame& frame, uint64_t frame_number)
+{
+    evbuffer *buffer = evbuffer_new();
+
+    if(buffer == nullptr)
+    {
+        LOG(LOG_ERR,"evbuffer_new() failed\n");
+    }
+    else
+    {
+        evbuffer_add_printf(buffer, "--" MJPEG_SERVER_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n", frame->size());
+
+        /* Referenced, the frame is released when the last client has written it */
+        auto reference = new Frame(frame);
+        if(0 != evbuffer_add_reference(buffer, frame->data(), frame->size(), OnFrameSent, reference))
+        {
+            LOG(LOG_ERR,"evbuffer_add_reference() failed\n");
+            delete reference;
+        }
+        else
+        {
+            evbuffer_add(buffer, "\r\n", 2);
+            evhttp_send_reply_chunk(client.request, buffer);
+            client.last_frame = frame_number;
+            m_frames_sent++;
+        }
+
+        evbuffer_free(buffer);
+    }
+}
+
+void MjpegServer::OnFrameSent(const void *data, size_t length, void *frame)
+{
+    delete reinterpret_cast<Frame*>(frame);
+}
@@ -0,0 +1,143 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file persistence_worker.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <exception>
+#include <future>
+#include <unordered_map>
+
+#include "persistence_worker.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+PersistenceWorker::PersistenceWorker() :
+    m_stop(false),
+    m_sleeping(false)
+{
+    try
+    {
+        m_thread = std::make_unique<std::thread>(&PersistenceWorker::Run, this);
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LOG_ERR,"PersistenceWorker thread creation failed\n");
+        throw std::exception();
+    }
+}
+
+PersistenceWorker::~PersistenceWorker()
+{
+    m_stop.store(true);
+    Wake();
+    m_thread->join();
+}
+
+void PersistenceWorker::Post(Command command, const std::string& key)
+{
+    m_queue.Push(PendingCommand{key, std::move(command)});
+    Wake();
+}
+
+void PersistenceWorker::Flush()
+{
+    std::promise<void> applied;
+    std::future<void> future = applied.get_future();
+
+    Post([&applied] { applied.set_value(); });
+    future.wait();
+}
+
+void PersistenceWorker::Wake()
+{
+    /* Pairs with the one in Sleep(): either the worker sees the command or this sees it sleeping */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(m_sleeping.exchange(false))
+    {
+        std::lock_guard<std::mutex> lock(m_wake_mutex);
+        m_wake_condition.notify_one();
+    }
+}
+
+void PersistenceWorker::Sleep(std::vector<PendingCommand>& batch)
+{
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    PendingCommand pending;
+
+    m_sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(m_queue.Pop(pending) || m_stop.load())
+    {
+        /* Posted while going to sleep, the poster may or may not have seen it sleeping */
+        m_sleeping.store(false);
+        if(pending.command)
+        {
+            batch.push_back(std::move(pending));
+        }
+    }
+    else
+    {
+        m_wake_condition.wait(lock, [this] { return !m_sleeping.load(); });
+    }
+}
+
+void PersistenceWorker::Run()
+{
+    std::vector<PendingCommand> batch;
+    PendingCommand pending;
+    bool stop = false;
+
+    while(!stop)
+    {
+        /* Read before draining: everything posted before the stop is applied */
+        stop = m_stop.load();
+
+        while(m_queue.Pop(pending))
+        {
+            batch.push_back(std::move(pending));
+        }
+
+        if(!batch.empty())
+        {
+            Apply(batch);
+            batch.clear();
+        }
+        else if(!stop)
+        {
+            Sleep(batch);
+        }
+    }
+}
+
+void PersistenceWorker::Apply(std::vector<PendingCommand>& batch)
+{
+    std::unordered_map<std::string, size_t> last_with_key;
+
+    for(size_t i = 0; i < batch.size(); i++)
+    {
+        if(!batch[i].key.empty())
+        {
+            last_with_key[batch[i].key] = i;
+        }
+    }
+
+    for(size_t i = 0; i < batch.size(); i++)
+    {
+        /* Superseded by a later one in the same batch */
+        if(!batch[i].key.empty() && last_with_key[batch[i].key] != i)
+        {
+            continue;
+        }
+
+        batch[i].command();
+    }
+}
@@ -0,0 +1,345 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file replay_kinect.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "replay_kinect.hpp"
+#include "global_parameters.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+ReplayKinect::ReplayKinect(std::string recording_path, ReplayKinectConfig config, uint32_t timeout_ms) :
+    CyclicTask("ReplayKinect", 0),
+    m_recording_path(recording_path),
+    m_config(config),
+    m_recording(nullptr),
+    m_recording_size(0),
+    m_next_frame(0),
+    m_frame_source(timeout_ms),
+    m_stopping(false),
+    m_finished(false)
+{
+}
+
+ReplayKinect::~ReplayKinect()
+{
+    if(IsRunning())
+    {
+        Stop();
+    }
+    Term();
+}
+
+int ReplayKinect::Init()
+{
+    int retval = -1;
+    int fd = -1;
+    struct stat file_stat;
+
+    if(m_recording != nullptr)
+    {
+        LOG(LOG_INFO,"ReplayKinect is already initialized\n");
+        retval = 0;
+    }
+    else if(0 > (fd = open(m_recording_path.c_str(), O_RDONLY | O_CLOEXEC)))
+    {
+        LOG(LOG_ERR,"ReplayKinect couldn't open %s: %s\n", m_recording_path.c_str(), strerror(errno));
+    }
+    else if(0 != fstat(fd, &file_stat))
+    {
+        LOG(LOG_ERR,"ReplayKinect fstat() failed: %s\n", strerror(errno));
+    }
+    else if(static_cast<size_t>(file_stat.st_size) < sizeof(KinectRecordingHeader))
+    {
+        LOG(LOG_ERR,"ReplayKinect %s is not a recording\n", m_recording_path.c_str());
+    }
+    else
+    {
+        void* map = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(map == MAP_FAILED)
+        {
+            LOG(LOG_ERR,"ReplayKinect mmap() failed: %s\n", strerror(errno));
+        }
+        else
+        {
+            m_recording      = static_cast<const uint8_t*>(map);
+            m_recording_size = file_stat.st_size;
+
+            /* The recording is read front to back */
+            madvise(map, m_recording_size, MADV_SEQUENTIAL);
+
+            if(0 != IndexRecording())
+            {
+                Term();
+            }
+            else
+            {
+                LOG(LOG_INFO,"ReplayKinect loaded %s with %zu frames\n", m_recording_path.c_str(), m_frame_offsets.size());
+                retval = 0;
+            }
+        }
+    }
+
+    /* The mapping stays valid after closing the descriptor */
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+
+    return retval;
+}
+
+int ReplayKinect::Term()
+{
+    int retval = 0;
+
+    if(m_recording == nullptr)
+    {
+        LOG(LOG_INFO,"ReplayKinect is already terminated\n");
+    }
+    else
+    {
+        if(0 != munmap(const_cast<uint8_t*>(m_recording), m_recording_size))
+        {
+            LOG(LOG_ERR,"ReplayKinect munmap() failed: %s\n", strerror(errno));
+            retval = -1;
+        }
+        m_recording      = nullptr;
+        m_recording_size = 0;
+        m_frame_offsets.clear();
+    }
+
+    return retval;
+}
+
+int ReplayKinect::Start()
+{
+    int retval = -1;
+
+    if(m_recording == nullptr)
+    {
+        LOG(LOG_ERR,"ReplayKinect is not initialized\n");
+    }
+    else
+    {
+        /* Every start replays the recording from the beginning */
+        m_frame_source.Reset();
+        m_next_frame   = 0;
+        m_finished     = m_frame_offsets.empty();
+        m_stopping     = false;
+        m_replay_start = std::chrono::steady_clock::now();
+
+        if(0 != CyclicTask::Start())
+        {
+            LOG(LOG_ERR,"CyclicTask::Start() failed\n");
+        }
+        else
+        {
+            LOG(LOG_INFO,"ReplayKinect started successfully\n");
+            retval = 0;
+        }
+    }
+
+    return retval;
+}
+
+int ReplayKinect::Stop()
+{
+    int retval = 0;
+
+    /* Wake up the execution thread if it's waiting for the next capture time */
+    {
+        std::lock_guard<std::mutex> lock(m_pacing_mutex);
+        m_stopping = true;
+    }
+    m_pacing_cv.notify_one();
+
+    /* Call parent Stop to stop the execution thread*/
+    if(0 != CyclicTask::Stop())
+    {
+        LOG(LOG_ERR,"CyclicTask::Stop() failed\n");
+        retval = -1;
+    }
+    else
+    {
+        LOG(LOG_INFO,"ReplayKinect stopped successfully\n");
+    }
+
+    return retval;
+}
+
+bool ReplayKinect::IsRunning()
+{
+    return CyclicTask::IsRunning();
+}
+
+bool ReplayKinect::IsFinished()
+{
+    return m_finished;
+}
+
+uint64_t ReplayKinect::GetNumberOfFrames()
+{
+    return m_frame_offsets.size();
+}
+
+void ReplayKinect::GetDepthFrame(KinectDepthFrame& frame)
+{
+    m_frame_source.GetDepthFrame(frame);
+}
+
+void ReplayKinect::GetVideoFrame(KinectVideoFrame& frame)
+{
+    m_frame_source.GetVideoFrame(frame);
+}
+
+int ReplayKinect::Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    return m_frame_source.Subscribe(frame_type, observer);
+}
+
+int ReplayKinect::Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    return m_frame_source.Unsubscribe(frame_type, observer);
+}
+
+int ReplayKinect::ChangeTilt(double tilt_angle)
+{
+    /* There is no motor to move */
+    LOG(LOG_DEBUG,"ReplayKinect::ChangeTilt() ignored\n");
+    return 0;
+}
+
+int ReplayKinect::ChangeLedColor(freenect_led_options color)
+{
+    /* There is no led to change */
+    LOG(LOG_DEBUG,"ReplayKinect::ChangeLedColor() ignored\n");
+    return 0;
+}
+
+int ReplayKinect::IndexRecording()
+{
+    int retval = 0;
+    const KinectRecordingHeader* header = reinterpret_cast<const KinectRecordingHeader*>(m_recording);
+    size_t depth_size = sizeof(KinectRecordingFrameHeader) + DEPTH_WIDTH * DEPTH_HEIGHT * sizeof(uint16_t);
+    size_t video_size = sizeof(KinectRecordingFrameHeader) + VIDEO_WIDTH * VIDEO_HEIGHT * sizeof(uint16_t);
+
+    m_frame_offsets.clear();
+
+    if(0 != memcmp(header->magic, KINECT_RECORDING_MAGIC, sizeof(header->magic)))
+    {
+        LOG(LOG_ERR,"ReplayKinect %s is not a recording\n", m_recording_path.c_str());
+        retval = -1;
+    }
+    else if(header->version != KINECT_RECORDING_VERSION)
+    {
+        LOG(LOG_ERR,"ReplayKinect recording version %u not supported\n", header->version);
+        retval = -1;
+    }
+    else if(header->depth_width != DEPTH_WIDTH || header->depth_height != DEPTH_HEIGHT ||
+            header->video_width != VIDEO_WIDTH || header->video_height != VIDEO_HEIGHT)
+    {
+        LOG(LOG_ERR,"ReplayKinect recording resolution doesn't match the Kinect's one\n");
+        retval = -1;
+    }
+    else
+    {
+        size_t offset = sizeof(KinectRecordingHeader);
+
+        while(retval == 0 && offset < m_recording_size)
+        {
+            const KinectRecordingFrameHeader* frame_header = reinterpret_cast<const KinectRecordingFrameHeader*>(m_recording + offset);
+            size_t frame_size = 0;
+
+            if(m_recording_size - offset >= sizeof(KinectRecordingFrameHeader))
+            {
+                if(frame_header->frame_type == static_cast<uint8_t>(KinectFrameType::Depth))
+                {
+                    frame_size = depth_size;
+                }
+                else if(frame_header->frame_type == static_cast<uint8_t>(KinectFrameType::Video))
+                {
+                    frame_size = video_size;
+                }
+            }
+
+            if(frame_size == 0 || m_recording_size - offset < frame_size)
+            {
+                LOG(LOG_ERR,"ReplayKinect recording corrupted at offset %zu\n", offset);
+                retval = -1;
+            }
+            else
+            {
+                m_frame_offsets.push_back(offset);
+                offset += frame_size;
+            }
+        }
+    }
+
+    return retval;
+}
+
+void ReplayKinect::ExecutionCycle()
+{
+    if(m_finished)
+    {
+        /* Nothing else to deliver, sleep until stopped */
+        std::unique_lock<std::mutex> lock(m_pacing_mutex);
+        m_pacing_cv.wait(lock, [this] { return m_stopping; });
+        return;
+    }
+
+    const uint8_t* frame = m_recording + m_frame_offsets[m_next_frame];
+    const KinectRecordingFrameHeader* frame_header = reinterpret_cast<const KinectRecordingFrameHeader*>(frame);
+    const uint16_t* frame_data = reinterpret_cast<const uint16_t*>(frame + sizeof(KinectRecordingFrameHeader));
+
+    if(m_config.mode == ReplayMode::RealTime)
+    {
+        const KinectRecordingFrameHeader* first_header = reinterpret_cast<const KinectRecordingFrameHeader*>(m_recording + m_frame_offsets.front());
+        auto deliver_time = m_replay_start + std::chrono::microseconds(frame_header->capture_time_us - first_header->capture_time_us);
+
+        std::unique_lock<std::mutex> lock(m_pacing_mutex);
+        if(m_pacing_cv.wait_until(lock, deliver_time, [this] { return m_stopping; }))
+        {
+            return;
+        }
+    }
+
+    if(frame_header->frame_type == static_cast<uint8_t>(KinectFrameType::Depth))
+    {
+        m_frame_source.DeliverDepthFrame(frame_data, frame_header->timestamp);
+    }
+    else
+    {
+        m_frame_source.DeliverVideoFrame(frame_data, frame_header->timestamp);
+    }
+
+    if(++m_next_frame == m_frame_offsets.size())
+    {
+        if(m_config.loop)
+        {
+            m_next_frame   = 0;
+            m_replay_start = std::chrono::steady_clock::now();
+        }
+        else
+        {
+            LOG(LOG_INFO,"ReplayKinect reached the end of the recording\n");
+            m_finished = true;
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file resp_writer.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <charconv>
+#include <cstdio>
+
+#include "resp_writer.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+RespWriter::RespWriter()
+{
+}
+
+void RespWriter::Clear()
+{
+    m_buffer.clear();
+}
+
+void RespWriter::Reserve(size_t size)
+{
+    m_buffer.reserve(size);
+}
+
+void RespWriter::BeginCommand(uint32_t argc)
+{
+    AppendHeader('*', argc);
+}
+
+void RespWriter::AddArgument(std::string_view argument)
+{
+    AppendHeader('$', argument.size());
+    m_buffer.append(argument.data(), argument.size());
+    m_buffer.append("\r\n", 2);
+}
+
+void RespWriter::AddArgument(const char* argument)
+{
+    AddArgument(std::string_view(argument));
+}
+
+void RespWriter::AddArgument(int32_t argument)
+{
+    char number[16];
+    auto result = std::to_chars(number, number + sizeof(number), argument);
+
+    AddArgument(std::string_view(number, result.ptr - number));
+}
+
+void RespWriter::AddArgument(float argument)
+{
+    /* Same format as std::to_string(), the one GetVariable() parses back */
+    char number[64];
+    int length = snprintf(number, sizeof(number), "%f", argument);
+
+    AddArgument(std::string_view(number, (length > 0) ? length : 0));
+}
+
+void RespWriter::AddArgument(bool argument)
+{
+    AddArgument(argument ? std::string_view("true") : std::string_view("false"));
+}
+
+int RespWriter::AddArgument(const Variable& variable)
+{
+    int retval = 0;
+
+    if(variable.data_type == DataType::Integer && std::holds_alternative<int32_t>(variable.value))
+    {
+        AddArgument(std::get<int32_t>(variable.value));
+    }
+    else if(variable.data_type == DataType::Float && std::holds_alternative<float>(variable.value))
+    {
+        AddArgument(std::get<float>(variable.value));
+    }
+    else if(variable.data_type == DataType::String && std::holds_alternative<std::string>(variable.value))
+    {
+        AddArgument(std::string_view(std::get<std::string>(variable.value)));
+    }
+    else if(variable.data_type == DataType::Boolean && std::holds_alternative<bool>(variable.value))
+    {
+        AddArgument(std::get<bool>(variable.value));
+    }
+    else
+    {
+        retval = -1;
+    }
+
+    return retval;
+}
+
+const char* RespWriter::GetData() const
+{
+    return m_buffer.data();
+}
+
+size_t RespWriter::GetSize() const
+{
+    return m_buffer.size();
+}
+
+std::string RespWriter::TakeBuffer()
+{
+    std::string buffer;
+
+    buffer.swap(m_buffer);
+    return buffer;
+}
+
+void RespWriter::AppendHeader(char type, int64_t value)
+{
+    char header[24];
+    auto result = std::to_chars(header + 1, header + sizeof(header) - 2, value);
+
+    header[0] = type;
+    result.ptr[0] = '\r';
+    result.ptr[1] = '\n';
+    m_buffer.append(header, result.ptr + 2 - header);
+}
@@ -12,6 +12,7 @@
 
 #include "state_persistence_factory.hpp"
 #include "state_persistence.hpp"
+#include "global_parameters.hpp"
 
 /*******************************************************************
  * Class definition
@@ -19,7 +20,7 @@
 
 std::shared_ptr<IDatabase> StatePersistenceFactory::CreateDatabase(std::string path)
 {
-    return std::make_shared<Database>(path);
+    return std::make_shared<Database>(path, SQLITE_SYNCHRONOUS, SQLITE_FLUSH_INTERVAL_MS);
 }
 
 std::shared_ptr<IDataTable> StatePersistenceFactory::CreateDatatable(std::weak_ptr<IDatabase> data_base, const std::string& name, const Entry list_variables)
@@ -9,6 +9,9 @@
  * Includes
  *******************************************************************/
 #include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 #include "state_persistence.hpp"
 
@@ -22,8 +25,18 @@ const std::map<DataType, std::string> DataTable::m_data_type_map{
     {DataType::Boolean, "CHAR(50)"}
 };
 
-Database::Database(const std::string path) :
-    m_path(path)
+const std::map<DatabaseSynchronous, std::string> Database::m_synchronous_map{
+    {DatabaseSynchronous::Off,    "OFF"},
+    {DatabaseSynchronous::Normal, "NORMAL"},
+    {DatabaseSynchronous::Full,   "FULL"}
+};
+
+Database::Database(const std::string path, DatabaseSynchronous synchronous, uint32_t flush_interval_ms) :
+    m_path(path),
+    m_sqlite_database(nullptr),
+    m_flush_interval_ms(flush_interval_ms),
+    m_stop(false),
+    m_failed_writes(0)
 {
     int ret_val = 0;
 
@@ -34,19 +47,184 @@ Database::Database(const std::string path) :
         sqlite3_close(m_sqlite_database);
         throw std::exception();
     }
+    /* A commit appends to the log instead of rewriting the pages and syncing the journal */
+    else if(0 != ExecuteSqlCommand("PRAGMA journal_mode=WAL") ||
+            0 != ExecuteSqlCommand("PRAGMA synchronous=" + m_synchronous_map.at(synchronous)))
+    {
+        LOG(LOG_ERR,"Cannot configure sqlite database on path %s\n", m_path.c_str());
+        sqlite3_close(m_sqlite_database);
+        throw std::exception();
+    }
+
+    if(m_flush_interval_ms > 0)
+    {
+        try
+        {
+            m_writer_thread = std::make_unique<std::thread>([this]
+            {
+                std::unique_lock<std::mutex> lock(m_write_mutex);
+
+                while(!m_stop)
+                {
+                    /* The first write of a batch waits at most one interval */
+                    m_write_condition.wait(lock, [this] { return m_stop || !m_pending_writes.empty(); });
+                    m_write_condition.wait_for(lock, std::chrono::milliseconds(m_flush_interval_ms), [this] { return m_stop; });
+
+                    lock.unlock();
+                    Flush();
+                    lock.lock();
+                }
+            });
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LOG_ERR,"Database writer thread creation failed\n");
+            sqlite3_close(m_sqlite_database);
+            throw std::exception();
+        }
+    }
 }
 
 Database::~Database()
 {
-    sqlite3_close(m_sqlite_database);
+    if(m_writer_thread != nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_write_mutex);
+            m_stop = true;
+        }
+        m_write_condition.notify_one();
+        m_writer_thread->join();
+    }
+
+    /* Nothing queued is lost on shutdown */
+    Flush();
+
+    /* Closed once the statements still cached by the tables are finalized */
+    sqlite3_close_v2(m_sqlite_database);
 }
 
 int Database::RemoveDatabase()
 {
     std::remove(m_path.c_str());
+    std::remove((m_path + "-wal").c_str());
+    std::remove((m_path + "-shm").c_str());
     return 0;
 }
 
+int Database::Flush()
+{
+    std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+
+    return CommitPendingWrites();
+}
+
+int Database::CommitPendingWrites()
+{
+    int ret_val = 0;
+    bool transaction;
+    uint64_t failed_writes = 0;
+    std::vector<PendingWrite> pending_writes;
+
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        pending_writes.swap(m_pending_writes);
+    }
+
+    if(!pending_writes.empty())
+    {
+        /* Without it they are still written, each one on its own */
+        transaction = (0 == ExecuteSqlCommand("BEGIN"));
+
+        /* In order: after a crash the database holds the writes up to some batch, never a later one without an earlier */
+        for(auto& pending_write : pending_writes)
+        {
+            if(0 != pending_write.write())
+            {
+                failed_writes++;
+            }
+        }
+
+        if(transaction && 0 != ExecuteSqlCommand("COMMIT"))
+        {
+            LOG(LOG_ERR,"Failed to commit %zu writes\n", pending_writes.size());
+            ExecuteSqlCommand("ROLLBACK");
+            failed_writes = pending_writes.size();
+        }
+
+        /* Their callers were already told they succeeded, this is where it is reported */
+        if(failed_writes > 0)
+        {
+            m_failed_writes += failed_writes;
+            ret_val = -1;
+        }
+    }
+
+    return ret_val;
+}
+
+uint64_t Database::GetFailedWrites()
+{
+    return m_failed_writes;
+}
+
+int Database::QueueWrite(PendingWrite pending_write, bool wait)
+{
+    int ret_val = 0;
+
+    if(m_flush_interval_ms == 0 || wait)
+    {
+        std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+
+        /* Never ahead of a write queued earlier, whose failure is counted as in Flush */
+        CommitPendingWrites();
+        ret_val = pending_write.write();
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_write_mutex);
+            auto previous = m_pending_writes.rend();
+
+            /* The last queued write that touches the same row */
+            if(pending_write.overwrite)
+            {
+                previous = std::find_if(m_pending_writes.rbegin(), m_pending_writes.rend(), [&pending_write](const PendingWrite& pending)
+                {
+                    return pending.table == pending_write.table && (!pending.row || *pending.row == *pending_write.row);
+                });
+            }
+
+            if(previous != m_pending_writes.rend() && previous->overwrite && previous->row == pending_write.row)
+            {
+                *previous = std::move(pending_write);
+            }
+            else
+            {
+                m_pending_writes.push_back(std::move(pending_write));
+            }
+        }
+        m_write_condition.notify_one();
+    }
+
+    return ret_val;
+}
+
+int Database::ExecuteSqlCommand(const std::string& command)
+{
+    int ret_val = 0;
+    char *error_message = nullptr;
+
+    if(SQLITE_OK != sqlite3_exec(m_sqlite_database, command.c_str(), NULL, 0, &error_message))
+    {
+        LOG(LOG_ERR,"SQL command error: %s\n", error_message);
+        sqlite3_free(error_message);
+        ret_val = -1;
+    }
+
+    return ret_val;
+}
+
 DataTable::DataTable(std::weak_ptr<IDatabase> data_base, const std::string& name, Entry list_variables) :
     m_name(name),
     m_list_variables(list_variables)
@@ -68,6 +246,9 @@ DataTable::DataTable(std::weak_ptr<IDatabase> data_base, const std::string& name
 
 DataTable::~DataTable()
 {
+    /* The queued writes refer to this table */
+    FlushDatabase();
+    FinalizeStatements();
 }
 
 int DataTable::FormCreateTableMessage(std::string& command)
@@ -111,6 +292,11 @@ int DataTable::DeleteTable()
 {
     int ret_val = 0;
     std::string command;
+
+    /* They would keep referring to the dropped table */
+    FlushDatabase();
+    FinalizeStatements();
+
     if(0 != FormDeleteTableMessage(command))
     {
         LOG(LOG_ERR,"Error forming DeleteTable message\n");
@@ -143,9 +329,10 @@ int DataTable::ExecuteSqlCommand(const std::string& command)
     char *error_message = nullptr;
     std::shared_ptr<Database> l_data_base = m_data_base.lock();
 
-    if(l_data_base == nullptr && l_data_base->m_sqlite_database == nullptr)
+    if(l_data_base == nullptr || l_data_base->m_sqlite_database == nullptr)
     {
         LOG(LOG_ERR,"ExecuteSqlCommand failed, database is nullptr\n");
+        ret_val = -1;
     }
     else
     {
@@ -167,15 +354,18 @@ int DataTable::ExecuteSqlRequest(const std::string& command, sqlite3_stmt **resp
     int ret_val = 0;
     std::shared_ptr<Database> l_data_base = m_data_base.lock();
 
-    if(l_data_base == nullptr && l_data_base->m_sqlite_database == nullptr)
+    if(l_data_base == nullptr || l_data_base->m_sqlite_database == nullptr)
     {
         LOG(LOG_ERR,"ExecuteSqlRequest failed, database is nullptr\n");
+        ret_val = -1;
     }
     else
     {
         if (SQLITE_OK != sqlite3_prepare_v2(l_data_base->m_sqlite_database, command.c_str(), -1, response, 0))
         {
             LOG(LOG_ERR,"SQL command error: %s\n", sqlite3_errmsg(l_data_base->m_sqlite_database));
+            sqlite3_finalize(*response);
+            *response = nullptr;
             ret_val = -1;
         }
     }
@@ -183,22 +373,122 @@ int DataTable::ExecuteSqlRequest(const std::string& command, sqlite3_stmt **resp
     return ret_val;
 }
 
-int DataTable::NumberItems(int& number_items)
+sqlite3_stmt* DataTable::GetStatement(Statement type, const Entry& item, const std::string& range_column)
 {
-    int ret_val = -1;
+    PreparedStatement& prepared = m_statements[type];
     std::string command;
+    int ret_val = 0;
+
+    /* The SQL depends on the columns of the item, prepared again only if they change */
+    if(prepared.statement != nullptr && prepared.range_column == range_column &&
+       std::equal(prepared.columns.begin(), prepared.columns.end(), item.begin(), item.end(),
+                  [](const std::string& column, const Variable& variable) { return column == variable.name; }))
+    {
+        return prepared.statement;
+    }
+
+    sqlite3_finalize(prepared.statement);
+    prepared.statement = nullptr;
+    prepared.columns.clear();
+
+    switch(type)
+    {
+        case Statement::NumberItems:
+            ret_val = FormNumberItemsMessage(command);
+            break;
+        case Statement::InsertItem:
+            ret_val = FormInsertItemMessage(command, item);
+            break;
+        case Statement::GetItem:
+            ret_val = FormGetItemMessage(command, item);
+            break;
+        case Statement::SetItem:
+            ret_val = FormSetItemMessage(command, item);
+            break;
+        case Statement::DeleteItem:
+            ret_val = FormDeleteItemMessage(command, item);
+            break;
+        case Statement::DeleteAllItems:
+            ret_val = FormDeleteAllItemsMessage(command);
+            break;
+        case Statement::QueryItems:
+        case Statement::QueryItemsBefore:
+            ret_val = FormQueryItemsMessage(command, item, range_column, type == Statement::QueryItemsBefore);
+            break;
+    }
+
+    if(0 != ret_val)
+    {
+        LOG(LOG_ERR,"Error forming %s statement\n", m_name.c_str());
+    }
+    else if(0 == ExecuteSqlRequest(command, &prepared.statement))
+    {
+        for(const auto& variable : item)
+        {
+            prepared.columns.push_back(variable.name);
+        }
+        prepared.range_column = range_column;
+    }
+
+    return prepared.statement;
+}
+
+void DataTable::FinalizeStatements()
+{
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+
+    for(auto& prepared : m_statements)
+    {
+        sqlite3_finalize(prepared.second.statement);
+    }
+    m_statements.clear();
+}
+
+int DataTable::QueueWrite(std::optional<Value> row, bool overwrite, bool wait, std::function<int()> write)
+{
+    int ret_val = -1;
     std::shared_ptr<Database> l_data_base = m_data_base.lock();
-    sqlite3_stmt *response;
 
-    if(0 != FormNumberItemsMessage(command))
+    if(l_data_base == nullptr)
+    {
+        LOG(LOG_ERR,"QueueWrite failed, database is nullptr\n");
+    }
+    else
     {
-        LOG(LOG_ERR,"Error forming NumberItems message\n");
+        ret_val = l_data_base->QueueWrite(Database::PendingWrite{this, std::move(row), overwrite, std::move(write)}, wait);
     }
-    else if(0 != ExecuteSqlRequest(command, &response))
+
+    return ret_val;
+}
+
+int DataTable::FlushDatabase()
+{
+    int ret_val = 0;
+    std::shared_ptr<Database> l_data_base = m_data_base.lock();
+
+    if(l_data_base != nullptr)
+    {
+        ret_val = l_data_base->Flush();
+    }
+
+    return ret_val;
+}
+
+int DataTable::NumberItems(int& number_items)
+{
+    int ret_val = -1;
+
+    /* Reads see the queued writes */
+    FlushDatabase();
+
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    sqlite3_stmt *response = GetStatement(Statement::NumberItems, Entry());
+
+    if(response == nullptr)
     {
         LOG(LOG_ERR,"Failed to request number of items\n");
     }
-    else if (0 != HandleNumberItemsResponse(&response, number_items))
+    else if (0 != HandleNumberItemsResponse(response, number_items))
     {
         LOG(LOG_ERR,"Failed to parse the response\n");
     }
@@ -223,37 +513,72 @@ int DataTable::FormNumberItemsMessage(std::string& command)
     return ret_val;
 }
 
-int DataTable::HandleNumberItemsResponse(sqlite3_stmt **response, int& number_items)
+int DataTable::HandleNumberItemsResponse(sqlite3_stmt *response, int& number_items)
 {
     int ret_val = 0;
 
-    if(SQLITE_ROW != sqlite3_step(*response))
+    if(SQLITE_ROW != sqlite3_step(response))
     {
         ret_val = -1;
     }
     else
     {
-        number_items = sqlite3_column_int(*response, 0);
+        number_items = sqlite3_column_int(response, 0);
     }
 
-    sqlite3_finalize(*response);
+    sqlite3_reset(response);
 
     return ret_val;
 }
 
 int DataTable::InsertItem(const Entry& item)
 {
-    int ret_val = 0;
-    std::string command;
+    return InsertItem(item, false);
+}
+
+int DataTable::InsertItem(const Entry& item, bool wait)
+{
+    int ret_val = -1;
 
-    if(0 != FormInsertItemMessage(command, item))
+    if(item.empty())
+    {
+        LOG(LOG_ERR,"InsertItem failed, empty item\n");
+    }
+    else
+    {
+        ret_val = QueueWrite(item.front().value, false, wait, [this, item] { return ApplyInsertItem(item); });
+    }
+
+    return ret_val;
+}
+
+int DataTable::ApplyInsertItem(const Entry& item)
+{
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    sqlite3_stmt *statement = GetStatement(Statement::InsertItem, item);
+    int index = 1;
+
+    if(statement == nullptr)
     {
         LOG(LOG_ERR,"Error forming InsertItem message\n");
     }
-    else if(0 != ExecuteSqlCommand(command))
+    else
     {
-        LOG(LOG_ERR,"Failed to delete table\n");
-        ret_val = -1;
+        ret_val = 0;
+        for(auto it = item.cbegin(); it != item.cend() && ret_val == 0; std::advance(it,1), index++)
+        {
+            ret_val = BindVariable(statement, index, *it);
+        }
+
+        if(ret_val == 0 && SQLITE_DONE != sqlite3_step(statement))
+        {
+            LOG(LOG_ERR,"Failed to insert item\n");
+            ret_val = -1;
+        }
+
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
     }
 
     return ret_val;
@@ -264,7 +589,7 @@ int DataTable::FormInsertItemMessage(std::string& command, const Entry& item)
     int ret_val = 0;
 
     /*
-     * INSERT INTO {table} ({var1.name}, {var2.name}) VALUES ({var1.value}, {var2.value})
+     * INSERT INTO {table} ({var1.name}, {var2.name}) VALUES (?, ?)
      */
 
     command = "INSERT INTO " + m_name +  " (";
@@ -282,7 +607,7 @@ int DataTable::FormInsertItemMessage(std::string& command, const Entry& item)
 
     for(auto it = item.cbegin(); it != item.cend(); std::advance(it,1))
     {
-        command += VariableToString(*it);
+        command += "?";
 
         if(it != std::prev(item.cend()))
         {
@@ -298,19 +623,21 @@ int DataTable::FormInsertItemMessage(std::string& command, const Entry& item)
 int DataTable::GetItem(Entry& item)
 {
     int ret_val = -1;
-    std::string command;
-    std::shared_ptr<Database> l_data_base = m_data_base.lock();
-    sqlite3_stmt *response;
 
-    if(0 != FormGetItemMessage(command, item))
+    FlushDatabase();
+
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    sqlite3_stmt *response = GetStatement(Statement::GetItem, item);
+
+    if(response == nullptr)
     {
         LOG(LOG_ERR,"Error forming GetItem message\n");
     }
-    else if(0 != ExecuteSqlRequest(command, &response))
+    else if(0 != BindVariable(response, 1, item.front()))
     {
-        LOG(LOG_ERR,"Failed to request number of items\n");
+        sqlite3_clear_bindings(response);
     }
-    else if (0 != HandleGetItemResponse(&response, item))
+    else if (0 != HandleGetItemResponse(response, item))
     {
         LOG(LOG_ERR,"Failed to parse the response\n");
     }
@@ -327,7 +654,7 @@ int DataTable::FormGetItemMessage(std::string& command, const Entry& item)
     int ret_val = 0;
 
     /*
-     * SELECT * FROM {table} WHERE id={id}
+     * SELECT {var1},{var2} FROM {table} WHERE {var1}=?
      */
 
     if(item.empty())
@@ -336,18 +663,27 @@ int DataTable::FormGetItemMessage(std::string& command, const Entry& item)
     }
     else
     {
-        command = "SELECT * FROM " + m_name +  " WHERE " + item.front().name + "=" + VariableToString(item.front());
+        command = "SELECT ";
+        for(auto it = item.cbegin(); it != item.cend(); std::advance(it,1))
+        {
+            command += it->name;
+            if(it != std::prev(item.cend()))
+            {
+                command += ",";
+            }
+        }
+        command += " FROM " + m_name +  " WHERE " + item.front().name + "=?";
     }
 
     return ret_val;
 }
 
-int DataTable::HandleGetItemResponse(sqlite3_stmt **response, Entry& item)
+int DataTable::HandleGetItemResponse(sqlite3_stmt *response, Entry& item)
 {
     int ret_val = 0;
     int i = 0;
 
-    if(SQLITE_ROW != sqlite3_step(*response))
+    if(SQLITE_ROW != sqlite3_step(response))
     {
         LOG(LOG_ERR,"Failed sqlite3_step\n");
         ret_val = -1;
@@ -356,92 +692,135 @@ int DataTable::HandleGetItemResponse(sqlite3_stmt **response, Entry& item)
     {
         for(auto it = item.begin(); it != item.end(); std::advance(it,1), i++)
         {
-            std::string string_value = reinterpret_cast<const char *>(sqlite3_column_text(*response, i));
-            StringToVariable(string_value, *it);
+            ColumnToVariable(response, i, *it);
         }
     }
 
-    sqlite3_finalize(*response);
+    sqlite3_reset(response);
+    sqlite3_clear_bindings(response);
 
     return ret_val;
 }
 
-std::string DataTable::VariableToString(const Variable& variable)
+int DataTable::BindVariable(sqlite3_stmt *statement, int index, const Variable& variable)
 {
-    std::string string_value;
-    try
+    int result = SQLITE_MISMATCH;
+
+    /* The text is only bound until the statement is reset, the caller's variable outlives it */
+    if(variable.data_type == DataType::Integer && std::holds_alternative<int32_t>(variable.value))
     {
-        switch (variable.data_type)
-        {
-            case DataType::Integer:
-                string_value = std::to_string(std::get<int>(variable.value));
-                break;
-            case DataType::Float:
-                string_value = std::to_string(std::get<float>(variable.value));
-                break;
-            case DataType::String:
-                string_value = "'";
-                string_value += std::get<std::string>(variable.value);
-                string_value += "'";
-                break;
-            case DataType::Boolean:
-                string_value = "'";
-                string_value += std::get<bool>(variable.value) == true ? "true" : "false";
-                string_value += "'";
-                break;
-        }
+        result = sqlite3_bind_int(statement, index, std::get<int32_t>(variable.value));
+    }
+    else if(variable.data_type == DataType::Float && std::holds_alternative<float>(variable.value))
+    {
+        result = sqlite3_bind_double(statement, index, std::get<float>(variable.value));
     }
-    catch(...)
+    else if(variable.data_type == DataType::String && std::holds_alternative<std::string>(variable.value))
     {
-        LOG(LOG_ERR,"Failed to convert variable value to string value\n");
+        const std::string& value = std::get<std::string>(variable.value);
+        result = sqlite3_bind_text(statement, index, value.data(), value.size(), SQLITE_STATIC);
+    }
+    else if(variable.data_type == DataType::Boolean && std::holds_alternative<bool>(variable.value))
+    {
+        result = sqlite3_bind_text(statement, index, std::get<bool>(variable.value) ? "true" : "false", -1, SQLITE_STATIC);
+    }
+
+    if(result != SQLITE_OK)
+    {
+        LOG(LOG_ERR,"Failed to bind %s\n", variable.name.c_str());
     }
 
-    return string_value;
+    return (result == SQLITE_OK) ? 0 : -1;
 }
 
-int DataTable::StringToVariable(const std::string& string_value, Variable& variable)
+int DataTable::ColumnToVariable(sqlite3_stmt *statement, int column, Variable& variable)
 {
     int ret_val = 0;
-    try
+    const char *text;
+
+    if(sqlite3_column_type(statement, column) == SQLITE_NULL)
+    {
+        LOG(LOG_ERR,"Column %s is NULL\n", variable.name.c_str());
+        ret_val = -1;
+    }
+    else
     {
         switch (variable.data_type)
         {
             case DataType::Integer:
-                variable.value = std::stoi(string_value);
+                variable.value = static_cast<int32_t>(sqlite3_column_int(statement, column));
                 break;
             case DataType::Float:
-                variable.value = std::stof(string_value);
+                variable.value = static_cast<float>(sqlite3_column_double(statement, column));
                 break;
             case DataType::String:
-                variable.value = string_value;
+                text = reinterpret_cast<const char *>(sqlite3_column_text(statement, column));
+                variable.value = std::string(text, sqlite3_column_bytes(statement, column));
                 break;
             case DataType::Boolean:
-                variable.value = string_value == "true" ? true : false;
+                text = reinterpret_cast<const char *>(sqlite3_column_text(statement, column));
+                variable.value = std::string_view(text, sqlite3_column_bytes(statement, column)) == "true";
                 break;
         }
     }
-    catch(...)
+
+    return ret_val;
+}
+
+int DataTable::SetItem(const Entry& item)
+{
+    return SetItem(item, false);
+}
+
+int DataTable::SetItem(const Entry& item, bool wait)
+{
+    int ret_val = -1;
+
+    if(item.empty())
+    {
+        LOG(LOG_ERR,"SetItem failed, empty item\n");
+    }
+    else
     {
-        LOG(LOG_ERR,"Failed to convert string value to variable value\n");
-        ret_val = -1;
+        /* Only the last value of a row rewritten several times in a batch is written */
+        ret_val = QueueWrite(item.front().value, true, wait, [this, item] { return ApplySetItem(item); });
     }
 
     return ret_val;
 }
 
-int DataTable::SetItem(const Entry& item)
+int DataTable::ApplySetItem(const Entry& item)
 {
-    int ret_val = 0;
-    std::string command;
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    sqlite3_stmt *statement = GetStatement(Statement::SetItem, item);
+    int index = 1;
 
-    if(0 != FormSetItemMessage(command, item))
+    if(statement == nullptr)
     {
         LOG(LOG_ERR,"Error forming set Item message\n");
     }
-    else if(0 != ExecuteSqlCommand(command))
+    else
     {
-        LOG(LOG_ERR,"ExecuteSqlCommand failed\n");
-        ret_val = -1;
+        /* SET values first, the key goes last in the WHERE */
+        ret_val = 0;
+        for(auto it = std::next(item.cbegin()); it != item.cend() && ret_val == 0; std::advance(it,1), index++)
+        {
+            ret_val = BindVariable(statement, index, *it);
+        }
+        if(ret_val == 0)
+        {
+            ret_val = BindVariable(statement, index, item.front());
+        }
+
+        if(ret_val == 0 && SQLITE_DONE != sqlite3_step(statement))
+        {
+            LOG(LOG_ERR,"Failed to set item\n");
+            ret_val = -1;
+        }
+
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
     }
 
     return ret_val;
@@ -452,10 +831,10 @@ int DataTable::FormSetItemMessage(std::string& command, const Entry& item)
     int ret_val = 0;
 
     /*
-     * UPDATE {tablename} SET {var2}={val2},{var3}={val3} WHERE {var1}={val1};
+     * UPDATE {tablename} SET {var2}=?,{var3}=? WHERE {var1}=?;
      */
 
-    if(item.empty())
+    if(item.size() < 2)
     {
         ret_val = -1;
     }
@@ -465,14 +844,14 @@ int DataTable::FormSetItemMessage(std::string& command, const Entry& item)
 
         for(auto it = std::next(item.cbegin()); it != item.cend(); std::advance(it,1))
         {
-            command += it->name + "=" + VariableToString(*it);
+            command += it->name + "=?";
             if(it != std::prev(item.cend()))
             {
                 command += ",";
             }
         }
 
-        command += " WHERE " + item.front().name + "=" + VariableToString(item.front());
+        command += " WHERE " + item.front().name + "=?";
     }
 
     return ret_val;
@@ -480,17 +859,42 @@ int DataTable::FormSetItemMessage(std::string& command, const Entry& item)
 
 int DataTable::DeleteItem(const Entry& item)
 {
-    int ret_val = 0;
-    std::string command;
+    int ret_val = -1;
 
-    if(0 != FormDeleteItemMessage(command, item))
+    if(item.empty())
     {
-        LOG(LOG_ERR,"Error forming set Item message\n");
+        LOG(LOG_ERR,"DeleteItem failed, empty item\n");
     }
-    else if(0 != ExecuteSqlCommand(command))
+    else
     {
-        LOG(LOG_ERR,"ExecuteSqlCommand failed\n");
-        ret_val = -1;
+        ret_val = QueueWrite(item.front().value, false, false, [this, item] { return ApplyDeleteItem(item); });
+    }
+
+    return ret_val;
+}
+
+int DataTable::ApplyDeleteItem(const Entry& item)
+{
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    sqlite3_stmt *statement = GetStatement(Statement::DeleteItem, item);
+
+    if(statement == nullptr)
+    {
+        LOG(LOG_ERR,"Error forming delete Item message\n");
+    }
+    else
+    {
+        ret_val = BindVariable(statement, 1, item.front());
+
+        if(ret_val == 0 && SQLITE_DONE != sqlite3_step(statement))
+        {
+            LOG(LOG_ERR,"Failed to delete item\n");
+            ret_val = -1;
+        }
+
+        sqlite3_reset(statement);
+        sqlite3_clear_bindings(statement);
     }
 
     return ret_val;
@@ -501,27 +905,45 @@ int DataTable::FormDeleteItemMessage(std::string& command, const Entry& item)
     int ret_val = 0;
 
     /*
-     * DELETE FROM {datatable} WHERE {var1}={val1};
+     * DELETE FROM {datatable} WHERE {var1}=?;
      */
 
-    command = "DELETE FROM " + m_name +  " WHERE " + item.front().name + "=" + VariableToString(item.front());
+    if(item.empty())
+    {
+        ret_val = -1;
+    }
+    else
+    {
+        command = "DELETE FROM " + m_name +  " WHERE " + item.front().name + "=?";
+    }
 
     return ret_val;
 }
 
 int DataTable::DeleteAllItems()
 {
-    int ret_val = 0;
-    std::string command;
+    return QueueWrite(std::nullopt, false, false, [this] { return ApplyDeleteAllItems(); });
+}
+
+int DataTable::ApplyDeleteAllItems()
+{
+    int ret_val = -1;
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    sqlite3_stmt *statement = GetStatement(Statement::DeleteAllItems, Entry());
 
-    if(0 != FormDeleteAllItemsMessage(command))
+    if(statement == nullptr)
     {
-        LOG(LOG_ERR,"Error forming set Item message\n");
+        LOG(LOG_ERR,"Error forming delete all Items message\n");
     }
-    else if(0 != ExecuteSqlCommand(command))
+    else
     {
-        LOG(LOG_ERR,"ExecuteSqlCommand failed\n");
-        ret_val = -1;
+        ret_val = (SQLITE_DONE == sqlite3_step(statement)) ? 0 : -1;
+        if(ret_val != 0)
+        {
+            LOG(LOG_ERR,"Failed to delete all items\n");
+        }
+
+        sqlite3_reset(statement);
     }
 
     return ret_val;
@@ -538,4 +960,140 @@ int DataTable::FormDeleteAllItemsMessage(std::string& command)
     command = "DELETE FROM " + m_name ;
 
     return ret_val;
-}
\ No newline at end of file
+}
+
+int DataTable::QueryItems(Entry& item, const ItemRange& range, const std::function<bool(const Entry&)>& on_item)
+{
+    int ret_val = -1;
+    std::string command;
+    sqlite3_stmt *response = nullptr;
+    bool before = range.before_column.has_value() && range.before_key.has_value();
+    auto column = std::find_if(m_list_variables.cbegin(), m_list_variables.cend(),
+                               [&range](const Variable& variable) { return variable.name == range.column; });
+
+    FlushDatabase();
+
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+
+    if(item.empty() || column == m_list_variables.cend())
+    {
+        LOG(LOG_ERR,"QueryItems failed, unknown column %s\n", range.column.c_str());
+    }
+    else if(m_indexed_columns.count(range.column) == 0 &&
+            (0 != FormCreateIndexMessage(command, range.column) || 0 != ExecuteSqlCommand(command)))
+    {
+        LOG(LOG_ERR,"Failed to index %s\n", range.column.c_str());
+    }
+    else if(nullptr == (response = GetStatement(before ? Statement::QueryItemsBefore : Statement::QueryItems, item, range.column)))
+    {
+        LOG(LOG_ERR,"Error forming QueryItems message\n");
+    }
+    else
+    {
+        /* The upper bound is where the index seek starts: the next page doesn't walk the previous ones */
+        const Variable from{column->name, column->data_type, range.from};
+        const Variable to{column->name, column->data_type, (before && *range.before_column < range.to) ? *range.before_column : range.to};
+        const Variable before_column{column->name, column->data_type, range.before_column.value_or(Value())};
+        const Variable before_key{m_list_variables.front().name, m_list_variables.front().data_type, range.before_key.value_or(Value())};
+        int index = 1;
+
+        m_indexed_columns.insert(range.column);
+
+        /* Bound without copies, they must outlive the query */
+        ret_val = 0;
+        if(0 != BindVariable(response, index++, from) ||
+           0 != BindVariable(response, index++, to) ||
+           (before && 0 != BindVariable(response, index++, before_column)) ||
+           (before && 0 != BindVariable(response, index++, before_key)) ||
+           SQLITE_OK != sqlite3_bind_int(response, index++, range.limit))
+        {
+            ret_val = -1;
+        }
+        else if(0 != HandleQueryItemsResponse(response, item, on_item))
+        {
+            LOG(LOG_ERR,"Failed to parse the response\n");
+            ret_val = -1;
+        }
+
+        sqlite3_reset(response);
+        sqlite3_clear_bindings(response);
+    }
+
+    return ret_val;
+}
+
+int DataTable::FormQueryItemsMessage(std::string& command, const Entry& item, const std::string& range_column, bool before)
+{
+    int ret_val = 0;
+    const std::string& key = m_list_variables.front().name;
+
+    /*
+     * SELECT {var1},{var2} FROM {table} WHERE {column}>=? AND {column}<=? [AND ({column},{key})<(?,?)]
+     * ORDER BY {column} DESC,{key} DESC LIMIT ?
+     */
+
+    if(item.empty())
+    {
+        ret_val = -1;
+    }
+    else
+    {
+        command = "SELECT ";
+        for(auto it = item.cbegin(); it != item.cend(); std::advance(it,1))
+        {
+            command += it->name;
+            if(it != std::prev(item.cend()))
+            {
+                command += ",";
+            }
+        }
+        command += " FROM " + m_name + " WHERE " + range_column + ">=? AND " + range_column + "<=?";
+        if(before)
+        {
+            command += " AND (" + range_column + "," + key + ")<(?,?)";
+        }
+        command += " ORDER BY " + range_column + " DESC," + key + " DESC LIMIT ?";
+    }
+
+    return ret_val;
+}
+
+int DataTable::FormCreateIndexMessage(std::string& command, const std::string& column)
+{
+    int ret_val = 0;
+
+    /*
+     * CREATE INDEX IF NOT EXISTS {table}_{column} ON {table}({column});
+     * The primary key is implicitly part of it, the query is sorted by the index
+     */
+
+    command = "CREATE INDEX IF NOT EXISTS " + m_name + "_" + column + " ON " + m_name + "(" + column + ");";
+
+    return ret_val;
+}
+
+int DataTable::HandleQueryItemsResponse(sqlite3_stmt *response, Entry& item, const std::function<bool(const Entry&)>& on_item)
+{
+    int ret_val = 0;
+    int result;
+    bool more = true;
+
+    while(more && SQLITE_ROW == (result = sqlite3_step(response)))
+    {
+        int i = 0;
+        for(auto it = item.begin(); it != item.end(); std::advance(it,1), i++)
+        {
+            ColumnToVariable(response, i, *it);
+        }
+
+        more = on_item(item);
+    }
+
+    if(more && result != SQLITE_DONE)
+    {
+        LOG(LOG_ERR,"Failed sqlite3_step\n");
+        ret_val = -1;
+    }
+
+    return ret_val;
+}
@@ -0,0 +1,309 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file synthetic_kinect.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <algorithm>
+
+#include "synthetic_kinect.hpp"
+#include "global_parameters.hpp"
+#include "log.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define IR_MAX_VALUE 1023
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+SyntheticKinect::SyntheticKinect(SyntheticSceneConfig config, uint32_t timeout_ms) :
+    CyclicTask("SyntheticKinect", config.frame_interval_ms),
+    m_config(config),
+    m_frame_source(timeout_ms),
+    m_is_initialized(false),
+    m_random_state(1),
+    m_num_frames(0)
+{
+    m_room.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+    m_depth_data.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+    m_video_data.resize(VIDEO_WIDTH * VIDEO_HEIGHT);
+}
+
+SyntheticKinect::~SyntheticKinect()
+{
+    if(IsRunning())
+    {
+        Stop();
+    }
+}
+
+int SyntheticKinect::Init()
+{
+    if(m_is_initialized)
+    {
+        LOG(LOG_INFO,"SyntheticKinect is already initialized\n");
+    }
+    else
+    {
+        ResetScene();
+        m_is_initialized = true;
+        LOG(LOG_INFO,"SyntheticKinect initialization successful\n");
+    }
+
+    return 0;
+}
+
+int SyntheticKinect::Term()
+{
+    m_is_initialized = false;
+    return 0;
+}
+
+int SyntheticKinect::Start()
+{
+    int retval = -1;
+
+    if(!m_is_initialized)
+    {
+        LOG(LOG_ERR,"SyntheticKinect is not initialized\n");
+    }
+    else
+    {
+        /* Every start renders the same sequence of frames */
+        ResetScene();
+        m_frame_source.Reset();
+
+        if(0 != CyclicTask::Start())
+        {
+            LOG(LOG_ERR,"CyclicTask::Start() failed\n");
+        }
+        else
+        {
+            LOG(LOG_INFO,"SyntheticKinect started successfully\n");
+            retval = 0;
+        }
+    }
+
+    return retval;
+}
+
+int SyntheticKinect::Stop()
+{
+    int retval = 0;
+
+    /* Call parent Stop to stop the execution thread*/
+    if(0 != CyclicTask::Stop())
+    {
+        LOG(LOG_ERR,"CyclicTask::Stop() failed\n");
+        retval = -1;
+    }
+    else
+    {
+        LOG(LOG_INFO,"SyntheticKinect stopped successfully, %llu frames rendered\n", static_cast<unsigned long long>(m_num_frames));
+    }
+
+    return retval;
+}
+
+bool SyntheticKinect::IsRunning()
+{
+    return CyclicTask::IsRunning();
+}
+
+void SyntheticKinect::GetDepthFrame(KinectDepthFrame& frame)
+{
+    m_frame_source.GetDepthFrame(frame);
+}
+
+void SyntheticKinect::GetVideoFrame(KinectVideoFrame& frame)
+{
+    m_frame_source.GetVideoFrame(frame);
+}
+
+int SyntheticKinect::Subscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    return m_frame_source.Subscribe(frame_type, observer);
+}
+
+int SyntheticKinect::Unsubscribe(KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer)
+{
+    return m_frame_source.Unsubscribe(frame_type, observer);
+}
+
+int SyntheticKinect::ChangeTilt(double tilt_angle)
+{
+    /* There is no motor to move */
+    LOG(LOG_DEBUG,"SyntheticKinect::ChangeTilt() ignored\n");
+    return 0;
+}
+
+int SyntheticKinect::ChangeLedColor(freenect_led_options color)
+{
+    /* There is no led to change */
+    LOG(LOG_DEBUG,"SyntheticKinect::ChangeLedColor() ignored\n");
+    return 0;
+}
+
+bool SyntheticKinect::IsIntrusionFrame(uint64_t frame_number) const
+{
+    bool retval = false;
+
+    if(m_config.blob_count == 0 || m_config.blob_active_frames == 0)
+    {
+        retval = false;
+    }
+    else if(m_config.blob_idle_frames == 0)
+    {
+        retval = true;
+    }
+    else
+    {
+        /* Each period starts with the scene empty, so a reference frame taken at the start is clean */
+        uint64_t period = m_config.blob_idle_frames + m_config.blob_active_frames;
+        retval = ((frame_number - 1) % period) >= m_config.blob_idle_frames;
+    }
+
+    return retval;
+}
+
+uint64_t SyntheticKinect::GetNumberOfFrames()
+{
+    return m_num_frames;
+}
+
+uint32_t SyntheticKinect::NextRandom()
+{
+    /* xorshift32, cheap enough to be called per pixel */
+    m_random_state ^= m_random_state << 13;
+    m_random_state ^= m_random_state >> 17;
+    m_random_state ^= m_random_state << 5;
+    return m_random_state;
+}
+
+void SyntheticKinect::ResetScene()
+{
+    m_random_state = (m_config.seed != 0) ? m_config.seed : 1;
+    m_num_frames = 0;
+
+    for(uint32_t y = 0; y < DEPTH_HEIGHT; y++)
+    {
+        uint16_t depth = m_config.room_depth;
+
+        if(y > DEPTH_HEIGHT / 2)
+        {
+            uint32_t decrease = (y - DEPTH_HEIGHT / 2) * m_config.floor_slope;
+            depth = (decrease < depth) ? depth - decrease : 0;
+        }
+        std::fill_n(m_room.begin() + y * DEPTH_WIDTH, DEPTH_WIDTH, depth);
+    }
+
+    m_blobs.resize(m_config.blob_count);
+    for(auto& blob : m_blobs)
+    {
+        blob.x       = NextRandom() % DEPTH_WIDTH;
+        blob.y       = NextRandom() % DEPTH_HEIGHT;
+        blob.speed_x = (NextRandom() & 1) ? m_config.blob_speed : -static_cast<int32_t>(m_config.blob_speed);
+        blob.speed_y = (NextRandom() & 1) ? m_config.blob_speed / 2 : -static_cast<int32_t>(m_config.blob_speed / 2);
+    }
+}
+
+void SyntheticKinect::MoveBlobs()
+{
+    for(auto& blob : m_blobs)
+    {
+        blob.x += blob.speed_x;
+        blob.y += blob.speed_y;
+
+        if(blob.x < 0 || blob.x >= static_cast<int32_t>(DEPTH_WIDTH))
+        {
+            blob.speed_x = -blob.speed_x;
+            blob.x = std::clamp<int32_t>(blob.x, 0, DEPTH_WIDTH - 1);
+        }
+        if(blob.y < 0 || blob.y >= static_cast<int32_t>(DEPTH_HEIGHT))
+        {
+            blob.speed_y = -blob.speed_y;
+            blob.y = std::clamp<int32_t>(blob.y, 0, DEPTH_HEIGHT - 1);
+        }
+    }
+}
+
+bool SyntheticKinect::RenderFrames(std::vector<uint16_t>& depth_data, std::vector<uint16_t>& video_data)
+{
+    uint64_t sequence = ++m_num_frames;
+    bool render_video = (m_config.video_frame_divider <= 1) || (sequence % m_config.video_frame_divider == 0);
+    int32_t noise_range = 2 * m_config.noise_amplitude + 1;
+
+    depth_data.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+
+    /* Static room with noise and dropouts, one random number per pixel */
+    for(uint32_t i = 0; i < DEPTH_WIDTH * DEPTH_HEIGHT; i++)
+    {
+        uint32_t random = NextRandom();
+
+        if((random >> 16) % 1000 < m_config.dropout_per_mille)
+        {
+            depth_data[i] = BLANK_DEPTH_PIXEL;
+        }
+        else
+        {
+            int32_t depth = m_room[i] + static_cast<int32_t>((random & 0xFFFF) % noise_range) - m_config.noise_amplitude;
+            depth_data[i] = std::clamp<int32_t>(depth, 0, BLANK_DEPTH_PIXEL - 1);
+        }
+    }
+
+    /* Blobs */
+    if(IsIntrusionFrame(sequence))
+    {
+        int32_t radius = m_config.blob_radius;
+
+        MoveBlobs();
+        for(auto& blob : m_blobs)
+        {
+            for(int32_t y = std::max(0, blob.y - radius); y < std::min<int32_t>(DEPTH_HEIGHT, blob.y + radius); y++)
+            {
+                for(int32_t x = std::max(0, blob.x - radius); x < std::min<int32_t>(DEPTH_WIDTH, blob.x + radius); x++)
+                {
+                    if((x - blob.x) * (x - blob.x) + (y - blob.y) * (y - blob.y) <= radius * radius)
+                    {
+                        depth_data[y * DEPTH_WIDTH + x] = m_config.blob_depth;
+                    }
+                }
+            }
+        }
+    }
+
+    /* IR video: closer is brighter, with a global flicker */
+    if(render_video)
+    {
+        int32_t flicker = static_cast<int32_t>(NextRandom() % (2 * m_config.flicker_amplitude + 1)) - m_config.flicker_amplitude;
+
+        video_data.resize(VIDEO_WIDTH * VIDEO_HEIGHT);
+        for(uint32_t i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; i++)
+        {
+            uint16_t depth = depth_data[i % (DEPTH_WIDTH * DEPTH_HEIGHT)];
+            int32_t ir = (depth == BLANK_DEPTH_PIXEL) ? 0 : IR_MAX_VALUE - depth / 2 + flicker;
+            video_data[i] = std::clamp<int32_t>(ir, 0, IR_MAX_VALUE);
+        }
+    }
+
+    return render_video;
+}
+
+void SyntheticKinect::ExecutionCycle()
+{
+    bool video_rendered = RenderFrames(m_depth_data, m_video_data);
+    uint32_t timestamp = static_cast<uint32_t>(m_num_frames);
+
+    m_frame_source.DeliverDepthFrame(m_depth_data.data(), timestamp);
+
+    if(video_rendered)
+    {
+        m_frame_source.DeliverVideoFrame(m_video_data.data(), timestamp);
+    }
+}
@@ -10,6 +10,11 @@
  *******************************************************************/
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <thread>
 
 #include "../common/mocks/kinect_mock.hpp"
 #include "../common/mocks/message_broker_mock.hpp"
@@ -31,6 +36,8 @@ using ::testing::DoAll;
 using ::testing::Invoke;
 using ::testing::InSequence;
 using ::testing::Mock;
+using ::testing::SaveArg;
+using ::testing::InvokeWithoutArgs;
 
 std::shared_ptr<IDataTable> g_data_table_mock;
 std::shared_ptr<KinectMock> g_kinect_mock;
@@ -40,6 +47,37 @@ std::shared_ptr<StatePersistenceFactoryMock> g_state_persistence_factory_mock;
 std::shared_ptr<DataTableMock> g_detection_datatable_mock;
 std::shared_ptr<DataTableMock> g_status_datatable_mock;
 
+/* Frame the pipeline copies the captured ones to, its JPEG encoding always fails */
+class UnencodableVideoFrame : public KinectVideoFrame
+{
+public:
+    UnencodableVideoFrame() : KinectVideoFrame(VIDEO_WIDTH, VIDEO_HEIGHT) {}
+
+    int SaveToJpegInMemory(std::vector<uint8_t>& jpeg_frame, int32_t brightness, int32_t contrast) override
+    {
+        return -1;
+    }
+};
+
+class GatedVideoFrame : public KinectVideoFrame
+{
+public:
+    GatedVideoFrame(std::shared_future<void> gate, std::shared_ptr<std::atomic<bool>> encoding) :
+        KinectVideoFrame(VIDEO_WIDTH, VIDEO_HEIGHT), m_gate(gate), m_encoding(encoding) {}
+
+    /* Holds the encode stage until the gate opens */
+    int SaveToJpegInMemory(std::vector<uint8_t>& jpeg_frame, int32_t brightness, int32_t contrast) override
+    {
+        *m_encoding = true;
+        m_gate.wait();
+        return KinectVideoFrame::SaveToJpegInMemory(jpeg_frame, brightness, contrast);
+    }
+
+private:
+    std::shared_future<void> m_gate;
+    std::shared_ptr<std::atomic<bool>> m_encoding;
+};
+
 class AlarmTest : public ::testing::Test
 {
 protected:
@@ -76,6 +114,9 @@ public:
         m_data_base_mock                 = std::make_shared<StrictMock<DatabaseMock>>();
         m_message_broker_mock            = std::make_shared<StrictMock<MessageBrokerMock>>();
 
+        std::filesystem::remove_all(DETECTION_PATH);
+        std::filesystem::create_directories(DETECTION_PATH);
+
         m_alarm = std::make_shared<Alarm>(m_message_broker_mock, m_data_base_mock);
     }
 
@@ -143,6 +184,11 @@ public:
 
     void FakeIntrusion()
     {
+        /* No frame was encoded, the email goes without snapshot from the disk stage */
+        std::promise<void> email_sent;
+        EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", "")).
+            WillOnce(DoAll(Invoke([&email_sent](const std::string&, const std::string&) { email_sent.set_value(); }), Return(0)));
+
         InSequence seq;
         AlarmDetectionObserver detection_observer(*m_alarm);
 
@@ -154,16 +200,18 @@ public:
         EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
             WillOnce(Return(0));
 
-        EXPECT_CALL(*m_message_broker_mock, Publish("new_det", _)).
-            WillOnce(Return(0));
         EXPECT_CALL(*g_detection_datatable_mock, InsertItem(_)).
             WillOnce(Return(0));
         EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
             WillOnce(Return(0));
+        EXPECT_CALL(*m_message_broker_mock, Publish("new_det", _)).
+            WillOnce(Return(0));
         EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
             WillOnce(Return(0));
 
         detection_observer.IntrusionStopped(1);
+        email_sent.get_future().wait();
+        m_alarm->SyncPersistence();
     }
 
 };
@@ -230,6 +278,24 @@ TEST_F(AlarmTest, InitFailedStatusPersistenceTable)
     EXPECT_NE(0, alarm.Init());
 }
 
+TEST_F(AlarmTest, InitFailedCreatingStatus)
+{
+    Alarm alarm(m_message_broker_mock, m_data_base_mock);
+
+    EXPECT_CALL(*g_state_persistence_factory_mock, CreateDatatable(_, "DETECTIONS", _)).
+        WillOnce(Return(g_detection_datatable_mock));
+    EXPECT_CALL(*g_state_persistence_factory_mock, CreateDatatable(_, "STATUS", _)).
+        WillOnce(Return(g_status_datatable_mock));
+    EXPECT_CALL(*g_status_datatable_mock, GetItem(_)).
+        WillOnce(Return(-1));
+
+    /* Waited for, its failure is known */
+    EXPECT_CALL(*g_status_datatable_mock, InsertItem(_, true)).
+        WillOnce(Return(-1));
+
+    EXPECT_NE(0, alarm.Init());
+}
+
 TEST_F(AlarmTest, InitFailedReadingStatusTable)
 {
     Alarm alarm(m_message_broker_mock, m_data_base_mock);
@@ -240,7 +306,7 @@ TEST_F(AlarmTest, InitFailedReadingStatusTable)
         WillOnce(Return(g_status_datatable_mock));
     EXPECT_CALL(*g_status_datatable_mock, GetItem(_)).
         WillOnce(Return(-1));
-    EXPECT_CALL(*g_status_datatable_mock, InsertItem(_)).
+    EXPECT_CALL(*g_status_datatable_mock, InsertItem(_, true)).
         WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillRepeatedly(Return(0));
@@ -270,7 +336,7 @@ TEST_F(AlarmTest, InitFailedKinectInit)
         WillOnce(Return(g_status_datatable_mock));
     EXPECT_CALL(*g_status_datatable_mock, GetItem(_)).
         WillOnce(Return(-1));
-    EXPECT_CALL(*g_status_datatable_mock, InsertItem(_)).
+    EXPECT_CALL(*g_status_datatable_mock, InsertItem(_, true)).
         WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillRepeatedly(Return(0));
@@ -322,9 +388,7 @@ TEST_F(AlarmTest, InitDetectionIsActive)
         WillOnce(Return(false));
     EXPECT_CALL(*g_detection_mock, Start).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
-        WillOnce(Return(0));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     /* UpdateLed */
@@ -333,6 +397,8 @@ TEST_F(AlarmTest, InitDetectionIsActive)
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
         WillOnce(Return(0));
 
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Detection started")).
         WillOnce(Return(0));
 
@@ -383,9 +449,7 @@ TEST_F(AlarmTest, InitLiveviewIsActive)
         WillOnce(Return(false));
     EXPECT_CALL(*g_liveview_mock, Start).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
-        WillOnce(Return(0));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     /* UpdateLed */
@@ -396,6 +460,8 @@ TEST_F(AlarmTest, InitLiveviewIsActive)
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
         WillOnce(Return(0));
 
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Liveview started")).
         WillOnce(Return(0));
 
@@ -419,9 +485,7 @@ TEST_F(AlarmTest, StartDetection)
         WillOnce(Return(false));
     EXPECT_CALL(*g_detection_mock, Start).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
-        WillOnce(Return(0));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     /* UpdateLed */
@@ -430,6 +494,8 @@ TEST_F(AlarmTest, StartDetection)
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
         WillOnce(Return(0));
 
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Detection started")).
         WillOnce(Return(0));
 
@@ -446,9 +512,7 @@ TEST_F(AlarmTest, StopDetection)
         WillOnce(Return(true));
     EXPECT_CALL(*g_detection_mock, Stop).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
-        WillOnce(Return(0));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     /* UpdateLed */
@@ -459,6 +523,8 @@ TEST_F(AlarmTest, StopDetection)
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
         WillOnce(Return(0));
 
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Detection stopped")).
         WillOnce(Return(0));
 
@@ -486,9 +552,7 @@ TEST_F(AlarmTest, StartLiveview)
         WillOnce(Return(false));
     EXPECT_CALL(*g_liveview_mock, Start).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
-        WillOnce(Return(0));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     /* UpdateLed */
@@ -499,6 +563,8 @@ TEST_F(AlarmTest, StartLiveview)
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
         WillOnce(Return(0));
 
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Liveview started")).
         WillOnce(Return(0));
 
@@ -515,9 +581,7 @@ TEST_F(AlarmTest, StopLiveview)
         WillOnce(Return(true));
     EXPECT_CALL(*g_liveview_mock, Stop).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
-        WillOnce(Return(0));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     /* UpdateLed */
@@ -528,6 +592,8 @@ TEST_F(AlarmTest, StopLiveview)
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
         WillOnce(Return(0));
 
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Liveview stopped")).
         WillOnce(Return(0));
 
@@ -542,10 +608,47 @@ TEST_F(AlarmTest, StopLiveview)
     ClearExpectationsOnMocks();
 }
 
+TEST_F(AlarmTest, StartStopRecording)
+{
+    InSequence seq;
+    AlarmInit();
+    std::filesystem::remove_all(KINECT_RECORDING_PATH);
+    std::filesystem::create_directories(KINECT_RECORDING_PATH);
+
+    EXPECT_CALL(*g_kinect_mock, IsRunning).
+        WillOnce(Return(true));
+    EXPECT_CALL(*g_kinect_mock, Subscribe(KinectFrameType::Depth, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, Subscribe(KinectFrameType::Video, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, ::testing::StartsWith("Recording started "))).
+        WillOnce(Return(0));
+
+    EXPECT_EQ(0, m_alarm->StartRecording());
+    ClearExpectationsOnMocks();
+
+    EXPECT_CALL(*g_kinect_mock, Unsubscribe(KinectFrameType::Depth, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, Unsubscribe(KinectFrameType::Video, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_INFO_CHANNEL, "Recording stopped, 0 frames, 0 dropped")).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_detection_mock, IsRunning).
+        WillOnce(Return(false));
+    EXPECT_CALL(*g_liveview_mock, IsRunning).
+        WillOnce(Return(false));
+    EXPECT_CALL(*g_kinect_mock, Stop).
+        WillOnce(Return(0));
+
+    EXPECT_EQ(0, m_alarm->StopRecording());
+    ClearExpectationsOnMocks();
+
+    EXPECT_EQ(1, std::distance(std::filesystem::directory_iterator(KINECT_RECORDING_PATH), std::filesystem::directory_iterator()));
+}
+
 
 TEST_F(AlarmTest, GetNumDetections)
 {
-    InSequence seq;
     AlarmInit();
 
     EXPECT_EQ(0, m_alarm->GetNumDetections());
@@ -556,6 +659,35 @@ TEST_F(AlarmTest, GetNumDetections)
     ClearExpectationsOnMocks();
 }
 
+TEST_F(AlarmTest, ListDetections)
+{
+    AlarmInit();
+
+    /* A full page of two, so the cursor of the next one is the last detection */
+    EXPECT_CALL(*g_detection_datatable_mock, QueryItems(_, _, _)).
+        WillOnce(Invoke([](Entry& item, const ItemRange& range, const std::function<bool(const Entry&)>& on_item)
+        {
+            EXPECT_EQ("DATE", range.column);
+            EXPECT_EQ(2U, range.limit);
+            EXPECT_EQ(Value(1500), range.before_column.value());
+            EXPECT_EQ(Value(15), range.before_key.value());
+
+            for(int32_t id : {14, 13})
+            {
+                item[0].value = id;
+                item[1].value = 1000 + id;
+                item[2].value = 5;
+                on_item(item);
+            }
+            return 0;
+        }));
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_DET_LIST_CHANNEL, "detlist 2 1013 13\n14 1014 5\n13 1013 5")).
+        WillOnce(Return(0));
+
+    EXPECT_EQ(0, m_alarm->ListDetections(1000, 2000, 2, 1500, 15));
+    ClearExpectationsOnMocks();
+}
+
 /*TESTs for ResetDetection */
 /*TESTs for DeleteDetection */
 
@@ -569,7 +701,7 @@ TEST_F(AlarmTest, ChangeTilt)
         WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     EXPECT_EQ(0, m_alarm->ChangeTilt(tilt_value));
@@ -584,7 +716,7 @@ TEST_F(AlarmTest, ChangeBrightness)
 
     EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     EXPECT_EQ(0, m_alarm->ChangeBrightness(value));
@@ -599,7 +731,7 @@ TEST_F(AlarmTest, ChangeContrast)
 
     EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
 
     EXPECT_EQ(0, m_alarm->ChangeContrast(value));
@@ -613,9 +745,9 @@ TEST_F(AlarmTest, ChangeThreshold)
     AlarmInit();
 
     EXPECT_CALL(*g_detection_mock, UpdateConfig(_));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_SUCCESS_CHANNEL, _)).
         WillOnce(Return(0));
@@ -631,9 +763,9 @@ TEST_F(AlarmTest, ChangeSensitivity)
     AlarmInit();
 
     EXPECT_CALL(*g_detection_mock, UpdateConfig(_));
-    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
         WillOnce(Return(0));
-    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
         WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_SUCCESS_CHANNEL, _)).
         WillOnce(Return(0));
@@ -654,13 +786,45 @@ TEST_F(AlarmTest, NewFrame)
     liveview_observer.NewFrame(frame);
 }
 
+TEST_F(AlarmTest, PipelineStats)
+{
+    KinectVideoFrame frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+    Alarm alarm(m_message_broker_mock, m_data_base_mock);
+    AlarmLiveviewObserver liveview_observer(alarm);
+    FramePipelineStats stats;
+
+    EXPECT_CALL(*m_message_broker_mock, Publish("liveview", _)).
+        Times(2).
+        WillRepeatedly(Return(0));
+
+    frame.SetTimestamp(1);
+    liveview_observer.NewFrame(frame);
+    frame.SetTimestamp(2);
+    liveview_observer.NewFrame(frame);
+
+    /* Encoded by one stage and published by the next one */
+    for(int i = 0; i < 500; i++)
+    {
+        stats = alarm.GetPipelineStats();
+        if(stats.publish.processed == 2)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(2U, stats.encode.processed);
+    EXPECT_EQ(0U, stats.encode.dropped);
+    EXPECT_EQ(2U, stats.publish.pushed);
+    EXPECT_EQ(2U, stats.publish.processed);
+    EXPECT_EQ(0U, stats.disk.pushed);
+}
+
 TEST_F(AlarmTest, IntrusionStarted)
 {
     AlarmInit();
     AlarmDetectionObserver detection_observer(*m_alarm);
 
-    EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", _)).
-        WillOnce(Return(0));
     EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_ERROR_CHANNEL, _)).
         WillOnce(Return(0));
     EXPECT_CALL(*g_kinect_mock, ChangeLedColor(LED_RED)).
@@ -692,7 +856,12 @@ TEST_F(AlarmTest, IntrusionStopped)
     EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
         WillOnce(Return(0));
 
+    /* Without frames the email goes without snapshot */
+    EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", "")).
+        WillOnce(Return(0));
+
     detection_observer.IntrusionStopped(1);
+    m_alarm->SyncPersistence();
     ClearExpectationsOnMocks();
 }
 
@@ -702,6 +871,240 @@ TEST_F(AlarmTest, IntrusionFrame)
     AlarmInit();
     AlarmDetectionObserver detection_observer(*m_alarm);
 
+    EXPECT_CALL(*m_message_broker_mock, Publish(_, _)).
+        WillRepeatedly(Return(0));
+    EXPECT_CALL(*g_kinect_mock, ChangeLedColor(LED_RED)).
+        WillOnce(Return(0));
+
+    /* Its frames go to the container of the detection */
+    detection_observer.IntrusionStarted();
+    EXPECT_TRUE(std::filesystem::exists(DETECTION_PATH "/0/" DETECTION_CONTAINER_NAME));
+
     detection_observer.IntrusionFrame(frame, 1);
     ClearExpectationsOnMocks();
 }
+
+TEST_F(AlarmTest, IntrusionSnapshot)
+{
+    std::shared_ptr<KinectVideoFrame> frame = std::make_shared<KinectVideoFrame>(640, 480);
+    std::promise<void> published;
+    AlarmInit();
+    AlarmDetectionObserver detection_observer(*m_alarm);
+
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_ERROR_CHANNEL, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, ChangeLedColor(LED_RED)).
+        WillOnce(Return(0));
+    detection_observer.IntrusionStarted();
+
+    /* The email is sent with the first frame, once it is on disk */
+    EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", DETECTION_PATH "/0/" DETECTION_SNAPSHOT_NAME)).
+        WillOnce(DoAll(InvokeWithoutArgs([&published] { published.set_value(); }), Return(0)));
+    detection_observer.IntrusionFrame(frame, 0);
+
+    ASSERT_EQ(std::future_status::ready, published.get_future().wait_for(std::chrono::seconds(5)));
+    EXPECT_LT(0U, std::filesystem::file_size(DETECTION_PATH "/0/" DETECTION_SNAPSHOT_NAME));
+    ClearExpectationsOnMocks();
+}
+
+TEST_F(AlarmTest, IntrusionEmailWithoutSnapshot)
+{
+    std::shared_ptr<KinectVideoFrame> frame = std::make_shared<KinectVideoFrame>(VIDEO_WIDTH, VIDEO_HEIGHT);
+    std::promise<void> published;
+
+    m_alarm = std::make_shared<Alarm>(m_message_broker_mock, m_data_base_mock, []
+    {
+        return std::make_unique<UnencodableVideoFrame>();
+    });
+    AlarmInit();
+    AlarmDetectionObserver detection_observer(*m_alarm);
+
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_ERROR_CHANNEL, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
+        WillRepeatedly(Return(0));
+    EXPECT_CALL(*g_detection_mock, IsRunning).
+        WillRepeatedly(Return(false));
+    EXPECT_CALL(*g_liveview_mock, IsRunning).
+        WillRepeatedly(Return(false));
+    EXPECT_CALL(*m_message_broker_mock, Publish("new_det", _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_detection_datatable_mock, InsertItem(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+        WillOnce(Return(0));
+
+    /* The first frame couldn't be encoded, the email is still sent when the intrusion ends */
+    EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", "")).
+        WillOnce(DoAll(InvokeWithoutArgs([&published] { published.set_value(); }), Return(0)));
+
+    detection_observer.IntrusionStarted();
+    detection_observer.IntrusionFrame(frame, 0);
+    detection_observer.IntrusionStopped(1);
+
+    ASSERT_EQ(std::future_status::ready, published.get_future().wait_for(std::chrono::seconds(5)));
+    m_alarm->SyncPersistence();
+    EXPECT_FALSE(std::filesystem::exists(DETECTION_PATH "/0/" DETECTION_SNAPSHOT_NAME));
+    ClearExpectationsOnMocks();
+}
+
+TEST_F(AlarmTest, IntrusionEmailAfterDroppedFirstFrame)
+{
+    std::shared_ptr<KinectVideoFrame> frame = std::make_shared<KinectVideoFrame>(VIDEO_WIDTH, VIDEO_HEIGHT);
+    std::promise<void> gate;
+    std::shared_future<void> gate_future = gate.get_future().share();
+    auto encoding = std::make_shared<std::atomic<bool>>(false);
+    std::promise<void> published;
+
+    m_alarm = std::make_shared<Alarm>(m_message_broker_mock, m_data_base_mock, [gate_future, encoding]
+    {
+        return std::make_unique<GatedVideoFrame>(gate_future, encoding);
+    });
+    AlarmInit();
+    AlarmDetectionObserver detection_observer(*m_alarm);
+
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_ERROR_CHANNEL, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, ChangeLedColor(LED_RED)).
+        WillOnce(Return(0));
+    detection_observer.IntrusionStarted();
+
+    /* The encode stage holds one frame and its input is full, the first frame of the detection is dropped */
+    detection_observer.IntrusionFrame(frame, 1);
+    while(!*encoding)
+    {
+        std::this_thread::yield();
+    }
+    for(uint32_t frame_num = 2; frame_num < 2 + FRAME_PIPELINE_CAPACITY; frame_num++)
+    {
+        detection_observer.IntrusionFrame(frame, frame_num);
+    }
+    detection_observer.IntrusionFrame(frame, 0);
+    EXPECT_EQ(1U, m_alarm->GetPipelineStats().encode.dropped);
+
+    /* The snapshot is the first frame that made it to the disk */
+    EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", DETECTION_PATH "/0/" DETECTION_SNAPSHOT_NAME)).
+        WillOnce(DoAll(InvokeWithoutArgs([&published] { published.set_value(); }), Return(0)));
+    gate.set_value();
+
+    ASSERT_EQ(std::future_status::ready, published.get_future().wait_for(std::chrono::seconds(5)));
+    ClearExpectationsOnMocks();
+}
+
+TEST_F(AlarmTest, IntrusionStoppedWithEncodeInputFull)
+{
+    std::shared_ptr<KinectVideoFrame> frame = std::make_shared<KinectVideoFrame>(VIDEO_WIDTH, VIDEO_HEIGHT);
+    std::promise<void> gate;
+    std::shared_future<void> gate_future = gate.get_future().share();
+    auto encoding = std::make_shared<std::atomic<bool>>(false);
+    std::promise<void> published;
+
+    m_alarm = std::make_shared<Alarm>(m_message_broker_mock, m_data_base_mock, [gate_future, encoding]
+    {
+        return std::make_unique<GatedVideoFrame>(gate_future, encoding);
+    });
+    AlarmInit();
+    AlarmDetectionObserver detection_observer(*m_alarm);
+
+    EXPECT_CALL(*m_message_broker_mock, Publish(REDIS_EVENT_ERROR_CHANNEL, _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
+        WillRepeatedly(Return(0));
+    EXPECT_CALL(*g_detection_mock, IsRunning).
+        WillRepeatedly(Return(false));
+    EXPECT_CALL(*g_liveview_mock, IsRunning).
+        WillRepeatedly(Return(false));
+    detection_observer.IntrusionStarted();
+
+    /* The encode stage holds one frame and its input is full */
+    detection_observer.IntrusionFrame(frame, 1);
+    while(!*encoding)
+    {
+        std::this_thread::yield();
+    }
+    for(uint32_t frame_num = 2; frame_num < 2 + FRAME_PIPELINE_CAPACITY; frame_num++)
+    {
+        detection_observer.IntrusionFrame(frame, frame_num);
+    }
+
+    EXPECT_CALL(*m_message_broker_mock, Publish("new_det", _)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_detection_datatable_mock, InsertItem(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*m_message_broker_mock, Publish("email_send_det", DETECTION_PATH "/0/" DETECTION_SNAPSHOT_NAME)).
+        WillOnce(DoAll(InvokeWithoutArgs([&published] { published.set_value(); }), Return(0)));
+
+    /* The end of the detection doesn't wait for the encode stage */
+    std::future<void> stopped = std::async(std::launch::async, [&detection_observer] { detection_observer.IntrusionStopped(1 + FRAME_PIPELINE_CAPACITY); });
+    EXPECT_EQ(std::future_status::ready, stopped.wait_for(std::chrono::seconds(5)));
+    EXPECT_EQ(0U, m_alarm->GetPipelineStats().encode.dropped);
+
+    gate.set_value();
+    stopped.wait();
+    ASSERT_EQ(std::future_status::ready, published.get_future().wait_for(std::chrono::seconds(5)));
+    m_alarm->SyncPersistence();
+    ClearExpectationsOnMocks();
+}
+
+TEST_F(AlarmTest, RecoverInterruptedDetection)
+{
+    InSequence seq;
+    Entry recovered;
+
+    /* Stopped in the middle of the intrusion: manifest without end, container without index */
+    std::filesystem::create_directories(DETECTION_PATH "/5");
+    {
+        const uint8_t jpeg[10] = {};
+        uint64_t offset;
+        FrameContainerWriter writer(DETECTION_PATH "/5/" DETECTION_CONTAINER_NAME, 1000, 0);
+        writer.Append(0, 1, jpeg, sizeof(jpeg), offset);
+        writer.Append(1, 2, jpeg, sizeof(jpeg), offset);
+        writer.Close();
+        std::filesystem::resize_file(DETECTION_PATH "/5/" DETECTION_CONTAINER_NAME, offset + sizeof(jpeg));
+    }
+    std::ofstream(DETECTION_PATH "/5/manifest") << "detection 5 1000\n"
+                                                   "frame 0 1 " DETECTION_CONTAINER_NAME " 40 10\n"
+                                                   "frame 1 2 " DETECTION_CONTAINER_NAME " 74 10\n";
+
+    EXPECT_CALL(*g_state_persistence_factory_mock, CreateDatatable(_, "DETECTIONS", _)).
+        WillOnce(Return(g_detection_datatable_mock));
+    EXPECT_CALL(*g_state_persistence_factory_mock, CreateDatatable(_, "STATUS", _)).
+        WillOnce(Return(g_status_datatable_mock));
+    EXPECT_CALL(*g_status_datatable_mock, GetItem(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*m_message_broker_mock, SetVariable(_)).Times(8).
+        WillRepeatedly(Return(0));
+    EXPECT_CALL(*g_kinect_mock, Init).
+        WillOnce(Return(0));
+
+    /* RecoverDetections */
+    EXPECT_CALL(*g_detection_datatable_mock, InsertItem(_, true)).
+        WillOnce(DoAll(SaveArg<0>(&recovered), Return(0)));
+    EXPECT_CALL(*g_status_datatable_mock, SetItem(_, true)).
+        WillOnce(Return(0));
+
+    EXPECT_CALL(*g_detection_mock, IsRunning).
+        WillOnce(Return(false));
+    EXPECT_CALL(*g_liveview_mock, IsRunning).
+        WillOnce(Return(false));
+    EXPECT_CALL(*g_kinect_mock, ChangeLedColor(_)).
+        WillOnce(Return(0));
+    EXPECT_CALL(*g_kinect_mock, ChangeTilt(_)).
+        WillOnce(Return(0));
+
+    EXPECT_EQ(0, m_alarm->Init());
+
+    ASSERT_EQ(5U, recovered.size());
+    EXPECT_EQ(5, std::get<int32_t>(recovered[0].value));
+    EXPECT_EQ(1000, std::get<int32_t>(recovered[1].value));
+    EXPECT_EQ(2, std::get<int32_t>(recovered[2].value));
+    EXPECT_EQ(DETECTION_PATH "/5/capture.zip", std::get<std::string>(recovered[3].value));
+    EXPECT_EQ(6, m_alarm->GetNumDetections());
+    ClearExpectationsOnMocks();
+}
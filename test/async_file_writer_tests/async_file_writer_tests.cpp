@@ -0,0 +1,163 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file async_file_writer_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../../inc/async_file_writer.hpp"
+
+using ::testing::TestWithParam;
+using ::testing::Values;
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+
+/* Parameter: whether to use io_uring, it falls back to the thread if the kernel doesn't have it */
+class AsyncFileWriterTest : public TestWithParam<bool>
+{
+public:
+    const std::string m_path = "/tmp/kinectalarm_async_file_writer_tests";
+
+    void SetUp() override
+    {
+        std::filesystem::remove_all(m_path);
+        std::filesystem::create_directories(m_path);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_path);
+    }
+
+    int Open(const std::string& filename)
+    {
+        return open((m_path + "/" + filename).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    }
+
+    std::string Read(const std::string& filename)
+    {
+        std::ifstream file(m_path + "/" + filename, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_P(AsyncFileWriterTest, WriteSyncClose)
+{
+    AsyncFileWriter writer(4, GetParam());
+    std::string first = "first ", second = "second";
+    std::vector<int> results;
+    int fd = Open("file");
+
+    ASSERT_LE(0, fd);
+    writer.Write(fd, {{first.data(), first.size()}, {second.data(), second.size()}}, 0, [&results](int result) { results.push_back(result); });
+    writer.Sync(fd, [&results](int result) { results.push_back(result); });
+    writer.Close(fd, [&results](int result) { results.push_back(result); });
+    writer.Flush();
+
+    EXPECT_EQ((std::vector<int>{12, 0, 0}), results);
+    EXPECT_EQ("first second", Read("file"));
+}
+
+TEST_P(AsyncFileWriterTest, ManyWritesAtTheirOffsets)
+{
+    AsyncFileWriter writer(8, GetParam());
+    std::vector<std::string> blocks;
+    std::atomic<int> written(0);
+    std::string expected;
+    int fd = Open("file");
+
+    for(int i = 0; i < 100; i++)
+    {
+        blocks.push_back(std::string(1000, static_cast<char>('a' + i % 26)));
+        expected += blocks.back();
+    }
+
+    /* More than the queue depth, completed in any order */
+    for(int i = 0; i < 100; i++)
+    {
+        writer.Write(fd, {{blocks[i].data(), blocks[i].size()}}, i * 1000, [&written](int result) { written += result; });
+    }
+    writer.Close(fd, [](int) {});
+    writer.Flush();
+
+    EXPECT_EQ(100000, written.load());
+    EXPECT_EQ(expected, Read("file"));
+}
+
+TEST_P(AsyncFileWriterTest, CloseAfterPreviousWrites)
+{
+    AsyncFileWriter writer(8, GetParam());
+    std::vector<int> results;
+    std::string block(64 * 1024, 'x');
+    int fd = Open("file");
+
+    for(int i = 0; i < 16; i++)
+    {
+        writer.Write(fd, {{block.data(), block.size()}}, i * block.size(), [&results](int result) { results.push_back(result); });
+    }
+    writer.Close(fd, [&results](int result) { results.push_back(-1000 + result); });
+    writer.Flush();
+
+    ASSERT_EQ(17U, results.size());
+    EXPECT_EQ(-1000, results.back());
+    EXPECT_EQ(16 * block.size(), std::filesystem::file_size(m_path + "/file"));
+}
+
+TEST_P(AsyncFileWriterTest, ErrorReported)
+{
+    AsyncFileWriter writer(4, GetParam());
+    std::string data = "data";
+    std::vector<int> results;
+
+    writer.Write(-1, {{data.data(), data.size()}}, 0, [&results](int result) { results.push_back(result); });
+    writer.Sync(-1, [&results](int result) { results.push_back(result); });
+    writer.Flush();
+
+    EXPECT_EQ((std::vector<int>{-EBADF, -EBADF}), results);
+}
+
+TEST_P(AsyncFileWriterTest, DestructorCompletesPending)
+{
+    std::string data(4096, 'y');
+    std::atomic<int> completed(0);
+    int fd = Open("file");
+
+    {
+        AsyncFileWriter writer(2, GetParam());
+        for(int i = 0; i < 10; i++)
+        {
+            writer.Write(fd, {{data.data(), data.size()}}, i * data.size(), [&completed](int) { completed++; });
+        }
+        writer.Close(fd, [&completed](int) { completed++; });
+    }
+
+    EXPECT_EQ(11, completed.load());
+    EXPECT_EQ(10 * data.size(), std::filesystem::file_size(m_path + "/file"));
+}
+
+TEST(AsyncFileWriterFallbackTest, ThreadWhenAsked)
+{
+    AsyncFileWriter writer(4, false);
+
+    EXPECT_FALSE(writer.IsUring());
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, AsyncFileWriterTest, Values(true, false));
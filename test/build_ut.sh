@@ -6,13 +6,29 @@ set -e
 # Parameters
 ################################################################################
 TEST_FILES=("alarm_tests"
+            "async_file_writer_tests"
             "cyclic_task_tests"
+            "detection_storage_tests"
             "detection_tests"
+            "frame_container_tests"
+            "jpeg_cache_tests"
             "kinect_frame_tests"
             "kinect_tests"
+            "liveview_shm_tests"
             "liveview_tests"
+            "logger_tests"
             "message_broker_tests"
-            "state_persistence_tests")
+            "mjpeg_server_tests"
+            "mpsc_queue_tests"
+            "persistence_worker_tests"
+            "pipeline_stage_tests"
+            "replay_kinect_tests"
+            "resp_writer_tests"
+            "ring_buffer_tests"
+            "row_schema_tests"
+            "spsc_queue_tests"
+            "state_persistence_tests"
+            "synthetic_kinect_tests")
 
 SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
 DEFAULT_BUILD_FOLDER="build"
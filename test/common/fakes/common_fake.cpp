@@ -1,6 +1,6 @@
 #include "../../../inc/common.hpp"
 
-int CreateDirectory(char *dir)
+int CreateDirectory(const char *dir)
 {
     return 0;
 }
@@ -0,0 +1,514 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file resp_server_fake.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "resp_server_fake.hpp"
+
+/*******************************************************************
+ * Class definition
+ *******************************************************************/
+RespServerFake::RespServerFake(const std::string& path) :
+    m_path(path),
+    m_listen_fd(-1)
+{
+    m_running = false;
+    m_disconnect_requested = false;
+    m_latency_us = 0;
+    m_command_count = 0;
+    m_client_count = 0;
+
+    if(0 != pipe2(m_wake_pipe, O_NONBLOCK))
+    {
+        throw std::exception();
+    }
+
+    if(0 != Start())
+    {
+        close(m_wake_pipe[0]);
+        close(m_wake_pipe[1]);
+        throw std::exception();
+    }
+}
+
+RespServerFake::~RespServerFake()
+{
+    Stop();
+    close(m_wake_pipe[0]);
+    close(m_wake_pipe[1]);
+}
+
+int RespServerFake::Start()
+{
+    int retval = -1;
+    sockaddr_un address = {};
+
+    std::lock_guard<std::mutex> lock(m_start_mutex);
+
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, m_path.c_str(), sizeof(address.sun_path) - 1);
+
+    if(m_running)
+    {
+        retval = 0;
+    }
+    else
+    {
+        /* A socket file left by a previous run would make bind() fail */
+        unlink(m_path.c_str());
+
+        m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if(m_listen_fd < 0)
+        {
+        }
+        else if(0 != bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ||
+                0 != listen(m_listen_fd, 16))
+        {
+            close(m_listen_fd);
+            m_listen_fd = -1;
+        }
+        else
+        {
+            m_running = true;
+            m_thread = std::make_unique<std::thread>(&RespServerFake::Serve, this);
+            retval = 0;
+        }
+    }
+
+    return retval;
+}
+
+void RespServerFake::Stop()
+{
+    std::lock_guard<std::mutex> lock(m_start_mutex);
+
+    if(m_running)
+    {
+        m_running = false;
+        Wake();
+        m_thread->join();
+        m_thread.reset();
+    }
+}
+
+void RespServerFake::DisconnectClients()
+{
+    m_disconnect_requested = true;
+    Wake();
+}
+
+void RespServerFake::SetReplyLatency(std::chrono::microseconds latency)
+{
+    m_latency_us = latency.count();
+}
+
+uint64_t RespServerFake::GetCommandCount()
+{
+    return m_command_count;
+}
+
+uint32_t RespServerFake::GetClientCount()
+{
+    return m_client_count;
+}
+
+void RespServerFake::Wake()
+{
+    char byte = 0;
+
+    if(write(m_wake_pipe[1], &byte, 1) < 0)
+    {
+        /* Already full, the server thread is going to wake anyway */
+    }
+}
+
+void RespServerFake::Serve()
+{
+    std::vector<pollfd> poll_fds;
+    char byte;
+
+    while(m_running)
+    {
+        if(m_disconnect_requested.exchange(false))
+        {
+            CloseClients();
+        }
+
+        poll_fds.clear();
+        poll_fds.push_back({m_wake_pipe[0], POLLIN, 0});
+        poll_fds.push_back({m_listen_fd, POLLIN, 0});
+        for(const auto& client : m_clients)
+        {
+            poll_fds.push_back({client->fd, static_cast<short>(POLLIN | (client->output.empty() ? 0 : POLLOUT)), 0});
+        }
+
+        if(poll(poll_fds.data(), poll_fds.size(), -1) < 0)
+        {
+            continue;
+        }
+
+        while(read(m_wake_pipe[0], &byte, 1) > 0)
+        {
+        }
+
+        /* Only the clients polled, the accepted one is served on the next round */
+        for(size_t i = 0; i < poll_fds.size() - 2; i++)
+        {
+            Client& client = *m_clients[i];
+
+            if((poll_fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) && !ReadClient(client))
+            {
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+
+        if(poll_fds[1].revents & POLLIN)
+        {
+            AcceptClient();
+        }
+
+        /* A PUBLISH also fills the output of the subscribers */
+        for(auto& client : m_clients)
+        {
+            if(client->fd >= 0 && !client->output.empty() && !WriteClient(*client))
+            {
+                close(client->fd);
+                client->fd = -1;
+            }
+        }
+
+        m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                       [](const std::unique_ptr<Client>& client) { return client->fd < 0; }),
+                        m_clients.end());
+        m_client_count = m_clients.size();
+    }
+
+    CloseClients();
+    close(m_listen_fd);
+    m_listen_fd = -1;
+    unlink(m_path.c_str());
+}
+
+void RespServerFake::AcceptClient()
+{
+    int fd;
+
+    while((fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+    {
+        auto client = std::make_unique<Client>();
+
+        client->fd = fd;
+        m_clients.push_back(std::move(client));
+    }
+}
+
+bool RespServerFake::ReadClient(Client& client)
+{
+    bool retval = true;
+    char buffer[16384];
+    std::vector<std::string> command;
+    ssize_t received;
+    int parsed;
+
+    while((received = recv(client.fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        client.input.append(buffer, received);
+    }
+    if(received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        retval = false;
+    }
+
+    while(retval && (parsed = ParseCommand(client.input, command)) != 0)
+    {
+        if(parsed < 0)
+        {
+            /* Only arrays of bulk strings, what hiredis sends */
+            retval = false;
+        }
+        else
+        {
+            ExecuteCommand(client, command);
+        }
+    }
+
+    return retval;
+}
+
+bool RespServerFake::WriteClient(Client& client)
+{
+    bool retval = true;
+    ssize_t sent;
+
+    while(retval && !client.output.empty())
+    {
+        sent = send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+        if(sent > 0)
+        {
+            client.output.erase(0, sent);
+        }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        else
+        {
+            retval = false;
+        }
+    }
+
+    return retval;
+}
+
+void RespServerFake::CloseClients()
+{
+    for(const auto& client : m_clients)
+    {
+        close(client->fd);
+    }
+    m_clients.clear();
+    m_client_count = 0;
+}
+
+int RespServerFake::ParseCommand(std::string& input, std::vector<std::string>& command)
+{
+    size_t position = 0;
+    long length;
+    long arguments;
+
+    /* 1 if it read the header, 0 if it's incomplete, -1 if malformed */
+    auto read_header = [&](char type, long& value)
+    {
+        int retval = 0;
+        size_t end;
+
+        if(position >= input.size())
+        {
+        }
+        else if(input[position] != type)
+        {
+            retval = -1;
+        }
+        else if((end = input.find("\r\n", position)) != std::string::npos)
+        {
+            value = strtol(input.c_str() + position + 1, nullptr, 10);
+            position = end + 2;
+            retval = (value < 0) ? -1 : 1;
+        }
+
+        return retval;
+    };
+
+    int retval = read_header('*', arguments);
+
+    command.clear();
+    while(retval == 1 && command.size() < static_cast<size_t>(arguments))
+    {
+        retval = read_header('$', length);
+        if(retval == 1)
+        {
+            if(position + length + 2 > input.size())
+            {
+                retval = 0;
+            }
+            else
+            {
+                command.emplace_back(input, position, length);
+                position += length + 2;
+            }
+        }
+    }
+
+    if(retval == 1)
+    {
+        input.erase(0, position);
+    }
+
+    return retval;
+}
+
+void RespServerFake::ExecuteCommand(Client& client, const std::vector<std::string>& command)
+{
+    std::string name;
+
+    m_command_count++;
+    if(m_latency_us > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(m_latency_us));
+    }
+
+    if(!command.empty())
+    {
+        name = command[0];
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    }
+
+    if(name == "MULTI")
+    {
+        client.output += client.in_multi ? "-ERR MULTI calls can not be nested\r\n" : "+OK\r\n";
+        client.in_multi = true;
+    }
+    else if(name == "EXEC")
+    {
+        if(!client.in_multi)
+        {
+            client.output += "-ERR EXEC without MULTI\r\n";
+        }
+        else
+        {
+            client.output += "*" + std::to_string(client.queued.size()) + "\r\n";
+            for(const auto& queued : client.queued)
+            {
+                client.output += RunCommand(client, queued);
+            }
+            client.queued.clear();
+            client.in_multi = false;
+        }
+    }
+    else if(client.in_multi)
+    {
+        client.queued.push_back(command);
+        client.output += "+QUEUED\r\n";
+    }
+    else
+    {
+        client.output += RunCommand(client, command);
+    }
+}
+
+std::string RespServerFake::RunCommand(Client& client, const std::vector<std::string>& command)
+{
+    std::string reply;
+    std::string name;
+
+    if(!command.empty())
+    {
+        name = command[0];
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    }
+
+    if(name == "PING" && command.size() == 1)
+    {
+        reply = "+PONG\r\n";
+    }
+    else if(name == "SET" && command.size() == 3)
+    {
+        m_values[command[1]] = Value{command[2], {}, false};
+        reply = "+OK\r\n";
+    }
+    else if(name == "SETEX" && command.size() == 4)
+    {
+        char *end;
+        long seconds = strtol(command[2].c_str(), &end, 10);
+
+        if(command[2].empty() || *end != '\0' || seconds <= 0)
+        {
+            reply = "-ERR invalid expire time in 'setex' command\r\n";
+        }
+        else
+        {
+            m_values[command[1]] = Value{command[3], std::chrono::steady_clock::now() + std::chrono::seconds(seconds), true};
+            reply = "+OK\r\n";
+        }
+    }
+    else if(name == "GET" && command.size() == 2)
+    {
+        auto value = m_values.find(command[1]);
+
+        if(value != m_values.end() && value->second.expires && value->second.expiration <= std::chrono::steady_clock::now())
+        {
+            m_values.erase(value);
+            value = m_values.end();
+        }
+        reply = (value == m_values.end()) ? "$-1\r\n" : BulkString(value->second.data);
+    }
+    else if(name == "FLUSHALL" && command.size() == 1)
+    {
+        m_values.clear();
+        reply = "+OK\r\n";
+    }
+    else if(name == "PUBLISH" && command.size() == 3)
+    {
+        reply = Integer(Deliver(command[1], command[2]));
+    }
+    else if(name == "SUBSCRIBE" && command.size() >= 2)
+    {
+        for(size_t i = 1; i < command.size(); i++)
+        {
+            client.channels.insert(command[i]);
+            reply += "*3\r\n" + BulkString("subscribe") + BulkString(command[i]) + Integer(client.channels.size());
+        }
+    }
+    else if(name == "UNSUBSCRIBE")
+    {
+        std::vector<std::string> channels(command.begin() + 1, command.end());
+
+        if(channels.empty())
+        {
+            channels.assign(client.channels.begin(), client.channels.end());
+        }
+        if(channels.empty())
+        {
+            reply = "*3\r\n" + BulkString("unsubscribe") + "$-1\r\n" + Integer(0);
+        }
+        for(const auto& channel : channels)
+        {
+            client.channels.erase(channel);
+            reply += "*3\r\n" + BulkString("unsubscribe") + BulkString(channel) + Integer(client.channels.size());
+        }
+    }
+    else if(name == "PING" || name == "SET" || name == "SETEX" || name == "GET" ||
+            name == "FLUSHALL" || name == "PUBLISH" || name == "SUBSCRIBE")
+    {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        reply = "-ERR wrong number of arguments for '" + name + "' command\r\n";
+    }
+    else
+    {
+        reply = "-ERR unknown command '" + (command.empty() ? std::string() : command[0]) + "'\r\n";
+    }
+
+    return reply;
+}
+
+uint32_t RespServerFake::Deliver(const std::string& channel, const std::string& message)
+{
+    uint32_t receivers = 0;
+
+    for(auto& client : m_clients)
+    {
+        if(client->fd >= 0 && client->channels.count(channel) > 0)
+        {
+            client->output += "*3\r\n" + BulkString("message") + BulkString(channel) + BulkString(message);
+            receivers++;
+        }
+    }
+
+    return receivers;
+}
+
+std::string RespServerFake::BulkString(const std::string& value)
+{
+    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+std::string RespServerFake::Integer(int64_t value)
+{
+    return ":" + std::to_string(value) + "\r\n";
+}
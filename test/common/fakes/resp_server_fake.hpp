@@ -0,0 +1,116 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file resp_server_fake.hpp
+ *
+ */
+
+#ifndef RESP_SERVER_FAKE__H_
+#define RESP_SERVER_FAKE__H_
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+/*******************************************************************
+ * Class declaration
+ *******************************************************************/
+
+/*
+ * Minimal Redis stand-in listening on a unix socket, so MessageBroker can be tested and
+ * benchmarked without an outside server. Speaks RESP2 and supports SET, SETEX, GET, PUBLISH,
+ * SUBSCRIBE, UNSUBSCRIBE, FLUSHALL, MULTI/EXEC and PING. All the clients are served from one
+ * thread, like Redis does. Latency and disconnects can be injected.
+ */
+class RespServerFake
+{
+public:
+    /**
+     * @brief Start listening on path, an existing socket file is replaced
+     */
+    RespServerFake(const std::string& path);
+    ~RespServerFake();
+
+    /**
+     * @brief Listen again after Stop(), the stored variables are kept
+     *
+     * @return 0 if ok
+     */
+    int Start();
+
+    /**
+     * @brief Close every connection and stop listening, as if the server went down
+     */
+    void Stop();
+
+    /**
+     * @brief Close every connection but keep listening, the clients can reconnect straight away
+     */
+    void DisconnectClients();
+
+    /**
+     * @brief Wait this long before answering each command
+     */
+    void SetReplyLatency(std::chrono::microseconds latency);
+
+    uint64_t GetCommandCount();
+    uint32_t GetClientCount();
+
+private:
+    struct Client
+    {
+        int fd;
+        std::string input;
+        std::string output;
+        std::set<std::string> channels;
+        bool in_multi = false;
+        std::vector<std::vector<std::string>> queued;
+    };
+
+    struct Value
+    {
+        std::string data;
+        std::chrono::steady_clock::time_point expiration;
+        bool expires;
+    };
+
+    std::string m_path;
+    int m_listen_fd;
+    int m_wake_pipe[2];
+    std::unique_ptr<std::thread> m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_disconnect_requested;
+    std::atomic<int64_t> m_latency_us;
+    std::atomic<uint64_t> m_command_count;
+    std::atomic<uint32_t> m_client_count;
+    std::mutex m_start_mutex;
+
+    /* Owned by the server thread */
+    std::vector<std::unique_ptr<Client>> m_clients;
+    std::map<std::string, Value> m_values;
+
+    void Serve();
+    void Wake();
+    void AcceptClient();
+    bool ReadClient(Client& client);
+    bool WriteClient(Client& client);
+    void CloseClients();
+    int ParseCommand(std::string& input, std::vector<std::string>& command);
+    void ExecuteCommand(Client& client, const std::vector<std::string>& command);
+    std::string RunCommand(Client& client, const std::vector<std::string>& command);
+    uint32_t Deliver(const std::string& channel, const std::string& message);
+
+    static std::string BulkString(const std::string& value);
+    static std::string Integer(int64_t value);
+};
+
+#endif /* RESP_SERVER_FAKE__H_ */
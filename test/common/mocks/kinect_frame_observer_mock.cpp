@@ -0,0 +1,9 @@
+#include "kinect_frame_observer_mock.hpp"
+
+KinectFrameObserverMock::KinectFrameObserverMock()
+{
+}
+
+KinectFrameObserverMock::~KinectFrameObserverMock()
+{
+}
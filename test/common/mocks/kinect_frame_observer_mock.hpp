@@ -0,0 +1,19 @@
+#ifndef KINECT_FRAME_OBSERVER_MOCK__H_
+#define KINECT_FRAME_OBSERVER_MOCK__H_
+
+#include <gmock/gmock.h>
+
+#include "../../../inc/kinect_interface.hpp"
+
+class KinectFrameObserverMock : public KinectFrameObserver
+{
+public:
+
+    KinectFrameObserverMock();
+    virtual ~KinectFrameObserverMock();
+
+    MOCK_METHOD(void, NewDepthFrame, (const KinectDepthFrame& frame, uint64_t sequence));
+    MOCK_METHOD(void, NewVideoFrame, (const KinectVideoFrame& frame, uint64_t sequence));
+};
+
+#endif
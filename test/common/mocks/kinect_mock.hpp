@@ -29,6 +29,8 @@ public:
     MOCK_METHOD(bool, IsRunning, ());
     MOCK_METHOD(void, GetDepthFrame, (KinectDepthFrame& frame));
     MOCK_METHOD(void, GetVideoFrame, (KinectVideoFrame& frame));
+    MOCK_METHOD(int, Subscribe, (KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer));
+    MOCK_METHOD(int, Unsubscribe, (KinectFrameType frame_type, std::shared_ptr<KinectFrameObserver> observer));
     MOCK_METHOD(int, ChangeTilt, (double tilt_angle));
     MOCK_METHOD(int, ChangeLedColor, (freenect_led_options color));
 };
@@ -27,6 +27,12 @@ public:
     MOCK_METHOD(int, SetVariable, (const Variable& variable));
     MOCK_METHOD(int, SetVariableExpiration, (const Variable& variable, int livetime_seconds));
     MOCK_METHOD(int, Clear, ());
+
+    /* The commands are expected one by one, all together as far as the tests can tell */
+    int ExecuteBatch(const MessageBrokerBatch& batch, bool atomic = false) override
+    {
+        return ExecuteBatchInOrder(batch);
+    }
 };
 
 #endif
\ No newline at end of file
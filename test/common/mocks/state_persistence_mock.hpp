@@ -28,9 +28,12 @@ public:
     MOCK_METHOD(int, InsertItem, (const Entry& item));
     MOCK_METHOD(int, GetItem, (Entry& item));
     MOCK_METHOD(int, SetItem, (const Entry& item));
+    MOCK_METHOD(int, InsertItem, (const Entry& item, bool wait));
+    MOCK_METHOD(int, SetItem, (const Entry& item, bool wait));
     MOCK_METHOD(int, DeleteItem, (const Entry& item));
     MOCK_METHOD(int, DeleteAllItems, ());
     MOCK_METHOD(int, DeleteTable, ());
+    MOCK_METHOD(int, QueryItems, (Entry& item, const ItemRange& range, const std::function<bool(const Entry&)>& on_item));
 };
 
 #endif
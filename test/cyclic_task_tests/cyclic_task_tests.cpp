@@ -11,6 +11,8 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 
 #include "../../inc/cyclic_task.hpp"
 
@@ -20,6 +22,8 @@
 using ::testing::StrictMock;
 using ::testing::AtMost;
 using ::testing::Between;
+using ::testing::TestWithParam;
+using ::testing::Values;
 
 class TaskMock
 {
@@ -42,6 +46,33 @@ public:
     StrictMock<TaskMock> task_mock;
 };
 
+class CyclicTaskTimestamps : public CyclicTask
+{
+public:
+    CyclicTaskTimestamps(uint32_t loop_interval_ms, CyclicTaskConfig config) : CyclicTask("jitter", loop_interval_ms, config)
+    {
+        wakeups.reserve(1000);
+    }
+
+    void ExecutionCycle() override
+    {
+        wakeups.push_back(std::chrono::steady_clock::now());
+    }
+
+    std::vector<std::chrono::steady_clock::time_point> wakeups;
+};
+
+class CyclicTaskBackendTest : public TestWithParam<CyclicTaskBackend>
+{
+public:
+    CyclicTaskConfig Config()
+    {
+        CyclicTaskConfig config;
+        config.backend = GetParam();
+        return config;
+    }
+};
+
 /*******************************************************************
  * Test cases
  *******************************************************************/
@@ -104,3 +135,96 @@ TEST(CyclicTaskTest, CheckStoppingTimeLess1ms)
 
     EXPECT_TRUE(max_stoping_time > std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
 }
+
+TEST_P(CyclicTaskBackendTest, TaskExecution)
+{
+    CyclicTaskTimestamps task(10, Config());
+
+    EXPECT_EQ(0, task.Start());
+    std::this_thread::sleep_for (std::chrono::milliseconds(105));
+    EXPECT_EQ(0, task.Stop());
+
+    EXPECT_GE(task.wakeups.size(), 10U);
+    EXPECT_LE(task.wakeups.size(), 12U);
+}
+
+TEST_P(CyclicTaskBackendTest, CheckStoppingTimeLess1ms)
+{
+    int64_t max_stoping_time = 1;
+    CyclicTaskTimestamps task(100, Config());
+
+    EXPECT_EQ(0, task.Start());
+    std::this_thread::sleep_for (std::chrono::milliseconds(50));
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    EXPECT_EQ(0, task.Stop());
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(max_stoping_time > std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
+}
+
+TEST_P(CyclicTaskBackendTest, RestartAfterStop)
+{
+    CyclicTaskTimestamps task(10, Config());
+
+    EXPECT_EQ(0, task.Start());
+    EXPECT_EQ(0, task.Stop());
+    EXPECT_EQ(0, task.Start());
+    std::this_thread::sleep_for (std::chrono::milliseconds(25));
+    EXPECT_EQ(0, task.Stop());
+
+    EXPECT_GE(task.wakeups.size(), 3U);
+}
+
+TEST_P(CyclicTaskBackendTest, SchedulingConfigDoesNotPreventExecution)
+{
+    /* Without CAP_SYS_NICE the SCHED_FIFO request fails, the task must run anyway */
+    CyclicTaskConfig config = Config();
+    config.rt_priority = 10;
+    config.cpu_affinity = 0;
+    CyclicTaskTimestamps task(10, config);
+
+    EXPECT_EQ(0, task.Start());
+    std::this_thread::sleep_for (std::chrono::milliseconds(25));
+    EXPECT_EQ(0, task.Stop());
+
+    EXPECT_GE(task.wakeups.size(), 2U);
+}
+
+TEST_P(CyclicTaskBackendTest, JitterBenchmark)
+{
+    const uint32_t interval_ms = 5;
+    const size_t num_cycles = 100;
+    CyclicTaskTimestamps task(interval_ms, Config());
+
+    EXPECT_EQ(0, task.Start());
+    std::this_thread::sleep_for (std::chrono::milliseconds(interval_ms * num_cycles + interval_ms / 2));
+    EXPECT_EQ(0, task.Stop());
+
+    ASSERT_GE(task.wakeups.size(), num_cycles / 2);
+
+    /* Lateness of every wake-up relative to its ideal absolute deadline */
+    std::vector<int64_t> lateness_us;
+    for(size_t i = 1; i < task.wakeups.size(); i++)
+    {
+        auto ideal = task.wakeups.front() + std::chrono::milliseconds(interval_ms * i);
+        lateness_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(task.wakeups[i] - ideal).count());
+    }
+    std::sort(lateness_us.begin(), lateness_us.end());
+
+    int64_t p50 = lateness_us[lateness_us.size() / 2];
+    int64_t p99 = lateness_us[(lateness_us.size() * 99) / 100];
+    int64_t max = lateness_us.back();
+
+    RecordProperty("jitter_p50_us", static_cast<int>(p50));
+    RecordProperty("jitter_p99_us", static_cast<int>(p99));
+    RecordProperty("jitter_max_us", static_cast<int>(max));
+    printf("[ JITTER   ] %s: p50 %lld us, p99 %lld us, max %lld us\n",
+           GetParam() == CyclicTaskBackend::TimerFd ? "timerfd" : "condition_variable",
+           static_cast<long long>(p50), static_cast<long long>(p99), static_cast<long long>(max));
+
+    /* Loose bound so the test stays stable on loaded CI machines, the numbers above are the benchmark */
+    EXPECT_LT(p50, interval_ms * 1000);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, CyclicTaskBackendTest,
+                         Values(CyclicTaskBackend::ConditionVariable, CyclicTaskBackend::TimerFd));
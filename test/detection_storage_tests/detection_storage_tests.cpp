@@ -0,0 +1,290 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file detection_storage_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <ctime>
+#include <chrono>
+#include <thread>
+
+#include "../../inc/detection_storage.hpp"
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+class DetectionStorageTest : public ::testing::Test
+{
+public:
+    const std::string m_path = "/tmp/kinectalarm_detection_storage_tests";
+    std::vector<int32_t> m_evicted;
+
+    void SetUp() override
+    {
+        std::filesystem::remove_all(m_path);
+        std::filesystem::create_directories(m_path);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_path);
+    }
+
+    std::string WriteFile(const std::string& filename, size_t size)
+    {
+        std::string filepath = m_path + "/" + filename;
+        std::filesystem::create_directories(std::filesystem::path(filepath).parent_path());
+        std::ofstream file(filepath, std::ios::binary);
+
+        file << std::string(size, 'x');
+
+        return filepath;
+    }
+
+    std::unique_ptr<DetectionStorage> Create(uint64_t max_bytes, uint32_t max_age_s)
+    {
+        DetectionStoragePolicy policy;
+        policy.max_bytes = max_bytes;
+        policy.max_age_s = max_age_s;
+        policy.reclaim_interval_ms = 10;
+
+        return std::make_unique<DetectionStorage>(m_path, policy, [this](int32_t id) { m_evicted.push_back(id); });
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(DetectionStorageTest, Manifest)
+{
+    auto storage = Create(0, 0);
+    std::string directory = storage->GetDirectory(3);
+
+    ASSERT_EQ(0, storage->BeginDetection(3, 1000));
+    EXPECT_EQ(0, storage->AddFrame(3, 0, 77, WriteFile("3/capture.frames", 100), 24, 76));
+    EXPECT_EQ(0, storage->AddFile(3, WriteFile("3/capture.zip", 50)));
+    EXPECT_EQ(0, storage->EndDetection(3, 1010, 1));
+
+    std::ifstream manifest(directory + "/manifest");
+    std::string content((std::istreambuf_iterator<char>(manifest)), std::istreambuf_iterator<char>());
+    EXPECT_EQ("detection 3 1000\n"
+              "frame 0 77 capture.frames 24 76\n"
+              "file capture.zip 50\n"
+              "end 1010 1\n", content);
+
+    EXPECT_EQ(150U, storage->GetStats().bytes);
+    EXPECT_TRUE(storage->GetInterrupted().empty());
+}
+
+TEST_F(DetectionStorageTest, ManifestClosedAfterFileAddedToEndedDetection)
+{
+    auto storage = Create(0, 0);
+
+    ASSERT_EQ(0, storage->BeginDetection(3, 1000));
+    EXPECT_EQ(0, storage->EndDetection(3, 1010, 0));
+
+    /* Each file added after the end opens the manifest again, none is left open */
+    size_t open_fds = std::distance(std::filesystem::directory_iterator("/proc/self/fd"), std::filesystem::directory_iterator());
+    for(int i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(0, storage->AddFile(3, WriteFile("3/capture" + std::to_string(i) + ".zip", 50)));
+    }
+    EXPECT_EQ(open_fds, static_cast<size_t>(std::distance(std::filesystem::directory_iterator("/proc/self/fd"), std::filesystem::directory_iterator())));
+    EXPECT_TRUE(storage->GetInterrupted().empty());
+}
+
+TEST_F(DetectionStorageTest, IndexFromManifests)
+{
+    {
+        auto storage = Create(0, 0);
+        storage->BeginDetection(1, 1000);
+        storage->AddFrame(1, 0, 1, WriteFile("1/capture.frames", 100), 0, 100);
+        storage->EndDetection(1, 1001, 1);
+        storage->BeginDetection(2, 2000);
+        std::string container = WriteFile("2/capture.frames", 20);
+        storage->AddFrame(2, 0, 1, container, 0, 10);
+        storage->AddFrame(2, 1, 2, container, 10, 10);
+    }
+    WriteFile("not_a_detection", 1000);
+    auto storage = Create(0, 0);
+
+    DetectionStorageStats stats = storage->GetStats();
+    EXPECT_EQ(120U, stats.bytes);
+    EXPECT_EQ(2U, stats.detections);
+
+    /* The second one never ended */
+    std::vector<InterruptedDetection> interrupted = storage->GetInterrupted();
+    ASSERT_EQ(1U, interrupted.size());
+    EXPECT_EQ(2, interrupted[0].id);
+    EXPECT_EQ(2000, interrupted[0].date);
+    EXPECT_EQ(2U, interrupted[0].frames);
+
+    EXPECT_EQ(0, storage->EndDetection(2, 2000, 2));
+    EXPECT_TRUE(storage->GetInterrupted().empty());
+}
+
+TEST_F(DetectionStorageTest, IndexCutDetectionRecord)
+{
+    /* Cut by a crash in the date and before it */
+    WriteFile("1/capture.zip", 100);
+    std::ofstream(m_path + "/1/manifest") << "detection 1 1";
+    WriteFile("2/capture.zip", 100);
+    std::ofstream(m_path + "/2/manifest") << "detection 2";
+    WriteFile("3/capture.zip", 100);
+    auto storage = Create(0, 3600);
+
+    EXPECT_EQ(3U, storage->GetStats().detections);
+    EXPECT_EQ(0U, storage->Reclaim());
+    EXPECT_TRUE(m_evicted.empty());
+}
+
+TEST_F(DetectionStorageTest, IndexFlatLayout)
+{
+    WriteFile("1_capture_0.jpeg", 100);
+    WriteFile("1_capture.zip", 50);
+    WriteFile("2_capture_0.jpeg", 10);
+    auto storage = Create(0, 0);
+
+    DetectionStorageStats stats = storage->GetStats();
+    EXPECT_EQ(160U, stats.bytes);
+    EXPECT_EQ(2U, stats.detections);
+
+    EXPECT_EQ(0, storage->DeleteDetection(1));
+    EXPECT_FALSE(std::filesystem::exists(m_path + "/1_capture.zip"));
+    EXPECT_TRUE(std::filesystem::exists(m_path + "/2_capture_0.jpeg"));
+}
+
+TEST_F(DetectionStorageTest, AddFile)
+{
+    auto storage = Create(0, 0);
+    storage->BeginDetection(3, 1000);
+    std::string filepath = WriteFile("3/capture_0.jpeg", 100);
+
+    EXPECT_EQ(0, storage->AddFile(3, filepath));
+    EXPECT_EQ(100U, storage->GetStats().bytes);
+
+    /* Rewritten: its size is updated, not added again */
+    WriteFile("3/capture_0.jpeg", 40);
+    EXPECT_EQ(0, storage->AddFile(3, filepath));
+    EXPECT_EQ(40U, storage->GetStats().bytes);
+
+    EXPECT_NE(0, storage->AddFile(3, m_path + "/3/missing.jpeg"));
+}
+
+TEST_F(DetectionStorageTest, DeleteDetection)
+{
+    auto storage = Create(0, 0);
+    storage->BeginDetection(1, 1000);
+    storage->AddFrame(1, 0, 1, WriteFile("1/capture.frames", 10), 0, 10);
+    storage->BeginDetection(12, 1000);
+    storage->AddFrame(12, 0, 1, WriteFile("12/capture.frames", 10), 0, 10);
+    storage->AddFile(12, WriteFile("12/capture.zip", 10));
+
+    /* Only detection 12, not those whose ID starts the same */
+    EXPECT_EQ(0, storage->DeleteDetection(12));
+
+    EXPECT_FALSE(std::filesystem::exists(m_path + "/12"));
+    EXPECT_TRUE(std::filesystem::exists(m_path + "/1/capture.frames"));
+    EXPECT_EQ(10U, storage->GetStats().bytes);
+    EXPECT_EQ(1U, storage->GetStats().detections);
+}
+
+TEST_F(DetectionStorageTest, DeleteAll)
+{
+    WriteFile("1_capture_0.jpeg", 10);
+    WriteFile("2/capture_0.jpeg", 10);
+    std::string other = WriteFile("not_a_detection", 10);
+    auto storage = Create(0, 0);
+
+    EXPECT_EQ(0, storage->DeleteAll());
+
+    EXPECT_FALSE(std::filesystem::exists(m_path + "/1_capture_0.jpeg"));
+    EXPECT_FALSE(std::filesystem::exists(m_path + "/2"));
+    EXPECT_TRUE(std::filesystem::exists(other));
+    EXPECT_EQ(0U, storage->GetStats().bytes);
+}
+
+TEST_F(DetectionStorageTest, EvictOldestOverSize)
+{
+    for(int id = 1; id <= 4; id++)
+    {
+        WriteFile(std::to_string(id) + "/capture.zip", 100);
+    }
+    auto storage = Create(250, 0);
+
+    EXPECT_EQ(2U, storage->Reclaim());
+    EXPECT_EQ((std::vector<int32_t>{1, 2}), m_evicted);
+    EXPECT_FALSE(std::filesystem::exists(m_path + "/1"));
+    EXPECT_TRUE(std::filesystem::exists(m_path + "/3/capture.zip"));
+
+    DetectionStorageStats stats = storage->GetStats();
+    EXPECT_EQ(200U, stats.bytes);
+    EXPECT_EQ(2U, stats.evicted);
+}
+
+TEST_F(DetectionStorageTest, NewestNeverEvicted)
+{
+    WriteFile("1/capture.zip", 100);
+    WriteFile("2/capture.zip", 100);
+    auto storage = Create(50, 0);
+
+    EXPECT_EQ(1U, storage->Reclaim());
+    EXPECT_EQ(0U, storage->Reclaim());
+    EXPECT_TRUE(std::filesystem::exists(m_path + "/2/capture.zip"));
+}
+
+TEST_F(DetectionStorageTest, EvictedNotIndexedAgain)
+{
+    WriteFile("1/capture.zip", 100);
+    WriteFile("2/capture.zip", 100);
+    auto storage = Create(150, 0);
+    EXPECT_EQ(1U, storage->Reclaim());
+
+    /* An export of the evicted detection that ends afterwards */
+    std::string filepath = WriteFile("1/capture.mp4", 100);
+    EXPECT_NE(0, storage->AddFile(1, filepath));
+
+    DetectionStorageStats stats = storage->GetStats();
+    EXPECT_EQ(1U, stats.detections);
+    EXPECT_EQ(100U, stats.bytes);
+
+    /* Numbered from the start again once all are deleted */
+    EXPECT_EQ(0, storage->DeleteAll());
+    filepath = WriteFile("1/capture.mp4", 100);
+    EXPECT_EQ(0, storage->AddFile(1, filepath));
+}
+
+TEST_F(DetectionStorageTest, EvictOlderThanAge)
+{
+    std::string old_file = WriteFile("1/capture.zip", 10);
+    WriteFile("2/capture.zip", 10);
+    WriteFile("3/capture.zip", 10);
+
+    std::filesystem::last_write_time(old_file, std::filesystem::file_time_type::clock::now() - std::chrono::hours(2));
+    auto storage = Create(0, 3600);
+
+    EXPECT_EQ(1U, storage->Reclaim());
+    EXPECT_EQ((std::vector<int32_t>{1}), m_evicted);
+}
+
+TEST_F(DetectionStorageTest, BackgroundReclaim)
+{
+    WriteFile("1/capture.zip", 100);
+    WriteFile("2/capture.zip", 100);
+    auto storage = Create(150, 0);
+
+    storage->Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    storage->Stop();
+
+    EXPECT_EQ((std::vector<int32_t>{1}), m_evicted);
+}
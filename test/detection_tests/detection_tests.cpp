@@ -10,6 +10,8 @@
  *******************************************************************/
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <atomic>
+#include <thread>
 
 #include "../common/mocks/kinect_mock.hpp"
 #include "mocks/detection_observer_mock.hpp"
@@ -25,6 +27,8 @@ using ::testing::StrictMock;
 using ::testing::SetArgReferee;
 using ::testing::Ref;
 using ::testing::AtLeast;
+using ::testing::SaveArg;
+using ::testing::DoAll;
 
 class DetectionTest : public ::testing::Test
 {
@@ -56,10 +60,41 @@ public:
         frame.Fill(frame_data.data(), timestamp);
     }
 
+    void ExpectDepthSubscription()
+    {
+        EXPECT_CALL(*kinect_mock, Subscribe(KinectFrameType::Depth, _)).
+            WillOnce(DoAll(SaveArg<1>(&frame_observer), Return(0)));
+        EXPECT_CALL(*kinect_mock, Unsubscribe(KinectFrameType::Depth, _)).
+            WillOnce(Return(0));
+    }
+
+    void StartPushingDepthFrames(KinectDepthFrame& frame, uint32_t period_ms)
+    {
+        pushing_frames = true;
+        push_frames_thread = std::thread([this, &frame, period_ms]
+        {
+            uint64_t sequence = 0;
+            while(pushing_frames)
+            {
+                frame_observer->NewDepthFrame(frame, ++sequence);
+                std::this_thread::sleep_for(std::chrono::milliseconds(period_ms));
+            }
+        });
+    }
+
+    void StopPushingDepthFrames()
+    {
+        pushing_frames = false;
+        push_frames_thread.join();
+    }
+
 protected:
     DetectionConfig detection_config;
     std::shared_ptr<KinectMock> kinect_mock;
     std::shared_ptr<DetectionObserverMock> detection_observer_mock;
+    std::shared_ptr<KinectFrameObserver> frame_observer;
+    std::thread push_frames_thread;
+    std::atomic<bool> pushing_frames;
     uint32_t loop_period_ms = 100;
 };
 
@@ -79,11 +114,15 @@ TEST_F(DetectionTest, StartsTakingDepthFrames)
     KinectDepthFrame kinect_frame_ref(1920,1080);
 
     EXPECT_CALL(*kinect_mock, GetDepthFrame(_)).
-        WillRepeatedly(SetArgReferee<0>(kinect_frame_ref));
+        WillOnce(SetArgReferee<0>(kinect_frame_ref));
+    ExpectDepthSubscription();
 
     ASSERT_EQ(detection.Start(), 0);
+    ASSERT_NE(frame_observer, nullptr);
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    StartPushingDepthFrames(kinect_frame_ref, 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    StopPushingDepthFrames();
 
     ASSERT_EQ(detection.Stop(), 0);
 }
@@ -98,9 +137,10 @@ TEST_F(DetectionTest, DetectionOccursSuccess)
     FillFrameWithValue(kinect_depth_frame_ref, 100, 1);
     FillFrameWithValue(kinect_depth_frame_1, 200, 2);
 
+    /* Only the reference is requested synchronously, the rest of frames are pushed */
     EXPECT_CALL(*kinect_mock, GetDepthFrame(_)).
-        WillOnce(SetArgReferee<0>(kinect_depth_frame_ref)).
-        WillRepeatedly(SetArgReferee<0>(kinect_depth_frame_1));
+        WillOnce(SetArgReferee<0>(kinect_depth_frame_ref));
+    ExpectDepthSubscription();
 
     EXPECT_CALL(*detection_observer_mock, IntrusionStarted()).Times(1);
 
@@ -113,7 +153,58 @@ TEST_F(DetectionTest, DetectionOccursSuccess)
 
     ASSERT_EQ(detection.Start(), 0);
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    StartPushingDepthFrames(kinect_depth_frame_1, 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    StopPushingDepthFrames();
+
+    ASSERT_EQ(detection.Stop(), 0);
+}
+
+TEST_F(DetectionTest, NoIntrusionWithoutNewFrames)
+{
+    Detection detection(kinect_mock, detection_observer_mock, detection_config);
+    KinectDepthFrame kinect_depth_frame_ref(1920,1080);
+
+    FillFrameWithValue(kinect_depth_frame_ref, 100, 1);
+
+    EXPECT_CALL(*kinect_mock, GetDepthFrame(_)).
+        WillOnce(SetArgReferee<0>(kinect_depth_frame_ref));
+    ExpectDepthSubscription();
+
+    ASSERT_EQ(detection.Start(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(detection.Stop(), 0);
+}
+
+TEST_F(DetectionTest, StopWhileWaitingForFrameIsFast)
+{
+    Detection detection(kinect_mock, detection_observer_mock, detection_config);
+    KinectDepthFrame kinect_depth_frame_ref(1920,1080);
+
+    EXPECT_CALL(*kinect_mock, GetDepthFrame(_)).
+        WillOnce(SetArgReferee<0>(kinect_depth_frame_ref));
+    ExpectDepthSubscription();
+
+    ASSERT_EQ(detection.Start(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
 
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
     ASSERT_EQ(detection.Stop(), 0);
-}
\ No newline at end of file
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count(), 10);
+}
+
+TEST_F(DetectionTest, StartFailsIfSubscriptionFails)
+{
+    Detection detection(kinect_mock, detection_observer_mock, detection_config);
+    KinectDepthFrame kinect_depth_frame_ref(1920,1080);
+
+    EXPECT_CALL(*kinect_mock, GetDepthFrame(_)).
+        WillOnce(SetArgReferee<0>(kinect_depth_frame_ref));
+    EXPECT_CALL(*kinect_mock, Subscribe(KinectFrameType::Depth, _)).
+        WillOnce(Return(-1));
+
+    ASSERT_NE(detection.Start(), 0);
+    ASSERT_FALSE(detection.IsRunning());
+}
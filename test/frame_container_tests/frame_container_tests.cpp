@@ -0,0 +1,268 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file frame_container_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <csignal>
+#include <sys/resource.h>
+
+#include "../../inc/frame_container.hpp"
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+class FrameContainerTest : public ::testing::Test
+{
+public:
+    const std::string m_path = "/tmp/kinectalarm_frame_container_tests";
+    const std::string m_container_path = m_path + "/capture.frames";
+
+    void SetUp() override
+    {
+        std::filesystem::remove_all(m_path);
+        std::filesystem::create_directories(m_path);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_path);
+    }
+
+    static std::vector<uint8_t> Jpeg(uint32_t frame_num)
+    {
+        return std::vector<uint8_t>(100 + frame_num, static_cast<uint8_t>(frame_num));
+    }
+
+    /* Returns the offset of the end of the last frame */
+    uint64_t WriteContainer(uint32_t frames, bool close)
+    {
+        FrameContainerWriter writer(m_container_path, 1000, 2);
+        uint64_t offset = 0;
+
+        for(uint32_t frame_num = 0; frame_num < frames; frame_num++)
+        {
+            std::vector<uint8_t> jpeg = Jpeg(frame_num);
+            EXPECT_EQ(0, writer.Append(frame_num, frame_num * 10, jpeg.data(), jpeg.size(), offset));
+            offset += jpeg.size();
+        }
+
+        if(close)
+        {
+            EXPECT_EQ(0, writer.Close());
+        }
+
+        return offset;
+    }
+
+    void ExpectFrames(FrameContainerReader& reader, uint32_t frames)
+    {
+        ContainerFrame frame;
+
+        ASSERT_EQ(frames, reader.GetFrameCount());
+        for(uint32_t i = 0; i < frames; i++)
+        {
+            std::vector<uint8_t> jpeg = Jpeg(i);
+
+            ASSERT_EQ(0, reader.GetFrame(i, frame));
+            EXPECT_EQ(i, frame.frame_num);
+            EXPECT_EQ(i * 10, frame.timestamp);
+            EXPECT_EQ(jpeg, std::vector<uint8_t>(frame.data, frame.data + frame.size));
+        }
+        EXPECT_NE(0, reader.GetFrame(frames, frame));
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(FrameContainerTest, RoundTrip)
+{
+    WriteContainer(5, true);
+    FrameContainerReader reader(m_container_path);
+
+    EXPECT_TRUE(reader.IsComplete());
+    EXPECT_EQ(1000, reader.GetDate());
+    ExpectFrames(reader, 5);
+}
+
+TEST_F(FrameContainerTest, OffsetOfFrame)
+{
+    FrameContainerWriter writer(m_container_path, 1000, 0);
+    std::vector<uint8_t> jpeg = Jpeg(7);
+    uint64_t offset;
+
+    ASSERT_EQ(0, writer.Append(7, 70, jpeg.data(), jpeg.size(), offset));
+    EXPECT_EQ(sizeof(FrameContainerHeader) + sizeof(FrameContainerRecord), offset);
+    EXPECT_EQ(m_container_path, writer.GetPath());
+
+    /* Closed, nothing else is appended */
+    writer.Close();
+    EXPECT_NE(0, writer.Append(8, 80, jpeg.data(), jpeg.size(), offset));
+}
+
+TEST_F(FrameContainerTest, WithoutIndex)
+{
+    /* Crashed: not closed and the last record cut */
+    uint64_t end = WriteContainer(4, true);
+    std::filesystem::resize_file(m_container_path, end - 10);
+    FrameContainerReader reader(m_container_path);
+
+    EXPECT_FALSE(reader.IsComplete());
+    ExpectFrames(reader, 3);
+}
+
+TEST_F(FrameContainerTest, FailedAppend)
+{
+    FrameContainerWriter writer(m_container_path, 1000, 0);
+    std::vector<uint8_t> jpeg;
+    std::vector<uint8_t> large_jpeg(10000, 0xFF);
+    uint64_t offset;
+    rlimit file_size_limit, previous_limit;
+
+    for(uint32_t frame_num = 0; frame_num < 2; frame_num++)
+    {
+        jpeg = Jpeg(frame_num);
+        ASSERT_EQ(0, writer.Append(frame_num, frame_num * 10, jpeg.data(), jpeg.size(), offset));
+    }
+    uintmax_t size = std::filesystem::file_size(m_container_path);
+
+    /* Exported while the disk fills up */
+    FrameContainerReader exporting(m_container_path);
+    signal(SIGXFSZ, SIG_IGN);
+    getrlimit(RLIMIT_FSIZE, &previous_limit);
+    file_size_limit = previous_limit;
+    file_size_limit.rlim_cur = size + sizeof(FrameContainerRecord) + 50;
+    ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &file_size_limit));
+
+    jpeg = Jpeg(2);
+    EXPECT_NE(0, writer.Append(2, 20, jpeg.data(), jpeg.size(), offset));
+    setrlimit(RLIMIT_FSIZE, &previous_limit);
+    /* Not shrunk under the mapping, the partial record stays until written over */
+    EXPECT_LT(size, std::filesystem::file_size(m_container_path));
+    ExpectFrames(exporting, 2);
+
+    /* Written over the partial record */
+    ASSERT_EQ(0, writer.Append(2, 20, jpeg.data(), jpeg.size(), offset));
+
+    /* And the index past the partial one of the last frame */
+    file_size_limit.rlim_cur = std::filesystem::file_size(m_container_path) + 5000;
+    ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &file_size_limit));
+    EXPECT_NE(0, writer.Append(3, 30, large_jpeg.data(), large_jpeg.size(), offset));
+    setrlimit(RLIMIT_FSIZE, &previous_limit);
+    EXPECT_EQ(0, writer.Close());
+
+    FrameContainerReader reader(m_container_path);
+    EXPECT_TRUE(reader.IsComplete());
+    ExpectFrames(reader, 3);
+}
+
+TEST_F(FrameContainerTest, FrameNumberOrder)
+{
+    FrameContainerWriter writer(m_container_path, 1000, 0);
+    uint64_t offset;
+
+    for(uint32_t frame_num : {2U, 0U, 1U})
+    {
+        std::vector<uint8_t> jpeg = Jpeg(frame_num);
+        writer.Append(frame_num, frame_num * 10, jpeg.data(), jpeg.size(), offset);
+    }
+    writer.Close();
+
+    FrameContainerReader reader(m_container_path);
+    ExpectFrames(reader, 3);
+}
+
+TEST_F(FrameContainerTest, ConcurrentAppend)
+{
+    FrameContainerWriter writer(m_container_path, 1000, 3);
+    std::vector<std::thread> threads;
+
+    for(uint32_t thread = 0; thread < 4; thread++)
+    {
+        threads.emplace_back([&writer, thread]
+        {
+            for(uint32_t frame_num = thread; frame_num < 40; frame_num += 4)
+            {
+                std::vector<uint8_t> jpeg = Jpeg(frame_num);
+                uint64_t offset;
+                writer.Append(frame_num, frame_num * 10, jpeg.data(), jpeg.size(), offset);
+            }
+        });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    writer.Close();
+
+    FrameContainerReader reader(m_container_path);
+    ExpectFrames(reader, 40);
+}
+
+TEST_F(FrameContainerTest, AsyncAppend)
+{
+    auto io = std::make_shared<AsyncFileWriter>(4);
+    std::vector<std::thread> threads;
+
+    {
+        FrameContainerWriter writer(m_container_path, 1000, 5, io);
+
+        for(uint32_t thread = 0; thread < 4; thread++)
+        {
+            threads.emplace_back([&writer, thread]
+            {
+                for(uint32_t frame_num = thread; frame_num < 40; frame_num += 4)
+                {
+                    uint64_t offset;
+                    EXPECT_EQ(0, writer.Append(frame_num, frame_num * 10, std::make_shared<const std::vector<uint8_t>>(Jpeg(frame_num)), offset));
+                }
+            });
+        }
+        for(auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        /* Waits for the frames still being written */
+        EXPECT_EQ(0, writer.Close());
+    }
+
+    FrameContainerReader reader(m_container_path);
+    EXPECT_TRUE(reader.IsComplete());
+    ExpectFrames(reader, 40);
+}
+
+TEST_F(FrameContainerTest, NotAContainer)
+{
+    std::ofstream(m_container_path) << "not a container, but long enough";
+
+    EXPECT_THROW(FrameContainerReader reader(m_container_path), std::exception);
+    EXPECT_THROW(FrameContainerReader reader(m_path + "/missing.frames"), std::exception);
+}
+
+TEST_F(FrameContainerTest, ExportToZip)
+{
+    WriteContainer(3, true);
+    FrameContainerReader reader(m_container_path);
+    std::string zip_path = m_path + "/capture.zip";
+
+    ASSERT_EQ(0, ExportContainerToZip(reader, zip_path));
+    EXPECT_FALSE(std::filesystem::exists(zip_path + ".tmp"));
+
+    /* Readable by the usual tools, each JPEG back as it was */
+    std::string command = "cd " + m_path + " && unzip -tq capture.zip > /dev/null && unzip -q capture.zip capture_2.jpeg";
+    ASSERT_EQ(0, system(command.c_str()));
+    EXPECT_EQ(Jpeg(2).size(), std::filesystem::file_size(m_path + "/capture_2.jpeg"));
+}
@@ -0,0 +1,126 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file jpeg_cache_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "../../inc/jpeg_cache.hpp"
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+
+/* Counts its encodings, slow enough for others to ask for it meanwhile */
+class CountingVideoFrame : public KinectVideoFrame
+{
+public:
+    std::atomic<int> encodings{0};
+
+    CountingVideoFrame(uint32_t timestamp) : KinectVideoFrame(64, 48)
+    {
+        SetTimestamp(timestamp);
+    }
+
+    int SaveToJpegInMemory(std::vector<uint8_t>& jpeg_frame, int32_t brightness, int32_t contrast) override
+    {
+        encodings++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        jpeg_frame.assign(16, static_cast<uint8_t>(GetTimestamp() + brightness + contrast));
+        return 0;
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(JpegCacheTest, EncodedOnce)
+{
+    JpegCache cache(4);
+    CountingVideoFrame frame(1);
+    CountingVideoFrame same_frame(1);
+
+    std::shared_ptr<const EncodedFrame> first = cache.Encode(frame, 0, 0);
+    std::shared_ptr<const EncodedFrame> second = cache.Encode(same_frame, 0, 0);
+
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1, frame.encodings + same_frame.encodings);
+    EXPECT_EQ(1U, cache.GetStats().encoded);
+    EXPECT_EQ(1U, cache.GetStats().reused);
+}
+
+TEST(JpegCacheTest, EncodedPerSettings)
+{
+    JpegCache cache(4);
+    CountingVideoFrame frame(1);
+
+    std::shared_ptr<const EncodedFrame> first = cache.Encode(frame, 0, 0);
+    std::shared_ptr<const EncodedFrame> brighter = cache.Encode(frame, 10, 0);
+
+    EXPECT_NE(first, brighter);
+    EXPECT_EQ(10, brighter->brightness);
+    EXPECT_EQ(2, frame.encodings);
+}
+
+TEST(JpegCacheTest, WaitsForTheOneBeingEncoded)
+{
+    JpegCache cache(4);
+    CountingVideoFrame frame(7);
+    std::vector<std::shared_ptr<const EncodedFrame>> results(4);
+    std::vector<std::thread> threads;
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        threads.emplace_back([&cache, &frame, &results, i] { results[i] = cache.Encode(frame, 0, 0); });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(1, frame.encodings);
+    for(const auto& result : results)
+    {
+        EXPECT_EQ(results[0], result);
+    }
+}
+
+TEST(JpegCacheTest, OldestForgotten)
+{
+    JpegCache cache(2);
+    CountingVideoFrame first(1), second(2), third(3);
+
+    cache.Encode(first, 0, 0);
+    cache.Encode(second, 0, 0);
+    cache.Encode(third, 0, 0);
+    cache.Encode(first, 0, 0);
+
+    EXPECT_EQ(2, first.encodings);
+    EXPECT_EQ(4U, cache.GetStats().encoded);
+}
+
+TEST(JpegCacheTest, Latest)
+{
+    JpegCache cache(4);
+    CountingVideoFrame frame(1);
+
+    EXPECT_EQ(nullptr, cache.GetLatest(0, 0, std::chrono::milliseconds(100)));
+
+    std::shared_ptr<const EncodedFrame> encoded = cache.Encode(frame, 0, 0);
+    EXPECT_EQ(encoded, cache.GetLatest(0, 0, std::chrono::milliseconds(100)));
+
+    /* Other settings or too old */
+    EXPECT_EQ(nullptr, cache.GetLatest(5, 0, std::chrono::milliseconds(100)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(nullptr, cache.GetLatest(0, 0, std::chrono::milliseconds(10)));
+}
@@ -16,6 +16,7 @@
 
 #include "../../inc/kinect.hpp"
 #include "mocks/libfreenect_mock.hpp"
+#include "../common/mocks/kinect_frame_observer_mock.hpp"
 
 /*******************************************************************
  * Defines
@@ -31,6 +32,8 @@ using ::testing::_;
 using ::testing::Return; 
 using ::testing::NiceMock;
 using ::testing::StrictMock;
+using ::testing::SaveArg;
+using ::testing::Property;
 
 MockLibFreenect *libfreenect_mock;
 volatile bool kinect_update_frame = true;
@@ -59,6 +62,13 @@ public:
                                      frame.GetTimestamp());
     }
 
+    void SetKinectsLastVideoFrame(KinectVideoFrame& frame)
+    {
+        libfreenect_mock->m_video_cb(libfreenect_mock->m_dev,
+                                     const_cast<void*>(reinterpret_cast<const void*>(frame.GetDataPointer())),
+                                     frame.GetTimestamp());
+    }
+
     void StartUpdatingKinectsLastDepthFrame(KinectDepthFrame& frame)
     {
         kinect_update_frame = true;
@@ -333,3 +343,74 @@ TEST_F(KinectTest, ChangeLedColorFailsOnFreenectSetTiltDegs)
 
     ASSERT_NE(kinect.ChangeLedColor(LED_GREEN), 0);
 }
+
+TEST_F(KinectTest, SubscribedObserverReceivesEveryDepthFrame)
+{
+    auto observer = std::make_shared<StrictMock<KinectFrameObserverMock>>();
+    KinectDepthFrame test_depth_frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+    uint64_t first_sequence = 0, second_sequence = 0;
+
+    ASSERT_EQ(kinect.Init(), 0);
+    ASSERT_EQ(kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+
+    EXPECT_CALL(*observer, NewDepthFrame(Property(&KinectFrame::GetTimestamp, 1111), _)).
+        WillOnce(SaveArg<1>(&first_sequence));
+    EXPECT_CALL(*observer, NewDepthFrame(Property(&KinectFrame::GetTimestamp, 2222), _)).
+        WillOnce(SaveArg<1>(&second_sequence));
+
+    test_depth_frame.SetTimestamp(1111);
+    SetKinectsLastDepthFrame(test_depth_frame);
+    test_depth_frame.SetTimestamp(2222);
+    SetKinectsLastDepthFrame(test_depth_frame);
+
+    EXPECT_EQ(second_sequence, first_sequence + 1);
+
+    ASSERT_EQ(kinect.Unsubscribe(KinectFrameType::Depth, observer), 0);
+}
+
+TEST_F(KinectTest, DepthObserverIsNotCalledWithVideoFrames)
+{
+    auto observer = std::make_shared<StrictMock<KinectFrameObserverMock>>();
+    KinectVideoFrame test_video_frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+
+    ASSERT_EQ(kinect.Init(), 0);
+    ASSERT_EQ(kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+
+    SetKinectsLastVideoFrame(test_video_frame);
+
+    ASSERT_EQ(kinect.Unsubscribe(KinectFrameType::Depth, observer), 0);
+}
+
+TEST_F(KinectTest, SubscribedObserverReceivesVideoFrames)
+{
+    auto observer = std::make_shared<StrictMock<KinectFrameObserverMock>>();
+    KinectVideoFrame test_video_frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+
+    ASSERT_EQ(kinect.Init(), 0);
+    ASSERT_EQ(kinect.Subscribe(KinectFrameType::Video, observer), 0);
+
+    EXPECT_CALL(*observer, NewVideoFrame(_, _)).Times(1);
+
+    SetKinectsLastVideoFrame(test_video_frame);
+
+    ASSERT_EQ(kinect.Unsubscribe(KinectFrameType::Video, observer), 0);
+}
+
+TEST_F(KinectTest, UnsubscribedObserverIsNotCalled)
+{
+    auto observer = std::make_shared<StrictMock<KinectFrameObserverMock>>();
+    KinectDepthFrame test_depth_frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+
+    ASSERT_EQ(kinect.Init(), 0);
+    ASSERT_EQ(kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+    ASSERT_EQ(kinect.Unsubscribe(KinectFrameType::Depth, observer), 0);
+
+    SetKinectsLastDepthFrame(test_depth_frame);
+
+    EXPECT_NE(kinect.Unsubscribe(KinectFrameType::Depth, observer), 0);
+}
+
+TEST_F(KinectTest, SubscribeNullObserverFails)
+{
+    EXPECT_NE(kinect.Subscribe(KinectFrameType::Depth, nullptr), 0);
+}
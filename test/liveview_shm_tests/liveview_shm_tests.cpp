@@ -0,0 +1,144 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file liveview_shm_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <sys/mman.h>
+
+#include "../../inc/liveview_shm.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define TEST_SHM_NAME "/kinectalarm_liveview_tests"
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+class LiveviewShmTest : public ::testing::Test
+{
+public:
+    LiveviewShmTest()
+    {
+        shm_unlink(TEST_SHM_NAME);
+    }
+
+    ~LiveviewShmTest()
+    {
+        shm_unlink(TEST_SHM_NAME);
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(LiveviewShmTest, ReaderWithoutWriter)
+{
+    EXPECT_ANY_THROW(LiveviewShmReader reader(TEST_SHM_NAME));
+}
+
+TEST_F(LiveviewShmTest, NoFrameYet)
+{
+    LiveviewShmWriter writer(TEST_SHM_NAME, 4, 1024);
+    LiveviewShmReader reader(TEST_SHM_NAME);
+    uint32_t frame;
+    const uint8_t *data;
+    size_t size;
+
+    EXPECT_EQ(-1, reader.GetFrame(frame, data, size));
+    EXPECT_EQ(0U, reader.WaitFrame(0, 10));
+}
+
+TEST_F(LiveviewShmTest, WriteRead)
+{
+    LiveviewShmWriter writer(TEST_SHM_NAME, 4, 1024);
+    LiveviewShmReader reader(TEST_SHM_NAME);
+    std::string jpeg("\xFF\xD8 not really a jpeg \xFF\xD9");
+    uint32_t frame;
+    const uint8_t *data;
+    size_t size;
+
+    EXPECT_EQ(1U, writer.Write(reinterpret_cast<const uint8_t*>(jpeg.data()), jpeg.size()));
+    EXPECT_EQ(1U, reader.WaitFrame(0, 10));
+
+    ASSERT_EQ(0, reader.GetFrame(frame, data, size));
+    EXPECT_EQ(1U, frame);
+    EXPECT_EQ(jpeg, std::string(reinterpret_cast<const char*>(data), size));
+    EXPECT_TRUE(reader.IsValid(frame));
+}
+
+TEST_F(LiveviewShmTest, FrameTooBig)
+{
+    LiveviewShmWriter writer(TEST_SHM_NAME, 4, 16);
+    std::vector<uint8_t> jpeg(17, 0);
+
+    EXPECT_EQ(0U, writer.Write(jpeg.data(), jpeg.size()));
+}
+
+TEST_F(LiveviewShmTest, SlotReused)
+{
+    LiveviewShmWriter writer(TEST_SHM_NAME, 2, 16);
+    LiveviewShmReader reader(TEST_SHM_NAME);
+    uint8_t value = 1;
+    uint32_t frame;
+    const uint8_t *data;
+    size_t size;
+
+    writer.Write(&value, 1);
+    ASSERT_EQ(0, reader.GetFrame(frame, data, size));
+
+    /* The next frame goes to the other slot, the one after that overwrites it */
+    value = 2;
+    writer.Write(&value, 1);
+    EXPECT_TRUE(reader.IsValid(frame));
+    value = 3;
+    writer.Write(&value, 1);
+    EXPECT_FALSE(reader.IsValid(frame));
+
+    ASSERT_EQ(0, reader.GetFrame(frame, data, size));
+    EXPECT_EQ(3U, frame);
+    EXPECT_EQ(3, data[0]);
+}
+
+TEST_F(LiveviewShmTest, WriterRestartKeepsNumbering)
+{
+    auto writer = std::make_unique<LiveviewShmWriter>(TEST_SHM_NAME, 4, 16);
+    uint8_t value = 0;
+
+    writer->Write(&value, 1);
+    writer->Write(&value, 1);
+    LiveviewShmReader reader(TEST_SHM_NAME);
+
+    writer = std::make_unique<LiveviewShmWriter>(TEST_SHM_NAME, 4, 16);
+    EXPECT_EQ(3U, writer->Write(&value, 1));
+    EXPECT_EQ(3U, reader.WaitFrame(2, 10));
+}
+
+TEST_F(LiveviewShmTest, WaitWokenByWriter)
+{
+    LiveviewShmWriter writer(TEST_SHM_NAME, 4, 16);
+    LiveviewShmReader reader(TEST_SHM_NAME);
+    uint8_t value = 0;
+
+    std::thread producer([&]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        writer.Write(&value, 1);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(1U, reader.WaitFrame(0, 1000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+    producer.join();
+}
@@ -0,0 +1,177 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file logger_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#define LOG_COMPILE_LEVEL LOG_INFO
+#include "../../inc/log.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define LOG_TEST_FILE "/tmp/kinectalarm_logger_tests.log"
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+class LoggerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::remove(LOG_TEST_FILE);
+        ASSERT_EQ(0, Logger::Instance().SetSink(LogSink::File, LOG_TEST_FILE));
+        Logger::Instance().SetRateLimit(LOG_RATE_LIMIT_BURST, LOG_RATE_LIMIT_INTERVAL_MS);
+    }
+
+    void TearDown() override
+    {
+        Logger::Instance().SetSink(LogSink::Stdout);
+        std::remove(LOG_TEST_FILE);
+    }
+
+    std::vector<std::string> ReadLines()
+    {
+        std::vector<std::string> lines;
+        std::ifstream file(LOG_TEST_FILE);
+        std::string line;
+
+        Logger::Instance().Flush();
+        while(std::getline(file, line))
+        {
+            lines.push_back(line);
+        }
+
+        return lines;
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(LoggerTest, WrittenWithLevel)
+{
+    LOG(LOG_WARNING, "Disk %d almost full\n", 3);
+
+    std::vector<std::string> lines = ReadLines();
+    ASSERT_EQ(1U, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find(" WARNING Disk 3 almost full"));
+}
+
+TEST_F(LoggerTest, LevelCompiledOut)
+{
+    int evaluated = 0;
+
+    /* Above LOG_COMPILE_LEVEL: not written, its arguments not evaluated */
+    LOG(LOG_DEBUG, "Debug %d\n", ++evaluated);
+    LOG(LOG_INFO, "Info %d\n", ++evaluated);
+
+    std::vector<std::string> lines = ReadLines();
+    EXPECT_EQ(1, evaluated);
+    ASSERT_EQ(1U, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find("INFO Info 1"));
+}
+
+TEST_F(LoggerTest, ThreadOrderKept)
+{
+    const int threads = 4, messages = 20;
+    std::vector<std::thread> loggers;
+
+    Logger::Instance().SetRateLimit(0, 0);
+    for(int t = 0; t < threads; t++)
+    {
+        loggers.emplace_back([t]
+        {
+            for(int i = 0; i < messages; i++)
+            {
+                LOG(LOG_NOTICE, "Thread %d message %d\n", t, i);
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+    }
+    for(auto& logger : loggers)
+    {
+        logger.join();
+    }
+
+    /* Also the messages of the threads that already exited */
+    std::vector<int> next(threads, 0);
+    for(const std::string& line : ReadLines())
+    {
+        int t, i;
+        ASSERT_EQ(2, sscanf(line.substr(line.find("Thread")).c_str(), "Thread %d message %d", &t, &i));
+        EXPECT_EQ(next[t], i);
+        next[t] = i + 1;
+    }
+    for(int t = 0; t < threads; t++)
+    {
+        EXPECT_EQ(messages, next[t]);
+    }
+}
+
+TEST_F(LoggerTest, RateLimited)
+{
+    uint64_t suppressed = Logger::Instance().GetSuppressed();
+
+    for(uint32_t i = 0; i < LOG_RATE_LIMIT_BURST + 5; i++)
+    {
+        LOG(LOG_ERR, "Repeated error %u\n", i);
+    }
+    LOG(LOG_ERR, "Another error\n");
+
+    /* The burst of each call site is written, the rest counted */
+    std::vector<std::string> lines = ReadLines();
+    EXPECT_EQ(LOG_RATE_LIMIT_BURST + 1, lines.size());
+    EXPECT_NE(std::string::npos, lines.back().find("Another error"));
+    EXPECT_EQ(suppressed + 5, Logger::Instance().GetSuppressed());
+}
+
+TEST_F(LoggerTest, SuppressedCountWritten)
+{
+    Logger::Instance().SetRateLimit(1, 50);
+
+    for(int i = 0; i < 3; i++)
+    {
+        LOG(LOG_ERR, "Sensor error %d\n", i);
+    }
+    Logger::Instance().Flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    LOG(LOG_ERR, "Sensor error %d\n", 3);
+
+    /* With the first message after the interval */
+    std::vector<std::string> lines = ReadLines();
+    ASSERT_EQ(3U, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find("Sensor error 0"));
+    EXPECT_NE(std::string::npos, lines[1].find("2 messages suppressed like: Sensor error 3"));
+    EXPECT_NE(std::string::npos, lines[2].find("Sensor error 3"));
+}
+
+TEST_F(LoggerTest, LongMessageTruncated)
+{
+    std::string long_message(2 * LOG_MESSAGE_SIZE, 'x');
+
+    LOG(LOG_NOTICE, "%s", long_message.c_str());
+
+    std::vector<std::string> lines = ReadLines();
+    ASSERT_EQ(1U, lines.size());
+    EXPECT_NE(std::string::npos, lines[0].find(std::string(LOG_MESSAGE_SIZE - 1, 'x')));
+    EXPECT_EQ(std::string::npos, lines[0].find(std::string(LOG_MESSAGE_SIZE, 'x')));
+}
+
+TEST_F(LoggerTest, UnwritableFile)
+{
+    EXPECT_EQ(-1, Logger::Instance().SetSink(LogSink::File, "/nonexistent/kinectalarm.log"));
+}
@@ -15,12 +15,17 @@
 
 #include "../../inc/message_broker.hpp"
 #include "mocks/message_broker_observer_mock.hpp"
+#include "../common/fakes/resp_server_fake.hpp"
 
 /*******************************************************************
  * Defines
  *******************************************************************/
-#ifndef REDIS_UNIX_SOCKET
-    #define REDIS_UNIX_SOCKET "/var/run/redis/redis-server.sock"
+/* Without a Redis server given the tests run against the in-process stand-in */
+#ifdef REDIS_UNIX_SOCKET
+    #define RESP_SERVER_FAKE false
+#else
+    #define REDIS_UNIX_SOCKET "/tmp/kinectalarm_tests_redis.sock"
+    #define RESP_SERVER_FAKE true
 #endif
 
 /*******************************************************************
@@ -33,9 +38,25 @@ using ::testing::StrictMock;
 using ::testing::SetArgReferee;
 using ::testing::Ref;
 
+/* Only has the default ExecuteBatch() */
+class SequentialMessageBroker : public IMessageBroker
+{
+public:
+    uint32_t commands = 0;
+
+    int Subscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer) override { return 0; }
+    int Unsubscribe(const std::string& channel, const std::shared_ptr<IChannelMessageObserver> observer) override { return 0; }
+    int Publish(const std::string& channel, const std::string& message) override { commands++; return 0; }
+    int GetVariable(Variable& variable) override { return 0; }
+    int SetVariable(const Variable& variable) override { commands++; return 0; }
+    int SetVariableExpiration(const Variable& variable, int livetime_seconds) override { return 0; }
+    int Clear() override { return 0; }
+};
+
 class MessageBrokerTest : public ::testing::Test
 {
 public:
+    std::unique_ptr<RespServerFake> resp_server{RESP_SERVER_FAKE ? std::make_unique<RespServerFake>(REDIS_UNIX_SOCKET) : nullptr};
     MessageBroker message_broker{REDIS_UNIX_SOCKET};
     std::shared_ptr<ChannelMessageObserverMock> channel_observer_mock, channel_observer_mock_2;
 
@@ -141,6 +162,42 @@ TEST_F(MessageBrokerTest, TwosubscribersOneUnsubscribe)
 }
 
 
+TEST_F(MessageBrokerTest, PublishStats)
+{
+    std::string message("testing");
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(message)).Times(10);
+    EXPECT_EQ(0, message_broker.Subscribe("test", channel_observer_mock));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+    for(int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(0, message_broker.Publish("test", message));
+    }
+    std::this_thread::sleep_for (std::chrono::milliseconds(20));
+
+    PublishStats stats = message_broker.GetPublishStats();
+    EXPECT_EQ(10U, stats.queued);
+    EXPECT_EQ(10U, stats.sent);
+    EXPECT_EQ(0U, stats.failed);
+    EXPECT_EQ(0U, stats.dropped);
+}
+
+TEST_F(MessageBrokerTest, PublishFromObserver)
+{
+    std::string message("testing");
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(message)).Times(1).WillOnce([&](std::string_view)
+    {
+        /* Called from the event loop thread, Publish() mustn't wait for it */
+        EXPECT_EQ(0, message_broker.Publish("test2", message));
+    });
+    EXPECT_CALL(*channel_observer_mock_2, ChannelMessageListener(message)).Times(1);
+    EXPECT_EQ(0, message_broker.Subscribe("test1", channel_observer_mock));
+    EXPECT_EQ(0, message_broker.Subscribe("test2", channel_observer_mock_2));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+    EXPECT_EQ(0, message_broker.Publish("test1", message));
+    std::this_thread::sleep_for (std::chrono::milliseconds(10));
+}
+
+
 TEST_F(MessageBrokerTest, GetEmptyVar)
 {
     Variable var{"testvar", DataType::Integer, 0};
@@ -188,6 +245,17 @@ TEST_F(MessageBrokerTest, SetGetVariable_String)
     EXPECT_EQ(std::get<std::string>(var.value),std::get<std::string>(var2.value));
 }
 
+TEST_F(MessageBrokerTest, SetGetVariable_BinaryString)
+{
+    Variable var{"test var", DataType::String, std::string("hello world\0\r\n", 14)};
+    Variable var2{"test var", DataType::String, std::string()};
+
+    EXPECT_EQ(0, message_broker.SetVariable(var));
+    EXPECT_EQ(0, message_broker.GetVariable(var2));
+
+    EXPECT_EQ(std::get<std::string>(var.value),std::get<std::string>(var2.value));
+}
+
 TEST_F(MessageBrokerTest, SetGetVariable_Bool)
 {
     Variable var{"testvar", DataType::Boolean, true};
@@ -212,4 +280,239 @@ TEST_F(MessageBrokerTest, SetGetVariableExpiration)
     std::this_thread::sleep_for (std::chrono::milliseconds(1100));
 
     EXPECT_NE(0, message_broker.GetVariable(var2));
-}
\ No newline at end of file
+}
+TEST_F(MessageBrokerTest, ExecuteBatch)
+{
+    std::string message("testing");
+    MessageBrokerBatch batch;
+    Variable var{"testvar", DataType::Integer, 10};
+    Variable var2{"testvar2", DataType::String, std::string("hello world")};
+    Variable result{"testvar", DataType::Integer, 0};
+    Variable result2{"testvar2", DataType::String, std::string()};
+
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(message)).Times(1);
+    EXPECT_EQ(0, message_broker.Subscribe("test", channel_observer_mock));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+
+    batch.SetVariable(var);
+    batch.SetVariable(var2);
+    batch.Publish("test", message);
+    EXPECT_EQ(0, message_broker.ExecuteBatch(batch));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+
+    EXPECT_EQ(0, message_broker.GetVariable(result));
+    EXPECT_EQ(0, message_broker.GetVariable(result2));
+    EXPECT_EQ(std::get<int>(var.value), std::get<int>(result.value));
+    EXPECT_EQ(std::get<std::string>(var2.value), std::get<std::string>(result2.value));
+}
+
+TEST_F(MessageBrokerTest, ExecuteBatchAtomic)
+{
+    MessageBrokerBatch batch;
+    Variable var{"testvar", DataType::Integer, 10};
+    Variable result{"testvar", DataType::Integer, 0};
+
+    batch.SetVariable(var);
+    batch.Publish("test", "testing");
+    EXPECT_EQ(0, message_broker.ExecuteBatch(batch, true));
+
+    EXPECT_EQ(0, message_broker.GetVariable(result));
+    EXPECT_EQ(std::get<int>(var.value), std::get<int>(result.value));
+}
+
+TEST_F(MessageBrokerTest, ExecuteBatchWrongValue)
+{
+    MessageBrokerBatch batch;
+    Variable result{"testvar", DataType::Integer, 0};
+
+    batch.SetVariable({"testvar", DataType::Integer, 10});
+    batch.SetVariable({"testvar2", DataType::Integer, std::string("not an integer")});
+    EXPECT_NE(0, message_broker.ExecuteBatch(batch));
+
+    /* Nothing sent */
+    EXPECT_NE(0, message_broker.GetVariable(result));
+}
+
+TEST_F(MessageBrokerTest, ExecuteBatchInPublishOrder)
+{
+    ::testing::InSequence seq;
+    MessageBrokerBatch batch;
+
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(std::string("1"))).Times(1);
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(std::string("2"))).Times(1);
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(std::string("3"))).Times(1);
+    EXPECT_EQ(0, message_broker.Subscribe("test", channel_observer_mock));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+
+    /* Behind the publishes queued before it, counted with them */
+    batch.SetVariable({"testvar", DataType::Integer, 10});
+    batch.Publish("test", "2");
+    EXPECT_EQ(0, message_broker.Publish("test", "1"));
+    EXPECT_EQ(0, message_broker.ExecuteBatch(batch, true));
+    EXPECT_EQ(0, message_broker.Publish("test", "3"));
+    std::this_thread::sleep_for (std::chrono::milliseconds(20));
+
+    PublishStats stats = message_broker.GetPublishStats();
+    EXPECT_EQ(3U, stats.queued);
+    EXPECT_EQ(3U, stats.sent);
+}
+
+TEST_F(MessageBrokerTest, ExecuteBatchWithoutRedis)
+{
+    std::unique_ptr<MessageBroker> offline_message_broker;
+    MessageBrokerBatch batch;
+
+    ASSERT_NO_THROW(offline_message_broker = std::make_unique<MessageBroker>("/nonexistent/redis.sock"));
+    batch.SetVariable({"testvar", DataType::Integer, 10});
+    batch.Publish("test", "kept");
+
+    /* Not applied, the event waits for Redis like the other publishes */
+    EXPECT_NE(0, offline_message_broker->ExecuteBatch(batch, true));
+
+    PublishStats stats = offline_message_broker->GetPublishStats();
+    EXPECT_EQ(1U, stats.queued);
+    EXPECT_EQ(0U, stats.sent);
+    EXPECT_EQ(0U, stats.dropped);
+}
+
+TEST_F(MessageBrokerTest, PostBatchWithoutRedis)
+{
+    std::unique_ptr<MessageBroker> offline_message_broker;
+    MessageBrokerBatch batch;
+    std::promise<int> result;
+    std::future<int> done = result.get_future();
+
+    ASSERT_NO_THROW(offline_message_broker = std::make_unique<MessageBroker>("/nonexistent/redis.sock"));
+    batch.SetVariable({"testvar", DataType::Integer, 10});
+    batch.Publish("test", "kept");
+
+    /* Returns straight away, the result comes later */
+    EXPECT_EQ(0, offline_message_broker->PostBatch(batch, true, [&result](int batch_result) { result.set_value(batch_result); }));
+    ASSERT_EQ(std::future_status::ready, done.wait_for(std::chrono::seconds(5)));
+    EXPECT_NE(0, done.get());
+
+    /* Nothing queued with a wrong value, no result either */
+    batch.SetVariable({"testvar2", DataType::Integer, std::string("not an integer")});
+    EXPECT_NE(0, offline_message_broker->PostBatch(batch, true, [](int) { FAIL(); }));
+}
+
+TEST_F(MessageBrokerTest, DefaultExecuteBatchNotAtomic)
+{
+    SequentialMessageBroker sequential_message_broker;
+    MessageBrokerBatch batch;
+
+    batch.SetVariable({"testvar", DataType::Integer, 10});
+    batch.Publish("test", "testing");
+
+    EXPECT_NE(0, sequential_message_broker.ExecuteBatch(batch, true));
+    EXPECT_EQ(0U, sequential_message_broker.commands);
+    EXPECT_EQ(0, sequential_message_broker.ExecuteBatch(batch));
+    EXPECT_EQ(2U, sequential_message_broker.commands);
+}
+
+TEST_F(MessageBrokerTest, SubscribeWhileDispatching)
+{
+    std::string message("testing");
+    std::atomic<bool> running(true);
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(message)).Times(100);
+    EXPECT_CALL(*channel_observer_mock_2, ChannelMessageListener(_)).Times(::testing::AnyNumber());
+    EXPECT_EQ(0, message_broker.Subscribe("test", channel_observer_mock));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+
+    /* The table is swapped continuously while the loop thread dispatches */
+    std::thread subscriber([&]
+    {
+        while(running)
+        {
+            message_broker.Subscribe("test", channel_observer_mock_2);
+            message_broker.Unsubscribe("test", channel_observer_mock_2);
+        }
+    });
+
+    for(int i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(0, message_broker.Publish("test", message));
+    }
+    std::this_thread::sleep_for (std::chrono::milliseconds(50));
+
+    running = false;
+    subscriber.join();
+}
+
+TEST_F(MessageBrokerTest, WithoutRedis)
+{
+    std::unique_ptr<MessageBroker> offline_message_broker;
+
+    ASSERT_NO_THROW(offline_message_broker = std::make_unique<MessageBroker>("/nonexistent/redis.sock"));
+    EXPECT_FALSE(offline_message_broker->IsConnected());
+    offline_message_broker->SetVolatileChannel("volatile");
+
+    EXPECT_NE(0, offline_message_broker->SetVariable(Variable{"test", DataType::Integer, 10}));
+    EXPECT_EQ(0, offline_message_broker->Publish("test", "kept"));
+    EXPECT_EQ(0, offline_message_broker->Publish("volatile", "dropped"));
+    std::this_thread::sleep_for (std::chrono::milliseconds(10));
+
+    /* The first one waits in the offline buffer */
+    PublishStats stats = offline_message_broker->GetPublishStats();
+    EXPECT_EQ(2U, stats.queued);
+    EXPECT_EQ(0U, stats.sent);
+    EXPECT_EQ(0U, stats.failed);
+    EXPECT_EQ(1U, stats.dropped);
+}
+
+TEST_F(MessageBrokerTest, Reconnect)
+{
+    if(resp_server == nullptr)
+    {
+        GTEST_SKIP() << "Needs the RESP server stand-in";
+    }
+
+    std::string message("testing");
+    Variable variable{"test", DataType::Integer, 10};
+    EXPECT_CALL(*channel_observer_mock, ChannelMessageListener(message)).Times(1);
+    EXPECT_EQ(0, message_broker.Subscribe("test", channel_observer_mock));
+    EXPECT_EQ(0, message_broker.SetVariable(variable));
+    std::this_thread::sleep_for (std::chrono::milliseconds(5));
+    ASSERT_TRUE(message_broker.IsConnected());
+
+    /* Lost variables and publishes made while down are restored once the server is back */
+    resp_server->Stop();
+    std::this_thread::sleep_for (std::chrono::milliseconds(20));
+    EXPECT_FALSE(message_broker.IsConnected());
+    EXPECT_EQ(0, message_broker.Publish("test", message));
+    ASSERT_EQ(0, resp_server->Start());
+
+    for(int i = 0; i < 100 && !message_broker.IsConnected(); i++)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(message_broker.IsConnected());
+    std::this_thread::sleep_for (std::chrono::milliseconds(10));
+
+    variable.value = 0;
+    EXPECT_EQ(0, message_broker.GetVariable(variable));
+    EXPECT_EQ(10, std::get<int32_t>(variable.value));
+
+    PublishStats stats = message_broker.GetPublishStats();
+    EXPECT_EQ(1U, stats.sent);
+    EXPECT_EQ(0U, stats.dropped);
+}
+
+TEST_F(MessageBrokerTest, PublishDoesntWaitForRedis)
+{
+    if(resp_server == nullptr)
+    {
+        GTEST_SKIP() << "Needs the RESP server stand-in";
+    }
+
+    resp_server->SetReplyLatency(std::chrono::milliseconds(20));
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(0, message_broker.Publish("test", "testing"));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+    resp_server->SetReplyLatency(std::chrono::microseconds(0));
+}
@@ -18,5 +18,5 @@ public:
     ChannelMessageObserverMock();
     virtual ~ChannelMessageObserverMock();
 
-    MOCK_METHOD(void, ChannelMessageListener, (const std::string& message));
+    MOCK_METHOD(void, ChannelMessageListener, (std::string_view message));
 };
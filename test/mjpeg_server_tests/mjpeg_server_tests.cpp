@@ -0,0 +1,169 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file mjpeg_server_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "../../inc/mjpeg_server.hpp"
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+class MjpegServerTest : public ::testing::Test
+{
+public:
+    MjpegServer server{"127.0.0.1", 0, "/liveview.mjpg", 100};
+
+    int Connect(const std::string& target)
+    {
+        sockaddr_in address = {};
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        std::string request = "GET " + target + " HTTP/1.0\r\n\r\n";
+
+        address.sin_family = AF_INET;
+        address.sin_port = htons(server.GetPort());
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+        EXPECT_EQ(static_cast<ssize_t>(request.size()), send(fd, request.data(), request.size(), 0));
+
+        return fd;
+    }
+
+    /* Everything received during timeout_ms */
+    std::string Receive(int fd, int timeout_ms)
+    {
+        std::string received;
+        char buffer[4096];
+        pollfd poll_fd = {fd, POLLIN, 0};
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        ssize_t length;
+
+        while(std::chrono::steady_clock::now() < deadline && poll(&poll_fd, 1, 5) >= 0)
+        {
+            if((poll_fd.revents & POLLIN) && (length = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+            {
+                received.append(buffer, length);
+            }
+        }
+
+        return received;
+    }
+
+    static size_t CountFrames(const std::string& stream)
+    {
+        size_t count = 0;
+
+        for(size_t position = stream.find("--" MJPEG_SERVER_BOUNDARY); position != std::string::npos;
+            position = stream.find("--" MJPEG_SERVER_BOUNDARY, position + 1))
+        {
+            count++;
+        }
+
+        return count;
+    }
+
+    static std::vector<uint8_t> Jpeg(const std::string& content)
+    {
+        return std::vector<uint8_t>(content.begin(), content.end());
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(MjpegServerTest, NotFound)
+{
+    int fd = Connect("/other");
+
+    EXPECT_NE(std::string::npos, Receive(fd, 50).find("404"));
+    close(fd);
+}
+
+TEST_F(MjpegServerTest, CurrentFrameOnConnect)
+{
+    server.PushFrame(Jpeg("first frame"));
+    int fd = Connect("/liveview.mjpg");
+    std::string stream = Receive(fd, 50);
+
+    EXPECT_NE(std::string::npos, stream.find("multipart/x-mixed-replace; boundary=" MJPEG_SERVER_BOUNDARY));
+    EXPECT_NE(std::string::npos, stream.find("Content-Type: image/jpeg\r\nContent-Length: 11\r\n\r\nfirst frame\r\n"));
+    close(fd);
+}
+
+TEST_F(MjpegServerTest, FramesToEveryClient)
+{
+    int fd_1 = Connect("/liveview.mjpg");
+    int fd_2 = Connect("/liveview.mjpg");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(2U, server.GetStats().clients);
+
+    server.PushFrame(Jpeg("frame"));
+    EXPECT_EQ(1U, CountFrames(Receive(fd_1, 50)));
+    EXPECT_EQ(1U, CountFrames(Receive(fd_2, 50)));
+    EXPECT_EQ(2U, server.GetStats().frames_sent);
+
+    close(fd_1);
+    close(fd_2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(0U, server.GetStats().clients);
+}
+
+TEST_F(MjpegServerTest, ClientPacing)
+{
+    int fd = Connect("/liveview.mjpg?fps=1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    /* Only the first one goes within the second, the next ones replace each other */
+    for(int i = 0; i < 3; i++)
+    {
+        server.PushFrame(Jpeg("frame " + std::to_string(i)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::string stream = Receive(fd, 100);
+
+    EXPECT_EQ(1U, CountFrames(stream));
+    EXPECT_NE(std::string::npos, stream.find("frame 0"));
+
+    stream = Receive(fd, 1000);
+    EXPECT_EQ(1U, CountFrames(stream));
+    EXPECT_NE(std::string::npos, stream.find("frame 2"));
+    EXPECT_EQ(1U, server.GetStats().frames_dropped);
+    close(fd);
+}
+
+TEST_F(MjpegServerTest, SlowClientDoesntBlock)
+{
+    int fd = Connect("/liveview.mjpg");
+    std::vector<uint8_t> jpeg(256 * 1024, 0xAA);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    /* The client never reads: frames are dropped instead of queued */
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < 50; i++)
+    {
+        server.PushFrame(jpeg);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    MjpegServerStats stats = server.GetStats();
+    EXPECT_GT(stats.frames_dropped, 0U);
+    EXPECT_LT(stats.frames_sent, 50U);
+    close(fd);
+}
@@ -0,0 +1,95 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file mpsc_queue_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "../../inc/mpsc_queue.hpp"
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(MpscQueueTest, PopEmpty)
+{
+    MpscQueue<int> queue;
+    int value = 0;
+
+    EXPECT_FALSE(queue.Pop(value));
+}
+
+TEST(MpscQueueTest, Fifo)
+{
+    MpscQueue<std::string> queue;
+    std::string value;
+
+    queue.Push("first");
+    queue.Push("second");
+
+    ASSERT_TRUE(queue.Pop(value));
+    EXPECT_EQ("first", value);
+    ASSERT_TRUE(queue.Pop(value));
+    EXPECT_EQ("second", value);
+    EXPECT_FALSE(queue.Pop(value));
+}
+
+TEST(MpscQueueTest, DestructorReleasesElements)
+{
+    auto element = std::make_shared<int>(0);
+    {
+        MpscQueue<std::shared_ptr<int>> queue;
+        queue.Push(element);
+        queue.Push(element);
+        EXPECT_EQ(3, element.use_count());
+    }
+    EXPECT_EQ(1, element.use_count());
+}
+
+TEST(MpscQueueTest, ConcurrentProducers)
+{
+    const uint32_t producers = 4, elements = 100000;
+    MpscQueue<uint64_t> queue;
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> last(producers, 0);
+    uint64_t value;
+    uint32_t popped = 0;
+
+    for(uint32_t producer = 0; producer < producers; producer++)
+    {
+        threads.emplace_back([&queue, producer]
+        {
+            for(uint64_t i = 1; i <= elements; i++)
+            {
+                queue.Push((static_cast<uint64_t>(producer) << 32) | i);
+            }
+        });
+    }
+
+    while(popped < producers * elements)
+    {
+        if(queue.Pop(value))
+        {
+            uint32_t producer = value >> 32;
+
+            /* Each producer's elements come out in its own order */
+            ASSERT_EQ(last[producer] + 1, value & 0xFFFFFFFF);
+            last[producer] = value & 0xFFFFFFFF;
+            popped++;
+        }
+    }
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_FALSE(queue.Pop(value));
+}
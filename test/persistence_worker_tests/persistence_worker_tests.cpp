@@ -0,0 +1,128 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file persistence_worker_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include "../../inc/persistence_worker.hpp"
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(PersistenceWorkerTest, AppliedInOrder)
+{
+    PersistenceWorker worker;
+    std::vector<int> applied;
+
+    for(int i = 0; i < 100; i++)
+    {
+        worker.Post([&applied, i] { applied.push_back(i); });
+    }
+    worker.Flush();
+
+    ASSERT_EQ(100U, applied.size());
+    for(int i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(i, applied[i]);
+    }
+}
+
+TEST(PersistenceWorkerTest, PostDoesntWait)
+{
+    PersistenceWorker worker;
+    std::atomic<bool> release(false);
+
+    worker.Post([&release]
+    {
+        while(!release.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    worker.Post([] {});
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+
+    release.store(true);
+}
+
+TEST(PersistenceWorkerTest, LaterWithSameKeyReplaces)
+{
+    PersistenceWorker worker;
+    std::atomic<bool> release(false);
+    std::vector<std::string> applied;
+
+    /* Holds the worker so the next ones end up in the same batch */
+    worker.Post([&release]
+    {
+        while(!release.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    worker.Post([&applied] { applied.push_back("status 1"); }, "status");
+    worker.Post([&applied] { applied.push_back("detection"); });
+    worker.Post([&applied] { applied.push_back("status 2"); }, "status");
+    release.store(true);
+    worker.Flush();
+
+    ASSERT_EQ(2U, applied.size());
+    EXPECT_EQ("detection", applied[0]);
+    EXPECT_EQ("status 2", applied[1]);
+}
+
+TEST(PersistenceWorkerTest, DestructorAppliesEverything)
+{
+    std::atomic<int> applied(0);
+
+    {
+        PersistenceWorker worker;
+        for(int i = 0; i < 1000; i++)
+        {
+            worker.Post([&applied] { applied++; });
+        }
+    }
+
+    EXPECT_EQ(1000, applied.load());
+}
+
+TEST(PersistenceWorkerTest, ConcurrentProducers)
+{
+    PersistenceWorker worker;
+    std::vector<std::thread> producers;
+    std::atomic<int> applied(0);
+
+    for(int i = 0; i < 4; i++)
+    {
+        producers.emplace_back([&worker, &applied]
+        {
+            for(int j = 0; j < 10000; j++)
+            {
+                worker.Post([&applied] { applied++; });
+                if(j % 1000 == 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        });
+    }
+    for(auto& producer : producers)
+    {
+        producer.join();
+    }
+    worker.Flush();
+
+    EXPECT_EQ(40000, applied.load());
+}
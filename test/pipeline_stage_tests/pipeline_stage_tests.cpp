@@ -0,0 +1,187 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file pipeline_stage_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+
+#include "../../inc/pipeline_stage.hpp"
+#include "../../inc/object_pool.hpp"
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(PipelineStageTest, ProcessedInOrder)
+{
+    std::vector<int> processed;
+    {
+        PipelineStage<int> stage("Test stage", 1, 16, CyclicTaskConfig(), [&processed](int& item) { processed.push_back(item); });
+
+        for(int i = 0; i < 10; i++)
+        {
+            EXPECT_TRUE(stage.Push(0, int(i)));
+        }
+    }
+
+    /* Everything pushed is processed before the destructor returns */
+    ASSERT_EQ(10U, processed.size());
+    for(int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(i, processed[i]);
+    }
+}
+
+TEST(PipelineStageTest, DropsWhenFull)
+{
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    PipelineStage<int> stage("Test stage", 1, 2, CyclicTaskConfig(), [released](int& item) { released.wait(); });
+
+    /* The first one is taken by the stage and blocks it, two fill the input */
+    EXPECT_TRUE(stage.Push(0, 0));
+    while(stage.GetStats().occupancy != 0)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(stage.Push(0, 1));
+    EXPECT_TRUE(stage.Push(0, 2));
+    EXPECT_FALSE(stage.Push(0, 3));
+    stage.Dropped(0);
+
+    PipelineStageStats stats = stage.GetStats();
+    EXPECT_EQ(3U, stats.pushed);
+    EXPECT_EQ(2U, stats.dropped);
+    EXPECT_EQ(2U, stats.occupancy);
+    EXPECT_EQ(2U, stats.max_occupancy);
+    EXPECT_EQ(2U, stats.capacity);
+
+    release.set_value();
+    while(stage.GetStats().processed != 3)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(0U, stage.GetStats().occupancy);
+}
+
+TEST(PipelineStageTest, PushOrDeferNotDropped)
+{
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::vector<int> processed;
+    {
+        PipelineStage<int> stage("Test stage", 1, 1, CyclicTaskConfig(), [released, &processed](int& item)
+        {
+            released.wait();
+            processed.push_back(item);
+        });
+
+        /* The first one blocks the stage, the second fills the input */
+        EXPECT_TRUE(stage.Push(0, 0));
+        while(stage.GetStats().occupancy != 0)
+        {
+            std::this_thread::yield();
+        }
+        EXPECT_TRUE(stage.Push(0, 1));
+
+        /* Kept aside without waiting, nothing goes ahead of them */
+        stage.PushOrDefer(0, 2);
+        stage.PushOrDefer(0, 3);
+        EXPECT_FALSE(stage.Push(0, 4));
+
+        PipelineStageStats stats = stage.GetStats();
+        EXPECT_EQ(4U, stats.pushed);
+        EXPECT_EQ(1U, stats.dropped);
+        EXPECT_EQ(3U, stats.occupancy);
+
+        release.set_value();
+    }
+
+    ASSERT_EQ(4U, processed.size());
+    for(int i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(i, processed[i]);
+    }
+}
+
+TEST(PipelineStageTest, SeveralInputs)
+{
+    const int items = 100000;
+    std::vector<int> last(2, -1);
+    bool ordered = true;
+    PipelineStageStats stats;
+    {
+        PipelineStage<std::pair<int, int>> stage("Test stage", 2, 8, CyclicTaskConfig(), [&](std::pair<int, int>& item)
+        {
+            ordered = ordered && (item.second > last[item.first]);
+            last[item.first] = item.second;
+        });
+
+        std::vector<std::thread> producers;
+        for(int input = 0; input < 2; input++)
+        {
+            producers.emplace_back([&stage, input]
+            {
+                for(int i = 0; i < items; i++)
+                {
+                    stage.Push(input, std::make_pair(input, i));
+                }
+            });
+        }
+
+        for(auto& producer : producers)
+        {
+            producer.join();
+        }
+        stats = stage.GetStats();
+    }
+
+    /* Each input in order, what didn't fit is counted */
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(2U * items, stats.pushed + stats.dropped);
+}
+
+TEST(PipelineStageTest, ObjectPool)
+{
+    ObjectPool<std::vector<int>> pool(2, [] { return std::make_unique<std::vector<int>>(4); });
+
+    std::shared_ptr<std::vector<int>> first = pool.Acquire();
+    std::shared_ptr<std::vector<int>> second = pool.Acquire();
+
+    ASSERT_NE(nullptr, first);
+    ASSERT_NE(nullptr, second);
+    EXPECT_EQ(nullptr, pool.Acquire());
+    EXPECT_EQ(0U, pool.Available());
+
+    /* Given back when the last reference is dropped, as it was left */
+    (*first)[0] = 7;
+    std::vector<int> *object = first.get();
+    first.reset();
+    EXPECT_EQ(1U, pool.Available());
+
+    std::shared_ptr<std::vector<int>> again = pool.Acquire();
+    EXPECT_EQ(object, again.get());
+    EXPECT_EQ(7, (*again)[0]);
+}
+
+TEST(PipelineStageTest, ObjectOutlivesPool)
+{
+    std::shared_ptr<int> object;
+    {
+        ObjectPool<int> pool(1, [] { return std::make_unique<int>(5); });
+        object = pool.Acquire();
+    }
+
+    ASSERT_NE(nullptr, object);
+    EXPECT_EQ(5, *object);
+    object.reset();
+}
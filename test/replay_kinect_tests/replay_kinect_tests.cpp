@@ -0,0 +1,284 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file replay_kinect_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+#include <csignal>
+#include <sys/resource.h>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "../../inc/replay_kinect.hpp"
+#include "../../inc/kinect_recording.hpp"
+#include "../../inc/global_parameters.hpp"
+#include "../common/mocks/kinect_mock.hpp"
+#include "../common/mocks/kinect_frame_observer_mock.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define RECORDING_PATH "/tmp/replay_kinect_tests.rec"
+#define TIMEOUT_MS 100U
+#define FRAME_PERIOD_MS 20U
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+using ::testing::_;
+using ::testing::Return;
+using ::testing::StrictMock;
+using ::testing::NiceMock;
+using ::testing::InSequence;
+using ::testing::Invoke;
+
+class ReplayKinectTest : public ::testing::Test
+{
+public:
+    std::shared_ptr<KinectMock> kinect_mock;
+    std::shared_ptr<KinectFrameObserver> depth_observer;
+    std::shared_ptr<KinectFrameObserver> video_observer;
+    uint32_t num_frames = 3;
+
+    ReplayKinectTest()
+    {
+        kinect_mock = std::make_shared<NiceMock<KinectMock>>();
+    }
+
+    ~ReplayKinectTest()
+    {
+        remove(RECORDING_PATH);
+    }
+
+    void FillFrameWithValue(KinectFrame& frame, uint16_t value, uint32_t timestamp)
+    {
+        std::vector<uint16_t> frame_data(DEPTH_WIDTH * DEPTH_HEIGHT, value);
+        frame.Fill(frame_data.data(), timestamp);
+    }
+
+    /* Records num_frames depth frames (value = timestamp = i+1) and one video frame */
+    void CreateRecording()
+    {
+        KinectRecorder recorder(kinect_mock);
+        KinectDepthFrame depth_frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+        KinectVideoFrame video_frame(VIDEO_WIDTH, VIDEO_HEIGHT);
+
+        EXPECT_CALL(*kinect_mock, Subscribe(KinectFrameType::Depth, _)).
+            WillOnce(DoAll(SaveArg<1>(&depth_observer), Return(0)));
+        EXPECT_CALL(*kinect_mock, Subscribe(KinectFrameType::Video, _)).
+            WillOnce(DoAll(SaveArg<1>(&video_observer), Return(0)));
+
+        ASSERT_EQ(recorder.Start(RECORDING_PATH), 0);
+
+        for(uint32_t i = 0; i < num_frames; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_PERIOD_MS));
+            FillFrameWithValue(depth_frame, i + 1, i + 1);
+            depth_observer->NewDepthFrame(depth_frame, i + 1);
+        }
+        FillFrameWithValue(video_frame, 42, 42);
+        video_observer->NewVideoFrame(video_frame, 1);
+
+        ASSERT_EQ(recorder.Stop(), 0);
+        ASSERT_EQ(recorder.GetNumberOfFrames(), num_frames + 1);
+        ASSERT_EQ(recorder.GetDroppedFrames(), 0U);
+    }
+
+    void WaitUntilFinished(ReplayKinect& replay_kinect, uint32_t timeout_ms)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while(!replay_kinect.IsFinished() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(ReplayKinectTest, InitFailsWithoutRecording)
+{
+    ReplayKinect replay_kinect("/tmp/non_existent_recording.rec", {}, TIMEOUT_MS);
+
+    ASSERT_NE(replay_kinect.Init(), 0);
+    ASSERT_NE(replay_kinect.Start(), 0);
+}
+
+TEST_F(ReplayKinectTest, InitFailsWithCorruptedRecording)
+{
+    CreateRecording();
+
+    /* Cut the last frame in half */
+    FILE* file = fopen(RECORDING_PATH, "r+");
+    ASSERT_NE(file, nullptr);
+    fseek(file, 0, SEEK_END);
+    ASSERT_EQ(ftruncate(fileno(file), ftell(file) - (VIDEO_WIDTH * VIDEO_HEIGHT)), 0);
+    fclose(file);
+
+    ReplayKinect replay_kinect(RECORDING_PATH, {}, TIMEOUT_MS);
+    ASSERT_NE(replay_kinect.Init(), 0);
+}
+
+TEST_F(ReplayKinectTest, RecordingStopsOnShortWrite)
+{
+    KinectRecorder recorder(kinect_mock);
+    KinectDepthFrame depth_frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+    const uint64_t frame_size = sizeof(KinectRecordingFrameHeader) + DEPTH_WIDTH * DEPTH_HEIGHT * sizeof(uint16_t);
+    rlimit file_size_limit, previous_limit;
+
+    EXPECT_CALL(*kinect_mock, Subscribe(KinectFrameType::Depth, _)).
+        WillOnce(DoAll(SaveArg<1>(&depth_observer), Return(0)));
+    EXPECT_CALL(*kinect_mock, Subscribe(KinectFrameType::Video, _)).
+        WillOnce(Return(0));
+    ASSERT_EQ(recorder.Start(RECORDING_PATH), 0);
+
+    /* Room for one frame and a half, the disk is full in the middle of the second one */
+    signal(SIGXFSZ, SIG_IGN);
+    getrlimit(RLIMIT_FSIZE, &previous_limit);
+    file_size_limit = previous_limit;
+    file_size_limit.rlim_cur = sizeof(KinectRecordingHeader) + frame_size + frame_size / 2;
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &file_size_limit), 0);
+
+    FillFrameWithValue(depth_frame, 1, 1);
+    depth_observer->NewDepthFrame(depth_frame, 1);
+    FillFrameWithValue(depth_frame, 2, 2);
+    depth_observer->NewDepthFrame(depth_frame, 2);
+
+    /* Written by the recorder's thread */
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(recorder.IsRecording() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_FALSE(recorder.IsRecording());
+
+    setrlimit(RLIMIT_FSIZE, &previous_limit);
+    EXPECT_EQ(recorder.Stop(), 0);
+    EXPECT_EQ(recorder.GetNumberOfFrames(), 1U);
+
+    /* Cut back to the last complete frame, it can be replayed */
+    ReplayKinect replay_kinect(RECORDING_PATH, {}, TIMEOUT_MS);
+    EXPECT_EQ(replay_kinect.Init(), 0);
+}
+
+TEST_F(ReplayKinectTest, AsFastAsPossibleDeliversEveryFrameInOrder)
+{
+    CreateRecording();
+
+    ReplayKinect replay_kinect(RECORDING_PATH, {ReplayMode::AsFastAsPossible, false}, TIMEOUT_MS);
+    auto observer = std::make_shared<StrictMock<KinectFrameObserverMock>>();
+    ASSERT_EQ(replay_kinect.Init(), 0);
+    ASSERT_EQ(replay_kinect.GetNumberOfFrames(), num_frames + 1);
+
+    {
+        InSequence sequence;
+        for(uint32_t i = 0; i < num_frames; i++)
+        {
+            EXPECT_CALL(*observer, NewDepthFrame(_, i + 1)).WillOnce(Invoke([i](const KinectDepthFrame& frame, uint64_t)
+            {
+                EXPECT_EQ(frame.GetTimestamp(), i + 1);
+                EXPECT_EQ(frame.GetDataPointer()[0], i + 1);
+            }));
+        }
+        EXPECT_CALL(*observer, NewVideoFrame(_, 1)).WillOnce(Invoke([](const KinectVideoFrame& frame, uint64_t)
+        {
+            EXPECT_EQ(frame.GetTimestamp(), 42U);
+        }));
+    }
+
+    ASSERT_EQ(replay_kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+    ASSERT_EQ(replay_kinect.Subscribe(KinectFrameType::Video, observer), 0);
+
+    auto begin = std::chrono::steady_clock::now();
+    ASSERT_EQ(replay_kinect.Start(), 0);
+    WaitUntilFinished(replay_kinect, 1000);
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    ASSERT_TRUE(replay_kinect.IsFinished());
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), num_frames * FRAME_PERIOD_MS);
+
+    ASSERT_EQ(replay_kinect.Stop(), 0);
+}
+
+TEST_F(ReplayKinectTest, RealTimeHonorsCaptureTimes)
+{
+    CreateRecording();
+
+    ReplayKinect replay_kinect(RECORDING_PATH, {ReplayMode::RealTime, false}, TIMEOUT_MS);
+    ASSERT_EQ(replay_kinect.Init(), 0);
+
+    auto begin = std::chrono::steady_clock::now();
+    ASSERT_EQ(replay_kinect.Start(), 0);
+    WaitUntilFinished(replay_kinect, 1000);
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    ASSERT_TRUE(replay_kinect.IsFinished());
+    EXPECT_GE(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), (num_frames - 1) * FRAME_PERIOD_MS);
+
+    ASSERT_EQ(replay_kinect.Stop(), 0);
+}
+
+TEST_F(ReplayKinectTest, LoopStartsOver)
+{
+    CreateRecording();
+
+    ReplayKinect replay_kinect(RECORDING_PATH, {ReplayMode::AsFastAsPossible, true}, TIMEOUT_MS);
+    auto observer = std::make_shared<NiceMock<KinectFrameObserverMock>>();
+    std::atomic<uint64_t> last_sequence(0);
+
+    ON_CALL(*observer, NewDepthFrame(_, _)).WillByDefault(Invoke([&last_sequence](const KinectDepthFrame&, uint64_t sequence)
+    {
+        last_sequence = sequence;
+    }));
+
+    ASSERT_EQ(replay_kinect.Init(), 0);
+    ASSERT_EQ(replay_kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+    ASSERT_EQ(replay_kinect.Start(), 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    ASSERT_FALSE(replay_kinect.IsFinished());
+    ASSERT_EQ(replay_kinect.Stop(), 0);
+    EXPECT_GT(last_sequence, num_frames);
+}
+
+TEST_F(ReplayKinectTest, GetDepthFrameReturnsNextFrame)
+{
+    CreateRecording();
+
+    ReplayKinect replay_kinect(RECORDING_PATH, {ReplayMode::RealTime, false}, TIMEOUT_MS);
+    KinectDepthFrame depth_frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+
+    ASSERT_EQ(replay_kinect.Init(), 0);
+    ASSERT_EQ(replay_kinect.Start(), 0);
+
+    replay_kinect.GetDepthFrame(depth_frame);
+    EXPECT_EQ(depth_frame.GetTimestamp(), 1U);
+    replay_kinect.GetDepthFrame(depth_frame);
+    EXPECT_EQ(depth_frame.GetTimestamp(), 2U);
+
+    ASSERT_EQ(replay_kinect.Stop(), 0);
+}
+
+TEST_F(ReplayKinectTest, StopWhileWaitingIsFast)
+{
+    CreateRecording();
+
+    ReplayKinect replay_kinect(RECORDING_PATH, {ReplayMode::RealTime, false}, TIMEOUT_MS);
+    ASSERT_EQ(replay_kinect.Init(), 0);
+    ASSERT_EQ(replay_kinect.Start(), 0);
+
+    auto begin = std::chrono::steady_clock::now();
+    ASSERT_EQ(replay_kinect.Stop(), 0);
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), FRAME_PERIOD_MS / 2);
+}
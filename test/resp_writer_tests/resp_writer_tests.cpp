@@ -0,0 +1,102 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file resp_writer_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+
+#include "../../inc/resp_writer.hpp"
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(RespWriterTest, Command)
+{
+    RespWriter command_writer;
+
+    command_writer.BeginCommand(3);
+    command_writer.AddArgument("PUBLISH");
+    command_writer.AddArgument(std::string("event_info"));
+    command_writer.AddArgument("Detection started");
+
+    EXPECT_EQ("*3\r\n$7\r\nPUBLISH\r\n$10\r\nevent_info\r\n$17\r\nDetection started\r\n",
+              std::string(command_writer.GetData(), command_writer.GetSize()));
+}
+
+TEST(RespWriterTest, BinarySafe)
+{
+    RespWriter command_writer;
+    std::string value("a\0b\r\nc", 6);
+
+    command_writer.BeginCommand(2);
+    command_writer.AddArgument(value);
+    command_writer.AddArgument("");
+
+    EXPECT_EQ(std::string("*2\r\n$6\r\na\0b\r\nc\r\n$0\r\n\r\n", 22),
+              std::string(command_writer.GetData(), command_writer.GetSize()));
+}
+
+TEST(RespWriterTest, TypedArguments)
+{
+    RespWriter command_writer;
+
+    command_writer.AddArgument(static_cast<int32_t>(-42));
+    command_writer.AddArgument(1.5f);
+    command_writer.AddArgument(true);
+    command_writer.AddArgument(false);
+
+    EXPECT_EQ("$3\r\n-42\r\n$8\r\n1.500000\r\n$4\r\ntrue\r\n$5\r\nfalse\r\n",
+              std::string(command_writer.GetData(), command_writer.GetSize()));
+}
+
+TEST(RespWriterTest, Variable)
+{
+    RespWriter command_writer;
+
+    EXPECT_EQ(0, command_writer.AddArgument(Variable{"tilt", DataType::Integer, 10}));
+    EXPECT_EQ(0, command_writer.AddArgument(Variable{"version", DataType::String, std::string("1.0 beta")}));
+    EXPECT_EQ(0, command_writer.AddArgument(Variable{"active", DataType::Boolean, true}));
+
+    EXPECT_EQ("$2\r\n10\r\n$8\r\n1.0 beta\r\n$4\r\ntrue\r\n",
+              std::string(command_writer.GetData(), command_writer.GetSize()));
+}
+
+TEST(RespWriterTest, VariableWrongType)
+{
+    RespWriter command_writer;
+
+    EXPECT_NE(0, command_writer.AddArgument(Variable{"tilt", DataType::Integer, std::string("10")}));
+    EXPECT_EQ(0U, command_writer.GetSize());
+}
+
+TEST(RespWriterTest, ClearKeepsCapacity)
+{
+    RespWriter command_writer;
+    std::string value(1024, 'a');
+
+    command_writer.AddArgument(value);
+    const char* data = command_writer.GetData();
+
+    command_writer.Clear();
+    EXPECT_EQ(0U, command_writer.GetSize());
+
+    command_writer.AddArgument(value);
+    EXPECT_EQ(data, command_writer.GetData());
+}
+
+TEST(RespWriterTest, TakeBuffer)
+{
+    RespWriter command_writer;
+
+    command_writer.BeginCommand(1);
+    command_writer.AddArgument("PING");
+
+    EXPECT_EQ("*1\r\n$4\r\nPING\r\n", command_writer.TakeBuffer());
+    EXPECT_EQ(0U, command_writer.GetSize());
+}
@@ -0,0 +1,72 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file ring_buffer_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+
+#include "../../inc/ring_buffer.hpp"
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(RingBufferTest, PopEmpty)
+{
+    RingBuffer<int> ring_buffer(4);
+    int value = 0;
+
+    EXPECT_TRUE(ring_buffer.Empty());
+    EXPECT_FALSE(ring_buffer.Pop(value));
+}
+
+TEST(RingBufferTest, Fifo)
+{
+    RingBuffer<std::string> ring_buffer(4);
+    std::string value;
+
+    EXPECT_FALSE(ring_buffer.Push("first"));
+    EXPECT_FALSE(ring_buffer.Push("second"));
+    EXPECT_EQ(2U, ring_buffer.Size());
+
+    ASSERT_TRUE(ring_buffer.Pop(value));
+    EXPECT_EQ("first", value);
+    ASSERT_TRUE(ring_buffer.Pop(value));
+    EXPECT_EQ("second", value);
+    EXPECT_FALSE(ring_buffer.Pop(value));
+}
+
+TEST(RingBufferTest, OverwriteOldest)
+{
+    RingBuffer<int> ring_buffer(3);
+    int value = 0;
+
+    for(int i = 0; i < 3; i++)
+    {
+        EXPECT_FALSE(ring_buffer.Push(i));
+    }
+    EXPECT_TRUE(ring_buffer.Push(3));
+    EXPECT_TRUE(ring_buffer.Push(4));
+    EXPECT_EQ(3U, ring_buffer.Size());
+
+    for(int i = 2; i <= 4; i++)
+    {
+        ASSERT_TRUE(ring_buffer.Pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_TRUE(ring_buffer.Empty());
+}
+
+TEST(RingBufferTest, ZeroCapacity)
+{
+    RingBuffer<int> ring_buffer(0);
+    int value = 0;
+
+    EXPECT_TRUE(ring_buffer.Push(1));
+    EXPECT_FALSE(ring_buffer.Pop(value));
+}
@@ -0,0 +1,90 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file row_schema_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <string>
+
+#include "../../inc/row_schema.hpp"
+
+/*******************************************************************
+ * Type definitions
+ *******************************************************************/
+struct TestRow
+{
+    int32_t id;
+    float ratio;
+    std::string name;
+    bool active;
+
+    static constexpr auto columns = std::make_tuple(MakeColumn("ID",     &TestRow::id),
+                                                    MakeColumn("RATIO",  &TestRow::ratio),
+                                                    MakeColumn("NAME",   &TestRow::name),
+                                                    MakeColumn("ACTIVE", &TestRow::active));
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(RowSchemaTest, Definition)
+{
+    Entry definition = RowDefinition<TestRow>();
+
+    ASSERT_EQ(4U, definition.size());
+    EXPECT_EQ("ID", definition[0].name);
+    EXPECT_EQ(DataType::Integer, definition[0].data_type);
+    EXPECT_EQ(DataType::Float, definition[1].data_type);
+    EXPECT_EQ(DataType::String, definition[2].data_type);
+    EXPECT_EQ("ACTIVE", definition[3].name);
+    EXPECT_EQ(DataType::Boolean, definition[3].data_type);
+    EXPECT_TRUE(std::holds_alternative<std::string>(definition[2].value));
+}
+
+TEST(RowSchemaTest, RoundTrip)
+{
+    TestRow row{7, 0.5F, "detection", true};
+    TestRow read{};
+    Entry entry = ToEntry(row);
+
+    EXPECT_EQ(7, std::get<int32_t>(entry[0].value));
+    EXPECT_EQ("detection", std::get<std::string>(entry[2].value));
+
+    ASSERT_EQ(0, FromEntry(entry, read));
+    EXPECT_EQ(7, read.id);
+    EXPECT_FLOAT_EQ(0.5F, read.ratio);
+    EXPECT_EQ("detection", read.name);
+    EXPECT_TRUE(read.active);
+}
+
+TEST(RowSchemaTest, LayoutMismatch)
+{
+    TestRow row{};
+    Entry entry = RowDefinition<TestRow>();
+
+    entry[1].value = std::string("not a float");
+    EXPECT_EQ(-1, FromEntry(entry, row));
+
+    entry.pop_back();
+    EXPECT_EQ(-1, FromEntry(entry, row));
+    EXPECT_EQ(-1, ToEntry(row, entry));
+}
+
+TEST(RowSchemaTest, Variables)
+{
+    TestRow row{3, 1.0F, "name", false};
+    std::vector<Variable> variables;
+
+    ForEachVariable(row, [&variables](const Variable& variable) { variables.push_back(variable); });
+
+    ASSERT_EQ(4U, variables.size());
+    EXPECT_EQ("ID", variables[0].name);
+    EXPECT_EQ(3, std::get<int32_t>(variables[0].value));
+    EXPECT_EQ("NAME", variables[2].name);
+    EXPECT_EQ("name", std::get<std::string>(variables[2].value));
+}
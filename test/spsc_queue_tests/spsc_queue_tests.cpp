@@ -0,0 +1,107 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file spsc_queue_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <gtest/gtest.h>
+#include <thread>
+#include <string>
+#include <memory>
+
+#include "../../inc/spsc_queue.hpp"
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST(SpscQueueTest, CapacityRoundedUp)
+{
+    SpscQueue<int> queue(5);
+
+    EXPECT_EQ(8U, queue.Capacity());
+    EXPECT_EQ(0U, queue.Size());
+}
+
+TEST(SpscQueueTest, Fifo)
+{
+    SpscQueue<std::string> queue(4);
+    std::string value;
+
+    EXPECT_FALSE(queue.TryPop(value));
+    EXPECT_TRUE(queue.TryPush("first"));
+    EXPECT_TRUE(queue.TryPush("second"));
+    EXPECT_EQ(2U, queue.Size());
+
+    ASSERT_TRUE(queue.TryPop(value));
+    EXPECT_EQ("first", value);
+    ASSERT_TRUE(queue.TryPop(value));
+    EXPECT_EQ("second", value);
+    EXPECT_FALSE(queue.TryPop(value));
+}
+
+TEST(SpscQueueTest, FullKeepsValue)
+{
+    SpscQueue<std::unique_ptr<int>> queue(2);
+    std::unique_ptr<int> value = std::make_unique<int>(3);
+
+    EXPECT_TRUE(queue.TryPush(std::make_unique<int>(1)));
+    EXPECT_TRUE(queue.TryPush(std::make_unique<int>(2)));
+    EXPECT_FALSE(queue.TryPush(std::move(value)));
+
+    /* Not moved from when it didn't fit */
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(3, *value);
+}
+
+TEST(SpscQueueTest, PopReleasesSlot)
+{
+    auto element = std::make_shared<int>(0);
+    std::shared_ptr<int> value;
+    SpscQueue<std::shared_ptr<int>> queue(2);
+
+    queue.TryPush(std::shared_ptr<int>(element));
+    EXPECT_EQ(2, element.use_count());
+
+    ASSERT_TRUE(queue.TryPop(value));
+    value.reset();
+    EXPECT_EQ(1, element.use_count());
+}
+
+TEST(SpscQueueTest, ConcurrentProducerConsumer)
+{
+    const uint64_t elements = 100000;
+    SpscQueue<uint64_t> queue(64);
+    uint64_t expected = 0, value;
+
+    std::thread producer([&queue]
+    {
+        for(uint64_t i = 0; i < elements; i++)
+        {
+            while(!queue.TryPush(uint64_t(i)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    /* Every element, in order, across many wraps of the ring */
+    while(expected < elements)
+    {
+        if(queue.TryPop(value))
+        {
+            ASSERT_EQ(expected, value);
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+    EXPECT_EQ(0U, queue.Size());
+}
@@ -12,6 +12,8 @@
 #include <gmock/gmock.h>
 
 #include <memory>
+#include <thread>
+#include <chrono>
 
 #include "../../inc/state_persistence.hpp"
 
@@ -184,4 +186,192 @@ TEST_F(StatePersistenceTest, DeleteAllItems)
     EXPECT_EQ(0, data_table.DeleteAllItems());
     EXPECT_EQ(0, data_table.NumberItems(number_items));
     EXPECT_EQ(0, number_items);
-}
\ No newline at end of file
+}
+TEST_F(StatePersistenceTest, StringValuesAreBound)
+{
+    DataTable data_table(m_database, "testtable", m_table1_item_def);
+    Entry item = m_table1_item_1;
+    item[1].value = std::string("it's a 'quoted', value");
+
+    EXPECT_EQ(0, data_table.InsertItem(item));
+
+    Entry item_read{
+        {"Var0", DataType::Integer,10},
+        {"Var1", DataType::String,},
+        {"Var2", DataType::Float,},
+        {"Var3", DataType::Boolean,}
+    };
+    EXPECT_EQ(0, data_table.GetItem(item_read));
+    EXPECT_EQ(std::get<std::string>(item[1].value), std::get<std::string>(item_read[1].value));
+}
+
+TEST_F(StatePersistenceTest, BatchedWritesSeenByReads)
+{
+    int number_items = 0;
+    auto database = std::make_shared<Database>("test.db", DatabaseSynchronous::Normal, 60000);
+    DataTable data_table(database, "testtable", m_table1_item_def);
+
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_2));
+    EXPECT_EQ(0, data_table.NumberItems(number_items));
+    EXPECT_EQ(2, number_items);
+}
+
+TEST_F(StatePersistenceTest, BatchedWritesCommittedInBackground)
+{
+    int number_items = 0;
+    auto database = std::make_shared<Database>("test.db", DatabaseSynchronous::Normal, 10);
+    DataTable data_table(database, "testtable", m_table1_item_def);
+    DataTable other_connection_table(m_database, "testtable", m_table1_item_def);
+
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    EXPECT_EQ(0, other_connection_table.NumberItems(number_items));
+    EXPECT_EQ(1, number_items);
+}
+
+TEST_F(StatePersistenceTest, BatchedWritesKeepOrder)
+{
+    int number_items = 0;
+    auto database = std::make_shared<Database>("test.db", DatabaseSynchronous::Normal, 60000);
+    DataTable data_table(database, "testtable", m_table1_item_def);
+    Entry item_1_mod = m_table1_item_1;
+    item_1_mod[1].value = std::string("modified");
+
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(0, data_table.SetItem(item_1_mod));
+    EXPECT_EQ(0, data_table.DeleteAllItems());
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(0, data_table.SetItem(m_table1_item_1));
+    EXPECT_EQ(0, data_table.SetItem(item_1_mod));
+
+    EXPECT_EQ(0, data_table.NumberItems(number_items));
+    EXPECT_EQ(1, number_items);
+
+    Entry item_read = m_table1_item_def;
+    item_read[0].value = 10;
+    EXPECT_EQ(0, data_table.GetItem(item_read));
+    EXPECT_EQ(std::string("modified"), std::get<std::string>(item_read[1].value));
+}
+
+TEST_F(StatePersistenceTest, BatchedWritesFlushedOnDestruction)
+{
+    int number_items = 0;
+
+    {
+        auto database = std::make_shared<Database>("test.db", DatabaseSynchronous::Normal, 60000);
+        DataTable data_table(database, "testtable", m_table1_item_def);
+        EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    }
+
+    DataTable data_table(m_database, "testtable", m_table1_item_def);
+    EXPECT_EQ(0, data_table.NumberItems(number_items));
+    EXPECT_EQ(1, number_items);
+}
+
+TEST_F(StatePersistenceTest, BatchedWriteFailureReported)
+{
+    int number_items = 0;
+    auto database = std::make_shared<Database>("test.db", DatabaseSynchronous::Normal, 60000);
+    DataTable data_table(database, "testtable", m_table1_item_def);
+
+    /* Both are queued, the duplicated one fails when committed */
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(0U, database->GetFailedWrites());
+
+    EXPECT_EQ(-1, database->Flush());
+    EXPECT_EQ(1U, database->GetFailedWrites());
+
+    EXPECT_EQ(0, data_table.NumberItems(number_items));
+    EXPECT_EQ(1, number_items);
+    EXPECT_EQ(0, database->Flush());
+}
+
+TEST_F(StatePersistenceTest, BatchedWaitedWriteReportsItsResult)
+{
+    int number_items = 0;
+    auto database = std::make_shared<Database>("test.db", DatabaseSynchronous::Normal, 60000);
+    DataTable data_table(database, "testtable", m_table1_item_def);
+    DataTable other_connection_table(m_database, "testtable", m_table1_item_def);
+    Entry item_1_mod = m_table1_item_1;
+    item_1_mod[1].value = std::string("modified");
+
+    /* The queued insert is committed first, then the waited one fails on its own */
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(-1, data_table.InsertItem(m_table1_item_1, true));
+    EXPECT_EQ(0U, database->GetFailedWrites());
+
+    EXPECT_EQ(0, data_table.SetItem(item_1_mod, true));
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_2, true));
+
+    /* Committed, not just queued */
+    EXPECT_EQ(0, other_connection_table.NumberItems(number_items));
+    EXPECT_EQ(2, number_items);
+
+    Entry item_read = m_table1_item_def;
+    item_read[0].value = 10;
+    EXPECT_EQ(0, other_connection_table.GetItem(item_read));
+    EXPECT_EQ(std::string("modified"), std::get<std::string>(item_read[1].value));
+}
+
+TEST_F(StatePersistenceTest, QueryItemsPaginated)
+{
+    const Entry detection_def{
+        {"ID",       DataType::Integer,},
+        {"DATE",     DataType::Integer,},
+        {"DURATION", DataType::Integer,}
+    };
+    DataTable data_table(m_database, "detections", detection_def);
+    Entry item = detection_def;
+    std::vector<int32_t> ids;
+
+    for(int32_t id = 0; id < 10; id++)
+    {
+        item[0].value = id;
+        item[1].value = 1000 + id * 10;
+        item[2].value = id;
+        EXPECT_EQ(0, data_table.InsertItem(item));
+    }
+
+    /* DATE 1020 to 1080: IDs 8 down to 2, three per page */
+    ItemRange range{"DATE", 1020, 1080, std::nullopt, std::nullopt, 3};
+    auto on_item = [&ids, &range](const Entry& entry)
+    {
+        ids.push_back(std::get<int32_t>(entry[0].value));
+        range.before_column = entry[1].value;
+        range.before_key = entry[0].value;
+        return true;
+    };
+
+    EXPECT_EQ(0, data_table.QueryItems(item, range, on_item));
+    EXPECT_EQ(std::vector<int32_t>({8, 7, 6}), ids);
+
+    EXPECT_EQ(0, data_table.QueryItems(item, range, on_item));
+    EXPECT_EQ(0, data_table.QueryItems(item, range, on_item));
+    EXPECT_EQ(std::vector<int32_t>({8, 7, 6, 5, 4, 3, 2}), ids);
+
+    /* Nothing after the last page */
+    EXPECT_EQ(0, data_table.QueryItems(item, range, on_item));
+    EXPECT_EQ(7U, ids.size());
+}
+
+TEST_F(StatePersistenceTest, QueryItemsStopped)
+{
+    DataTable data_table(m_database, "testtable", m_table1_item_def);
+    Entry item = m_table1_item_def;
+    int calls = 0;
+
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_1));
+    EXPECT_EQ(0, data_table.InsertItem(m_table1_item_2));
+
+    EXPECT_EQ(0, data_table.QueryItems(item, ItemRange{"Var0", 0, 100, std::nullopt, std::nullopt, 10},
+                                       [&calls](const Entry& entry) { calls++; return false; }));
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(20, std::get<int32_t>(item[0].value));
+    EXPECT_EQ(std::string("test2"), std::get<std::string>(item[1].value));
+
+    EXPECT_NE(0, data_table.QueryItems(item, ItemRange{"Unknown", 0, 100, std::nullopt, std::nullopt, 10},
+                                       [](const Entry& entry) { return true; }));
+}
@@ -0,0 +1,243 @@
+/**
+ * @author Alejandro Solozabal
+ *
+ * @file synthetic_kinect_tests.cpp
+ *
+ */
+
+/*******************************************************************
+ * Includes
+ *******************************************************************/
+#include <thread>
+#include <mutex>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "../../inc/synthetic_kinect.hpp"
+#include "../../inc/global_parameters.hpp"
+#include "../common/mocks/kinect_frame_observer_mock.hpp"
+
+/*******************************************************************
+ * Defines
+ *******************************************************************/
+#define TIMEOUT_MS 100U
+
+/*******************************************************************
+ * Test class definition
+ *******************************************************************/
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::Invoke;
+
+class SyntheticKinectTest : public ::testing::Test
+{
+public:
+    SyntheticSceneConfig config;
+
+    SyntheticKinectTest()
+    {
+        config.blob_active_frames = 10;
+        config.blob_idle_frames   = 10;
+    }
+
+    uint32_t CountDifferences(std::vector<uint16_t>& data, std::vector<uint16_t>& reference_data)
+    {
+        KinectDepthFrame frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+        KinectDepthFrame reference(DEPTH_WIDTH, DEPTH_HEIGHT);
+
+        frame.Fill(data.data(), 1);
+        reference.Fill(reference_data.data(), 0);
+
+        return frame.ComputeDifferences(reference, DETECTION_SENSITIVITY);
+    }
+};
+
+/*******************************************************************
+ * Test cases
+ *******************************************************************/
+TEST_F(SyntheticKinectTest, StartFailsIfNotInitialized)
+{
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+
+    ASSERT_NE(synthetic_kinect.Start(), 0);
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+    ASSERT_EQ(synthetic_kinect.Start(), 0);
+    ASSERT_EQ(synthetic_kinect.Stop(), 0);
+}
+
+TEST_F(SyntheticKinectTest, SameSeedSameFrames)
+{
+    SyntheticKinect synthetic_kinect_1(config, TIMEOUT_MS);
+    SyntheticKinect synthetic_kinect_2(config, TIMEOUT_MS);
+    std::vector<uint16_t> depth_1, depth_2, video_1, video_2;
+
+    ASSERT_EQ(synthetic_kinect_1.Init(), 0);
+    ASSERT_EQ(synthetic_kinect_2.Init(), 0);
+
+    for(uint32_t i = 0; i < 25; i++)
+    {
+        ASSERT_TRUE(synthetic_kinect_1.RenderFrames(depth_1, video_1));
+        ASSERT_TRUE(synthetic_kinect_2.RenderFrames(depth_2, video_2));
+        ASSERT_EQ(depth_1, depth_2);
+        ASSERT_EQ(video_1, video_2);
+    }
+}
+
+TEST_F(SyntheticKinectTest, GroundTruth)
+{
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+
+    /* Every period starts empty */
+    EXPECT_FALSE(synthetic_kinect.IsIntrusionFrame(1));
+    EXPECT_FALSE(synthetic_kinect.IsIntrusionFrame(10));
+    EXPECT_TRUE(synthetic_kinect.IsIntrusionFrame(11));
+    EXPECT_TRUE(synthetic_kinect.IsIntrusionFrame(20));
+    EXPECT_FALSE(synthetic_kinect.IsIntrusionFrame(21));
+
+    config.blob_count = 0;
+    SyntheticKinect empty_synthetic_kinect(config, TIMEOUT_MS);
+    EXPECT_FALSE(empty_synthetic_kinect.IsIntrusionFrame(11));
+}
+
+TEST_F(SyntheticKinectTest, BlobsAreDetectableAndNoiseIsNot)
+{
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+    std::vector<uint16_t> reference, depth, video;
+
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+    synthetic_kinect.RenderFrames(reference, video);
+
+    for(uint64_t sequence = 2; sequence <= 40; sequence++)
+    {
+        synthetic_kinect.RenderFrames(depth, video);
+
+        if(synthetic_kinect.IsIntrusionFrame(sequence))
+        {
+            EXPECT_GT(CountDifferences(depth, reference), DETECTION_THRESHOLD) << "sequence " << sequence;
+        }
+        else
+        {
+            EXPECT_LT(CountDifferences(depth, reference), DETECTION_THRESHOLD) << "sequence " << sequence;
+        }
+    }
+}
+
+TEST_F(SyntheticKinectTest, DropoutsAreBlankPixels)
+{
+    std::vector<uint16_t> depth, video;
+
+    config.dropout_per_mille = 100;
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+
+    synthetic_kinect.RenderFrames(depth, video);
+    uint32_t blank_pixels = std::count(depth.begin(), depth.end(), BLANK_DEPTH_PIXEL);
+
+    EXPECT_GT(blank_pixels, depth.size() / 20);
+    EXPECT_LT(blank_pixels, depth.size() / 5);
+}
+
+TEST_F(SyntheticKinectTest, VideoFrameDivider)
+{
+    std::vector<uint16_t> depth, video;
+
+    config.video_frame_divider = 3;
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+
+    EXPECT_FALSE(synthetic_kinect.RenderFrames(depth, video));
+    EXPECT_FALSE(synthetic_kinect.RenderFrames(depth, video));
+    EXPECT_TRUE(synthetic_kinect.RenderFrames(depth, video));
+}
+
+TEST_F(SyntheticKinectTest, FasterThanSensorRate)
+{
+    std::atomic<uint64_t> depth_frames(0);
+    auto observer = std::make_shared<NiceMock<KinectFrameObserverMock>>();
+
+    ON_CALL(*observer, NewDepthFrame(_, _)).WillByDefault(Invoke([&depth_frames](const KinectDepthFrame&, uint64_t)
+    {
+        depth_frames++;
+    }));
+
+    config.frame_interval_ms = 0;
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+    ASSERT_EQ(synthetic_kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+
+    ASSERT_EQ(synthetic_kinect.Start(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ASSERT_EQ(synthetic_kinect.Stop(), 0);
+
+    /* 30 fps sensor would deliver 15 frames */
+    EXPECT_GT(depth_frames, 3 * 15U);
+    EXPECT_EQ(depth_frames, synthetic_kinect.GetNumberOfFrames());
+}
+
+TEST_F(SyntheticKinectTest, GroundTruthAfterRestart)
+{
+    std::mutex mutex;
+    std::vector<KinectDepthFrame> frames;
+    std::vector<uint64_t> sequences;
+    auto observer = std::make_shared<NiceMock<KinectFrameObserverMock>>();
+
+    ON_CALL(*observer, NewDepthFrame(_, _)).WillByDefault(Invoke([&](const KinectDepthFrame& frame, uint64_t sequence)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames.push_back(frame);
+        sequences.push_back(sequence);
+    }));
+
+    config.frame_interval_ms = 5;
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+    ASSERT_EQ(synthetic_kinect.Subscribe(KinectFrameType::Depth, observer), 0);
+
+    ASSERT_EQ(synthetic_kinect.Start(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(synthetic_kinect.Stop(), 0);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_FALSE(frames.empty());
+        frames.clear();
+        sequences.clear();
+    }
+
+    /* The scene starts over, the observer sequence doesn't: the ground truth goes by timestamp */
+    ASSERT_EQ(synthetic_kinect.Start(), 0);
+    while(synthetic_kinect.GetNumberOfFrames() < 2 * config.blob_idle_frames)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(synthetic_kinect.Stop(), 0);
+
+    ASSERT_GE(frames.size(), 2 * config.blob_idle_frames);
+    EXPECT_EQ(1U, frames.front().GetTimestamp());
+    EXPECT_GT(sequences.front(), 1U);
+    for(auto& frame : frames)
+    {
+        uint32_t differences = frame.ComputeDifferences(frames.front(), DETECTION_SENSITIVITY);
+
+        EXPECT_EQ(synthetic_kinect.IsIntrusionFrame(frame.GetTimestamp()), differences > DETECTION_THRESHOLD)
+            << "timestamp " << frame.GetTimestamp();
+    }
+}
+
+TEST_F(SyntheticKinectTest, GetDepthFrame)
+{
+    KinectDepthFrame frame(DEPTH_WIDTH, DEPTH_HEIGHT);
+
+    config.frame_interval_ms = 5;
+    SyntheticKinect synthetic_kinect(config, TIMEOUT_MS);
+    ASSERT_EQ(synthetic_kinect.Init(), 0);
+    ASSERT_EQ(synthetic_kinect.Start(), 0);
+
+    synthetic_kinect.GetDepthFrame(frame);
+    uint32_t timestamp = frame.GetTimestamp();
+    EXPECT_NE(timestamp, 0U);
+
+    synthetic_kinect.GetDepthFrame(frame);
+    EXPECT_GT(frame.GetTimestamp(), timestamp);
+
+    ASSERT_EQ(synthetic_kinect.Stop(), 0);
+}